@@ -0,0 +1,144 @@
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory_resource>
+#include <new>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace sp {
+  // Monotonic bump allocator scoped to one time window. Everything buffered
+  // for the window (records, copied line bytes, sort buffers) is
+  // carved out of large blocks and released in one shot by Reset() when the
+  // window is flushed. Blocks are kept across windows, so once the arena has
+  // grown to the size of the largest window the steady state never calls
+  // into the upstream allocator.
+  //
+  // Not thread safe: give each allocating thread its own arena, or only use
+  // it behind a lock. Not meant for long-lived containers such as
+  // MPSCQueue: Reset() frees whatever they still hold, and without Reset()
+  // the arena only grows.
+  class WindowArena : public std::pmr::memory_resource {
+  public:
+    static constexpr size_t kDefaultBlockSize = 1024 * 1024;
+
+    explicit WindowArena(
+      size_t p_block_size = kDefaultBlockSize,
+      std::pmr::memory_resource* p_upstream = std::pmr::get_default_resource())
+      : block_size_(std::max<size_t>(p_block_size, 64)),
+        upstream_(p_upstream) {}
+
+    WindowArena(const WindowArena&) = delete;
+    WindowArena& operator=(const WindowArena&) = delete;
+
+    ~WindowArena() override {
+      for (const auto& block : blocks_) {
+        upstream_->deallocate(block.data, block.size, alignof(std::max_align_t));
+      }
+    }
+
+    void* Allocate(size_t p_bytes, size_t p_alignment = alignof(std::max_align_t)) {
+      if (p_bytes == 0) p_bytes = 1;
+      while (current_block_ < blocks_.size()) {
+        if (void* ptr = BumpCurrent(p_bytes, p_alignment)) return ptr;
+        // Leave the tail of this block unused until the next Reset()
+        ++current_block_;
+        offset_ = 0;
+      }
+
+      const size_t size = std::max(block_size_, p_bytes + p_alignment);
+      auto* data = static_cast<std::byte*>(
+        upstream_->allocate(size, alignof(std::max_align_t)));
+      blocks_.push_back({data, size});
+      bytes_reserved_ += size;
+      current_block_ = blocks_.size() - 1;
+      offset_ = 0;
+      return BumpCurrent(p_bytes, p_alignment);
+    }
+
+    // Objects created here are never destroyed, only use trivially
+    // destructible types or types whose storage is all arena owned.
+    template<typename T, typename... Args>
+    T* Create(Args&&... p_args) {
+      void* ptr = Allocate(sizeof(T), alignof(T));
+      return ::new (ptr) T(std::forward<Args>(p_args)...);
+    }
+
+    // Copies p_str into the arena, the view stays valid until Reset()
+    std::string_view CopyString(std::string_view p_str) {
+      if (p_str.empty()) return {};
+      auto* dest = static_cast<char*>(Allocate(p_str.size(), 1));
+      std::memcpy(dest, p_str.data(), p_str.size());
+      return {dest, p_str.size()};
+    }
+
+    // Releases the whole window. Oversized blocks are returned upstream so a
+    // single huge window does not pin its memory forever.
+    void Reset() {
+      auto keep = std::remove_if(blocks_.begin(), blocks_.end(),
+        [this](const Block& block) {
+          if (block.size <= block_size_ * 4) return false;
+          upstream_->deallocate(block.data, block.size, alignof(std::max_align_t));
+          bytes_reserved_ -= block.size;
+          return true;
+        });
+      blocks_.erase(keep, blocks_.end());
+      current_block_ = 0;
+      offset_ = 0;
+      bytes_used_ = 0;
+    }
+
+    size_t GetBytesUsed() const { return bytes_used_; }
+    size_t GetBytesReserved() const { return bytes_reserved_; }
+    size_t GetBlockCount() const { return blocks_.size(); }
+
+  private:
+    struct Block {
+      std::byte* data;
+      size_t size;
+    };
+
+    void* BumpCurrent(size_t p_bytes, size_t p_alignment) {
+      auto& block = blocks_[current_block_];
+      const auto base = reinterpret_cast<std::uintptr_t>(block.data);
+      const auto aligned = (base + offset_ + p_alignment - 1) & ~(p_alignment - 1);
+      const size_t start = aligned - base;
+      if (start + p_bytes > block.size) return nullptr;
+      offset_ = start + p_bytes;
+      bytes_used_ += p_bytes;
+      return block.data + start;
+    }
+
+    void* do_allocate(size_t p_bytes, size_t p_alignment) override {
+      return Allocate(p_bytes, p_alignment);
+    }
+
+    // Monotonic: individual frees are no-ops, Reset() reclaims everything
+    void do_deallocate(void*, size_t, size_t) override {}
+
+    bool do_is_equal(const std::pmr::memory_resource& p_other) const noexcept override {
+      return this == &p_other;
+    }
+
+    size_t block_size_;
+    std::pmr::memory_resource* upstream_;
+    std::vector<Block> blocks_;
+    size_t current_block_ = 0;
+    size_t offset_ = 0;
+    size_t bytes_used_ = 0;
+    size_t bytes_reserved_ = 0;
+  };
+
+  namespace pmr {
+    // Sort buffer for one window, e.g. WindowBuffer<MktDataMessage> buf(&arena)
+    template<typename T>
+    using WindowBuffer = std::pmr::vector<T>;
+  } // namespace pmr
+} // namespace sp
+
+#endif // ARENA_HPP
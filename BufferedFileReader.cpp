@@ -0,0 +1,141 @@
+#include "BufferedFileReader.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace sp;
+
+BufferedFileReader::BufferedFileReader(const std::string& p_filename, size_t p_offset,
+                                       size_t p_buffer_size, size_t p_buffer_count)
+  : filename_(p_filename),
+    buffer_size_(std::max<size_t>(p_buffer_size, 4096)),
+    filled_(std::max<size_t>(p_buffer_count, 2)),
+    free_(std::max<size_t>(p_buffer_count, 2)),
+    position_(p_offset) {
+  fd_ = open(filename_.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd_ == -1) {
+    last_error_ = Error::FileOpenFailed;
+    return;
+  }
+  struct stat file_stat;
+  if (fstat(fd_, &file_stat) == -1) {
+    last_error_ = Error::FileOpenFailed;
+    close(fd_);
+    fd_ = -1;
+    return;
+  }
+  file_size_ = static_cast<size_t>(file_stat.st_size);
+  // The file is read front to back exactly once
+  posix_fadvise(fd_, static_cast<off_t>(p_offset), 0, POSIX_FADV_SEQUENTIAL);
+
+  const size_t count = std::max<size_t>(p_buffer_count, 2);
+  buffers_.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    buffers_.push_back(std::make_unique<char[]>(buffer_size_));
+    free_.TryPush(i);
+  }
+  io_thread_ = std::thread(&BufferedFileReader::FillLoop, this, p_offset);
+}
+
+BufferedFileReader::~BufferedFileReader() {
+  filled_.Close();
+  free_.Close();
+  if (io_thread_.joinable()) io_thread_.join();
+  if (fd_ != -1) close(fd_);
+}
+
+void BufferedFileReader::FillLoop(size_t p_offset) {
+  size_t offset = p_offset;
+  for (;;) {
+    const auto buffer = free_.Pop();
+    if (!buffer) return; // Reader destroyed
+    Block block;
+    block.buffer = *buffer;
+    char* data = buffers_[*buffer].get();
+    const size_t want = std::min(buffer_size_, file_size_ > offset ? file_size_ - offset : 0);
+    while (block.length < want) {
+      const ssize_t n = pread(fd_, data + block.length, want - block.length,
+                              static_cast<off_t>(offset + block.length));
+      if (n > 0) {
+        block.length += static_cast<size_t>(n);
+      } else if (n == 0 || errno != EINTR) {
+        // Truncated under us or an I/O error, either way nothing more to read
+        block.error = n == 0 ? 0 : errno;
+        block.last = true;
+        break;
+      }
+    }
+    offset += block.length;
+    block.last = block.last || offset >= file_size_;
+    if (!filled_.Push(block) || block.last) return;
+  }
+}
+
+bool BufferedFileReader::NextBlock() {
+  if (current_) {
+    const bool last = current_->last;
+    free_.TryPush(current_->buffer); // Never full, it holds every buffer
+    current_.reset();
+    if (last) return false;
+  }
+  current_ = filled_.Pop();
+  pos_ = 0;
+  if (!current_) return false;
+  if (current_->error != 0) {
+    std::cerr << "Failed to read file: " << filename_ << " with error: "
+              << std::strerror(current_->error) << std::endl;
+    last_error_ = Error::ReadFailed;
+  }
+  return true;
+}
+
+std::optional<std::string_view> BufferedFileReader::ReadLineView() {
+  if (carry_returned_) {
+    carry_.clear();
+    carry_returned_ = false;
+  }
+  if (!IsValid() || finished_) {
+    if (IsValid() && last_error_ == Error::None) last_error_ = Error::EndOfFile;
+    return std::nullopt;
+  }
+  for (;;) {
+    if (current_ && pos_ < current_->length) {
+      const char* data = buffers_[current_->buffer].get();
+      const char* begin = data + pos_;
+      const auto* newline = static_cast<const char*>(
+        std::memchr(begin, '\n', current_->length - pos_));
+      if (newline != nullptr) {
+        const size_t length = static_cast<size_t>(newline - begin);
+        pos_ += length + 1;
+        if (carry_.empty()) {
+          position_ += length + 1;
+          return std::string_view(begin, length);
+        }
+        carry_.append(begin, length);
+        position_ += carry_.size() + 1;
+        carry_returned_ = true;
+        return std::string_view(carry_);
+      }
+      // Continues in the next block
+      carry_.append(begin, current_->length - pos_);
+      pos_ = current_->length;
+    }
+    if (!NextBlock()) break;
+    if (last_error_ == Error::ReadFailed) break;
+  }
+
+  finished_ = true;
+  if (last_error_ == Error::None) last_error_ = Error::EndOfFile;
+  if (!carry_.empty() && last_error_ == Error::EndOfFile) {
+    // Unterminated last line
+    position_ += carry_.size();
+    carry_returned_ = true;
+    return std::string_view(carry_);
+  }
+  return std::nullopt;
+}
@@ -0,0 +1,84 @@
+#ifndef BufferedFileReader_hpp
+#define BufferedFileReader_hpp
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "SPSCRing.hpp"
+
+namespace sp {
+  // Line reader that keeps the disk ahead of the parser. An I/O thread
+  // pread()s the file into one of p_buffer_count owned buffers while the
+  // caller parses the previous one, filled buffers travel to the caller and
+  // empty ones back over two SPSCRings. The parsing thread never takes a
+  // page fault on file data and never waits for the disk as long as parsing
+  // a buffer takes longer than reading the next one.
+  class BufferedFileReader {
+  public:
+    enum class Error {
+      None,
+      FileOpenFailed,
+      ReadFailed,
+      EndOfFile
+    };
+
+    static constexpr size_t kDefaultBufferSize = 1024 * 1024;
+    static constexpr size_t kDefaultBufferCount = 2;
+
+    // Reads from p_offset to the end of the file as it is at construction
+    explicit BufferedFileReader(const std::string& p_filename, size_t p_offset = 0,
+                                size_t p_buffer_size = kDefaultBufferSize,
+                                size_t p_buffer_count = kDefaultBufferCount);
+    ~BufferedFileReader();
+
+    BufferedFileReader(const BufferedFileReader&) = delete;
+    BufferedFileReader& operator=(const BufferedFileReader&) = delete;
+
+    bool IsValid() const { return fd_ != -1; }
+    Error GetLastError() const { return last_error_; }
+    const std::string& GetFilename() const { return filename_; }
+
+    // Next line without its '\n', nullopt at the end (EndOfFile) or on a read
+    // error (ReadFailed). The view is valid until the next call; it points
+    // into a buffer the I/O thread refills once the parser moves on.
+    std::optional<std::string_view> ReadLineView();
+    // File offset of the next line
+    size_t GetPosition() const { return position_; }
+
+  private:
+    struct Block {
+      size_t buffer = 0; // Index into buffers_
+      size_t length = 0;
+      bool last = false; // End of file or read error, no blocks follow
+      int error = 0;     // errno of a failed read
+    };
+
+    void FillLoop(size_t p_offset);
+    // Hands the current buffer back and waits for the next, false at the end
+    bool NextBlock();
+
+    int fd_ = -1;
+    std::string filename_;
+    Error last_error_ = Error::None;
+    size_t file_size_ = 0;
+    size_t buffer_size_;
+    std::vector<std::unique_ptr<char[]>> buffers_;
+    SPSCRing<Block> filled_; // I/O thread -> parser
+    SPSCRing<size_t> free_;  // Parser -> I/O thread
+    std::thread io_thread_;
+
+    // Parser side
+    std::optional<Block> current_;
+    size_t pos_ = 0;      // In the current block
+    size_t position_ = 0; // File offset of the next line
+    std::string carry_;   // Line split across blocks
+    bool carry_returned_ = false;
+    bool finished_ = false;
+  };
+}// namespace sp
+
+#endif // BufferedFileReader_hpp
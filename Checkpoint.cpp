@@ -0,0 +1,128 @@
+#include "Checkpoint.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace sp;
+
+namespace {
+  constexpr const char* kHeader = "# MktDataAggregator merge checkpoint v1";
+  // Bytes hashed by OutputFingerprint, a few lines of output
+  constexpr size_t kFingerprintBytes = 4096;
+}
+
+std::optional<size_t> MergeCheckpoint::GetInputOffset(
+  const std::string& p_filename) const {
+  for (const auto& input : inputs) {
+    if (input.filename == p_filename) return input.offset;
+  }
+  return std::nullopt;
+}
+
+// One "key<TAB>value" per line, the value may contain spaces (timestamps,
+// file names). Inputs are "input<TAB>offset<TAB>filename".
+bool MergeCheckpoint::Save(const std::string& p_path) const {
+  std::ostringstream out;
+  out << kHeader << '\n'
+      << "output_length\t" << output_length << '\n'
+      << "records_written\t" << records_written << '\n'
+      << "last_timestamp\t" << last_timestamp << '\n'
+      << "last_symbol\t" << last_symbol << '\n';
+  for (const auto& input : inputs) {
+    out << "input\t" << input.offset << '\t' << input.filename << '\n';
+  }
+  return WriteFileAtomically(p_path, out.view());
+}
+
+std::optional<MergeCheckpoint> MergeCheckpoint::Load(const std::string& p_path) {
+  std::ifstream in(p_path);
+  if (!in) return std::nullopt;
+
+  std::string line;
+  if (!std::getline(in, line) || line != kHeader) {
+    std::cerr << "Not a merge checkpoint: " << p_path << std::endl;
+    return std::nullopt;
+  }
+
+  MergeCheckpoint checkpoint;
+  while (std::getline(in, line)) {
+    const auto tab = line.find('\t');
+    if (tab == std::string::npos) continue;
+    const auto key = line.substr(0, tab);
+    const auto value = line.substr(tab + 1);
+    try {
+      if (key == "output_length") {
+        checkpoint.output_length = std::stoull(value);
+      } else if (key == "records_written") {
+        checkpoint.records_written = std::stoull(value);
+      } else if (key == "last_timestamp") {
+        checkpoint.last_timestamp = value;
+      } else if (key == "last_symbol") {
+        checkpoint.last_symbol = value;
+      } else if (key == "input") {
+        const auto second_tab = value.find('\t');
+        if (second_tab == std::string::npos) continue;
+        checkpoint.inputs.push_back(
+          {value.substr(second_tab + 1), std::stoull(value.substr(0, second_tab))});
+      }
+    } catch (const std::exception&) {
+      std::cerr << "Corrupt checkpoint line: " << line << std::endl;
+      return std::nullopt;
+    }
+  }
+  return checkpoint;
+}
+
+bool sp::WriteFileAtomically(const std::string& p_path, std::string_view p_bytes) {
+  const std::string tmp_path = p_path + ".tmp";
+  const int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd == -1) {
+    std::cerr << "Failed to open file: " << tmp_path << std::endl;
+    return false;
+  }
+  bool ok = true;
+  while (ok && !p_bytes.empty()) {
+    const ssize_t written = write(fd, p_bytes.data(), p_bytes.size());
+    if (written < 0 && errno == EINTR) continue;
+    ok = written > 0;
+    if (ok) p_bytes.remove_prefix(static_cast<size_t>(written));
+  }
+  ok = ok && fsync(fd) == 0;
+  ok = close(fd) == 0 && ok;
+  if (!ok) {
+    std::cerr << "Failed to write file: " << tmp_path << std::endl;
+    std::remove(tmp_path.c_str());
+    return false;
+  }
+  if (std::rename(tmp_path.c_str(), p_path.c_str()) != 0) {
+    std::cerr << "Failed to commit file: " << p_path << std::endl;
+    return false;
+  }
+  return true;
+}
+
+std::optional<OutputFingerprint> OutputFingerprint::Of(const std::string& p_path,
+                                                       uint64_t p_length) {
+  const int fd = open(p_path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1) return std::nullopt;
+  struct stat st{};
+  char buffer[kFingerprintBytes];
+  const size_t size = static_cast<size_t>(std::min<uint64_t>(p_length, sizeof(buffer)));
+  const bool ok = fstat(fd, &st) == 0 && static_cast<uint64_t>(st.st_size) >= p_length &&
+    pread(fd, buffer, size, static_cast<off_t>(p_length - size)) == static_cast<ssize_t>(size);
+  close(fd);
+  if (!ok) return std::nullopt;
+  // FNV-1a
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash ^ static_cast<unsigned char>(buffer[i])) * 0x100000001b3ull;
+  }
+  return OutputFingerprint{p_length, hash};
+}
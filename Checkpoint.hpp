@@ -0,0 +1,57 @@
+#ifndef Checkpoint_hpp
+#define Checkpoint_hpp
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace sp {
+  // Restart point of a MergeJob. Every input offset is the file position of
+  // the first line not yet written (MMF mapped offset + current position),
+  // and output_length is the size of the output containing exactly the
+  // records emitted before that point.
+  struct MergeCheckpoint {
+    struct Input {
+      std::string filename;
+      size_t offset = 0;
+    };
+
+    std::vector<Input> inputs;
+    std::string last_timestamp; // Of the last emitted record
+    std::string last_symbol;
+    size_t output_length = 0;
+    size_t records_written = 0;
+
+    std::optional<size_t> GetInputOffset(const std::string& p_filename) const;
+
+    // Written with WriteFileAtomically
+    bool Save(const std::string& p_path) const;
+    static std::optional<MergeCheckpoint> Load(const std::string& p_path);
+  };
+
+  // Identity of the first length bytes of an output: the length and a hash
+  // of the bytes just before it. Sidecars save it so that a reader can tell
+  // an output that was only appended to from one that was rewritten.
+  struct OutputFingerprint {
+    uint64_t length = 0;
+    uint64_t tail_hash = 0;
+
+    // Of the first p_length bytes of p_path, nullopt if it is shorter
+    static std::optional<OutputFingerprint> Of(const std::string& p_path, uint64_t p_length);
+    // p_path still starts with the fingerprinted bytes
+    bool Matches(const std::string& p_path) const {
+      const auto current = Of(p_path, length);
+      return current && current->tail_hash == tail_hash;
+    }
+  };
+  static_assert(sizeof(OutputFingerprint) == 16);
+
+  // Writes p_bytes to a temporary file, fsyncs it and renames it over
+  // p_path, so that a crash mid-save leaves the previous file intact. Used
+  // for the checkpoint and every index saved next to the output.
+  bool WriteFileAtomically(const std::string& p_path, std::string_view p_bytes);
+}// namespace sp
+
+#endif // Checkpoint_hpp
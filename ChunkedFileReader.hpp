@@ -1,11 +1,17 @@
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <iostream>
+#include <optional>
 #include <string>
 #include <thread>
 #include <atomic>
 
+#include "Arena.hpp"
+#include "BufferedFileReader.hpp"
+#include "InputFilter.hpp"
 #include "MPSCQueue.hpp" // Assume this is your MPSCQueue header
+#include "MemoryBudget.hpp"
 #include "MktData.hpp"
 #include "MktDataMessage.hpp"
 #include "Mmf.hpp"
@@ -30,7 +36,7 @@ public:
     std::chrono::seconds timespan = std::chrono::hours(1))
     :
       filename_(filename),
-      symbol_(filename_.substr(filename_.find_first_of(".") + 1)),
+      symbol_(sp::MktData::GetSymbolFromFilename(filename_)),
       queue_(queue),
       chunk_size_(chunk_size),
       stop_flag_(false),
@@ -41,23 +47,72 @@ public:
     }
 
   void Run() {
+    // Pin first: the constructor only sets the mapping up, so the page
+    // faults of the seek and the reads below, and the parse buffers this
+    // thread allocates, all land on the cpu's local node.
+    if (cpu_ && !sp::PinCurrentThreadToCpu(*cpu_)) {
+      std::cerr << "Failed to pin reader for file: " << filename_
+                << " to cpu: " << *cpu_ << std::endl;
+    }
     if (!mmf_.IsValid()) {
       std::cerr << "Failed to open file: " << filename_ << " with error: "
-                << mmf_.GetLastError() << std::endl;
+                << static_cast<int>(mmf_.GetLastError()) << std::endl;
+      return;
+    }
+    if (buffer_count_ != 0 && !line_arena_) {
+      // The queued views would point into buffers the I/O thread refills
+      std::cerr << "Buffered read without a line arena, not reading: "
+                << filename_ << std::endl;
+      return;
+    }
+    if (filter_ && !filter_->AcceptsSymbol(symbol_)) {
+      std::cout << "Symbol: " << symbol_ << " is filtered out, not reading: "
+                << filename_ << std::endl;
       return;
     }
+    size_t start_offset = 0;
+    if (filter_ && !filter_->GetStartTime().empty()) {
+      // Start at the first line of the time range instead of reading up to it
+      const auto start = sp::SeekFileToTime(filename_, filter_->GetStartTime());
+      if (!start) return;
+      if (*start >= mmf_.GetFileSize().value_or(0)) return; // Nothing in range
+      start_offset = *start;
+      if (*start != 0 && buffer_count_ == 0) {
+        mmf_ = sp::MMF(filename_, *start, chunk_size_, sp::MMF::OpenMode::ReadOnly);
+        if (!mmf_.IsValid()) {
+          std::cerr << "Failed to seek file: " << filename_ << " to: " << *start
+                    << " with error: " << static_cast<int>(mmf_.GetLastError()) << std::endl;
+          return;
+        }
+      }
+    }
     ++thread_count_;
 
     std::cout << "Starting thread " << thread_id_ << " for file: " << filename_
               << " with symbol: " << symbol_
               << " and chunk size: " << chunk_size_ << std::endl;
 
+    // Read-ahead on its own thread, this one only parses
+    std::optional<sp::BufferedFileReader> buffered;
+    if (buffer_count_ != 0) {
+      buffered.emplace(filename_, start_offset, chunk_size_, buffer_count_);
+      if (!buffered->IsValid()) {
+        std::cerr << "Failed to open file: " << filename_ << " for buffered reading" << std::endl;
+        return;
+      }
+    }
+
     using namespace std::chrono;
     size_t prev_hour_ = 0;
     while (!stop_flag_) {
-      auto line_opt = mmf_.ReadLineView(true);
+      auto line_opt = buffered ? buffered->ReadLineView() : mmf_.ReadLineView(true);
       if (!line_opt) break;
       if (line_opt->empty()) continue; // Skip empty lines
+      if (filter_) {
+        if (!sp::MktData::IsDataLine(*line_opt)) continue;
+        if (filter_->IsPastEnd(sp::MktData::GetTimestampField(*line_opt))) break;
+        if (!filter_->AcceptsLine(*line_opt)) continue;
+      }
       if (line_opt->size() > chunk_size_) {
         std::cerr << "Line exceeds chunk size, skipping: " << *line_opt << std::endl;
         continue; // Skip lines that are too large
@@ -74,29 +129,63 @@ public:
           << prev_hour_ << " is finished for all other symbols"
           << ", thread_id:" << thread_id_ <<  std::endl;
         queue_.WaitUntilDoneFileReset();
+        // The consumer has flushed the previous window, its lines are dead
+        if (line_arena_) line_arena_->Reset();
         std::cout << "Resuming thread " << thread_id_ << " for file: "
                   << filename_ << " with symbol: " << symbol_
                   << " after hour change to: " << hour << std::endl;
       }
 
-      queue_.Enqueue( {symbol_, line_opt.value(), hour}); // or whatever your queue method is
+      // The mapping is replaced when ReadLineView extends it and read buffers
+      // are refilled, so views into either must not outlive the window unless
+      // the bytes are copied out first.
+      auto line = line_opt.value();
+      if (line_arena_) line = line_arena_->CopyString(line);
+
+      queue_.Enqueue( {symbol_, line, hour}); // or whatever your queue method is
     }
   }
 
   void Stop() { stop_flag_ = true; }
 
+  // Must be called before Run(), see sp::PlanCpuPlacement
+  void SetCpuAffinity(unsigned int cpu) { cpu_ = cpu; }
+
+  // Lines are copied into p_arena and released in one shot at every hour
+  // change. The arena must only be used by this reader. Call before Run().
+  void SetLineArena(sp::WindowArena* p_arena) { line_arena_ = p_arena; }
+
+  // Reads through p_buffer_count buffers of chunk size filled by a
+  // separate I/O thread (see sp::BufferedFileReader) instead of faulting
+  // the mapping in on this thread. 0, the default, reads the mapping.
+  // Lines are only valid until their buffer is refilled, so Run() refuses
+  // to read without SetLineArena. Call before Run().
+  void SetBufferedRead(size_t p_buffer_count) { buffer_count_ = p_buffer_count; }
+
+  // Lines outside p_filter are dropped before Enqueue, a filtered out symbol
+  // is not read at all. p_filter must outlive Run(), call before Run().
+  void SetFilter(const sp::InputFilter* p_filter) { filter_ = p_filter; }
+
+  // Per-thread share of the read window budget. Queue, sort and output
+  // buffers have their own shares, see sp::MemoryBudget.
   static size_t GetDefaultChunkSize() {
-    const size_t max_mem = sp::GetMaxMemoryPerThread();
-    return (max_mem > 1024 * 1024) ? (max_mem - 1024 * 1024) : max_mem;
+    static const sp::MemoryBudget budget;
+    const size_t window = budget.GetStageBudgetPerThread(
+      sp::MemoryBudget::Stage::ReadWindows, budget.GetEffectiveCpuCount());
+    return std::max<size_t>(window, 1024 * 1024);
   }
 
 private:
   std::string filename_;
-  std::string_view symbol_;
+  std::string symbol_;
   QueueType& queue_;
   size_t chunk_size_;
   std::atomic<bool> stop_flag_;
   sp::MMF mmf_;
-  thread_local size_t thread_id_ = thread_count_++; // Unique ID for each thread
+  std::optional<unsigned int> cpu_;
+  sp::WindowArena* line_arena_ = nullptr;
+  const sp::InputFilter* filter_ = nullptr;
+  size_t buffer_count_ = 0;
+  size_t thread_id_ = thread_count_++; // Unique ID for each thread
 };
 } // namespace sp
\ No newline at end of file
@@ -0,0 +1,403 @@
+#include "CompressedFile.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sys/mman.h>
+#include <zlib.h>
+
+#ifdef SP_HAVE_ZSTD // Set by the build when libzstd is linked
+#include <zstd.h>
+#endif
+
+using namespace sp;
+
+namespace {
+  constexpr size_t kStreamBlockSize = 1024 * 1024;
+
+  // gzip member header (RFC 1952) with FEXTRA
+  constexpr unsigned char kGzipId1 = 0x1f;
+  constexpr unsigned char kGzipId2 = 0x8b;
+  constexpr unsigned char kGzipDeflate = 8;
+  constexpr unsigned char kGzipFlagExtra = 4;
+  constexpr size_t kGzipFixedHeader = 10;
+  // Shortest deflate stream (an empty final block) and the CRC32 + ISIZE
+  // trailer
+  constexpr size_t kMinDeflateData = 2;
+  constexpr size_t kGzipTrailer = 8;
+  // Largest BGZF payload, a member claiming more in ISIZE is not trusted
+  // to size the output up front
+  constexpr size_t kBgzfMaxPayload = 64 * 1024;
+
+  // Little endian zstd frame magic 0xFD2FB528
+  constexpr unsigned char kZstdMagic[] = {0x28, 0xb5, 0x2f, 0xfd};
+
+  uint16_t ReadLe16(const unsigned char* p_data) {
+    return static_cast<uint16_t>(p_data[0] | (p_data[1] << 8));
+  }
+
+  uint32_t ReadLe32(const unsigned char* p_data) {
+    return static_cast<uint32_t>(p_data[0]) | (static_cast<uint32_t>(p_data[1]) << 8) |
+           (static_cast<uint32_t>(p_data[2]) << 16) | (static_cast<uint32_t>(p_data[3]) << 24);
+  }
+
+  // Total size of the member starting at p_data from its "BC" extra
+  // subfield, nullopt if it does not carry one or the size cannot even hold
+  // the member's header and trailer
+  std::optional<size_t> GetBgzfMemberSize(const unsigned char* p_data, size_t p_size) {
+    if (p_size < kGzipFixedHeader + 2 || p_data[0] != kGzipId1 || p_data[1] != kGzipId2 ||
+        p_data[2] != kGzipDeflate || !(p_data[3] & kGzipFlagExtra)) {
+      return std::nullopt;
+    }
+    const size_t extra_length = ReadLe16(p_data + kGzipFixedHeader);
+    const unsigned char* extra = p_data + kGzipFixedHeader + 2;
+    if (kGzipFixedHeader + 2 + extra_length > p_size) return std::nullopt;
+    for (size_t pos = 0; pos + 4 <= extra_length;) {
+      const size_t length = ReadLe16(extra + pos + 2);
+      if (extra[pos] == 'B' && extra[pos + 1] == 'C' && length == 2 && pos + 6 <= extra_length) {
+        const size_t size = static_cast<size_t>(ReadLe16(extra + pos + 4)) + 1;
+        if (size < kGzipFixedHeader + 2 + extra_length + kMinDeflateData + kGzipTrailer) {
+          return std::nullopt;
+        }
+        return size;
+      }
+      pos += 4 + length;
+    }
+    return std::nullopt;
+  }
+}
+
+CompressedFile::Format CompressedFile::DetectFormat(std::string_view p_data) {
+  const auto* bytes = reinterpret_cast<const unsigned char*>(p_data.data());
+  if (p_data.size() >= 2 && bytes[0] == kGzipId1 && bytes[1] == kGzipId2) return Format::Gzip;
+  if (p_data.size() >= 4 && std::memcmp(bytes, kZstdMagic, 4) == 0) return Format::Zstd;
+  return Format::Unknown;
+}
+
+CompressedFile::Format CompressedFile::DetectFormat(const std::string& p_filename) {
+  char magic[4] = {};
+  std::ifstream in(p_filename, std::ios::binary);
+  in.read(magic, sizeof(magic));
+  return DetectFormat(std::string_view(magic, static_cast<size_t>(in.gcount())));
+}
+
+CompressedFile::CompressedFile(const std::string& p_filename, unsigned int p_threads,
+                               size_t p_frames_in_flight)
+  : filename_(p_filename),
+    mmf_(std::make_unique<MMF>(p_filename)),
+    format_(Format::Unknown),
+    last_error_(Error::None) {
+  if (!mmf_->IsValid()) {
+    std::cerr << "Failed to open compressed file: " << filename_ << " with error: "
+              << static_cast<int>(mmf_->GetLastError()) << std::endl;
+    last_error_ = Error::FileOpenFailed;
+    return;
+  }
+  if (const auto data = mmf_->GetData()) {
+    data_ = std::string_view(static_cast<const char*>(*data), *mmf_->GetMappedSize());
+    madvise(const_cast<void*>(*data), data_.size(), MADV_SEQUENTIAL);
+  }
+  if (data_.empty()) {
+    last_error_ = Error::EndOfFile;
+    return;
+  }
+
+  format_ = DetectFormat(data_);
+  bool framed = false;
+  switch (format_) {
+    case Format::Gzip:
+      framed = SplitGzipMembers(data_);
+      break;
+    case Format::Zstd:
+#ifdef SP_HAVE_ZSTD
+      framed = SplitZstdFrames(data_);
+      if (!framed) last_error_ = Error::DecompressFailed;
+#else
+      std::cerr << "Built without zstd, cannot read: " << filename_ << std::endl;
+      last_error_ = Error::UnsupportedFormat;
+#endif
+      break;
+    case Format::Unknown:
+      std::cerr << "Not a gzip or zstd file: " << filename_ << std::endl;
+      last_error_ = Error::UnsupportedFormat;
+      break;
+  }
+  if (last_error_ != Error::None) return;
+
+  if (!framed) {
+    // Plain gzip, members can only be found by inflating them
+    stream_ = std::make_unique<z_stream>();
+    if (inflateInit2(stream_.get(), 16 + MAX_WBITS) != Z_OK) {
+      last_error_ = Error::DecompressFailed;
+      stream_.reset();
+      return;
+    }
+    stream_buffer_.resize(kStreamBlockSize);
+    std::cout << "Inflating: " << filename_ << " sequentially, no member index" << std::endl;
+    return;
+  }
+
+  if (p_threads == 0) {
+    p_threads = std::clamp(std::thread::hardware_concurrency(), 1u, kDefaultThreads);
+  }
+  p_threads = static_cast<unsigned int>(std::min<size_t>(p_threads, frames_.size()));
+  slots_.resize(std::max<size_t>(p_threads * std::max<size_t>(p_frames_in_flight, 1), 2));
+  std::cout << "Decompressing: " << filename_ << " with: " << frames_.size()
+            << " frames on: " << p_threads << " threads" << std::endl;
+  workers_.reserve(p_threads);
+  for (unsigned int i = 0; i < p_threads; ++i) {
+    workers_.emplace_back([this] { WorkerLoop(); });
+  }
+}
+
+CompressedFile::~CompressedFile() {
+  {
+    std::lock_guard lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  for (auto& worker : workers_) worker.join();
+  if (stream_) inflateEnd(stream_.get());
+}
+
+bool CompressedFile::SplitGzipMembers(std::string_view p_data) {
+  const auto* bytes = reinterpret_cast<const unsigned char*>(p_data.data());
+  std::vector<Frame> frames;
+  for (size_t offset = 0; offset < p_data.size();) {
+    const auto size = GetBgzfMemberSize(bytes + offset, p_data.size() - offset);
+    if (!size || offset + *size > p_data.size()) return false;
+    frames.push_back({offset, *size});
+    offset += *size;
+  }
+  frames_ = std::move(frames);
+  return true;
+}
+
+bool CompressedFile::SplitZstdFrames(std::string_view p_data) {
+#ifdef SP_HAVE_ZSTD
+  std::vector<Frame> frames;
+  for (size_t offset = 0; offset < p_data.size();) {
+    const size_t size = ZSTD_findFrameCompressedSize(p_data.data() + offset,
+                                                     p_data.size() - offset);
+    if (ZSTD_isError(size)) {
+      std::cerr << "Corrupt zstd frame in: " << filename_ << " at: " << offset
+                << " with error: " << ZSTD_getErrorName(size) << std::endl;
+      return false;
+    }
+    frames.push_back({offset, size});
+    offset += size;
+  }
+  frames_ = std::move(frames);
+  return true;
+#else
+  (void)p_data;
+  return false;
+#endif
+}
+
+bool CompressedFile::DecompressFrame(const Frame& p_frame, Slot& p_slot, void* p_context) const {
+  const char* input = data_.data() + p_frame.offset;
+  p_slot.size = 0;
+  if (format_ == Format::Zstd) {
+#ifdef SP_HAVE_ZSTD
+    auto* context = static_cast<ZSTD_DCtx*>(p_context);
+    const auto content_size = ZSTD_getFrameContentSize(input, p_frame.size);
+    if (content_size == ZSTD_CONTENTSIZE_ERROR) return false;
+    if (content_size != ZSTD_CONTENTSIZE_UNKNOWN) {
+      if (p_slot.data.size() < content_size) p_slot.data.resize(content_size);
+      const size_t written = ZSTD_decompressDCtx(context, p_slot.data.data(), content_size,
+                                                 input, p_frame.size);
+      if (ZSTD_isError(written)) return false;
+      p_slot.size = written;
+      return true;
+    }
+    ZSTD_DCtx_reset(context, ZSTD_reset_session_only);
+    ZSTD_inBuffer in{input, p_frame.size, 0};
+    for (;;) {
+      if (p_slot.data.size() - p_slot.size < ZSTD_DStreamOutSize()) {
+        p_slot.data.resize(p_slot.size + std::max(p_slot.data.size(), ZSTD_DStreamOutSize()));
+      }
+      ZSTD_outBuffer out{p_slot.data.data(), p_slot.data.size(), p_slot.size};
+      const size_t result = ZSTD_decompressStream(context, &out, &in);
+      if (ZSTD_isError(result)) return false;
+      p_slot.size = out.pos;
+      if (result == 0) return true;
+      if (in.pos == in.size && out.pos < out.size) return false; // Truncated
+    }
+#else
+    (void)p_context;
+    return false;
+#endif
+  }
+
+  auto* stream = static_cast<z_stream*>(p_context);
+  if (inflateReset(stream) != Z_OK) return false;
+  // ISIZE trailer, exact for members below 4 GiB. A damaged one must not
+  // size a huge buffer, anything past the BGZF limit grows by doubling.
+  const auto* trailer = reinterpret_cast<const unsigned char*>(input + p_frame.size - 4);
+  const size_t expected = std::min<size_t>(ReadLe32(trailer), kBgzfMaxPayload);
+  if (p_slot.data.size() < expected + 1) p_slot.data.resize(expected + 1);
+  stream->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input));
+  stream->avail_in = static_cast<uInt>(p_frame.size);
+  for (;;) {
+    stream->next_out = reinterpret_cast<Bytef*>(p_slot.data.data() + p_slot.size);
+    stream->avail_out = static_cast<uInt>(p_slot.data.size() - p_slot.size);
+    const int result = inflate(stream, Z_NO_FLUSH);
+    p_slot.size = p_slot.data.size() - stream->avail_out;
+    if (result == Z_STREAM_END) return true;
+    if (result != Z_OK && result != Z_BUF_ERROR) return false;
+    if (stream->avail_out != 0) return false; // Truncated member
+    p_slot.data.resize(p_slot.data.size() * 2);
+  }
+}
+
+void CompressedFile::WorkerLoop() {
+  // One decompression context per worker, reused for every frame
+  z_stream stream{};
+  inflateInit2(&stream, 16 + MAX_WBITS);
+  void* context = &stream;
+#ifdef SP_HAVE_ZSTD
+  ZSTD_DCtx* zstd_context = ZSTD_createDCtx();
+  if (format_ == Format::Zstd) context = zstd_context;
+#endif
+
+  std::unique_lock lock(mutex_);
+  for (;;) {
+    cv_.wait(lock, [this] {
+      return stop_ || next_frame_ >= frames_.size() ||
+             next_frame_ < consume_frame_ + slots_.size();
+    });
+    if (stop_ || next_frame_ >= frames_.size()) break;
+    const size_t index = next_frame_++;
+    Slot& slot = slots_[index % slots_.size()];
+    lock.unlock();
+
+    bool ok = false;
+    try {
+      ok = DecompressFrame(frames_[index], slot, context);
+    } catch (const std::exception& e) {
+      // bad_alloc on a damaged frame, reported as DecompressFailed
+      std::cerr << "Failed to decompress frame: " << index << " of: " << filename_
+                << " with error: " << e.what() << std::endl;
+    }
+
+    lock.lock();
+    slot.frame = index;
+    slot.failed = !ok;
+    slot.ready = true;
+    cv_.notify_all();
+  }
+  lock.unlock();
+
+  inflateEnd(&stream);
+#ifdef SP_HAVE_ZSTD
+  ZSTD_freeDCtx(zstd_context);
+#endif
+}
+
+bool CompressedFile::NextFramedBlock() {
+  std::unique_lock lock(mutex_);
+  if (consuming_) {
+    // Done with the previous block, its slot can take the next frame
+    slots_[consume_frame_ % slots_.size()].ready = false;
+    ++consume_frame_;
+    consuming_ = false;
+    cv_.notify_all();
+  }
+  if (consume_frame_ >= frames_.size()) return false;
+
+  Slot& slot = slots_[consume_frame_ % slots_.size()];
+  cv_.wait(lock, [&] { return slot.ready && slot.frame == consume_frame_; });
+  consuming_ = true;
+  if (slot.failed) {
+    std::cerr << "Failed to decompress frame: " << consume_frame_ << " of: "
+              << filename_ << " at offset: " << frames_[consume_frame_].offset << std::endl;
+    last_error_ = Error::DecompressFailed;
+    return false;
+  }
+  block_ = std::string_view(slot.data.data(), slot.size);
+  return true;
+}
+
+bool CompressedFile::NextStreamBlock() {
+  if (stream_done_) return false;
+  stream_->next_out = reinterpret_cast<Bytef*>(stream_buffer_.data());
+  stream_->avail_out = static_cast<uInt>(stream_buffer_.size());
+  while (stream_->avail_out != 0) {
+    if (stream_->avail_in == 0 && stream_input_ < data_.size()) {
+      // avail_in is 32 bit, feed large files piecewise
+      const size_t chunk = std::min<size_t>(data_.size() - stream_input_, UINT_MAX);
+      stream_->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data_.data() + stream_input_));
+      stream_->avail_in = static_cast<uInt>(chunk);
+      stream_input_ += chunk;
+    }
+    const int result = inflate(stream_.get(), Z_NO_FLUSH);
+    if (result == Z_STREAM_END) {
+      // Concatenated members, keep going if there is another one
+      if (stream_->avail_in == 0 && stream_input_ == data_.size()) {
+        stream_done_ = true;
+        break;
+      }
+      inflateReset(stream_.get());
+      continue;
+    }
+    if (result != Z_OK) {
+      std::cerr << "Failed to inflate: " << filename_ << " with error: " << result
+                << (result == Z_BUF_ERROR ? " (truncated)" : "") << std::endl;
+      last_error_ = Error::DecompressFailed;
+      stream_done_ = true;
+      return false;
+    }
+  }
+  block_ = std::string_view(stream_buffer_.data(), stream_buffer_.size() - stream_->avail_out);
+  return true;
+}
+
+bool CompressedFile::NextBlock() {
+  block_ = {};
+  block_pos_ = 0;
+  return stream_ ? NextStreamBlock() : NextFramedBlock();
+}
+
+std::optional<std::string_view> CompressedFile::ReadLineView() {
+  if (last_error_ != Error::None) return std::nullopt;
+  if (carry_returned_) {
+    carry_.clear();
+    carry_returned_ = false;
+  }
+
+  for (;;) {
+    if (block_pos_ < block_.size()) {
+      const char* start = block_.data() + block_pos_;
+      const size_t remaining = block_.size() - block_pos_;
+      const auto* eol = static_cast<const char*>(std::memchr(start, '\n', remaining));
+      if (eol) {
+        const std::string_view line(start, eol - start);
+        block_pos_ += line.size() + 1;
+        if (carry_.empty()) return line;
+        carry_.append(line);
+        carry_returned_ = true;
+        return std::string_view(carry_);
+      }
+      // Continues in the next block
+      carry_.append(start, remaining);
+      block_pos_ = block_.size();
+    }
+    if (!NextBlock()) {
+      if (last_error_ != Error::None) return std::nullopt;
+      last_error_ = Error::EndOfFile;
+      if (carry_.empty()) return std::nullopt;
+      carry_returned_ = true;
+      return std::string_view(carry_);
+    }
+  }
+}
+
+std::optional<std::string> CompressedFile::ReadLine() {
+  const auto line = ReadLineView();
+  if (!line) return std::nullopt;
+  return std::string(*line);
+}
@@ -0,0 +1,123 @@
+#ifndef CompressedFile_hpp
+#define CompressedFile_hpp
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "Mmf.hpp"
+
+struct z_stream_s; // zlib.h stays out of the header
+
+namespace sp {
+  // Line reader for compressed inputs with the MMF::ReadLineView interface.
+  //
+  // The file is mapped and split into independently compressed frames:
+  // zstd frames (when built with libzstd) or gzip members carrying their
+  // size in a "BC" extra field (BGZF, as written by bgzip). Frames are
+  // decompressed ahead of the reader by a small worker pool into a ring of
+  // reusable buffers and handed out in file order. A gzip file without
+  // member sizes cannot be split and is inflated sequentially instead.
+  class CompressedFile {
+  public:
+    enum class Format {
+      Unknown,
+      Gzip,
+      Zstd
+    };
+
+    enum class Error {
+      None,
+      FileOpenFailed,
+      UnsupportedFormat,
+      DecompressFailed,
+      EndOfFile
+    };
+
+    // p_threads 0 uses kDefaultThreads workers, or fewer cpus when there are
+    // fewer. Every open file runs its own workers, so keep this small when
+    // many files are read at once. p_frames_in_flight frames are
+    // decompressed ahead per worker.
+    static constexpr unsigned int kDefaultThreads = 4;
+    explicit CompressedFile(const std::string& p_filename, unsigned int p_threads = 0,
+                            size_t p_frames_in_flight = 2);
+    ~CompressedFile();
+
+    CompressedFile(const CompressedFile&) = delete;
+    CompressedFile& operator=(const CompressedFile&) = delete;
+
+    bool IsValid() const { return last_error_ == Error::None || last_error_ == Error::EndOfFile; }
+    Error GetLastError() const { return last_error_; }
+    const std::string& GetFilename() const { return filename_; }
+    Format GetFormat() const { return format_; }
+    // 0 when the file is inflated sequentially
+    size_t GetFrameCount() const { return frames_.size(); }
+
+    // The view is valid until the next call. A last line without newline is
+    // returned as is, then EndOfFile.
+    std::optional<std::string_view> ReadLineView();
+    std::optional<std::string> ReadLine();
+
+    // By magic number, Unknown for plain text
+    static Format DetectFormat(std::string_view p_data);
+    static Format DetectFormat(const std::string& p_filename);
+
+  private:
+    struct Frame {
+      size_t offset;
+      size_t size;
+    };
+
+    struct Slot {
+      std::vector<char> data;
+      size_t size = 0;
+      size_t frame = 0;
+      bool ready = false;
+      bool failed = false;
+    };
+
+    bool SplitGzipMembers(std::string_view p_data);
+    bool SplitZstdFrames(std::string_view p_data);
+    void WorkerLoop();
+    bool DecompressFrame(const Frame& p_frame, Slot& p_slot, void* p_context) const;
+    // Next decompressed block in file order, false at the end or on error
+    bool NextBlock();
+    bool NextFramedBlock();
+    bool NextStreamBlock();
+
+    std::string filename_;
+    std::unique_ptr<MMF> mmf_;
+    std::string_view data_;
+    Format format_;
+    Error last_error_;
+
+    // Framed mode: frame i is decompressed into slots_[i % slots_.size()]
+    std::vector<Frame> frames_;
+    std::vector<Slot> slots_;
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    size_t next_frame_ = 0;    // Next frame a worker claims
+    size_t consume_frame_ = 0; // Frame the reader is on
+    bool consuming_ = false;   // The reader holds slots_[consume_frame_]
+    bool stop_ = false;
+
+    // Stream mode: sequential inflate
+    std::unique_ptr<::z_stream_s> stream_;
+    std::vector<char> stream_buffer_;
+    size_t stream_input_ = 0;  // Bytes of data_ handed to zlib
+    bool stream_done_ = false;
+
+    std::string_view block_;   // Current decompressed block
+    size_t block_pos_ = 0;
+    std::string carry_;        // Line split across blocks
+    bool carry_returned_ = false;
+  };
+}// namespace sp
+
+#endif // CompressedFile_hpp
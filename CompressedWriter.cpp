@@ -0,0 +1,395 @@
+#include "CompressedWriter.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <zlib.h>
+
+#ifdef SP_HAVE_ZSTD // Set by the build when libzstd is linked
+#include <zstd.h>
+#endif
+
+#include "Checkpoint.hpp"
+#include "MktData.hpp"
+
+using namespace sp;
+
+namespace {
+  constexpr const char* kIndexHeader = "# MktDataAggregator frame index v1";
+
+  // Largest BGZF member payload that still fits the 16 bit size field when
+  // it does not compress, as used by bgzip
+  constexpr size_t kBgzfMaxInput = 0xff00;
+  constexpr size_t kBgzfHeaderSize = 18;
+  constexpr size_t kBgzfTrailerSize = 8;
+  // Empty member marking the end of a BGZF stream
+  constexpr unsigned char kBgzfEof[] = {
+    0x1f, 0x8b, 0x08, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0x06, 0x00, 0x42, 0x43,
+    0x02, 0x00, 0x1b, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+
+  void PutLe(std::string& p_out, size_t p_pos, uint32_t p_value, size_t p_bytes) {
+    for (size_t i = 0; i < p_bytes; ++i) {
+      p_out[p_pos + i] = static_cast<char>((p_value >> (8 * i)) & 0xff);
+    }
+  }
+
+  struct Context {
+    z_stream stream{};
+#ifdef SP_HAVE_ZSTD
+    ZSTD_CCtx* zstd = nullptr;
+#endif
+  };
+}
+
+size_t FrameIndex::FindFrame(std::string_view p_key) const {
+  // Lines equal to p_key may still end the frame before the first one whose
+  // key is not below it
+  const auto it = std::lower_bound(
+    frames.begin(), frames.end(), p_key,
+    [](const Frame& p_frame, std::string_view p_value) {
+      return p_frame.first_key.empty() || p_frame.first_key < p_value;
+    });
+  return it == frames.begin() ? 0 : static_cast<size_t>(it - frames.begin()) - 1;
+}
+
+bool FrameIndex::Save(const std::string& p_path) const {
+  std::ostringstream out;
+  out << kIndexHeader << '\n';
+  // frame<TAB>compressed offset<TAB>size<TAB>uncompressed offset<TAB>key
+  for (const auto& frame : frames) {
+    out << "frame\t" << frame.compressed_offset << '\t' << frame.compressed_size << '\t'
+        << frame.uncompressed_offset << '\t' << frame.first_key << '\n';
+  }
+  return WriteFileAtomically(p_path, out.view());
+}
+
+std::optional<FrameIndex> FrameIndex::Load(const std::string& p_path) {
+  std::ifstream in(p_path);
+  if (!in) return std::nullopt;
+  std::string line;
+  if (!std::getline(in, line) || line != kIndexHeader) {
+    std::cerr << "Not a frame index: " << p_path << std::endl;
+    return std::nullopt;
+  }
+
+  FrameIndex index;
+  while (std::getline(in, line)) {
+    if (!line.starts_with("frame\t")) continue;
+    Frame frame;
+    size_t pos = 6;
+    size_t* const numbers[] = {&frame.compressed_offset, &frame.compressed_size,
+                               &frame.uncompressed_offset};
+    for (size_t* number : numbers) {
+      const auto tab = line.find('\t', pos);
+      if (tab == std::string::npos) {
+        std::cerr << "Corrupt frame index line: " << line << std::endl;
+        return std::nullopt;
+      }
+      *number = MktData::ParseUnsigned(std::string_view(line).substr(pos, tab - pos));
+      pos = tab + 1;
+    }
+    frame.first_key = line.substr(pos);
+    index.frames.push_back(std::move(frame));
+  }
+  return index;
+}
+
+CompressedWriter::CompressedWriter(const std::string& p_filename, Format p_format,
+                                   unsigned int p_threads, size_t p_frame_size, int p_level,
+                                   size_t p_key_field)
+  : filename_(p_filename),
+    format_(p_format),
+    level_(p_level),
+    frame_size_(std::max<size_t>(p_frame_size, 1)),
+    key_field_(p_key_field),
+    last_error_(Error::None),
+    current_(std::make_unique<Job>()) {
+#ifndef SP_HAVE_ZSTD
+  if (format_ == Format::Zstd) {
+    std::cerr << "Built without zstd, cannot write: " << filename_ << std::endl;
+    last_error_ = Error::UnsupportedFormat;
+    closed_ = true;
+    return;
+  }
+#endif
+  file_ = std::make_unique<FileWriter>(filename_);
+  if (!file_->IsValid()) {
+    std::cerr << "Failed to open output file: " << filename_ << std::endl;
+    last_error_ = Error::FileOpenFailed;
+    closed_ = true;
+    return;
+  }
+
+  if (p_threads == 0) p_threads = std::max(1u, std::thread::hardware_concurrency());
+  max_in_flight_ = static_cast<size_t>(p_threads) * 2;
+  current_->input.reserve(frame_size_ + frame_size_ / 8);
+  workers_.reserve(p_threads);
+  for (unsigned int i = 0; i < p_threads; ++i) {
+    workers_.emplace_back([this] { WorkerLoop(); });
+  }
+}
+
+CompressedWriter::~CompressedWriter() {
+  if (!closed_) Close();
+  {
+    std::lock_guard lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  for (auto& worker : workers_) worker.join();
+}
+
+CompressedWriter::Error CompressedWriter::GetLastError() const {
+  std::lock_guard lock(mutex_);
+  return worker_error_ != Error::None ? worker_error_ : last_error_;
+}
+
+size_t CompressedWriter::GetLength() const {
+  std::lock_guard lock(mutex_);
+  return file_length_;
+}
+
+size_t CompressedWriter::GetFrameCount() const {
+  std::lock_guard lock(mutex_);
+  return index_.frames.size();
+}
+
+CompressedWriter::Error CompressedWriter::Appended() {
+  auto& input = current_->input;
+  // Only the first data line of a frame is looked at
+  while (current_->first_key.empty()) {
+    const auto eol = input.find('\n', line_start_);
+    if (eol == std::string::npos) break;
+    const auto key = MktData::GetField(
+      std::string_view(input).substr(line_start_, eol - line_start_), key_field_);
+    if (MktData::IsDataLine(key)) current_->first_key.assign(key);
+    line_start_ = eol + 1;
+  }
+  if (input.size() >= frame_size_ && input.back() == '\n' && !Submit()) {
+    return GetLastError();
+  }
+  return Error::None;
+}
+
+CompressedWriter::Error CompressedWriter::Write(std::string_view p_data) {
+  if (closed_) return last_error_ != Error::None ? last_error_ : Error::WriteFailed;
+  current_->input.append(p_data);
+  uncompressed_length_ += p_data.size();
+  return Appended();
+}
+
+CompressedWriter::Error CompressedWriter::WriteLine(std::string_view p_line) {
+  if (closed_) return last_error_ != Error::None ? last_error_ : Error::WriteFailed;
+  current_->input.append(p_line);
+  current_->input.push_back('\n');
+  uncompressed_length_ += p_line.size() + 1;
+  return Appended();
+}
+
+bool CompressedWriter::Submit() {
+  if (current_->input.empty()) return true;
+  std::unique_lock lock(mutex_);
+  // Bounded, the caller waits for the workers instead of buffering the
+  // whole output in memory
+  cv_.wait(lock, [this] {
+    return in_flight_ < max_in_flight_ || worker_error_ != Error::None;
+  });
+  if (worker_error_ != Error::None) return false;
+
+  current_->sequence = next_sequence_++;
+  current_->uncompressed_offset = uncompressed_length_ - current_->input.size();
+  pending_.push_back(std::move(current_));
+  ++in_flight_;
+  if (!free_.empty()) {
+    current_ = std::move(free_.back());
+    free_.pop_back();
+  } else {
+    current_ = std::make_unique<Job>();
+    current_->input.reserve(frame_size_ + frame_size_ / 8);
+  }
+  lock.unlock();
+  cv_.notify_all();
+
+  current_->input.clear();
+  current_->first_key.clear();
+  current_->failed = false;
+  line_start_ = 0;
+  return true;
+}
+
+bool CompressedWriter::Compress(Job& p_job, void* p_context) const {
+  auto& context = *static_cast<Context*>(p_context);
+  auto& output = p_job.output;
+  output.clear();
+  const std::string_view input(p_job.input);
+
+  if (format_ == Format::Zstd) {
+#ifdef SP_HAVE_ZSTD
+    output.resize(ZSTD_compressBound(input.size()));
+    const size_t size = ZSTD_compressCCtx(context.zstd, output.data(), output.size(),
+                                          input.data(), input.size(),
+                                          level_ < 0 ? ZSTD_CLEVEL_DEFAULT : level_);
+    if (ZSTD_isError(size)) return false;
+    output.resize(size);
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  // BGZF: a run of gzip members, each with its size in a "BC" extra field
+  for (size_t pos = 0; pos < input.size(); pos += kBgzfMaxInput) {
+    const auto chunk = input.substr(pos, kBgzfMaxInput);
+    if (deflateReset(&context.stream) != Z_OK) return false;
+    const size_t start = output.size();
+    const size_t bound = deflateBound(&context.stream, chunk.size());
+    output.resize(start + kBgzfHeaderSize + bound + kBgzfTrailerSize);
+
+    auto& stream = context.stream;
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(chunk.data()));
+    stream.avail_in = static_cast<uInt>(chunk.size());
+    stream.next_out = reinterpret_cast<Bytef*>(output.data() + start + kBgzfHeaderSize);
+    stream.avail_out = static_cast<uInt>(bound);
+    if (deflate(&stream, Z_FINISH) != Z_STREAM_END) return false;
+    const size_t compressed = bound - stream.avail_out;
+    const size_t member_size = kBgzfHeaderSize + compressed + kBgzfTrailerSize;
+    if (member_size > 0x10000) return false;
+
+    // ID1 ID2 CM FLG(FEXTRA) MTIME XFL OS XLEN, then "BC" SLEN BSIZE
+    std::copy(kBgzfEof, kBgzfEof + 16, output.begin() + start);
+    PutLe(output, start + 16, static_cast<uint32_t>(member_size - 1), 2);
+    const size_t trailer = start + kBgzfHeaderSize + compressed;
+    PutLe(output, trailer, static_cast<uint32_t>(crc32(0, reinterpret_cast<const Bytef*>(chunk.data()),
+                                                        static_cast<uInt>(chunk.size()))), 4);
+    PutLe(output, trailer + 4, static_cast<uint32_t>(chunk.size()), 4);
+    output.resize(start + member_size);
+  }
+  return true;
+}
+
+void CompressedWriter::WorkerLoop() {
+  // One compression context per worker, reused for every frame
+  Context context;
+  bool ready = true;
+  if (format_ == Format::Gzip) {
+    const int status = deflateInit2(&context.stream, level_ < 0 ? Z_DEFAULT_COMPRESSION : level_,
+                                    Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+    if (status != Z_OK) {
+      std::cerr << "Failed to initialise deflate: " << status << " level: " << level_
+                << " for: " << filename_ << std::endl;
+      ready = false;
+    }
+  }
+#ifdef SP_HAVE_ZSTD
+  if (format_ == Format::Zstd) {
+    context.zstd = ZSTD_createCCtx();
+    if (context.zstd == nullptr) {
+      std::cerr << "Failed to create zstd context for: " << filename_ << std::endl;
+      ready = false;
+    }
+  }
+#endif
+
+  std::unique_lock lock(mutex_);
+  for (;;) {
+    cv_.wait(lock, [this] { return stop_ || !pending_.empty(); });
+    if (pending_.empty()) break; // Stopped
+    auto job = std::move(pending_.front());
+    pending_.pop_front();
+    lock.unlock();
+
+    job->failed = !ready || !Compress(*job, &context);
+
+    lock.lock();
+    const size_t sequence = job->sequence;
+    done_.emplace(sequence, std::move(job));
+    WriteReady(lock);
+    cv_.notify_all();
+  }
+  lock.unlock();
+
+  if (format_ == Format::Gzip && ready) deflateEnd(&context.stream);
+#ifdef SP_HAVE_ZSTD
+  ZSTD_freeCCtx(context.zstd);
+#endif
+}
+
+void CompressedWriter::WriteReady(std::unique_lock<std::mutex>& p_lock) {
+  // The worker already writing picks up this job on its next pass
+  if (writing_) return;
+  writing_ = true;
+  std::vector<std::unique_ptr<Job>> batch;
+  while (!done_.empty() && done_.begin()->first == next_write_) {
+    // Take the in-order run under the lock ...
+    while (!done_.empty() && done_.begin()->first == next_write_) {
+      auto job = std::move(done_.begin()->second);
+      done_.erase(done_.begin());
+      if (job->failed) {
+        std::cerr << "Failed to compress frame: " << job->sequence << " of: " << filename_
+                  << std::endl;
+        worker_error_ = Error::CompressFailed;
+      } else if (worker_error_ == Error::None) {
+        index_.frames.push_back({file_length_, job->output.size(),
+                                 job->uncompressed_offset, job->first_key});
+        file_length_ += job->output.size();
+      }
+      job->failed = job->failed || worker_error_ != Error::None;
+      ++next_write_;
+      batch.push_back(std::move(job));
+    }
+
+    // ... and write it without, so the other workers keep compressing
+    p_lock.unlock();
+    bool write_failed = false;
+    for (const auto& job : batch) {
+      if (job->failed || write_failed) continue;
+      write_failed = file_->Write(job->output) != FileWriter::Error::None;
+    }
+    p_lock.lock();
+
+    if (write_failed && worker_error_ == Error::None) worker_error_ = Error::WriteFailed;
+    in_flight_ -= batch.size();
+    for (auto& job : batch) free_.push_back(std::move(job));
+    batch.clear();
+  }
+  writing_ = false;
+}
+
+CompressedWriter::Error CompressedWriter::Flush() {
+  if (closed_) return last_error_;
+  if (!Submit()) return GetLastError();
+  std::unique_lock lock(mutex_);
+  cv_.wait(lock, [this] { return in_flight_ == 0; });
+  if (worker_error_ == Error::None && file_->Flush() != FileWriter::Error::None) {
+    worker_error_ = Error::WriteFailed;
+  }
+  return worker_error_ != Error::None ? worker_error_ : last_error_;
+}
+
+CompressedWriter::Error CompressedWriter::Close() {
+  if (closed_) return GetLastError();
+  auto error = Flush();
+  closed_ = true;
+  if (error != Error::None) return error;
+
+  std::lock_guard lock(mutex_);
+  if (format_ == Format::Gzip) {
+    file_->Write(std::string_view(reinterpret_cast<const char*>(kBgzfEof), sizeof(kBgzfEof)));
+    file_length_ += sizeof(kBgzfEof);
+  }
+  if (file_->Flush() != FileWriter::Error::None) {
+    worker_error_ = Error::WriteFailed;
+    return worker_error_;
+  }
+  if (!index_.Save(FrameIndex::GetPath(filename_))) {
+    worker_error_ = Error::WriteFailed;
+    return worker_error_;
+  }
+  std::cout << "Closed: " << filename_ << " with: " << index_.frames.size()
+            << " frames, " << uncompressed_length_ << " bytes compressed to: "
+            << file_length_ << std::endl;
+  return Error::None;
+}
@@ -0,0 +1,143 @@
+#ifndef CompressedWriter_hpp
+#define CompressedWriter_hpp
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "FileWriter.hpp"
+
+namespace sp {
+  // Sidecar of a CompressedWriter output (<output>.fidx). Every frame starts
+  // at a line boundary and can be decompressed on its own, so a reader can
+  // start at any frame.
+  struct FrameIndex {
+    struct Frame {
+      size_t compressed_offset = 0;
+      size_t compressed_size = 0;
+      size_t uncompressed_offset = 0;
+      std::string first_key; // Key column of the first data line, if any
+    };
+
+    std::vector<Frame> frames;
+
+    // Frame to start reading at for the first line whose key is not before
+    // p_key. Keys must be sorted, e.g. the timestamps of the merged output.
+    size_t FindFrame(std::string_view p_key) const;
+
+    // Written with WriteFileAtomically, see Checkpoint.hpp
+    bool Save(const std::string& p_path) const;
+    static std::optional<FrameIndex> Load(const std::string& p_path);
+    static std::string GetPath(const std::string& p_output) { return p_output + ".fidx"; }
+  };
+
+  // Output writer that compresses the stream in independent frames on a
+  // worker pool. Frames are cut at line boundaries once frame_size bytes are
+  // buffered, compressed out of order and written in order, then listed in a
+  // FrameIndex when the writer is closed. Gzip frames are runs of BGZF
+  // members, zstd frames (when built with libzstd) are single zstd frames,
+  // both readable in parallel by CompressedFile and by standard tools.
+  class CompressedWriter {
+  public:
+    enum class Format {
+      Gzip,
+      Zstd
+    };
+
+    enum class Error {
+      None,
+      FileOpenFailed,
+      UnsupportedFormat,
+      CompressFailed,
+      WriteFailed
+    };
+
+    static constexpr size_t kDefaultFrameSize = 1024 * 1024;
+
+    // p_threads 0 uses every available cpu, p_level -1 is the codec default.
+    // p_key_field is the column recorded per frame, 1 = merged timestamp.
+    explicit CompressedWriter(const std::string& p_filename, Format p_format = Format::Gzip,
+                              unsigned int p_threads = 0, size_t p_frame_size = kDefaultFrameSize,
+                              int p_level = -1, size_t p_key_field = 1);
+    // Closes if still open
+    ~CompressedWriter();
+
+    CompressedWriter(const CompressedWriter&) = delete;
+    CompressedWriter& operator=(const CompressedWriter&) = delete;
+
+    bool IsValid() const { return GetLastError() == Error::None; }
+    Error GetLastError() const;
+    const std::string& GetFilename() const { return filename_; }
+
+    Error Write(std::string_view p_data);
+    Error WriteLine(std::string_view p_line);
+    // Ends the current frame and waits until every frame is on disk
+    Error Flush();
+    // Flush, end of stream marker and frame index
+    Error Close();
+
+    // Uncompressed bytes written so far
+    size_t GetUncompressedLength() const { return uncompressed_length_; }
+    // Compressed bytes on disk, only settles after Flush()
+    size_t GetLength() const;
+    size_t GetFrameCount() const;
+
+  private:
+    struct Job {
+      size_t sequence = 0;
+      size_t uncompressed_offset = 0;
+      std::string input;
+      std::string output;
+      std::string first_key;
+      bool failed = false;
+    };
+
+    void WorkerLoop();
+    bool Compress(Job& p_job, void* p_context) const;
+    // Queues the current frame, false if the writer has failed
+    bool Submit();
+    // Writes every finished job that is next in line. Called with mutex_
+    // held, the file is written with it released by one worker at a time
+    void WriteReady(std::unique_lock<std::mutex>& p_lock);
+    // Records the frame key and cuts the frame once it is full
+    Error Appended();
+
+    std::string filename_;
+    Format format_;
+    int level_;
+    size_t frame_size_;
+    size_t key_field_;
+    std::unique_ptr<FileWriter> file_;
+    Error last_error_;
+    bool closed_ = false;
+
+    std::unique_ptr<Job> current_;
+    size_t line_start_ = 0;    // In current_->input
+    size_t uncompressed_length_ = 0;
+
+    std::vector<std::thread> workers_;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::unique_ptr<Job>> pending_;       // Not claimed yet
+    std::map<size_t, std::unique_ptr<Job>> done_;    // Compressed, by sequence
+    std::vector<std::unique_ptr<Job>> free_;         // Reusable buffers
+    size_t next_sequence_ = 0;
+    size_t next_write_ = 0;
+    size_t in_flight_ = 0;
+    size_t max_in_flight_ = 0;
+    bool stop_ = false;
+    bool writing_ = false;     // A worker is writing outside the lock
+    size_t file_length_ = 0;   // Compressed bytes handed to file_
+    Error worker_error_ = Error::None;
+    FrameIndex index_;
+  };
+}// namespace sp
+
+#endif // CompressedWriter_hpp
@@ -0,0 +1,171 @@
+#include "CsvParser.hpp"
+
+#include <bit>
+#include <charconv>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "Dictionary.hpp"
+#include "MktData.hpp"
+#include "Price.hpp"
+
+using namespace sp;
+
+namespace {
+  constexpr size_t kStride = 64;
+
+  // Appends base + index of every set bit of p_mask
+  inline void Flatten(uint64_t p_mask, uint32_t p_base, std::vector<uint32_t>& p_out) {
+    if (p_mask == 0) return;
+    size_t at = p_out.size();
+    p_out.resize(at + static_cast<size_t>(std::popcount(p_mask)));
+    while (p_mask != 0) {
+      p_out[at++] = p_base + static_cast<uint32_t>(std::countr_zero(p_mask));
+      p_mask &= p_mask - 1;
+    }
+  }
+
+#if defined(__SSE2__)
+  // Bit i set if p_data[i] is ',' or '\n', for 64 bytes
+  inline uint64_t ClassifySse2(const char* p_data) {
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i newline = _mm_set1_epi8('\n');
+    uint64_t mask = 0;
+    for (int i = 0; i < 4; ++i) {
+      const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p_data + 16 * i));
+      const __m128i hits = _mm_or_si128(_mm_cmpeq_epi8(chunk, comma),
+                                        _mm_cmpeq_epi8(chunk, newline));
+      mask |= static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(hits))) << (16 * i);
+    }
+    return mask;
+  }
+#endif
+
+  inline std::string_view Trim(std::string_view p_field) {
+    while (!p_field.empty() && p_field.front() == ' ') p_field.remove_prefix(1);
+    while (!p_field.empty() && (p_field.back() == ' ' || p_field.back() == '\r')) {
+      p_field.remove_suffix(1);
+    }
+    return p_field;
+  }
+}
+
+void sp::IndexStructuralsScalar(std::string_view p_block, std::vector<uint32_t>& p_out) {
+  p_out.clear();
+  for (size_t i = 0; i < p_block.size(); ++i) {
+    if (p_block[i] == ',' || p_block[i] == '\n') p_out.push_back(static_cast<uint32_t>(i));
+  }
+}
+
+void sp::IndexStructurals(std::string_view p_block, std::vector<uint32_t>& p_out) {
+#if defined(__SSE2__)
+  p_out.clear();
+  const char* data = p_block.data();
+  const size_t size = p_block.size();
+  size_t pos = 0;
+  for (; pos + kStride <= size; pos += kStride) {
+    Flatten(ClassifySse2(data + pos), static_cast<uint32_t>(pos), p_out);
+  }
+  if (pos < size) {
+    // Zero padding never matches
+    alignas(16) char tail[kStride] = {};
+    std::memcpy(tail, data + pos, size - pos);
+    Flatten(ClassifySse2(tail), static_cast<uint32_t>(pos), p_out);
+  }
+#else
+  IndexStructuralsScalar(p_block, p_out);
+#endif
+}
+
+size_t CsvBatchParser::Parse(std::string_view p_block, std::vector<MktDataRecord>& p_records) {
+  IndexStructurals(p_block, structurals_);
+
+  size_t line_start = 0;
+  uint32_t commas[kFieldCount - 1];
+  size_t comma_count = 0;
+  for (const uint32_t pos : structurals_) {
+    if (p_block[pos] == ',') {
+      if (comma_count < kFieldCount - 1) commas[comma_count] = pos;
+      ++comma_count;
+      continue;
+    }
+
+    const auto line = p_block.substr(line_start, pos - line_start);
+    const size_t start = line_start;
+    line_start = pos + 1;
+    const size_t fields = comma_count + 1;
+    comma_count = 0;
+    if (!MktData::IsDataLine(line)) {
+      ++rejected_lines_; // Header or empty line
+      continue;
+    }
+    if (fields != kFieldCount) {
+      ++rejected_lines_;
+      ++dropped_data_lines_;
+      continue;
+    }
+
+    const auto field = [&](size_t p_index) {
+      const size_t begin = p_index == 0 ? start : commas[p_index - 1] + 1;
+      const size_t end = p_index == kFieldCount - 1 ? pos : commas[p_index];
+      return Trim(p_block.substr(begin, end - begin));
+    };
+    MktDataRecord record;
+    const auto timestamp = field(0);
+    record.timestamp = MktData::IsTimestamp(timestamp) ? MktData::TimestampToMillis(timestamp) : -1;
+    unsigned decimals = 0;
+    const auto price = MktData::ParsePrice(field(1), MktData::kPriceScale, &decimals);
+    const auto size = field(2);
+    const auto [size_end, size_error] =
+      std::from_chars(size.data(), size.data() + size.size(), record.size);
+    if (record.timestamp < 0 || !price || size_error != std::errc() ||
+        size_end != size.data() + size.size()) {
+      ++rejected_lines_;
+      ++dropped_data_lines_;
+      continue;
+    }
+    // Only valid lines may add venues to the dictionaries
+    const auto exchange = exchanges_.Encode(field(3));
+    const auto type = types_.Encode(field(4));
+    if (exchange == CodeDictionary::kInvalidCode || type == CodeDictionary::kInvalidCode) {
+      ++rejected_lines_;
+      ++dropped_data_lines_;
+      continue;
+    }
+    record.price = *price;
+    record.price_decimals = static_cast<uint8_t>(decimals);
+    record.exchange = exchange;
+    record.type = static_cast<uint8_t>(type);
+    p_records.push_back(record);
+  }
+  return line_start;
+}
+
+CsvBatchParser::CsvBatchParser()
+  : exchanges_(GetExchangeDictionary()),
+    types_(GetTypeDictionary()) {}
+
+size_t sp::FormatRecord(std::string_view p_symbol, const MktDataRecord& p_record, char* p_out) {
+  char* out = p_out;
+  const auto append = [&out](std::string_view p_text) {
+    std::memcpy(out, p_text.data(), p_text.size());
+    out += p_text.size();
+  };
+  append(p_symbol);
+  append(", ");
+  MktData::MillisToTimestamp(p_record.timestamp, out);
+  out += MktData::kTimestampLength;
+  append(", ");
+  out += MktData::FormatPrice(p_record.price, out, MktData::kPriceScale, p_record.price_decimals);
+  append(", ");
+  out = std::to_chars(out, out + 20, p_record.size).ptr;
+  append(", ");
+  append(GetExchangeDictionary().Decode(p_record.exchange));
+  append(", ");
+  append(GetTypeDictionary().Decode(p_record.type));
+  *out++ = '\n';
+  return static_cast<size_t>(out - p_out);
+}
@@ -0,0 +1,61 @@
+#ifndef CsvParser_hpp
+#define CsvParser_hpp
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "MktDataRecord.hpp"
+
+namespace sp {
+  class CodeDictionary;
+
+  // Structural index of a block: the offset of every ',' and '\n' in order.
+  // 64 bytes are classified at a time into bitmasks (SSE2 where available)
+  // and the set bits flattened into p_out, the same two stage scheme
+  // simdjson uses. p_out is cleared first. Blocks must be below 4 GiB.
+  void IndexStructurals(std::string_view p_block, std::vector<uint32_t>& p_out);
+  // Byte at a time reference of the above
+  void IndexStructuralsScalar(std::string_view p_block, std::vector<uint32_t>& p_out);
+
+  // Turns blocks of input lines into MktDataRecords with one structural
+  // index pass per block instead of a comma search per field. Separators
+  // may be "," or ", ", trailing '\r' is ignored. The header, empty lines
+  // and lines without exactly five well formed fields are skipped and
+  // counted. Prices become fixed point, Exchange and Type dictionary codes.
+  class CsvBatchParser {
+  public:
+    static constexpr size_t kFieldCount = 5;
+
+    CsvBatchParser();
+
+    // Appends the records of every complete line in p_block to p_records.
+    // Returns the bytes consumed, i.e. up to the last newline, so the caller
+    // can carry an unterminated tail over to the next block.
+    size_t Parse(std::string_view p_block, std::vector<MktDataRecord>& p_records);
+
+    size_t GetRejectedLines() const { return rejected_lines_; }
+    // Rejected lines that look like data (MktData::IsDataLine), e.g. prices
+    // with more decimals than kPriceScale or a venue that no longer fits the
+    // dictionary. MergeJob copies such lines through, records lose them.
+    size_t GetDroppedDataLines() const { return dropped_data_lines_; }
+
+  private:
+    std::vector<uint32_t> structurals_; // Reused across blocks
+    size_t rejected_lines_ = 0;
+    size_t dropped_data_lines_ = 0;
+    CodeDictionary& exchanges_;
+    CodeDictionary& types_;
+  };
+
+  // Separators, timestamp, price, size and newline of a formatted record
+  constexpr size_t kFormattedRecordOverhead = 75;
+
+  // Writes p_record as an output line "Symbol, Timestamp, Price, Size,
+  // Exchange, Type\n" to p_out and returns its length, the price with the
+  // decimals it was read with. p_out must hold kFormattedRecordOverhead
+  // plus the symbol, exchange and type lengths.
+  size_t FormatRecord(std::string_view p_symbol, const MktDataRecord& p_record, char* p_out);
+}// namespace sp
+
+#endif // CsvParser_hpp
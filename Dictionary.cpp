@@ -0,0 +1,94 @@
+#include "Dictionary.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <mutex>
+
+using namespace sp;
+
+CodeDictionary::CodeDictionary(std::initializer_list<std::string_view> p_known,
+                               size_t p_max_codes)
+  : known_(p_known.begin(), p_known.end()),
+    max_codes_(p_max_codes < kInvalidCode ? p_max_codes : kInvalidCode) {
+  // A table four times the key count makes a collision free seed likely
+  // within a few tries, it is only built once.
+  const size_t slots = std::bit_ceil(std::max<size_t>(8, known_.size() * 4));
+  mask_ = slots - 1;
+  for (;; ++seed_) {
+    table_.assign(slots, kInvalidCode);
+    bool collision = false;
+    for (size_t code = 0; code < known_.size() && !collision; ++code) {
+      auto& slot = table_[Hash(seed_, known_[code]) & mask_];
+      collision = slot != kInvalidCode;
+      slot = static_cast<Code>(code);
+    }
+    if (!collision) break;
+  }
+}
+
+uint64_t CodeDictionary::Hash(uint64_t p_seed, std::string_view p_name) {
+  // FNV-1a from the seed, then a murmur finaliser so the low bits used as
+  // the slot depend on every byte
+  uint64_t hash = 0xcbf29ce484222325ull ^ (p_seed * 0x9e3779b97f4a7c15ull);
+  for (const char c : p_name) {
+    hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001b3ull;
+  }
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdull;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+CodeDictionary::Code CodeDictionary::FindKnown(std::string_view p_name) const {
+  const Code code = table_[Hash(seed_, p_name) & mask_];
+  return code != kInvalidCode && known_[code] == p_name ? code : kInvalidCode;
+}
+
+CodeDictionary::Code CodeDictionary::Find(std::string_view p_name) const {
+  const Code code = FindKnown(p_name);
+  if (code != kInvalidCode) return code;
+  std::shared_lock lock(mutex_);
+  const auto it = dynamic_.find(p_name);
+  return it == dynamic_.end() ? kInvalidCode : it->second;
+}
+
+CodeDictionary::Code CodeDictionary::Encode(std::string_view p_name) {
+  const Code code = Find(p_name);
+  if (code != kInvalidCode) return code;
+
+  std::unique_lock lock(mutex_);
+  // Another thread may have added it in between
+  if (const auto it = dynamic_.find(p_name); it != dynamic_.end()) return it->second;
+  const size_t next = known_.size() + dynamic_names_.size();
+  if (next >= max_codes_) return kInvalidCode;
+  dynamic_names_.emplace_back(p_name);
+  dynamic_.emplace(dynamic_names_.back(), static_cast<Code>(next));
+  return static_cast<Code>(next);
+}
+
+std::string_view CodeDictionary::Decode(Code p_code) const {
+  if (p_code < known_.size()) return known_[p_code];
+  std::shared_lock lock(mutex_);
+  const size_t index = p_code - known_.size();
+  return index < dynamic_names_.size() ? std::string_view(dynamic_names_[index])
+                                       : std::string_view();
+}
+
+size_t CodeDictionary::GetSize() const {
+  std::shared_lock lock(mutex_);
+  return known_.size() + dynamic_names_.size();
+}
+
+CodeDictionary& sp::GetExchangeDictionary() {
+  static CodeDictionary dictionary(
+    {"NYSE", "NASDAQ", "NYSE_ARCA", "NSX", "NYSE_AMEX", "NYSE_NATIONAL", "BATS",
+     "BATY", "EDGA", "EDGX", "IEX", "CBOE", "PHLX", "BX", "PSX", "MEMX", "MIAX",
+     "LTSE", "CHX", "FINRA", "OTC"},
+    CodeDictionary::kInvalidCode);
+  return dictionary;
+}
+
+CodeDictionary& sp::GetTypeDictionary() {
+  static CodeDictionary dictionary({"Ask", "Bid", "TRADE"}, 256);
+  return dictionary;
+}
@@ -0,0 +1,70 @@
+#ifndef Dictionary_hpp
+#define Dictionary_hpp
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <initializer_list>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace sp {
+  // Maps the few distinct values of a text column (Exchange, Type) to small
+  // integer codes. The values known up front get codes 0..n-1 through a
+  // perfect hash built at construction: one hash, one table load and one
+  // compare, no locking. Anything else is appended to a dynamic dictionary
+  // on first sight, so codes are stable for the life of the process and
+  // shared by every reader thread.
+  class CodeDictionary {
+  public:
+    using Code = uint16_t;
+    static constexpr Code kInvalidCode = 0xffff;
+
+    // p_max_codes bounds known plus dynamic codes, e.g. 256 for uint8 storage
+    CodeDictionary(std::initializer_list<std::string_view> p_known, size_t p_max_codes);
+
+    CodeDictionary(const CodeDictionary&) = delete;
+    CodeDictionary& operator=(const CodeDictionary&) = delete;
+
+    // Code of p_name, adding it if unseen. kInvalidCode once p_max_codes
+    // are in use.
+    Code Encode(std::string_view p_name);
+    // As Encode but never adds, kInvalidCode for unseen names
+    Code Find(std::string_view p_name) const;
+    // Empty for codes never handed out
+    std::string_view Decode(Code p_code) const;
+
+    size_t GetKnownSize() const { return known_.size(); }
+    size_t GetSize() const;
+
+  private:
+    struct StringHash {
+      using is_transparent = void;
+      size_t operator()(std::string_view p_str) const {
+        return std::hash<std::string_view>{}(p_str);
+      }
+    };
+
+    static uint64_t Hash(uint64_t p_seed, std::string_view p_name);
+    Code FindKnown(std::string_view p_name) const;
+
+    std::vector<std::string> known_;  // Indexed by code
+    std::vector<Code> table_;         // Perfect hash slot -> code
+    uint64_t seed_ = 0;
+    uint64_t mask_ = 0;
+    size_t max_codes_;
+
+    mutable std::shared_mutex mutex_; // Guards the dynamic part
+    std::unordered_map<std::string, Code, StringHash, std::equal_to<>> dynamic_;
+    std::deque<std::string> dynamic_names_; // Code - known_.size()
+  };
+
+  // Process wide dictionaries of the Exchange (uint16 codes) and Type (uint8
+  // codes) columns, seeded with the US venues and Ask/Bid/TRADE
+  CodeDictionary& GetExchangeDictionary();
+  CodeDictionary& GetTypeDictionary();
+}// namespace sp
+
+#endif // Dictionary_hpp
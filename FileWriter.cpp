@@ -0,0 +1,112 @@
+#include "FileWriter.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace sp;
+
+FileWriter::FileWriter(const std::string& p_filename, OpenMode p_mode,
+                       size_t p_buffer_size,
+                       std::pmr::memory_resource* p_resource)
+  : fd_(-1),
+    filename_(p_filename),
+    buffer_(std::max<size_t>(p_buffer_size, 1), p_resource),
+    used_(0),
+    file_length_(0),
+    last_error_(Error::None) {
+  int flags = O_WRONLY | O_CREAT;
+  if (p_mode == OpenMode::Truncate) flags |= O_TRUNC;
+
+  fd_ = open(filename_.c_str(), flags, 0644);
+  if (fd_ == -1) {
+    last_error_ = Error::FileOpenFailed;
+    return;
+  }
+
+  struct stat file_stat;
+  if (fstat(fd_, &file_stat) == -1) {
+    last_error_ = Error::FileOpenFailed;
+    close(fd_);
+    fd_ = -1;
+    return;
+  }
+  file_length_ = static_cast<size_t>(file_stat.st_size);
+  lseek(fd_, 0, SEEK_END);
+}
+
+FileWriter::~FileWriter() {
+  if (fd_ != -1) {
+    Flush();
+    close(fd_);
+  }
+}
+
+FileWriter::Error FileWriter::WriteAll(const char* p_data, size_t p_size) {
+  while (p_size > 0) {
+    const ssize_t written = write(fd_, p_data, p_size);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      std::cerr << "Failed to write to file: " << filename_
+                << " error: " << std::strerror(errno) << std::endl;
+      last_error_ = Error::WriteFailed;
+      return last_error_;
+    }
+    p_data += written;
+    p_size -= static_cast<size_t>(written);
+    file_length_ += static_cast<size_t>(written);
+  }
+  return Error::None;
+}
+
+FileWriter::Error FileWriter::Write(std::string_view p_data) {
+  if (fd_ == -1) return Error::FileOpenFailed;
+
+  if (used_ + p_data.size() > buffer_.size()) {
+    if (const auto error = Flush(); error != Error::None) return error;
+    // Larger than the whole buffer, no point copying it
+    if (p_data.size() >= buffer_.size()) {
+      return WriteAll(p_data.data(), p_data.size());
+    }
+  }
+  std::memcpy(buffer_.data() + used_, p_data.data(), p_data.size());
+  used_ += p_data.size();
+  return Error::None;
+}
+
+FileWriter::Error FileWriter::WriteLine(std::string_view p_line) {
+  if (const auto error = Write(p_line); error != Error::None) return error;
+  return Write("\n");
+}
+
+FileWriter::Error FileWriter::Flush() {
+  if (fd_ == -1) return Error::FileOpenFailed;
+  if (used_ == 0) return Error::None;
+  const auto error = WriteAll(buffer_.data(), used_);
+  used_ = 0;
+  return error;
+}
+
+FileWriter::Error FileWriter::Sync() {
+  if (const auto error = Flush(); error != Error::None) return error;
+  if (fdatasync(fd_) == -1) {
+    last_error_ = Error::SyncFailed;
+    return last_error_;
+  }
+  return Error::None;
+}
+
+FileWriter::Error FileWriter::Truncate(size_t p_length) {
+  if (const auto error = Flush(); error != Error::None) return error;
+  if (ftruncate(fd_, static_cast<off_t>(p_length)) == -1 ||
+      lseek(fd_, static_cast<off_t>(p_length), SEEK_SET) == -1) {
+    last_error_ = Error::TruncateFailed;
+    return last_error_;
+  }
+  file_length_ = p_length;
+  return Error::None;
+}
@@ -0,0 +1,67 @@
+#ifndef FileWriter_hpp
+#define FileWriter_hpp
+#include <cstddef>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace sp {
+  // Buffered append-only output file for the merged stream. MMF::WriteLine
+  // msyncs on every line which is far too slow for billions of records, this
+  // writes whole buffers with write(2) and only syncs when asked to.
+  class FileWriter {
+  public:
+    enum class OpenMode {
+      Truncate, // Start from an empty file
+      Append    // Keep existing content, e.g. to resume from a checkpoint
+    };
+
+    enum class Error {
+      None,
+      FileOpenFailed,
+      WriteFailed,
+      SyncFailed,
+      TruncateFailed
+    };
+
+    static constexpr size_t kDefaultBufferSize = 4 * 1024 * 1024;
+
+    // p_resource backs the output buffer, e.g. a HugePageMemoryResource
+    explicit FileWriter(
+      const std::string& p_filename,
+      OpenMode p_mode = OpenMode::Truncate,
+      size_t p_buffer_size = kDefaultBufferSize,
+      std::pmr::memory_resource* p_resource = std::pmr::get_default_resource());
+    ~FileWriter();
+
+    FileWriter(const FileWriter&) = delete;
+    FileWriter& operator=(const FileWriter&) = delete;
+
+    bool IsValid() const { return fd_ != -1; }
+    Error GetLastError() const { return last_error_; }
+    const std::string& GetFilename() const { return filename_; }
+    // Bytes in the file once everything buffered is flushed
+    size_t GetLength() const { return file_length_ + used_; }
+
+    Error Write(std::string_view p_data);
+    Error WriteLine(std::string_view p_line);
+    Error Flush();
+    // Flush and fdatasync, used before a checkpoint refers to this length
+    Error Sync();
+    // Flushes, then cuts the file to p_length and continues writing there
+    Error Truncate(size_t p_length);
+
+  private:
+    Error WriteAll(const char* p_data, size_t p_size);
+
+    int fd_;
+    std::string filename_;
+    std::pmr::vector<char> buffer_;
+    size_t used_;
+    size_t file_length_;
+    Error last_error_;
+  };
+}// namespace sp
+
+#endif // FileWriter_hpp
@@ -0,0 +1,255 @@
+#include "HugePages.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <new>
+#include <sstream>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace sp;
+
+namespace {
+  constexpr size_t kDefaultPmdSize = 2 * 1024 * 1024;
+
+  struct Region {
+    void* ptr;
+    size_t size;
+    size_t requested;  // Caller's size, 0 for HugePageMode::None
+    HugePageMode mode; // Mode actually obtained
+    bool fallback;     // Regular pages although huge pages were asked for
+  };
+
+  struct Vma {
+    std::uintptr_t start;
+    std::uintptr_t end;
+    size_t huge_bytes;
+  };
+
+  std::mutex regions_mutex_;
+  std::vector<Region> regions_;
+  size_t requested_bytes_ = 0;
+  size_t fallback_bytes_ = 0;
+
+  size_t GetPageSize() {
+    static const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGE_SIZE));
+    return page_size;
+  }
+
+  size_t GetPmdSize() {
+    static const size_t pmd_size = [] {
+      std::ifstream in("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size");
+      size_t size = 0;
+      return (in >> size && size > 0) ? size : kDefaultPmdSize;
+    }();
+    return pmd_size;
+  }
+
+  size_t RoundUp(size_t p_value, size_t p_multiple) {
+    return (p_value + p_multiple - 1) / p_multiple * p_multiple;
+  }
+
+  std::vector<Vma> ReadSmaps() {
+    std::vector<Vma> vmas;
+    std::ifstream in("/proc/self/smaps");
+    std::string line;
+    while (std::getline(in, line)) {
+      if (line.empty()) continue;
+      // VMA header lines start with "start-end", field lines with "Name:"
+      const auto dash = line.find('-');
+      const auto colon = line.find(':');
+      if (dash != std::string::npos && (colon == std::string::npos || dash < colon) &&
+          std::isxdigit(static_cast<unsigned char>(line[0]))) {
+        const auto space = line.find(' ');
+        Vma vma{};
+        vma.start = std::stoull(line.substr(0, dash), nullptr, 16);
+        vma.end = std::stoull(line.substr(dash + 1, space - dash - 1), nullptr, 16);
+        vmas.push_back(vma);
+        continue;
+      }
+      if (vmas.empty()) continue;
+      if (line.rfind("AnonHugePages:", 0) == 0 || line.rfind("FilePmdMapped:", 0) == 0 ||
+          line.rfind("ShmemPmdMapped:", 0) == 0) {
+        std::istringstream iss(line.substr(colon + 1));
+        size_t kb = 0;
+        iss >> kb;
+        vmas.back().huge_bytes += kb * 1024;
+      }
+    }
+    return vmas;
+  }
+
+  // THP bytes of every VMA overlapping the range. VMAs merge with their
+  // neighbours, so this may include adjacent mappings with the same flags.
+  size_t SumHugeBytes(const std::vector<Vma>& p_vmas, const void* p_addr,
+                      size_t p_size) {
+    const auto begin = reinterpret_cast<std::uintptr_t>(p_addr);
+    const auto end = begin + p_size;
+    size_t bytes = 0;
+    for (const auto& vma : p_vmas) {
+      if (vma.start < end && begin < vma.end) {
+        bytes += std::min(vma.huge_bytes, p_size);
+      }
+    }
+    return std::min(bytes, p_size);
+  }
+
+  void* MapAnonymous(size_t p_size, int p_extra_flags) {
+    void* ptr = mmap(nullptr, p_size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | p_extra_flags, -1, 0);
+    return ptr == MAP_FAILED ? nullptr : ptr;
+  }
+
+  // Over-maps and trims so the buffer starts on a PMD boundary, otherwise
+  // the first and last partial huge page can never be collapsed.
+  void* MapPmdAligned(size_t p_size) {
+    const size_t pmd = GetPmdSize();
+    auto* raw = static_cast<char*>(MapAnonymous(p_size + pmd, 0));
+    if (raw == nullptr) return nullptr;
+    const auto addr = reinterpret_cast<std::uintptr_t>(raw);
+    auto* aligned = reinterpret_cast<char*>(RoundUp(addr, pmd));
+    const size_t head = aligned - raw;
+    const size_t tail = pmd - head;
+    if (head > 0) munmap(raw, head);
+    if (tail > 0) munmap(aligned + p_size, tail);
+    return aligned;
+  }
+} // namespace
+
+size_t sp::GetExplicitHugePageSize() {
+  std::ifstream meminfo("/proc/meminfo");
+  std::string line;
+  while (std::getline(meminfo, line)) {
+    if (line.rfind("Hugepagesize:", 0) == 0) {
+      std::istringstream iss(line.substr(13));
+      size_t kb = 0;
+      iss >> kb;
+      return kb * 1024;
+    }
+  }
+  return 0;
+}
+
+size_t sp::GetTransparentHugePageBytes(const void* p_addr, size_t p_size) {
+  if (p_addr == nullptr || p_size == 0) return 0;
+  return SumHugeBytes(ReadSmaps(), p_addr, p_size);
+}
+
+void* sp::AllocateHugePageBuffer(size_t p_size, HugePageMode p_mode,
+                                 size_t* p_mapped_size) {
+  if (p_size == 0) return nullptr;
+
+  void* ptr = nullptr;
+  size_t mapped_size = 0;
+  HugePageMode obtained = HugePageMode::None;
+  bool fallback = false;
+
+  if (p_mode == HugePageMode::Explicit) {
+    const size_t huge_page = GetExplicitHugePageSize();
+    if (huge_page > 0) {
+      mapped_size = RoundUp(p_size, huge_page);
+      ptr = MapAnonymous(mapped_size, MAP_HUGETLB);
+      if (ptr != nullptr) obtained = HugePageMode::Explicit;
+    }
+  }
+
+  if (ptr == nullptr && p_mode != HugePageMode::None) {
+    // Pool empty or not configured, try transparent huge pages instead
+    mapped_size = RoundUp(p_size, GetPmdSize());
+    ptr = MapPmdAligned(mapped_size);
+    if (ptr != nullptr) {
+      if (madvise(ptr, mapped_size, MADV_HUGEPAGE) == 0) {
+        obtained = HugePageMode::Transparent;
+      } else {
+        fallback = true;
+      }
+    }
+  }
+
+  if (ptr == nullptr) {
+    mapped_size = RoundUp(p_size, GetPageSize());
+    ptr = MapAnonymous(mapped_size, 0);
+    if (ptr == nullptr) return nullptr;
+    fallback = p_mode != HugePageMode::None;
+  }
+
+  const size_t requested = p_mode != HugePageMode::None ? p_size : 0;
+  {
+    std::lock_guard<std::mutex> lock(regions_mutex_);
+    regions_.push_back({ptr, mapped_size, requested, obtained, fallback});
+    requested_bytes_ += requested;
+    if (fallback) fallback_bytes_ += mapped_size;
+  }
+  if (fallback) {
+    // Once per process, GetHugePageStats has the totals
+    static std::once_flag logged;
+    std::call_once(logged, [p_size] {
+      std::cerr << "Huge pages unavailable for buffer of size: " << p_size
+                << ", using regular pages" << std::endl;
+    });
+  }
+
+  if (p_mapped_size) *p_mapped_size = mapped_size;
+  return ptr;
+}
+
+void sp::FreeHugePageBuffer(void* p_ptr, size_t p_mapped_size) {
+  if (p_ptr == nullptr) return;
+  {
+    std::lock_guard<std::mutex> lock(regions_mutex_);
+    auto it = std::find_if(regions_.begin(), regions_.end(),
+                           [p_ptr](const Region& r) { return r.ptr == p_ptr; });
+    if (it != regions_.end()) {
+      p_mapped_size = it->size;
+      requested_bytes_ -= it->requested;
+      if (it->fallback) fallback_bytes_ -= it->size;
+      regions_.erase(it);
+    }
+  }
+  if (p_mapped_size > 0) munmap(p_ptr, p_mapped_size);
+}
+
+bool sp::AdviseHugePages(void* p_addr, size_t p_size) {
+  if (p_addr == nullptr || p_size == 0) return false;
+  return madvise(p_addr, p_size, MADV_HUGEPAGE) == 0;
+}
+
+HugePageStats sp::GetHugePageStats() {
+  std::vector<Region> regions;
+  HugePageStats stats;
+  {
+    std::lock_guard<std::mutex> lock(regions_mutex_);
+    regions = regions_;
+    stats.requested_bytes = requested_bytes_;
+    stats.fallback_bytes = fallback_bytes_;
+  }
+
+  stats.explicit_page_size = GetExplicitHugePageSize();
+  std::vector<Vma> vmas;
+  for (const auto& region : regions) {
+    if (region.mode == HugePageMode::Explicit) {
+      if (stats.explicit_page_size > 0)
+        stats.explicit_pages += region.size / stats.explicit_page_size;
+    } else if (region.mode == HugePageMode::Transparent) {
+      if (vmas.empty()) vmas = ReadSmaps();
+      stats.transparent_bytes += SumHugeBytes(vmas, region.ptr, region.size);
+    }
+  }
+  return stats;
+}
+
+void* HugePageMemoryResource::do_allocate(size_t p_bytes, size_t p_alignment) {
+  if (p_alignment > GetPageSize()) throw std::bad_alloc();
+  void* ptr = AllocateHugePageBuffer(p_bytes, mode_);
+  if (ptr == nullptr) throw std::bad_alloc();
+  return ptr;
+}
+
+void HugePageMemoryResource::do_deallocate(void* p_ptr, size_t, size_t) {
+  FreeHugePageBuffer(p_ptr, 0);
+}
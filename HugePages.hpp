@@ -0,0 +1,59 @@
+#ifndef HugePages_hpp
+#define HugePages_hpp
+#include <cstddef>
+#include <memory_resource>
+
+namespace sp {
+  enum class HugePageMode {
+    None,        // Plain 4 KiB pages
+    Transparent, // madvise(MADV_HUGEPAGE), khugepaged may collapse later
+    Explicit     // MAP_HUGETLB from the reserved pool, falls back to Transparent
+  };
+
+  struct HugePageStats {
+    size_t requested_bytes = 0;  // Bytes asked for with a mode other than None
+    size_t explicit_pages = 0;   // Pages obtained from the hugetlb pool
+    size_t explicit_page_size = 0;
+    size_t transparent_bytes = 0; // THP backed bytes right now (smaps)
+    size_t fallback_bytes = 0;    // Bytes that could not even be advised
+  };
+
+  // Hugepagesize from /proc/meminfo, 0 when the kernel has no hugetlb
+  size_t GetExplicitHugePageSize();
+
+  // Bytes of [p_addr, p_addr + p_size) currently backed by transparent huge
+  // pages, anonymous (AnonHugePages) or file backed (FilePmdMapped)
+  size_t GetTransparentHugePageBytes(const void* p_addr, size_t p_size);
+
+  // Anonymous read/write buffer, never fails just because huge pages are not
+  // available. The returned size is rounded up to the page size in use and
+  // must be passed back to FreeHugePageBuffer. Returns nullptr on failure.
+  void* AllocateHugePageBuffer(size_t p_size, HugePageMode p_mode,
+                               size_t* p_mapped_size = nullptr);
+  void FreeHugePageBuffer(void* p_ptr, size_t p_mapped_size);
+
+  // Advises an existing mapping (e.g. an MMF window), false if refused
+  bool AdviseHugePages(void* p_addr, size_t p_size);
+
+  // Totals over the live buffers from AllocateHugePageBuffer
+  HugePageStats GetHugePageStats();
+
+  // Upstream for WindowArena and other pmr containers (sort arenas, output
+  // buffers) so that their blocks come from huge pages.
+  class HugePageMemoryResource : public std::pmr::memory_resource {
+  public:
+    explicit HugePageMemoryResource(HugePageMode p_mode = HugePageMode::Transparent)
+      : mode_(p_mode) {}
+
+  private:
+    void* do_allocate(size_t p_bytes, size_t p_alignment) override;
+    void do_deallocate(void* p_ptr, size_t p_bytes, size_t p_alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& p_other) const noexcept override {
+      return this == &p_other;
+    }
+
+    HugePageMode mode_;
+  };
+}// namespace sp
+
+#endif // HugePages_hpp
@@ -0,0 +1,202 @@
+#include "InputFilter.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+
+#include "Dictionary.hpp"
+#include "MktData.hpp"
+#include "Mmf.hpp"
+
+using namespace sp;
+
+namespace {
+  std::vector<std::string> Sorted(std::vector<std::string> p_values) {
+    std::sort(p_values.begin(), p_values.end());
+    p_values.erase(std::unique(p_values.begin(), p_values.end()), p_values.end());
+    return p_values;
+  }
+
+  bool Contains(const std::vector<std::string>& p_sorted, std::string_view p_value) {
+    return std::binary_search(p_sorted.begin(), p_sorted.end(), p_value, std::less<>{});
+  }
+
+  // Membership by code, names unseen so far are added to the dictionary so
+  // that records of those venues still match once they show up
+  std::vector<bool> EncodeSet(CodeDictionary& p_dictionary,
+                              const std::vector<std::string>& p_names) {
+    std::vector<bool> codes;
+    for (const auto& name : p_names) {
+      const auto code = p_dictionary.Encode(name);
+      if (code == CodeDictionary::kInvalidCode) continue;
+      if (code >= codes.size()) codes.resize(code + 1u, false);
+      codes[code] = true;
+    }
+    return codes;
+  }
+
+  bool ContainsCode(const std::vector<bool>& p_codes, size_t p_code) {
+    return p_code < p_codes.size() && p_codes[p_code];
+  }
+
+  // p_time padded to the full timestamp layout, nullopt if it is not a
+  // prefix of a timestamp
+  std::optional<std::string> PadTimestamp(std::string p_time) {
+    constexpr std::string_view kEarliest = "0000-01-01 00:00:00.000";
+    if (p_time.size() > kEarliest.size()) return std::nullopt;
+    p_time.append(kEarliest.substr(p_time.size()));
+    if (!MktData::IsTimestamp(p_time)) return std::nullopt;
+    return p_time;
+  }
+
+  // Input line layout: Timestamp, Price, Size, Exchange, Type
+  constexpr size_t kExchangeField = 3;
+  constexpr size_t kTypeField = 4;
+}
+
+InputFilter& InputFilter::SetSymbols(std::vector<std::string> p_symbols) {
+  symbols_ = Sorted(std::move(p_symbols));
+  return *this;
+}
+
+InputFilter& InputFilter::SetTimeRange(std::string p_start, std::string p_end) {
+  const auto start = p_start.empty() ? std::optional<std::string>("") : PadTimestamp(p_start);
+  const auto end = p_end.empty() ? std::optional<std::string>("") : PadTimestamp(p_end);
+  valid_time_range_ = start && end;
+  if (!valid_time_range_) {
+    std::cerr << "Invalid time range: [" << p_start << ", " << p_end
+              << "), nothing will be accepted" << std::endl;
+  }
+  start_time_ = start.value_or("");
+  end_time_ = end.value_or("");
+  start_millis_ = start_time_.empty() ? INT64_MIN : MktData::TimestampToMillis(start_time_);
+  end_millis_ = end_time_.empty() ? INT64_MAX : MktData::TimestampToMillis(end_time_);
+  return *this;
+}
+
+InputFilter& InputFilter::SetTypes(std::vector<std::string> p_types) {
+  types_ = Sorted(std::move(p_types));
+  type_codes_ = EncodeSet(GetTypeDictionary(), types_);
+  return *this;
+}
+
+InputFilter& InputFilter::SetExchanges(std::vector<std::string> p_exchanges) {
+  exchanges_ = Sorted(std::move(p_exchanges));
+  exchange_codes_ = EncodeSet(GetExchangeDictionary(), exchanges_);
+  return *this;
+}
+
+bool InputFilter::IsEmpty() const {
+  return valid_time_range_ && symbols_.empty() && start_time_.empty() && end_time_.empty() &&
+         types_.empty() && exchanges_.empty();
+}
+
+bool InputFilter::AcceptsSymbol(std::string_view p_symbol) const {
+  return symbols_.empty() || Contains(symbols_, p_symbol);
+}
+
+bool InputFilter::AcceptsLine(std::string_view p_line) const {
+  if (!valid_time_range_) return false;
+  if (!start_time_.empty() || !end_time_.empty()) {
+    const auto timestamp = MktData::GetTimestampField(p_line);
+    if (timestamp < start_time_ || IsPastEnd(timestamp)) return false;
+  }
+  if (!exchanges_.empty() && !Contains(exchanges_, MktData::GetField(p_line, kExchangeField))) {
+    return false;
+  }
+  return types_.empty() || Contains(types_, MktData::GetField(p_line, kTypeField));
+}
+
+bool InputFilter::AcceptsRecord(const MktDataRecord& p_record) const {
+  if (!valid_time_range_) return false;
+  if (p_record.timestamp < start_millis_ || p_record.timestamp >= end_millis_) return false;
+  if (!exchanges_.empty() && !ContainsCode(exchange_codes_, p_record.exchange)) return false;
+  return types_.empty() || ContainsCode(type_codes_, p_record.type);
+}
+
+std::string sp::GetRecordSourceSymbol(const std::string& p_filename) {
+  std::filesystem::path path(p_filename);
+  if (path.extension() == ".gz" || path.extension() == ".zst") path = path.stem();
+  return MktData::GetSymbolFromFilename(path.string());
+}
+
+bool sp::IsInputFilename(const std::string& p_filename) {
+  // TimeIndex, SymbolBitmapIndex, FrameIndex, MergeCheckpoint and
+  // WriteFileAtomically
+  static constexpr std::string_view kNotInputs[] = {".tidx", ".sbm", ".fidx", ".ckpt", ".tmp"};
+  const auto extension = std::filesystem::path(p_filename).extension().string();
+  return std::find(std::begin(kNotInputs), std::end(kNotInputs), extension) ==
+         std::end(kNotInputs);
+}
+
+std::vector<std::string> sp::ListInputFiles(const std::string& p_directory,
+                                            const InputFilter& p_filter) {
+  std::vector<std::string> files;
+  std::error_code ec;
+  for (const auto& entry : std::filesystem::directory_iterator(p_directory, ec)) {
+    if (!entry.is_regular_file(ec)) continue;
+    const auto filename = entry.path().string();
+    if (IsInputFilename(filename) && p_filter.AcceptsSymbol(GetRecordSourceSymbol(filename))) {
+      files.push_back(filename);
+    }
+  }
+  if (ec) {
+    std::cerr << "Failed to list input directory: " << p_directory
+              << " with error: " << ec.message() << std::endl;
+  }
+  std::sort(files.begin(), files.end());
+  return files;
+}
+
+size_t sp::SeekToTime(std::string_view p_data, std::string_view p_timestamp) {
+  // Every line before lo is early, the line at hi (if any) is not
+  size_t lo = 0;
+  size_t hi = p_data.size();
+  const auto line_end = [p_data](size_t p_start) {
+    const auto eol = p_data.find('\n', p_start);
+    return eol == std::string_view::npos ? p_data.size() : eol + 1;
+  };
+  const auto is_early = [&](size_t p_start) {
+    // The leading header sorts before everything. Any other non-data line,
+    // a blank one in the middle say, sorts with the next data line so that
+    // the predicate stays monotonic, or last if no data line follows.
+    for (size_t start = p_start; start < p_data.size(); start = line_end(start)) {
+      const auto line = p_data.substr(start, line_end(start) - start);
+      if (MktData::IsDataLine(line)) return MktData::GetTimestampField(line) < p_timestamp;
+      if (start == 0) return true;
+    }
+    return false;
+  };
+
+  while (lo < hi) {
+    const size_t mid = lo + (hi - lo) / 2;
+    const size_t start = mid == lo ? lo : line_end(mid - 1);
+    if (start >= hi) {
+      // No line starts in [mid, hi), the line at lo decides
+      if (is_early(lo)) {
+        lo = line_end(lo);
+      } else {
+        hi = lo;
+      }
+    } else if (is_early(start)) {
+      lo = line_end(start);
+    } else {
+      hi = start;
+    }
+  }
+  return lo;
+}
+
+std::optional<size_t> sp::SeekFileToTime(const std::string& p_filename,
+                                         std::string_view p_timestamp) {
+  const MMF mmf(p_filename);
+  if (!mmf.IsValid()) {
+    std::cerr << "Failed to open input file: " << p_filename << " with error: "
+              << static_cast<int>(mmf.GetLastError()) << std::endl;
+    return std::nullopt;
+  }
+  const auto data = mmf.GetData();
+  if (!data) return 0; // Empty file
+  return SeekToTime(
+    std::string_view(static_cast<const char*>(*data), *mmf.GetMappedSize()), p_timestamp);
+}
@@ -0,0 +1,76 @@
+#ifndef InputFilter_hpp
+#define InputFilter_hpp
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "MktDataRecord.hpp"
+
+namespace sp {
+  // Selection applied where the inputs are read, so that unwanted symbols
+  // are never opened, files are entered at the start time and nothing
+  // outside the selection reaches the queue or the merge. Every empty part
+  // accepts everything.
+  class InputFilter {
+  public:
+    InputFilter& SetSymbols(std::vector<std::string> p_symbols);
+    // [p_start, p_end) in the input format, e.g. "2021-03-05 10:00:00.000".
+    // Either may be empty for an open range. A prefix such as
+    // "2021-03-05 10:00" is padded to the full layout with the earliest time
+    // it covers. A bound that is not a timestamp makes IsValid() false and
+    // the filter accept nothing, on lines and records alike.
+    InputFilter& SetTimeRange(std::string p_start, std::string p_end);
+    // Type column, e.g. {"TRADE"}
+    InputFilter& SetTypes(std::vector<std::string> p_types);
+    InputFilter& SetExchanges(std::vector<std::string> p_exchanges);
+
+    bool IsEmpty() const;
+    bool IsValid() const { return valid_time_range_; }
+    const std::string& GetStartTime() const { return start_time_; }
+
+    bool AcceptsSymbol(std::string_view p_symbol) const;
+    // Time range, type and exchange of one input line
+    bool AcceptsLine(std::string_view p_line) const;
+    // Same for a parsed record, by dictionary code instead of text
+    bool AcceptsRecord(const MktDataRecord& p_record) const;
+    // Inputs are sorted by time, nothing after this can match any more
+    bool IsPastEnd(std::string_view p_timestamp) const {
+      return !valid_time_range_ || (!end_time_.empty() && p_timestamp >= end_time_);
+    }
+
+  private:
+    std::vector<std::string> symbols_;   // Sorted
+    std::string start_time_;
+    std::string end_time_;
+    std::vector<std::string> types_;     // Sorted
+    std::vector<std::string> exchanges_; // Sorted
+    int64_t start_millis_ = INT64_MIN;
+    int64_t end_millis_ = INT64_MAX;
+    bool valid_time_range_ = true;
+    std::vector<bool> type_codes_;       // Indexed by dictionary code
+    std::vector<bool> exchange_codes_;
+  };
+
+  // Symbol of an input without opening it, e.g. /data/MSFT.txt.gz -> MSFT
+  std::string GetRecordSourceSymbol(const std::string& p_filename);
+  // False for the files a merge leaves next to its output (time index,
+  // symbol bitmaps, frame index, checkpoint) and for unfinished .tmp files,
+  // which must never be merged as inputs
+  bool IsInputFilename(const std::string& p_filename);
+
+  // Input files of p_directory whose symbol passes p_filter, sorted by name
+  std::vector<std::string> ListInputFiles(const std::string& p_directory,
+                                          const InputFilter& p_filter = {});
+
+  // Offset of the first line of a time sorted input whose timestamp is not
+  // before p_timestamp, p_data.size() if there is none. Binary search, so
+  // only O(log n) pages of a mapped file are touched.
+  size_t SeekToTime(std::string_view p_data, std::string_view p_timestamp);
+  std::optional<size_t> SeekFileToTime(const std::string& p_filename,
+                                       std::string_view p_timestamp);
+}// namespace sp
+
+#endif // InputFilter_hpp
@@ -0,0 +1,252 @@
+#include "InputScan.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <fcntl.h>
+#include <filesystem>
+#include <iostream>
+#include <sys/stat.h>
+#include <thread>
+#include <tuple>
+#include <unistd.h>
+
+#include "MktData.hpp"
+#include "utils.hpp"
+
+using namespace sp;
+
+namespace {
+  // Read at either end of a file for its timestamps, lines are far shorter
+  constexpr size_t kEdgeBytes = 4096;
+
+  bool IsCompressed(const std::filesystem::path& p_path) {
+    return p_path.extension() == ".gz" || p_path.extension() == ".zst";
+  }
+
+  std::string Normalize(const std::string& p_path) {
+    return std::filesystem::path(p_path).lexically_normal().string();
+  }
+
+  bool IsTimestamp(std::string_view p_timestamp) {
+    return p_timestamp.size() == MktData::kTimestampLength && MktData::IsDataLine(p_timestamp);
+  }
+
+  // Timestamp of the first complete data line of p_data
+  std::string_view FirstTimestamp(std::string_view p_data) {
+    for (size_t eol; (eol = p_data.find('\n')) != std::string_view::npos;
+         p_data.remove_prefix(eol + 1)) {
+      const auto line = p_data.substr(0, eol);
+      if (MktData::IsDataLine(line)) return MktData::GetTimestampField(line);
+    }
+    return {};
+  }
+
+  // Timestamp of the last complete data line of p_data, the tail of a file
+  // whose first line may be cut
+  std::string_view LastTimestamp(std::string_view p_data) {
+    auto eol = p_data.rfind('\n');
+    while (eol != std::string_view::npos && eol != 0) {
+      const auto start = p_data.rfind('\n', eol - 1);
+      if (start == std::string_view::npos) break; // Possibly cut
+      const auto line = p_data.substr(start + 1, eol - start - 1);
+      if (MktData::IsDataLine(line)) return MktData::GetTimestampField(line);
+      eol = start;
+    }
+    return {};
+  }
+
+  // False if p_info.filename is gone or not a regular file
+  bool ScanFile(InputFileInfo& p_info, const InputScanOptions& p_options) {
+    const bool open = !p_info.compressed && (p_options.read_timestamps || p_options.prefetch_bytes);
+    struct stat st{};
+    int fd = -1;
+    if (open) {
+      fd = ::open(p_info.filename.c_str(), O_RDONLY | O_CLOEXEC);
+      if (fd < 0 || ::fstat(fd, &st) != 0) {
+        if (fd >= 0) ::close(fd);
+        return false;
+      }
+    } else if (::stat(p_info.filename.c_str(), &st) != 0) {
+      return false;
+    }
+    if (!S_ISREG(st.st_mode)) {
+      if (fd >= 0) ::close(fd);
+      return false;
+    }
+    p_info.size = static_cast<uint64_t>(st.st_size);
+    if (fd < 0) return true;
+
+    if (p_options.prefetch_bytes) {
+      const uint64_t length = std::min<uint64_t>(p_options.prefetch_bytes, p_info.size);
+      posix_fadvise(fd, 0, static_cast<off_t>(length), POSIX_FADV_WILLNEED);
+    }
+    if (p_options.read_timestamps && p_info.size != 0) {
+      char buffer[kEdgeBytes];
+      auto read = ::pread(fd, buffer, sizeof(buffer), 0);
+      const auto first = FirstTimestamp(std::string_view(buffer, read > 0 ? read : 0));
+      if (IsTimestamp(first)) p_info.first_timestamp = first;
+
+      const uint64_t tail = std::min<uint64_t>(p_info.size, kEdgeBytes);
+      read = ::pread(fd, buffer, tail, static_cast<off_t>(p_info.size - tail));
+      // The tail of a file holding a single page starts at a line
+      std::string_view data(buffer, read > 0 ? read : 0);
+      std::string padded;
+      if (tail == p_info.size) {
+        padded.reserve(data.size() + 1);
+        padded.append("\n").append(data);
+        data = padded;
+      }
+      const auto last = LastTimestamp(data);
+      if (IsTimestamp(last)) p_info.last_timestamp = last;
+    }
+    ::close(fd);
+    return true;
+  }
+}
+
+std::vector<std::string> InputDirectory::GetFilenames() const {
+  std::vector<std::string> filenames;
+  filenames.reserve(files.size());
+  for (const auto& file : files) filenames.push_back(file.filename);
+  return filenames;
+}
+
+std::vector<std::string> InputDirectory::GetSymbols() const {
+  std::vector<std::string> symbols;
+  symbols.reserve(files.size());
+  for (const auto& file : files) {
+    if (symbols.empty() || symbols.back() != file.symbol) symbols.push_back(file.symbol);
+  }
+  return symbols;
+}
+
+const InputFileInfo* InputDirectory::FindSymbol(std::string_view p_symbol) const {
+  const auto it = std::lower_bound(
+    files.begin(), files.end(), p_symbol,
+    [](const InputFileInfo& p_file, std::string_view p_value) { return p_file.symbol < p_value; });
+  return it != files.end() && it->symbol == p_symbol ? &*it : nullptr;
+}
+
+std::vector<std::string> InputDirectory::PlanTimePartitions(size_t p_parts) const {
+  struct Span {
+    int64_t first;
+    int64_t last;
+    double bytes;
+  };
+  std::vector<Span> spans;
+  double total = 0;
+  for (const auto& file : files) {
+    if (file.first_timestamp.empty() || file.last_timestamp.empty()) continue;
+    spans.push_back({MktData::TimestampToMillis(file.first_timestamp),
+                     MktData::TimestampToMillis(file.last_timestamp),
+                     static_cast<double>(file.size)});
+    total += spans.back().bytes;
+  }
+  if (p_parts < 2 || spans.empty() || total == 0) return {};
+
+  // Input bytes before p_millis
+  const auto bytes_before = [&spans](int64_t p_millis) {
+    double bytes = 0;
+    for (const auto& span : spans) {
+      if (p_millis > span.last) {
+        bytes += span.bytes;
+      } else if (p_millis > span.first) {
+        bytes += span.bytes * static_cast<double>(p_millis - span.first) /
+                 static_cast<double>(span.last - span.first + 1);
+      }
+    }
+    return bytes;
+  };
+
+  std::vector<std::string> boundaries;
+  int64_t lo = MktData::TimestampToMillis(first_timestamp);
+  const int64_t hi = MktData::TimestampToMillis(last_timestamp);
+  for (size_t part = 1; part < p_parts; ++part) {
+    const double target = total * static_cast<double>(part) / static_cast<double>(p_parts);
+    // First millisecond with at least target bytes before it
+    int64_t low = lo;
+    int64_t high = hi;
+    while (low < high) {
+      const int64_t mid = low + (high - low) / 2;
+      if (bytes_before(mid) < target) {
+        low = mid + 1;
+      } else {
+        high = mid;
+      }
+    }
+    lo = low;
+    char timestamp[MktData::kTimestampLength];
+    MktData::MillisToTimestamp(low, timestamp);
+    boundaries.emplace_back(timestamp, sizeof(timestamp));
+  }
+  return boundaries;
+}
+
+std::optional<InputDirectory> sp::ScanInputDirectory(const std::string& p_directory,
+                                                     const InputScanOptions& p_options) {
+  const auto start = std::chrono::steady_clock::now();
+  InputDirectory directory;
+  const std::string output = p_options.output.empty() ? std::string() : Normalize(p_options.output);
+  std::error_code ec;
+  // Names only: file types are checked by the parallel stat, a directory
+  // entry without d_type would otherwise cost a serial stat here
+  for (const auto& entry : std::filesystem::directory_iterator(p_directory, ec)) {
+    InputFileInfo info;
+    info.filename = entry.path().string();
+    if (!IsInputFilename(info.filename)) continue;
+    if (!output.empty() && Normalize(info.filename) == output) continue;
+    info.compressed = IsCompressed(entry.path());
+    info.symbol = GetRecordSourceSymbol(info.filename);
+    if (p_options.filter.AcceptsSymbol(info.symbol)) directory.files.push_back(std::move(info));
+  }
+  if (ec) {
+    std::cerr << "Failed to list input directory: " << p_directory
+              << " with error: " << ec.message() << std::endl;
+    return std::nullopt;
+  }
+
+  const size_t count = directory.files.size();
+  size_t threads = p_options.threads;
+  if (threads == 0) threads = std::max<size_t>(size_t{4} * GetCpuCoreCount(), 16);
+  threads = std::max<size_t>(std::min(threads, count), 1);
+  std::vector<char> found(count, 0);
+  std::atomic<size_t> next{0};
+  const auto worker = [&]() {
+    for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < count;) {
+      found[i] = ScanFile(directory.files[i], p_options);
+    }
+  };
+  std::vector<std::thread> workers;
+  workers.reserve(threads - 1);
+  for (size_t t = 1; t < threads; ++t) workers.emplace_back(worker);
+  worker();
+  for (auto& thread : workers) thread.join();
+
+  size_t kept = 0;
+  for (size_t i = 0; i < count; ++i) {
+    if (!found[i]) continue;
+    if (kept != i) directory.files[kept] = std::move(directory.files[i]);
+    ++kept;
+  }
+  directory.files.resize(kept);
+  std::sort(directory.files.begin(), directory.files.end(),
+            [](const InputFileInfo& p_lhs, const InputFileInfo& p_rhs) {
+              return std::tie(p_lhs.symbol, p_lhs.filename) < std::tie(p_rhs.symbol, p_rhs.filename);
+            });
+  for (const auto& file : directory.files) {
+    directory.total_bytes += file.size;
+    if (!file.first_timestamp.empty() &&
+        (directory.first_timestamp.empty() || file.first_timestamp < directory.first_timestamp)) {
+      directory.first_timestamp = file.first_timestamp;
+    }
+    if (file.last_timestamp > directory.last_timestamp) {
+      directory.last_timestamp = file.last_timestamp;
+    }
+  }
+  directory.elapsed = std::chrono::steady_clock::now() - start;
+  std::cout << "Scanned: " << directory.files.size() << " input files, "
+            << directory.total_bytes << " bytes in: "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(directory.elapsed).count()
+            << " ms with: " << threads << " threads" << std::endl;
+  return directory;
+}
@@ -0,0 +1,74 @@
+#ifndef InputScan_hpp
+#define InputScan_hpp
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "InputFilter.hpp"
+
+namespace sp {
+  struct InputFileInfo {
+    std::string filename;
+    std::string symbol;          // Without .txt and .gz / .zst
+    uint64_t size = 0;           // On disk, compressed size for .gz / .zst
+    bool compressed = false;
+    // First and last data line timestamps, read_timestamps only and never
+    // for compressed inputs. Empty if the file has no complete data line.
+    std::string first_timestamp;
+    std::string last_timestamp;
+  };
+
+  struct InputScanOptions {
+    // Files stat'ed (and read) at once, 0 uses 4 per core and at least 16:
+    // the work is latency bound on network filesystems, not CPU bound
+    unsigned int threads = 0;
+    // Reads the first and the last data line of every plain input, a page
+    // at each end
+    bool read_timestamps = false;
+    // Asks the kernel to read this much of every plain input ahead
+    // (POSIX_FADV_WILLNEED) so that the merge does not start on cold files
+    size_t prefetch_bytes = 0;
+    InputFilter filter;
+    // Merge output written into the scanned directory, left out like the
+    // sidecars and tmp files (IsInputFilename). Compared as spelled after
+    // lexical normalization, e.g. "data/merged.txt" for directory "data".
+    std::string output;
+  };
+
+  // Startup view of an input directory: what the merge stages need to plan
+  // before the first input is mapped.
+  struct InputDirectory {
+    // Sorted by symbol, then filename. A symbol may have several files
+    // (MSFT.txt and MSFT.txt.gz), so an index into files is not the
+    // symbol's rank: take ranks for tie-breaking from GetSymbols().
+    std::vector<InputFileInfo> files;
+    uint64_t total_bytes = 0;
+    std::string first_timestamp; // Earliest of every file, read_timestamps only
+    std::string last_timestamp;
+    std::chrono::steady_clock::duration elapsed{};
+
+    std::vector<std::string> GetFilenames() const;
+    // Sorted, without duplicates: the symbol table, an index is the rank
+    std::vector<std::string> GetSymbols() const;
+    // First file of p_symbol, nullptr if there is none
+    const InputFileInfo* FindSymbol(std::string_view p_symbol) const;
+    // p_parts - 1 timestamps splitting [first_timestamp, last_timestamp]
+    // into ranges of about the same input bytes, taking the bytes of every
+    // file as spread evenly between its first and last timestamp. Empty
+    // without timestamps.
+    std::vector<std::string> PlanTimePartitions(size_t p_parts) const;
+  };
+
+  // Lists p_directory and stats its input files passing p_options.filter on a
+  // pool of threads, so startup costs about one metadata round trip per
+  // thread's share of files instead of one per file. Files that disappear
+  // in between are left out. nullopt if the directory cannot be listed.
+  std::optional<InputDirectory> ScanInputDirectory(const std::string& p_directory,
+                                                   const InputScanOptions& p_options = {});
+}// namespace sp
+
+#endif // InputScan_hpp
@@ -1,70 +1,158 @@
 #ifndef MPSCQUEUE_HPP
 #define MPSCQUEUE_HPP
 
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <cstdint>
 #include <deque>
+#include <memory>
 #include <mutex>
 #include <optional>
+#include <thread>
+#include <type_traits>
+
 namespace sp {
-  template<typename T>
+  // How Dequeue() waits for an empty queue. Producers only pay for a
+  // wake-up (condition variable or futex) while the consumer is parked.
+  enum class QueueWaitStrategy {
+    Blocking,  // Park on a condition variable right away, no cpu burnt
+    BusySpin,  // Never park, lowest latency, one core at 100%
+    SpinYield, // Spin briefly, then keep yielding the core
+    SpinFutex  // Spin briefly, then park on a futex
+  };
+
+  // Counters of an instrumented MPSCQueue since construction or the last
+  // ResetTelemetry()
+  struct QueueTelemetry {
+    uint64_t enqueued = 0;
+    uint64_t dequeued = 0;
+    uint64_t high_water_mark = 0;     // Most items queued at once
+    uint64_t contended_enqueues = 0;  // Producer found the mutex taken
+    std::chrono::nanoseconds producer_blocked{0}; // Summed over producers
+    uint64_t cache_swaps = 0;         // Dequeue took a whole batch at once
+    std::chrono::nanoseconds consumer_idle{0};    // Dequeue found it empty
+    std::chrono::nanoseconds elapsed{0};
+
+    double GetEnqueueRate() const { return PerSecond(enqueued); }
+    double GetDequeueRate() const { return PerSecond(dequeued); }
+    // Mean items handed over per cache swap
+    double GetItemsPerSwap() const {
+      return cache_swaps == 0 ? 0.0 : static_cast<double>(dequeued) / cache_swaps;
+    }
+
+  private:
+    double PerSecond(uint64_t p_count) const {
+      return elapsed.count() == 0 ? 0.0 : p_count * 1e9 / elapsed.count();
+    }
+  };
+
+  // EnableTelemetry = true counts the figures of QueueTelemetry. Off, every
+  // counter and clock read is compiled out.
+  template<typename T, typename Allocator = std::allocator<T>, bool EnableTelemetry = false>
   class MPSCQueue {
   public:
+    using container_type = std::deque<T, Allocator>;
+    using WaitStrategy = QueueWaitStrategy;
+    static constexpr bool kTelemetry = EnableTelemetry;
+
+    // Spins before SpinYield yields and SpinFutex parks
+    static constexpr int kSpinCount = 1024;
+
+    MPSCQueue() = default;
+    // Both the shared queue and the consumer cache use p_allocator. The
+    // consumer frees nodes without holding the mutex, so it must be safe to
+    // use from the producers and the consumer at once.
+    explicit MPSCQueue(const Allocator& p_allocator)
+      : queue_(p_allocator), cache_(p_allocator) {}
+    explicit MPSCQueue(WaitStrategy p_strategy, const Allocator& p_allocator = Allocator())
+      : queue_(p_allocator), cache_(p_allocator), strategy_(p_strategy) {}
+
+    WaitStrategy GetWaitStrategy() const { return strategy_; }
+
     // Enqueue: called by multiple producers, never blocks
     void Enqueue(const T &value) {
+      bool parked;
       {
-        std::lock_guard<std::mutex> lock(mutex_);
+        const auto lock = LockProducer();
         queue_.push_back(value);
+        parked = Published(1);
       }
-      cv_.notify_one();
+      if (parked) WakeConsumer();
     }
 
     void Enqueue(T &&value) {
+      bool parked;
       {
-        std::lock_guard<std::mutex> lock(mutex_);
+        const auto lock = LockProducer();
         queue_.push_back(std::move(value));
+        parked = Published(1);
       }
-      cv_.notify_one();
+      if (parked) WakeConsumer();
     }
 
     void BulkEnqueue(const std::deque<T> &values) {
+      bool parked;
       {
-        std::lock_guard<std::mutex> lock(mutex_);
+        const auto lock = LockProducer();
         for (const auto &value: values) {
           queue_.push_back(value);
         }
+        parked = Published(values.size());
       }
-      cv_.notify_all();
+      if (parked) WakeConsumer();
     }
 
     void BulkEnqueue(std::deque<T> &&values) {
+      bool parked;
       {
-        std::lock_guard<std::mutex> lock(mutex_);
+        const auto lock = LockProducer();
         for (auto &value: values) {
           queue_.push_back(std::move(value));
         }
+        parked = Published(values.size());
       }
-      cv_.notify_all();
+      if (parked) WakeConsumer();
     }
 
-    // Dequeue: called by a single consumer, blocks if empty
+    // Dequeue: called by a single consumer, waits per the strategy if empty
     T Dequeue() {
       // Optimization
       if (!cache_.empty()) {
         T value = std::move(cache_.front());
         cache_.pop_front();
+        CountDequeued();
         return value;
       }
 
       // If cache is empty, wait for new items to be enqueued
+      if (strategy_ != WaitStrategy::Blocking &&
+          pending_.load(std::memory_order_acquire) == 0) {
+        const auto start = Now();
+        SpinUntilPending();
+        AddIdle(start);
+      }
       std::unique_lock<std::mutex> lock(mutex_);
-      cv_.wait(lock, [this] { return !queue_.empty(); });
+      if (queue_.empty()) {
+        // Blocking only, the spinning strategies return with items pending
+        const auto start = Now();
+        consumer_parked_.store(1, std::memory_order_relaxed);
+        consumer_cv_.wait(lock, [this] { return !queue_.empty(); });
+        consumer_parked_.store(0, std::memory_order_relaxed);
+        AddIdle(start);
+      }
       T value = std::move(queue_.front());
       queue_.pop_front();
       if (!queue_.empty()) {
         // Move remaining items to cache for next dequeue
         // This avoids locking the mutex again if the queue is not empty
         cache_.swap(queue_);
+        if constexpr (kTelemetry) {
+          telemetry_.cache_swaps.fetch_add(1, std::memory_order_relaxed);
+        }
       }
+      pending_.store(0, std::memory_order_relaxed);
+      CountDequeued();
       return value;
     }
 
@@ -74,6 +162,7 @@ namespace sp {
       if (!cache_.empty()) {
         T value = std::move(cache_.front());
         cache_.pop_front();
+        CountDequeued();
         return value;
       }
       std::lock_guard<std::mutex> lock(mutex_);
@@ -85,7 +174,12 @@ namespace sp {
         // Move remaining items to cache for next dequeue
         // This avoids locking the mutex again if the queue is not empty
         cache_.swap(queue_);
+        if constexpr (kTelemetry) {
+          telemetry_.cache_swaps.fetch_add(1, std::memory_order_relaxed);
+        }
       }
+      pending_.store(0, std::memory_order_relaxed);
+      CountDequeued();
       return value;
     }
 
@@ -117,13 +211,152 @@ namespace sp {
       cv_.wait(lock, [this] { return done_file_count_.load() == 0; });
     }
 
+    // True while Dequeue() sleeps on an empty queue (not while it spins)
+    bool IsConsumerParked() const {
+      return consumer_parked_.load(std::memory_order_acquire) != 0;
+    }
+
+    // Consistent per counter, not across counters while producers run
+    QueueTelemetry GetTelemetry() const requires EnableTelemetry {
+      QueueTelemetry snapshot;
+      snapshot.enqueued = telemetry_.enqueued.load(std::memory_order_relaxed);
+      snapshot.dequeued = telemetry_.dequeued.load(std::memory_order_relaxed);
+      snapshot.high_water_mark = telemetry_.high_water_mark.load(std::memory_order_relaxed);
+      snapshot.contended_enqueues = telemetry_.contended_enqueues.load(std::memory_order_relaxed);
+      snapshot.producer_blocked = std::chrono::nanoseconds(
+        telemetry_.producer_blocked_ns.load(std::memory_order_relaxed));
+      snapshot.cache_swaps = telemetry_.cache_swaps.load(std::memory_order_relaxed);
+      snapshot.consumer_idle = std::chrono::nanoseconds(
+        telemetry_.consumer_idle_ns.load(std::memory_order_relaxed));
+      snapshot.elapsed = Now() - telemetry_.since.load(std::memory_order_relaxed);
+      return snapshot;
+    }
+
+    void ResetTelemetry() requires EnableTelemetry {
+      std::lock_guard<std::mutex> lock(mutex_);
+      telemetry_.enqueued.store(0, std::memory_order_relaxed);
+      telemetry_.dequeued.store(0, std::memory_order_relaxed);
+      telemetry_.high_water_mark.store(0, std::memory_order_relaxed);
+      telemetry_.contended_enqueues.store(0, std::memory_order_relaxed);
+      telemetry_.producer_blocked_ns.store(0, std::memory_order_relaxed);
+      telemetry_.cache_swaps.store(0, std::memory_order_relaxed);
+      telemetry_.consumer_idle_ns.store(0, std::memory_order_relaxed);
+      telemetry_.since.store(Now(), std::memory_order_relaxed);
+    }
+
   private:
-    std::deque<T> queue_;
-    std::deque<T> cache_;
+    using Clock = std::chrono::steady_clock;
+
+    struct Counters {
+      std::atomic<uint64_t> enqueued{0};
+      std::atomic<uint64_t> dequeued{0};
+      std::atomic<uint64_t> high_water_mark{0};
+      std::atomic<uint64_t> contended_enqueues{0};
+      std::atomic<int64_t> producer_blocked_ns{0};
+      std::atomic<uint64_t> cache_swaps{0};
+      std::atomic<int64_t> consumer_idle_ns{0};
+      std::atomic<Clock::time_point> since{Clock::now()};
+    };
+    struct NoCounters {};
+
+    static Clock::time_point Now() {
+      if constexpr (kTelemetry) return Clock::now();
+      else return {};
+    }
+
+    void AddIdle(Clock::time_point p_start) {
+      if constexpr (kTelemetry) {
+        telemetry_.consumer_idle_ns.fetch_add((Now() - p_start).count(),
+                                              std::memory_order_relaxed);
+      }
+    }
+
+    void CountDequeued() {
+      if constexpr (kTelemetry) telemetry_.dequeued.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Plain lock without telemetry, otherwise a try_lock first so that only
+    // contended acquisitions are timed
+    std::unique_lock<std::mutex> LockProducer() {
+      if constexpr (kTelemetry) {
+        std::unique_lock<std::mutex> lock(mutex_, std::try_to_lock);
+        if (lock.owns_lock()) return lock;
+        const auto start = Clock::now();
+        lock.lock();
+        telemetry_.contended_enqueues.fetch_add(1, std::memory_order_relaxed);
+        telemetry_.producer_blocked_ns.fetch_add((Clock::now() - start).count(),
+                                                 std::memory_order_relaxed);
+        return lock;
+      } else {
+        return std::unique_lock<std::mutex>(mutex_);
+      }
+    }
+
+    // Under mutex_ after adding p_count items, true if the consumer must be
+    // woken. seq_cst on both sides: either the consumer sees the items
+    // before parking or the producer sees it parked.
+    bool Published(size_t p_count) {
+      if constexpr (kTelemetry) {
+        const uint64_t enqueued =
+          telemetry_.enqueued.fetch_add(p_count, std::memory_order_relaxed) + p_count;
+        // cache_ belongs to the consumer, the dequeue count stands in for it
+        const uint64_t dequeued = telemetry_.dequeued.load(std::memory_order_relaxed);
+        const uint64_t depth = enqueued > dequeued ? enqueued - dequeued : 0;
+        if (depth > telemetry_.high_water_mark.load(std::memory_order_relaxed)) {
+          telemetry_.high_water_mark.store(depth, std::memory_order_relaxed);
+        }
+      }
+      pending_.store(queue_.size(), std::memory_order_seq_cst);
+      return p_count != 0 && consumer_parked_.load(std::memory_order_seq_cst) != 0;
+    }
+
+    void WakeConsumer() {
+      if (strategy_ == WaitStrategy::SpinFutex) {
+        consumer_parked_.store(0, std::memory_order_seq_cst);
+        consumer_parked_.notify_one();
+      } else {
+        consumer_cv_.notify_one();
+      }
+    }
+
+    static void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+      __builtin_ia32_pause();
+#elif defined(__aarch64__)
+      asm volatile("yield");
+#endif
+    }
+
+    // Returns once pending_ is non-zero, without taking the mutex
+    void SpinUntilPending() {
+      for (int spin = 0; pending_.load(std::memory_order_acquire) == 0; ++spin) {
+        if (strategy_ == WaitStrategy::BusySpin || spin < kSpinCount) {
+          CpuRelax();
+        } else if (strategy_ == WaitStrategy::SpinYield) {
+          std::this_thread::yield();
+        } else {
+          // SpinFutex: declare parked, re-check, sleep on the flag
+          consumer_parked_.store(1, std::memory_order_seq_cst);
+          if (pending_.load(std::memory_order_seq_cst) != 0) {
+            consumer_parked_.store(0, std::memory_order_relaxed);
+            break;
+          }
+          consumer_parked_.wait(1, std::memory_order_seq_cst);
+        }
+      }
+    }
+
+    container_type queue_;
+    container_type cache_;
     mutable std::mutex mutex_;
-    std::condition_variable cv_;
-    std::atomic_size_t done_file_count_;
-    constexpr size_t total_files_ =
+    std::condition_variable cv_;          // Done file count changes
+    std::condition_variable consumer_cv_; // Blocking Dequeue
+    WaitStrategy strategy_ = WaitStrategy::Blocking;
+    std::atomic_size_t pending_{0};       // queue_.size(), readable without mutex_
+    std::atomic<uint32_t> consumer_parked_{0};
+    [[no_unique_address]] std::conditional_t<kTelemetry, Counters, NoCounters> telemetry_;
+    std::atomic_size_t done_file_count_{0};
+    static constexpr size_t total_files_ =
         10000;
   };
 } // namespace sp
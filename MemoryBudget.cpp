@@ -0,0 +1,290 @@
+#include "MemoryBudget.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <sched.h>
+#include <sstream>
+#include <string>
+
+#include "utils.hpp"
+
+using namespace sp;
+
+namespace {
+  // cgroup v1 reports "no limit" as a page-rounded LONG_MAX
+  constexpr size_t kUnlimitedThreshold = size_t{1} << 60;
+
+  std::optional<std::string> ReadFirstLine(const std::filesystem::path& p_path) {
+    std::ifstream in(p_path);
+    std::string line;
+    if (!in || !std::getline(in, line)) return std::nullopt;
+    return line;
+  }
+
+  std::optional<size_t> ReadNumber(const std::filesystem::path& p_path) {
+    const auto line = ReadFirstLine(p_path);
+    if (!line || line->empty() || *line == "max") return std::nullopt;
+    try {
+      const long long value = std::stoll(*line);
+      if (value < 0) return std::nullopt;
+      return static_cast<size_t>(value);
+    } catch (const std::exception&) {
+      return std::nullopt;
+    }
+  }
+
+  // Returns the value of "<p_key> <value>" from a memory.stat style file
+  size_t ReadStatValue(const std::filesystem::path& p_path,
+                       const std::string& p_key) {
+    std::ifstream in(p_path);
+    std::string key;
+    size_t value = 0;
+    while (in >> key >> value) {
+      if (key == p_key) return value;
+    }
+    return 0;
+  }
+
+  // Returns the value in bytes of a "<p_label> <kB> kB" line
+  size_t ReadMemInfoKb(const std::filesystem::path& p_path,
+                       const std::string& p_label) {
+    std::ifstream in(p_path);
+    std::string line;
+    while (std::getline(in, line)) {
+      const auto pos = line.find(p_label);
+      if (pos == std::string::npos) continue;
+      std::istringstream iss(line.substr(pos + p_label.size()));
+      size_t kb = 0;
+      iss >> kb;
+      return kb * 1024;
+    }
+    return 0;
+  }
+
+  struct CgroupPaths {
+    std::optional<std::filesystem::path> v2;
+    std::filesystem::path v2_mount;
+    std::optional<std::filesystem::path> v1_memory;
+    std::optional<std::filesystem::path> v1_cpu;
+  };
+
+  // The path in /proc/self/cgroup is relative to the hierarchy root, which in
+  // a container is usually mounted as the cgroup itself. Prefer the nested
+  // directory when it exists and fall back to the mount root otherwise.
+  std::filesystem::path ResolveCgroupDir(const std::filesystem::path& p_mount,
+                                         const std::string& p_relative) {
+    std::error_code ec;
+    const auto nested = p_mount / std::filesystem::path(p_relative).relative_path();
+    if (!p_relative.empty() && p_relative != "/" &&
+        std::filesystem::is_directory(nested, ec)) {
+      return nested;
+    }
+    return p_mount;
+  }
+
+  CgroupPaths FindCgroupPaths(const std::string& p_root) {
+    CgroupPaths paths;
+    const std::filesystem::path cgroup_root = p_root + "/sys/fs/cgroup";
+    std::ifstream in(p_root + "/proc/self/cgroup");
+    std::string line;
+    while (std::getline(in, line)) {
+      const auto first = line.find(':');
+      const auto second = line.find(':', first + 1);
+      if (first == std::string::npos || second == std::string::npos) continue;
+      const auto controllers = line.substr(first + 1, second - first - 1);
+      const auto relative = line.substr(second + 1);
+
+      if (controllers.empty()) {
+        std::error_code ec;
+        // Hybrid hosts mount v2 under unified/
+        const auto unified = cgroup_root / "unified";
+        const auto mount = std::filesystem::exists(cgroup_root / "cgroup.controllers", ec)
+                             ? cgroup_root : unified;
+        paths.v2 = ResolveCgroupDir(mount, relative);
+        paths.v2_mount = mount;
+        continue;
+      }
+
+      std::istringstream list(controllers);
+      std::string controller;
+      while (std::getline(list, controller, ',')) {
+        if (controller == "memory") {
+          paths.v1_memory = ResolveCgroupDir(cgroup_root / "memory", relative);
+        } else if (controller == "cpu") {
+          paths.v1_cpu = ResolveCgroupDir(cgroup_root / controllers, relative);
+        }
+      }
+    }
+    return paths;
+  }
+
+  void ProbeCgroupV2(const std::filesystem::path& p_dir,
+                     const std::filesystem::path& p_mount,
+                     MemoryBudget::Limits& p_limits) {
+    // A limit anywhere up the hierarchy applies, keep the tightest one
+    for (auto dir = p_dir;; dir = dir.parent_path()) {
+      if (const auto limit = ReadNumber(dir / "memory.max")) {
+        if (!p_limits.cgroup_limit || *limit < *p_limits.cgroup_limit) {
+          p_limits.cgroup_limit = *limit;
+          p_limits.cgroup_usage = ReadNumber(dir / "memory.current").value_or(0);
+          p_limits.cgroup_reclaimable = ReadStatValue(dir / "memory.stat", "inactive_file");
+        }
+      }
+      if (const auto cpu_max = ReadFirstLine(dir / "cpu.max")) {
+        std::istringstream iss(*cpu_max);
+        std::string quota;
+        double period = 0;
+        long long quota_us = 0;
+        if (iss >> quota >> period && quota != "max" && period > 0) {
+          const auto [end, error] =
+            std::from_chars(quota.data(), quota.data() + quota.size(), quota_us);
+          if (error == std::errc() && end == quota.data() + quota.size() && quota_us > 0) {
+            const double cpus = static_cast<double>(quota_us) / period;
+            if (!p_limits.cpu_quota || cpus < *p_limits.cpu_quota)
+              p_limits.cpu_quota = cpus;
+          }
+        }
+      }
+      if (dir == p_mount || dir == dir.parent_path()) break;
+    }
+  }
+
+  void ProbeCgroupV1(const CgroupPaths& p_paths, MemoryBudget::Limits& p_limits) {
+    if (p_paths.v1_memory) {
+      const auto& dir = *p_paths.v1_memory;
+      const auto limit = ReadNumber(dir / "memory.limit_in_bytes");
+      if (limit && *limit < kUnlimitedThreshold) {
+        p_limits.cgroup_limit = *limit;
+        p_limits.cgroup_usage = ReadNumber(dir / "memory.usage_in_bytes").value_or(0);
+        p_limits.cgroup_reclaimable = ReadStatValue(dir / "memory.stat", "total_inactive_file");
+      }
+    }
+    if (p_paths.v1_cpu) {
+      const auto& dir = *p_paths.v1_cpu;
+      const auto quota = ReadFirstLine(dir / "cpu.cfs_quota_us");
+      const auto period = ReadNumber(dir / "cpu.cfs_period_us");
+      if (quota && period && *period > 0) {
+        try {
+          const long long quota_us = std::stoll(*quota);
+          if (quota_us > 0)
+            p_limits.cpu_quota = static_cast<double>(quota_us) / *period;
+        } catch (const std::exception&) {}
+      }
+    }
+  }
+
+  std::vector<size_t> ProbeNodeFree(const std::string& p_root) {
+    // The nodes under p_root, not the live topology, so a fake root is
+    // probed consistently
+    std::vector<size_t> node_free;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(
+           p_root + "/sys/devices/system/node", ec)) {
+      const auto name = entry.path().filename().string();
+      unsigned int id = 0;
+      const auto [end, error] = std::from_chars(name.data() + std::min<size_t>(4, name.size()),
+                                                name.data() + name.size(), id);
+      if (name.rfind("node", 0) != 0 || error != std::errc() || end != name.data() + name.size()) {
+        continue;
+      }
+      if (node_free.size() <= id) node_free.resize(id + 1, 0);
+      node_free[id] = ReadMemInfoKb(entry.path() / "meminfo", "MemFree:");
+    }
+    return node_free;
+  }
+} // namespace
+
+MemoryBudget::Limits MemoryBudget::Probe(const std::string& p_root) {
+  Limits limits;
+  limits.mem_total = ReadMemInfoKb(p_root + "/proc/meminfo", "MemTotal:");
+  limits.mem_available = ReadMemInfoKb(p_root + "/proc/meminfo", "MemAvailable:");
+  if (limits.mem_available == 0) {
+    // Kernels before 3.14 do not report MemAvailable
+    limits.mem_available = ReadMemInfoKb(p_root + "/proc/meminfo", "MemFree:");
+  }
+
+  const auto paths = FindCgroupPaths(p_root);
+  if (paths.v2) {
+    ProbeCgroupV2(*paths.v2, paths.v2_mount, limits);
+  }
+  if (!limits.cgroup_limit || !limits.cpu_quota) {
+    ProbeCgroupV1(paths, limits);
+  }
+
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  limits.affinity_cpus = sched_getaffinity(0, sizeof(set), &set) == 0
+                           ? static_cast<unsigned int>(CPU_COUNT(&set))
+                           : GetCpuCoreCount();
+  limits.node_free = ProbeNodeFree(p_root);
+  return limits;
+}
+
+MemoryBudget::MemoryBudget(double p_fraction, StageShares p_shares,
+                           const std::string& p_root)
+  : limits_(Probe(p_root)),
+    fraction_(std::clamp(p_fraction, 0.0, 1.0)),
+    total_budget_(0),
+    stage_budgets_{} {
+  total_budget_ = static_cast<size_t>(GetUsableMemory() * fraction_);
+
+  const std::array<double, static_cast<size_t>(Stage::Count)> weights = {
+    std::max(p_shares.read_windows, 0.0),
+    std::max(p_shares.queue_capacity, 0.0),
+    std::max(p_shares.sort_buffers, 0.0),
+    std::max(p_shares.output_buffers, 0.0)};
+  double sum = 0;
+  for (const auto w : weights) sum += w;
+  if (sum <= 0) return;
+
+  for (size_t i = 0; i < weights.size(); ++i) {
+    stage_budgets_[i] = static_cast<size_t>(total_budget_ * (weights[i] / sum));
+  }
+}
+
+size_t MemoryBudget::GetUsableMemory() const {
+  size_t usable = limits_.mem_available;
+  if (limits_.cgroup_limit) {
+    const size_t unreclaimable = limits_.cgroup_usage > limits_.cgroup_reclaimable
+                                   ? limits_.cgroup_usage - limits_.cgroup_reclaimable
+                                   : 0;
+    const size_t headroom = *limits_.cgroup_limit > unreclaimable
+                              ? *limits_.cgroup_limit - unreclaimable
+                              : 0;
+    usable = usable == 0 ? headroom : std::min(usable, headroom);
+  }
+  return usable;
+}
+
+size_t MemoryBudget::GetStageBudget(Stage p_stage) const {
+  if (p_stage == Stage::Count) return 0;
+  return stage_budgets_[static_cast<size_t>(p_stage)];
+}
+
+size_t MemoryBudget::GetStageBudgetPerThread(Stage p_stage,
+                                             unsigned int p_threads) const {
+  return GetStageBudget(p_stage) / std::max(1u, p_threads);
+}
+
+size_t MemoryBudget::GetStageBudgetForNode(Stage p_stage,
+                                           unsigned int p_node) const {
+  size_t total_free = 0;
+  for (const auto free : limits_.node_free) total_free += free;
+  if (total_free == 0 || p_node >= limits_.node_free.size()) {
+    return GetStageBudget(p_stage);
+  }
+  const double share = static_cast<double>(limits_.node_free[p_node]) / total_free;
+  return static_cast<size_t>(GetStageBudget(p_stage) * share);
+}
+
+unsigned int MemoryBudget::GetEffectiveCpuCount() const {
+  unsigned int cpus = std::max(1u, limits_.affinity_cpus);
+  if (limits_.cpu_quota) {
+    const auto quota = static_cast<unsigned int>(std::ceil(*limits_.cpu_quota));
+    cpus = std::min(cpus, std::max(1u, quota));
+  }
+  return cpus;
+}
@@ -0,0 +1,77 @@
+#ifndef MemoryBudget_hpp
+#define MemoryBudget_hpp
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace sp {
+  // Relative weights of the MemoryBudget stages, normalised so that the
+  // stages always sum to the configured fraction.
+  struct MemoryStageShares {
+    double read_windows = 0.40;
+    double queue_capacity = 0.15;
+    double sort_buffers = 0.30;
+    double output_buffers = 0.15;
+  };
+
+  // Splits the memory the process may actually use between the pipeline
+  // stages. The usable amount is the smallest of MemAvailable and the
+  // headroom left under the cgroup (v1 or v2) memory limit, where reclaimable
+  // page cache charged to the cgroup counts as headroom. A configured
+  // fraction of that is handed out per stage according to StageShares.
+  class MemoryBudget {
+  public:
+    enum class Stage {
+      ReadWindows,
+      QueueCapacity,
+      SortBuffers,
+      OutputBuffers,
+      Count
+    };
+
+    using StageShares = MemoryStageShares;
+
+    struct Limits {
+      size_t mem_total = 0;
+      size_t mem_available = 0;
+      std::optional<size_t> cgroup_limit;
+      size_t cgroup_usage = 0;
+      size_t cgroup_reclaimable = 0;
+      unsigned int affinity_cpus = 0;
+      std::optional<double> cpu_quota; // In cpus, e.g. 2.5
+      std::vector<size_t> node_free;   // MemFree per NUMA node, by node id
+    };
+
+    // p_root prefixes /proc and /sys lookups, tests point it at a fake tree
+    explicit MemoryBudget(double p_fraction = 0.6,
+                          StageShares p_shares = {},
+                          const std::string& p_root = "");
+
+    static Limits Probe(const std::string& p_root = "");
+
+    const Limits& GetLimits() const { return limits_; }
+    double GetFraction() const { return fraction_; }
+
+    // Bytes the process can allocate without tripping the OOM killer
+    size_t GetUsableMemory() const;
+    // GetUsableMemory() scaled by the configured fraction
+    size_t GetTotalBudget() const { return total_budget_; }
+    size_t GetStageBudget(Stage p_stage) const;
+    size_t GetStageBudgetPerThread(Stage p_stage, unsigned int p_threads) const;
+    // Stage budget weighted by the node's share of free memory
+    size_t GetStageBudgetForNode(Stage p_stage, unsigned int p_node) const;
+
+    // min(affinity mask, ceil(cfs/cpu.max quota)), at least 1
+    unsigned int GetEffectiveCpuCount() const;
+
+  private:
+    Limits limits_;
+    double fraction_;
+    size_t total_budget_;
+    std::array<size_t, static_cast<size_t>(Stage::Count)> stage_budgets_;
+  };
+}// namespace sp
+
+#endif // MemoryBudget_hpp
@@ -0,0 +1,534 @@
+#include "MergeJob.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+#include "MemoryBudget.hpp"
+#include "MktData.hpp"
+
+using namespace sp;
+
+namespace {
+  constexpr size_t kMinReadWindow = 1024 * 1024;
+}
+
+MergeJob::MergeJob(std::vector<std::string> p_inputs, std::string p_output,
+                   Options p_options)
+  : inputs_(std::move(p_inputs)),
+    output_(std::move(p_output)),
+    options_(std::move(p_options)) {}
+
+MergeJob::~MergeJob() = default;
+
+bool MergeJob::Cursor::Advance() {
+  for (;;) {
+    while (auto line_opt = mmf->ReadLineView(true)) {
+      if (!MktData::IsDataLine(*line_opt)) continue; // Header or empty line
+      const char* base = static_cast<const char*>(mmf->GetData().value());
+      line = *line_opt;
+      timestamp = MktData::GetTimestampField(line);
+      line_offset = mmf->GetMappedOffset().value() + (line.data() - base);
+      if (filter) {
+        if (filter->IsPastEnd(timestamp)) {
+          // Done for good, also in follow mode
+          end_offset = line_offset;
+          keep_open = false;
+          mmf.reset();
+          has_line = false;
+          line = {};
+          timestamp = {};
+          return false;
+        }
+        if (!filter->AcceptsLine(line)) continue;
+      }
+      if (keep_open) millis = MktData::TimestampToMillis(timestamp);
+      has_line = true;
+      return true;
+    }
+    // A followed file may have grown since it was last looked at
+    if (!keep_open || !mmf->IsValid() || !mmf->Refresh()) break;
+  }
+  const auto error = mmf->GetLastError();
+  if (error != MMF::Error::EndOfFile && !(keep_open && error == MMF::Error::NotMapped)) {
+    std::cerr << "Failed to read file: " << filename << " with error: "
+              << static_cast<int>(error) << std::endl;
+  }
+  end_offset = mmf->IsValid()
+    ? mmf->GetMappedOffset().value() + mmf->GetCurrentPosition().value()
+    : file_size;
+  if (!keep_open) mmf.reset();
+  has_line = false;
+  line = {};
+  timestamp = {};
+  return false;
+}
+
+size_t MergeJob::Cursor::GetResumeOffset() const {
+  if (has_line) return line_offset;
+  if (mmf && mmf->IsValid()) {
+    return mmf->GetMappedOffset().value() + mmf->GetCurrentPosition().value();
+  }
+  return end_offset;
+}
+
+bool MergeJob::HeapGreater(size_t p_lhs, size_t p_rhs) const {
+  const auto& lhs = cursors_[p_lhs];
+  const auto& rhs = cursors_[p_rhs];
+  if (lhs.timestamp != rhs.timestamp) return lhs.timestamp > rhs.timestamp;
+  return lhs.symbol > rhs.symbol;
+}
+
+bool MergeJob::IsLate(const Cursor& p_cursor) const {
+  if (p_cursor.timestamp != last_timestamp_) return p_cursor.timestamp < last_timestamp_;
+  return p_cursor.symbol < last_symbol_;
+}
+
+void MergeJob::PushCursor(size_t p_index) {
+  if (options_.follow) {
+    max_seen_millis_ = std::max(max_seen_millis_, cursors_[p_index].millis);
+  }
+  heap_.push_back(p_index);
+  std::push_heap(heap_.begin(), heap_.end(),
+                 [this](size_t a, size_t b) { return HeapGreater(a, b); });
+}
+
+void MergeJob::RequeueCursor(size_t p_index) {
+  auto& cursor = cursors_[p_index];
+  if (cursor.Advance()) {
+    PushCursor(p_index);
+  } else if (cursor.keep_open) {
+    cursor.idle_since = std::chrono::steady_clock::now();
+    ++idle_cursors_;
+  }
+}
+
+bool MergeJob::OpenCursor(Cursor& p_cursor, size_t p_offset) {
+  if (!options_.filter.AcceptsSymbol(p_cursor.symbol)) {
+    p_cursor.end_offset = p_offset;
+    return true; // Never opened
+  }
+  struct stat file_stat;
+  if (stat(p_cursor.filename.c_str(), &file_stat) == -1) {
+    std::cerr << "Failed to stat input file: " << p_cursor.filename << std::endl;
+    return false;
+  }
+  p_cursor.file_size = static_cast<size_t>(file_stat.st_size);
+  if (!options_.filter.IsEmpty()) p_cursor.filter = &options_.filter;
+  p_cursor.keep_open = options_.follow;
+  if (p_offset == 0 && !options_.filter.GetStartTime().empty()) {
+    // Enter a fresh input at the start time instead of reading up to it
+    const auto start = SeekFileToTime(p_cursor.filename, options_.filter.GetStartTime());
+    if (!start) return false;
+    p_offset = *start;
+  }
+  if (p_offset >= p_cursor.file_size && !options_.follow) {
+    p_cursor.end_offset = p_offset;
+    return true; // Empty or already fully merged
+  }
+  if (p_offset < p_cursor.file_size) {
+    new_input_bytes_ += p_cursor.file_size - p_offset;
+    p_cursor.mmf = std::make_unique<MMF>(p_cursor.filename, p_offset,
+                                         options_.read_window);
+  } else {
+    // Followed input with nothing new yet, possibly empty. Mapped whole so
+    // that Refresh() can map it once data arrives.
+    p_cursor.mmf = std::make_unique<MMF>(p_cursor.filename);
+    p_cursor.mmf->SetWindowSize(options_.read_window);
+    if (p_cursor.mmf->IsValid() && p_offset != 0) {
+      p_cursor.mmf->SetPosition(p_offset);
+    }
+  }
+  if (!p_cursor.mmf->IsValid() || p_cursor.mmf->GetLastError() != MMF::Error::None) {
+    std::cerr << "Failed to open input file: " << p_cursor.filename
+              << " with error: " << static_cast<int>(p_cursor.mmf->GetLastError())
+              << std::endl;
+    p_cursor.mmf.reset();
+    return false;
+  }
+  // Unterminated last lines are still being written
+  p_cursor.mmf->SetFollowMode(options_.incremental || options_.follow);
+  return true;
+}
+
+bool MergeJob::Open() {
+  if (options_.incremental && options_.checkpoint_path.empty()) {
+    std::cerr << "Incremental merge into: " << output_
+              << " needs a checkpoint path to remember input offsets" << std::endl;
+    return false;
+  }
+
+  std::optional<MergeCheckpoint> checkpoint;
+  if (!options_.checkpoint_path.empty()) {
+    checkpoint = MergeCheckpoint::Load(options_.checkpoint_path);
+  }
+  resumed_ = checkpoint.has_value();
+  if (!resumed_) {
+    // Left over from an earlier output at this path, they would describe
+    // the wrong bytes
+    std::remove(TimeIndex::GetPath(output_).c_str());
+    std::remove(SymbolBitmapIndex::GetPath(output_).c_str());
+  }
+
+  if (options_.read_window == 0) {
+    const MemoryBudget budget;
+    const size_t window = budget.GetStageBudget(MemoryBudget::Stage::ReadWindows) /
+                          std::max<size_t>(inputs_.size(), 1);
+    options_.read_window = std::max(window, kMinReadWindow);
+  }
+
+  if (options_.output_compression) {
+    if (!options_.checkpoint_path.empty()) {
+      std::cerr << "Compressed output: " << output_ << " cannot be checkpointed" << std::endl;
+      return false;
+    }
+    if (options_.time_index || options_.symbol_bitmaps) {
+      std::cerr << "Compressed output: " << output_
+                << " has a frame index, no time index or symbol bitmaps" << std::endl;
+      return false;
+    }
+    compressed_writer_ = std::make_unique<CompressedWriter>(
+      output_, *options_.output_compression, options_.output_threads);
+    if (!compressed_writer_->IsValid()) {
+      std::cerr << "Failed to open output file: " << output_ << std::endl;
+      return false;
+    }
+    compressed_writer_->WriteLine(kOutputHeader);
+    return OpenCursors(std::nullopt);
+  }
+
+  writer_ = std::make_unique<FileWriter>(
+    output_,
+    resumed_ ? FileWriter::OpenMode::Append : FileWriter::OpenMode::Truncate,
+    options_.output_buffer_size);
+  if (!writer_->IsValid()) {
+    std::cerr << "Failed to open output file: " << output_ << std::endl;
+    return false;
+  }
+
+  if (resumed_) {
+    if (writer_->GetLength() < checkpoint->output_length ||
+        writer_->Truncate(checkpoint->output_length) != FileWriter::Error::None) {
+      std::cerr << "Output file: " << output_ << " is shorter than checkpoint: "
+                << options_.checkpoint_path << ", cannot resume" << std::endl;
+      return false;
+    }
+    records_written_.store(checkpoint->records_written, std::memory_order_relaxed);
+    last_timestamp_ = checkpoint->last_timestamp;
+    last_symbol_ = checkpoint->last_symbol;
+    std::cout << "Resuming merge into: " << output_ << " at length: "
+              << checkpoint->output_length << " after record: " << checkpoint->records_written
+              << " (" << last_timestamp_ << ", " << last_symbol_ << ")" << std::endl;
+  } else {
+    writer_->WriteLine(kOutputHeader);
+  }
+  if (options_.time_index) {
+    // Entries beyond the checkpoint refer to output that was just cut off
+    TimeIndex index;
+    if (resumed_) {
+      auto saved = TimeIndex::Load(TimeIndex::GetPath(output_));
+      if (saved && saved->output.Matches(output_)) {
+        index = std::move(*saved);
+        index.Truncate(checkpoint->output_length);
+      }
+    }
+    time_index_ = std::make_unique<TimeIndexWriter>(options_.time_index_records, std::move(index));
+  }
+  if (options_.symbol_bitmaps) {
+    std::vector<std::string> symbols;
+    symbols.reserve(inputs_.size());
+    for (const auto& input : inputs_) symbols.push_back(MktData::GetSymbolFromFilename(input));
+    std::sort(symbols.begin(), symbols.end());
+    symbols.erase(std::unique(symbols.begin(), symbols.end()), symbols.end());
+    std::optional<SymbolBitmapIndex> index;
+    if (resumed_) {
+      index = SymbolBitmapIndex::Load(SymbolBitmapIndex::GetPath(output_));
+      if (index && !index->output.Matches(output_)) index.reset();
+      if (index) index->Truncate(checkpoint->output_length);
+    }
+    symbol_bitmaps_ = std::make_unique<SymbolBitmapWriter>(
+      std::move(symbols), options_.symbol_bitmap_block_bytes, std::move(index));
+  }
+  return OpenCursors(checkpoint);
+}
+
+bool MergeJob::OpenCursors(const std::optional<MergeCheckpoint>& p_checkpoint) {
+  cursors_.clear();
+  cursors_.resize(inputs_.size());
+  heap_.clear();
+  heap_.reserve(inputs_.size());
+  idle_cursors_ = 0;
+  stale_cursors_ = 0;
+  max_seen_millis_ = 0;
+  for (size_t i = 0; i < inputs_.size(); ++i) {
+    auto& cursor = cursors_[i];
+    cursor.filename = inputs_[i];
+    cursor.symbol = MktData::GetSymbolFromFilename(inputs_[i]);
+    if (symbol_bitmaps_) cursor.symbol_bit = *symbol_bitmaps_->GetIndex().FindSymbol(cursor.symbol);
+    const size_t offset = p_checkpoint ? p_checkpoint->GetInputOffset(inputs_[i]).value_or(0) : 0;
+    if (!OpenCursor(cursor, offset)) return false;
+    if (cursor.mmf) RequeueCursor(i);
+  }
+  if (resumed_) {
+    std::cout << "Found: " << new_input_bytes_ << " new input bytes across: "
+              << inputs_.size() << " inputs" << std::endl;
+  }
+  SchedulePrefetch();
+  return true;
+}
+
+void MergeJob::SchedulePrefetch() {
+  if (options_.prefetch_inputs == 0 || options_.prefetch_bytes == 0 || heap_.empty()) return;
+  // The earliest heads are read next, make sure their files do not stall
+  // the merge on a page fault. Only their order among themselves matters.
+  prefetch_order_.assign(heap_.begin(), heap_.end());
+  const size_t count = std::min(options_.prefetch_inputs, prefetch_order_.size());
+  std::partial_sort(prefetch_order_.begin(), prefetch_order_.begin() + count,
+                    prefetch_order_.end(),
+                    [this](size_t a, size_t b) { return HeapGreater(b, a); });
+  for (size_t i = 0; i < count; ++i) {
+    const auto& mmf = cursors_[prefetch_order_[i]].mmf;
+    if (!mmf || !mmf->IsValid()) continue;
+    const size_t position = mmf->GetMappedOffset().value() + mmf->GetCurrentPosition().value();
+    const size_t ahead = mmf->GetPrefetchedUntil() > position
+      ? mmf->GetPrefetchedUntil() - position : 0;
+    if (ahead < options_.prefetch_bytes / 2) {
+      prefetched_bytes_ += mmf->Prefetch(options_.prefetch_bytes);
+    }
+  }
+}
+
+size_t MergeJob::Step(size_t p_max_records) {
+  const auto greater = [this](size_t a, size_t b) { return HeapGreater(a, b); };
+  size_t emitted = 0;
+  while (emitted < p_max_records && !heap_.empty() && !stop_flag_ && !checkpoint_failed_) {
+    std::pop_heap(heap_.begin(), heap_.end(), greater);
+    const size_t index = heap_.back();
+    heap_.pop_back();
+    auto& cursor = cursors_[index];
+
+    // Inputs that grew since the checkpoint may hold records behind it, in
+    // any resumed run and not only the incremental and follow ones
+    if ((options_.incremental || options_.follow || resumed_) && IsLate(cursor)) {
+      const size_t late = late_records_.load(std::memory_order_relaxed);
+      late_records_.store(late + 1, std::memory_order_relaxed);
+      if (late == 0) {
+        std::cerr << "Dropping records older than last emitted (" << last_timestamp_
+                  << ", " << last_symbol_ << "), first from: " << cursor.filename
+                  << " at: " << cursor.timestamp << std::endl;
+      }
+      RequeueCursor(index);
+      continue;
+    }
+
+    WriteRecord(cursor);
+    last_timestamp_.assign(cursor.timestamp);
+    last_symbol_.assign(cursor.symbol);
+    // Only this thread writes the counter, no read-modify-write needed
+    const size_t written = records_written_.load(std::memory_order_relaxed) + 1;
+    records_written_.store(written, std::memory_order_relaxed);
+    ++emitted;
+
+    RequeueCursor(index);
+
+    if (options_.prefetch_interval != 0 && written % options_.prefetch_interval == 0) {
+      SchedulePrefetch();
+    }
+    if (options_.checkpoint_interval != 0 && !options_.checkpoint_path.empty() &&
+        written % options_.checkpoint_interval == 0 && !Checkpoint()) {
+      // Without it a crash would replay everything since the last one
+      std::cerr << "Failed to write checkpoint: " << options_.checkpoint_path
+                << ", stopping the merge" << std::endl;
+      checkpoint_failed_ = true;
+    }
+  }
+  return emitted;
+}
+
+MergeCheckpoint MergeJob::MakeCheckpoint() const {
+  MergeCheckpoint checkpoint;
+  checkpoint.inputs.reserve(cursors_.size());
+  for (const auto& cursor : cursors_) {
+    checkpoint.inputs.push_back({cursor.filename, cursor.GetResumeOffset()});
+  }
+  checkpoint.last_timestamp = last_timestamp_;
+  checkpoint.last_symbol = last_symbol_;
+  checkpoint.output_length = writer_->GetLength();
+  checkpoint.records_written = records_written_.load(std::memory_order_relaxed);
+  return checkpoint;
+}
+
+bool MergeJob::Checkpoint() {
+  if (options_.checkpoint_path.empty() || !writer_) return false;
+  // The output must be durable up to the length the checkpoint refers to
+  if (writer_->Sync() != FileWriter::Error::None) {
+    std::cerr << "Failed to sync output file: " << output_ << std::endl;
+    return false;
+  }
+  return SaveSidecars() && MakeCheckpoint().Save(options_.checkpoint_path);
+}
+
+bool MergeJob::Run() {
+  if (options_.follow) return Follow();
+  if (!Open()) return false;
+  while (!IsDone() && !stop_flag_) {
+    Step(options_.checkpoint_interval ? options_.checkpoint_interval : 1'000'000);
+    if (!IsOutputValid() || checkpoint_failed_) return false;
+  }
+  if (!options_.checkpoint_path.empty()) {
+    return Checkpoint();
+  }
+  return CloseOutput();
+}
+
+void MergeJob::WriteRecord(const Cursor& p_cursor) {
+  if (compressed_writer_) {
+    compressed_writer_->Write(p_cursor.symbol);
+    compressed_writer_->Write(", ");
+    compressed_writer_->WriteLine(p_cursor.line);
+    return;
+  }
+  if (time_index_) time_index_->OnRecord(p_cursor.timestamp, writer_->GetLength(),
+                                         records_written_.load(std::memory_order_relaxed));
+  if (symbol_bitmaps_) symbol_bitmaps_->OnRecord(p_cursor.symbol_bit, writer_->GetLength());
+  writer_->Write(p_cursor.symbol);
+  writer_->Write(", ");
+  writer_->WriteLine(p_cursor.line);
+}
+
+bool MergeJob::IsOutputValid() const {
+  if (compressed_writer_) return compressed_writer_->IsValid();
+  return writer_->GetLastError() == FileWriter::Error::None;
+}
+
+bool MergeJob::FlushOutput() {
+  if (compressed_writer_) return compressed_writer_->Flush() == CompressedWriter::Error::None;
+  return writer_->Flush() == FileWriter::Error::None;
+}
+
+bool MergeJob::CloseOutput() {
+  if (compressed_writer_) return compressed_writer_->Close() == CompressedWriter::Error::None;
+  return writer_->Flush() == FileWriter::Error::None && SaveSidecars();
+}
+
+bool MergeJob::SaveSidecars() {
+  if (!time_index_ && !symbol_bitmaps_) return true;
+  // The output is flushed, its bytes on disk are the ones indexed
+  const auto output = OutputFingerprint::Of(output_, writer_->GetLength());
+  if (!output) {
+    std::cerr << "Failed to fingerprint output file: " << output_ << std::endl;
+    return false;
+  }
+  if (time_index_ && !time_index_->Finish(*output).Save(TimeIndex::GetPath(output_))) {
+    return false;
+  }
+  return !symbol_bitmaps_ ||
+         symbol_bitmaps_->Finish(*output).Save(SymbolBitmapIndex::GetPath(output_));
+}
+
+size_t MergeJob::EmitReady() {
+  // Inputs that have been quiet for the lateness bound stop holding back
+  // the others
+  if (idle_cursors_ != stale_cursors_) {
+    const auto deadline = std::chrono::steady_clock::now() - options_.lateness;
+    for (auto& cursor : cursors_) {
+      if (cursor.keep_open && !cursor.has_line && !cursor.stale &&
+          cursor.idle_since <= deadline) {
+        cursor.stale = true;
+        ++stale_cursors_;
+      }
+    }
+  }
+
+  // While an input has nothing pending its next record could still order
+  // before the heap top, wait for it up to the lateness bound
+  const int64_t watermark = max_seen_millis_ - options_.lateness.count();
+  size_t emitted = 0;
+  while (!heap_.empty() && !stop_flag_ && !checkpoint_failed_) {
+    if (idle_cursors_ != stale_cursors_ &&
+        cursors_[heap_.front()].millis > watermark) {
+      break;
+    }
+    emitted += Step(1);
+  }
+  return emitted;
+}
+
+void MergeJob::WaitForGrowth() {
+  std::vector<size_t> changed;
+  if (inotify_fd_ != -1) {
+    pollfd pfd{inotify_fd_, POLLIN, 0};
+    if (poll(&pfd, 1, static_cast<int>(options_.poll_interval.count())) <= 0) return;
+    alignas(inotify_event) char buffer[4096];
+    const ssize_t length = read(inotify_fd_, buffer, sizeof(buffer));
+    for (ssize_t pos = 0; pos < length;) {
+      const auto* event = reinterpret_cast<const inotify_event*>(buffer + pos);
+      const auto it = std::find(watches_.begin(), watches_.end(), event->wd);
+      if (it != watches_.end()) changed.push_back(it - watches_.begin());
+      pos += sizeof(inotify_event) + event->len;
+    }
+  } else {
+    // No watches available, fstat every idle input each interval
+    std::this_thread::sleep_for(options_.poll_interval);
+    for (size_t i = 0; i < cursors_.size(); ++i) changed.push_back(i);
+  }
+
+  for (const size_t index : changed) ReviveCursor(index);
+}
+
+void MergeJob::ReviveCursor(size_t p_index) {
+  auto& cursor = cursors_[p_index];
+  if (cursor.has_line || !cursor.mmf) return; // Refreshes itself at EOF
+  if (cursor.Advance()) {
+    --idle_cursors_;
+    if (cursor.stale) --stale_cursors_;
+    cursor.stale = false;
+    PushCursor(p_index);
+  }
+}
+
+bool MergeJob::Follow() {
+  if (!Open()) return false;
+
+  inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  watches_.assign(cursors_.size(), -1);
+  for (size_t i = 0; i < cursors_.size() && inotify_fd_ != -1; ++i) {
+    watches_[i] = inotify_add_watch(inotify_fd_, cursors_[i].filename.c_str(), IN_MODIFY);
+    if (watches_[i] == -1) {
+      std::cerr << "Failed to watch input file: " << cursors_[i].filename
+                << ", falling back to polling every "
+                << options_.poll_interval.count() << "ms" << std::endl;
+      close(inotify_fd_);
+      inotify_fd_ = -1;
+    }
+  }
+  // Catch up on anything appended before the watches existed
+  for (size_t i = 0; i < cursors_.size(); ++i) ReviveCursor(i);
+  std::cout << "Following: " << cursors_.size() << " inputs into: " << output_
+            << " with lateness: " << options_.lateness.count() << "ms" << std::endl;
+
+  bool ok = true;
+  while (!stop_flag_) {
+    const size_t emitted = EmitReady();
+    if (checkpoint_failed_ || (emitted != 0 && !FlushOutput())) {
+      ok = false;
+      break;
+    }
+    WaitForGrowth();
+  }
+
+  if (inotify_fd_ != -1) {
+    close(inotify_fd_);
+    inotify_fd_ = -1;
+  }
+  if (!ok) return false;
+  if (!options_.checkpoint_path.empty()) {
+    return Checkpoint();
+  }
+  return CloseOutput();
+}
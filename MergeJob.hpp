@@ -0,0 +1,196 @@
+#ifndef MergeJob_hpp
+#define MergeJob_hpp
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Checkpoint.hpp"
+#include "CompressedWriter.hpp"
+#include "FileWriter.hpp"
+#include "InputFilter.hpp"
+#include "Mmf.hpp"
+#include "SymbolBitmaps.hpp"
+#include "TimeIndex.hpp"
+
+namespace sp {
+  struct MergeJobOptions {
+    // Empty disables checkpointing. When the file exists the job resumes
+    // from it: the output is cut back to the checkpointed length and every
+    // input continues from its saved offset.
+    std::string checkpoint_path;
+    // Records between checkpoints, 0 only checkpoints at the end
+    size_t checkpoint_interval = 10'000'000;
+    // Per input MMF window, 0 derives it from the MemoryBudget read stage
+    size_t read_window = 0;
+    size_t output_buffer_size = FileWriter::kDefaultBufferSize;
+    // Read-ahead for the inputs consumed next: every prefetch_interval
+    // records the prefetch_inputs inputs with the earliest head records get
+    // prefetch_bytes requested ahead of their position (MMF::Prefetch)
+    // unless at least half of that is already requested. 0 disables it.
+    size_t prefetch_inputs = 4;
+    size_t prefetch_bytes = 4 * 1024 * 1024;
+    size_t prefetch_interval = 1024;
+    // Writes the output as independently compressed frames with a frame
+    // index sidecar (see CompressedWriter), compressed on output_threads
+    // workers. Cannot be combined with checkpoints.
+    std::optional<CompressedWriter::Format> output_compression;
+    unsigned int output_threads = 0;
+    // Writes a TimeIndex sidecar (<output>.tidx) along with the output, an
+    // entry every second of data and at least every time_index_records
+    // records, saved at every checkpoint and at the end. Plain output only.
+    bool time_index = false;
+    size_t time_index_records = TimeIndex::kDefaultRecordInterval;
+    // Writes a SymbolBitmapIndex sidecar (<output>.sbm): per block of about
+    // symbol_bitmap_block_bytes of output, the symbols it holds, so a reader
+    // filtering on symbols skips the blocks without them (see Replayer).
+    // Saved like the time index. Plain output only.
+    bool symbol_bitmaps = false;
+    size_t symbol_bitmap_block_bytes = SymbolBitmapIndex::kDefaultBlockBytes;
+    // Append mode for inputs that grow during the day. Run the job again
+    // with the same checkpoint_path to merge only what was appended since
+    // the last run. Unterminated last lines are left for the next run, and
+    // records ordering before the last emitted (timestamp, symbol) cannot be
+    // appended any more, they are dropped and counted.
+    bool incremental = false;
+    // Live tail: Run() keeps following the inputs as they grow (inotify,
+    // periodic fstat when watches run out) until Stop(). A record is emitted
+    // once every input has a pending record, once the inputs without one
+    // have been quiet for lateness, or once it is more than lateness older
+    // than the newest timestamp seen. Anything arriving behind the emitted
+    // stream after that is dropped and counted.
+    bool follow = false;
+    std::chrono::milliseconds lateness{1000};
+    std::chrono::milliseconds poll_interval{100};
+    // Inputs whose symbol is filtered out are not opened, fresh inputs are
+    // entered at the start time and rejected lines never reach the heap
+    InputFilter filter;
+  };
+
+  // K-way merge of per-symbol input files (each sorted by timestamp) into a
+  // single file ordered by (timestamp, symbol), with the symbol prepended as
+  // the first column.
+  class MergeJob {
+  public:
+    using Options = MergeJobOptions;
+
+    static constexpr std::string_view kOutputHeader =
+      "Symbol, Timestamp, Price, Size, Exchange, Type";
+
+    MergeJob(std::vector<std::string> p_inputs, std::string p_output,
+             Options p_options = {});
+    ~MergeJob();
+
+    MergeJob(const MergeJob&) = delete;
+    MergeJob& operator=(const MergeJob&) = delete;
+
+    // Opens every input and the output, resuming from the checkpoint if any
+    bool Open();
+    // Emits up to p_max_records, returns how many were written. Stops early,
+    // and for good, when a periodic checkpoint cannot be written.
+    size_t Step(size_t p_max_records);
+    bool IsDone() const { return heap_.empty(); }
+    // Syncs the output and atomically replaces the checkpoint file
+    bool Checkpoint();
+    // Open, merge everything, final checkpoint. False on any error, a failed
+    // periodic checkpoint included. In follow mode only returns after Stop()
+    // or such an error.
+    bool Run();
+    void Stop() { stop_flag_ = true; }
+
+    // Safe to poll from another thread while Run() is going
+    size_t GetRecordsWritten() const { return records_written_.load(std::memory_order_relaxed); }
+    const std::string& GetLastTimestamp() const { return last_timestamp_; }
+    const std::string& GetLastSymbol() const { return last_symbol_; }
+    bool IsResumed() const { return resumed_; }
+    bool HasCheckpointFailed() const { return checkpoint_failed_; }
+    size_t GetLateRecords() const { return late_records_.load(std::memory_order_relaxed); }
+    // Input bytes beyond the checkpointed offsets when the job was opened
+    size_t GetNewInputBytes() const { return new_input_bytes_; }
+    // Read-ahead requested by the prefetch scheduler
+    size_t GetPrefetchedBytes() const { return prefetched_bytes_; }
+
+  private:
+    struct Cursor {
+      std::string filename;
+      std::string symbol;
+      size_t symbol_bit = 0;      // Into the SymbolBitmapIndex symbols
+      std::unique_ptr<MMF> mmf;
+      std::string_view line;      // Head line, valid until the next Advance()
+      std::string_view timestamp; // Prefix of line
+      int64_t millis = 0;         // Of timestamp, follow mode only
+      size_t line_offset = 0;     // File position of the head line
+      size_t file_size = 0;
+      size_t end_offset = 0;      // Resume point once exhausted
+      bool has_line = false;
+      bool keep_open = false;     // Follow mode, EOF only means idle
+      bool stale = false;         // Idle for longer than the lateness bound
+      std::chrono::steady_clock::time_point idle_since;
+      const InputFilter* filter = nullptr;
+
+      // Moves to the next data line, false once the input is exhausted
+      // (idle in follow mode)
+      bool Advance();
+      // Where a resumed reader must start to re-read the head line
+      size_t GetResumeOffset() const;
+    };
+
+    // Min-heap order on (timestamp, symbol)
+    bool HeapGreater(size_t p_lhs, size_t p_rhs) const;
+    // True if the head record orders before the last emitted one
+    bool IsLate(const Cursor& p_cursor) const;
+    void PushCursor(size_t p_index);
+    // Back onto the heap after Advance(), or idle in follow mode
+    void RequeueCursor(size_t p_index);
+    bool OpenCursor(Cursor& p_cursor, size_t p_offset);
+    bool OpenCursors(const std::optional<MergeCheckpoint>& p_checkpoint);
+    void WriteRecord(const Cursor& p_cursor);
+    bool IsOutputValid() const;
+    bool FlushOutput();
+    bool CloseOutput();
+    // Time index and symbol bitmaps, whichever are enabled
+    bool SaveSidecars();
+    MergeCheckpoint MakeCheckpoint() const;
+    // Issues read-ahead for the inputs with the earliest heads
+    void SchedulePrefetch();
+    bool Follow();
+    // Follow mode: emits every head that is safe under the lateness bound
+    size_t EmitReady();
+    // Follow mode: blocks up to poll_interval, then revives idle inputs
+    void WaitForGrowth();
+    // Follow mode: back onto the heap if an idle input has a new line
+    void ReviveCursor(size_t p_index);
+
+    std::vector<std::string> inputs_;
+    std::string output_;
+    Options options_;
+    std::unique_ptr<FileWriter> writer_;
+    std::unique_ptr<CompressedWriter> compressed_writer_;
+    std::unique_ptr<TimeIndexWriter> time_index_;
+    std::unique_ptr<SymbolBitmapWriter> symbol_bitmaps_;
+    std::vector<Cursor> cursors_;
+    std::vector<size_t> heap_;
+    std::vector<size_t> prefetch_order_; // Reused by SchedulePrefetch
+    std::string last_timestamp_;
+    std::string last_symbol_;
+    std::atomic<size_t> records_written_{0};
+    std::atomic<size_t> late_records_{0};
+    size_t new_input_bytes_ = 0;
+    size_t prefetched_bytes_ = 0;
+    size_t idle_cursors_ = 0;
+    size_t stale_cursors_ = 0;
+    int64_t max_seen_millis_ = 0;
+    int inotify_fd_ = -1;
+    std::vector<int> watches_; // Watch descriptor per cursor
+    bool resumed_ = false;
+    bool checkpoint_failed_ = false;
+    std::atomic<bool> stop_flag_{false};
+  };
+}// namespace sp
+
+#endif // MergeJob_hpp
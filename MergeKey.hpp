@@ -0,0 +1,123 @@
+#ifndef MergeKey_hpp
+#define MergeKey_hpp
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <string_view>
+#include <vector>
+
+#include "MktDataRecord.hpp"
+
+namespace sp {
+  // Record orderings as compile time policies. Symbols enter the keys as
+  // their rank in the sorted symbol table of the job (see RankSymbols), so
+  // comparing two records is one integer compare:
+  //   Pack     64 bits, kTimeBits of timestamp and kRankBits of rank, for
+  //            timestamps and ranks that fit (FitsPacked)
+  //   PackWide 128 bits, the whole timestamp and rank, always exact
+  // and the merge, sort and index code is instantiated per ordering.
+  __extension__ typedef unsigned __int128 WideMergeKey;
+
+  constexpr unsigned kRankBits = 20;
+  constexpr unsigned kTimeBits = 64 - kRankBits;
+  constexpr uint32_t kMaxPackedRank = (uint32_t{1} << kRankBits) - 1;
+  constexpr int64_t kMaxPackedMillis = (int64_t{1} << kTimeBits) - 1; // Year 2527
+
+  namespace detail {
+    // Two's complement to offset binary, so that negative timestamps order
+    // first as unsigned
+    constexpr uint64_t BiasMillis(int64_t p_millis) {
+      return static_cast<uint64_t>(p_millis) ^ (uint64_t{1} << 63);
+    }
+  }
+
+  constexpr bool FitsPacked(int64_t p_millis, uint32_t p_rank) {
+    return p_millis >= 0 && p_millis <= kMaxPackedMillis && p_rank <= kMaxPackedRank;
+  }
+
+  // (timestamp, symbol), the output order of the merge
+  struct TimeSymbolOrder {
+    static constexpr uint64_t Pack(int64_t p_millis, uint32_t p_rank) {
+      return static_cast<uint64_t>(p_millis) << kRankBits | p_rank;
+    }
+    static constexpr WideMergeKey PackWide(int64_t p_millis, uint32_t p_rank) {
+      return WideMergeKey{detail::BiasMillis(p_millis)} << 64 | p_rank;
+    }
+  };
+
+  // (symbol, timestamp), every instrument in one piece for per-instrument
+  // replays
+  struct SymbolTimeOrder {
+    static constexpr uint64_t Pack(int64_t p_millis, uint32_t p_rank) {
+      return uint64_t{p_rank} << kTimeBits | static_cast<uint64_t>(p_millis);
+    }
+    static constexpr WideMergeKey PackWide(int64_t p_millis, uint32_t p_rank) {
+      return WideMergeKey{p_rank} << 64 | detail::BiasMillis(p_millis);
+    }
+  };
+
+  template<typename O>
+  concept MergeOrder = requires(int64_t p_millis, uint32_t p_rank) {
+    { O::Pack(p_millis, p_rank) } -> std::same_as<uint64_t>;
+    { O::PackWide(p_millis, p_rank) } -> std::same_as<WideMergeKey>;
+  };
+
+  // Rank of every symbol in p_symbols in sorted order, equal symbols share
+  // a rank
+  inline std::vector<uint32_t> RankSymbols(const std::vector<std::string_view>& p_symbols) {
+    std::vector<size_t> order(p_symbols.size());
+    std::iota(order.begin(), order.end(), size_t{0});
+    std::sort(order.begin(), order.end(),
+              [&p_symbols](size_t a, size_t b) { return p_symbols[a] < p_symbols[b]; });
+    std::vector<uint32_t> ranks(p_symbols.size());
+    uint32_t rank = 0;
+    for (size_t i = 0; i < order.size(); ++i) {
+      if (i != 0 && p_symbols[order[i]] != p_symbols[order[i - 1]]) ++rank;
+      ranks[order[i]] = rank;
+    }
+    return ranks;
+  }
+
+  // A record with the rank of its symbol, the unit SortRecords orders
+  struct RankedRecord {
+    MktDataRecord record;
+    uint32_t rank = 0;
+  };
+
+  // Stable sort of p_records in Order. Sorts on 64 bit keys when every
+  // record fits them, on 128 bit keys otherwise.
+  template<MergeOrder Order>
+  void SortRecords(std::vector<RankedRecord>& p_records) {
+    const bool packed = std::all_of(p_records.begin(), p_records.end(),
+      [](const RankedRecord& p_record) {
+        return FitsPacked(p_record.record.timestamp, p_record.rank);
+      });
+    const auto sort = [&p_records](auto p_pack) {
+      using Key = decltype(p_pack(p_records.front()));
+      std::vector<std::pair<Key, uint32_t>> keys(p_records.size());
+      for (size_t i = 0; i < p_records.size(); ++i) {
+        keys[i] = {p_pack(p_records[i]), static_cast<uint32_t>(i)};
+      }
+      // The index breaks ties, which makes it stable
+      std::sort(keys.begin(), keys.end());
+      std::vector<RankedRecord> sorted;
+      sorted.reserve(p_records.size());
+      for (const auto& key : keys) sorted.push_back(p_records[key.second]);
+      p_records.swap(sorted);
+    };
+    if (p_records.empty()) return;
+    if (packed) {
+      sort([](const RankedRecord& p_record) {
+        return Order::Pack(p_record.record.timestamp, p_record.rank);
+      });
+    } else {
+      sort([](const RankedRecord& p_record) {
+        return Order::PackWide(p_record.record.timestamp, p_record.rank);
+      });
+    }
+  }
+}// namespace sp
+
+#endif // MergeKey_hpp
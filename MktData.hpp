@@ -1,26 +1,158 @@
 #ifndef MktData_hpp
 #define MktData_hpp
-#include <sstream>
+#include <charconv>
+#include <cstdint>
+#include <filesystem>
 #include <string>
 #include <string_view>
 
 namespace sp {
   namespace MktData {
-    size_t GetHourFromTimestamp(const std::string_view& timestamp) {
+    inline size_t ParseUnsigned(std::string_view p_str) {
+      size_t value = 0;
+      std::from_chars(p_str.data(), p_str.data() + p_str.size(), value);
+      return value;
+    }
+
+    inline size_t GetHourFromTimestamp(const std::string_view& timestamp) {
       if (timestamp.size() < 19) return 0; // Invalid timestamp length
-      return std::stoul(timestamp.substr(11, 2));
+      return ParseUnsigned(timestamp.substr(11, 2));
+    }
+
+    // Input files are named after their symbol, e.g. /data/MSFT.txt -> MSFT
+    inline std::string GetSymbolFromFilename(const std::string& p_filename) {
+      return std::filesystem::path(p_filename).stem().string();
+    }
+
+    // First column of an input line, e.g. "2021-03-05 10:00:00.123". Fixed
+    // width timestamps order correctly under plain string comparison.
+    inline std::string_view GetTimestampField(std::string_view p_line) {
+      return p_line.substr(0, p_line.find(','));
+    }
+
+    // p_index'th comma separated column of p_line without surrounding
+    // blanks, e.g. 3 -> Exchange of an input line. Empty if there is none.
+    inline std::string_view GetField(std::string_view p_line, size_t p_index) {
+      for (; p_index != 0; --p_index) {
+        const auto comma = p_line.find(',');
+        if (comma == std::string_view::npos) return {};
+        p_line.remove_prefix(comma + 1);
+      }
+      p_line = p_line.substr(0, p_line.find(','));
+      const auto first = p_line.find_first_not_of(" \t");
+      if (first == std::string_view::npos) return {};
+      const auto last = p_line.find_last_not_of(" \t\r");
+      return p_line.substr(first, last - first + 1);
+    }
+
+    // False for empty lines and the "Timestamp, Price, ..." header
+    inline bool IsDataLine(std::string_view p_line) {
+      return !p_line.empty() && p_line.front() >= '0' && p_line.front() <= '9';
+    }
+
+    // Days since 1970-01-01 of a proleptic Gregorian date (Howard Hinnant's
+    // days_from_civil)
+    inline int64_t DaysFromCivil(int64_t p_year, unsigned p_month, unsigned p_day) {
+      p_year -= p_month <= 2;
+      const int64_t era = (p_year >= 0 ? p_year : p_year - 399) / 400;
+      const unsigned yoe = static_cast<unsigned>(p_year - era * 400);
+      const unsigned doy = (153 * (p_month + (p_month > 2 ? -3 : 9)) + 2) / 5 + p_day - 1;
+      const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+      return era * 146097 + static_cast<int64_t>(doe) - 719468;
+    }
+
+    // "2021-03-05 10:00:00.123" -> milliseconds since the epoch, -1 if the
+    // field is too short to be a timestamp
+    inline int64_t TimestampToMillis(std::string_view p_timestamp) {
+      if (p_timestamp.size() < 23) return -1;
+      const auto digits = [p_timestamp](size_t p_pos, size_t p_count) {
+        int64_t value = 0;
+        for (size_t i = p_pos; i < p_pos + p_count; ++i) {
+          value = value * 10 + (p_timestamp[i] - '0');
+        }
+        return value;
+      };
+      const int64_t days = DaysFromCivil(digits(0, 4),
+                                         static_cast<unsigned>(digits(5, 2)),
+                                         static_cast<unsigned>(digits(8, 2)));
+      return ((days * 24 + digits(11, 2)) * 60 + digits(14, 2)) * 60000 +
+             digits(17, 2) * 1000 + digits(20, 3);
+    }
+
+    // Inverse of DaysFromCivil (Howard Hinnant's civil_from_days)
+    inline void CivilFromDays(int64_t p_days, int64_t& p_year, unsigned& p_month,
+                              unsigned& p_day) {
+      p_days += 719468;
+      const int64_t era = (p_days >= 0 ? p_days : p_days - 146096) / 146097;
+      const unsigned doe = static_cast<unsigned>(p_days - era * 146097);
+      const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+      const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+      const unsigned mp = (5 * doy + 2) / 153;
+      p_day = doy - (153 * mp + 2) / 5 + 1;
+      p_month = mp < 10 ? mp + 3 : mp - 9;
+      p_year = static_cast<int64_t>(yoe) + era * 400 + (p_month <= 2);
+    }
+
+    constexpr size_t kTimestampLength = 23;
+
+    // Inverse of TimestampToMillis, writes kTimestampLength characters of
+    // "2021-03-05 10:00:00.123" to p_out. Years 0..9999.
+    inline void MillisToTimestamp(int64_t p_millis, char* p_out) {
+      int64_t days = p_millis / 86400000;
+      int64_t rest = p_millis % 86400000;
+      if (rest < 0) {
+        rest += 86400000;
+        --days;
+      }
+      int64_t year;
+      unsigned month, day;
+      CivilFromDays(days, year, month, day);
+      const auto put = [p_out](size_t p_pos, size_t p_count, uint64_t p_value) {
+        for (size_t i = p_pos + p_count; i > p_pos; --i) {
+          p_out[i - 1] = static_cast<char>('0' + p_value % 10);
+          p_value /= 10;
+        }
+      };
+      put(0, 4, static_cast<uint64_t>(year));
+      p_out[4] = '-';
+      put(5, 2, month);
+      p_out[7] = '-';
+      put(8, 2, day);
+      p_out[10] = ' ';
+      put(11, 2, static_cast<uint64_t>(rest / 3600000));
+      p_out[13] = ':';
+      put(14, 2, static_cast<uint64_t>(rest / 60000 % 60));
+      p_out[16] = ':';
+      put(17, 2, static_cast<uint64_t>(rest / 1000 % 60));
+      p_out[19] = '.';
+      put(20, 3, static_cast<uint64_t>(rest % 1000));
+    }
+
+    // True if p_timestamp is exactly "YYYY-MM-DD HH:MM:SS.mmm" naming a real
+    // calendar time, so MillisToTimestamp gives back the same text
+    inline bool IsTimestamp(std::string_view p_timestamp) {
+      constexpr std::string_view kLayout = "0000-00-00 00:00:00.000";
+      if (p_timestamp.size() != kTimestampLength) return false;
+      for (size_t i = 0; i < kTimestampLength; ++i) {
+        const bool digit = p_timestamp[i] >= '0' && p_timestamp[i] <= '9';
+        if (kLayout[i] == '0' ? !digit : p_timestamp[i] != kLayout[i]) return false;
+      }
+      const int64_t millis = TimestampToMillis(p_timestamp);
+      char text[kTimestampLength];
+      MillisToTimestamp(millis, text);
+      return p_timestamp == std::string_view(text, kTimestampLength);
     }
 
     //e.g. 2021-03-05 10:00:00.123
     struct MktDataTimeFormat {
       MktDataTimeFormat(const std::string_view& p_str)
-        : year(p_str.substr(0, 4)),
-          month(p_str.substr(5, 2)),
-          day(p_str.substr(8, 2)),
-          hour(p_str.substr(11, 2)),
-          minute(p_str.substr(14, 2)),
-          second(p_str.substr(17, 2)),
-          millisecond(p_str.substr(20, 3)) {}
+        : year(ParseUnsigned(p_str.substr(0, 4))),
+          month(ParseUnsigned(p_str.substr(5, 2))),
+          day(ParseUnsigned(p_str.substr(8, 2))),
+          hour(ParseUnsigned(p_str.substr(11, 2))),
+          minute(ParseUnsigned(p_str.substr(14, 2))),
+          second(ParseUnsigned(p_str.substr(17, 2))),
+          millisecond(ParseUnsigned(p_str.substr(20, 3))) {}
 
       size_t year;
       size_t month;
@@ -34,4 +166,4 @@ namespace sp {
   } // namespace sp
 } // namespace MktData
 
-#endif // MktData_hpp
\ No newline at end of file
+#endif // MktData_hpp
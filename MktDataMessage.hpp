@@ -17,4 +17,6 @@ namespace sp {
     std::string_view mkt_data_; // Market data
     size_t batch_id_; // Unique identifier for the batch
   };
-}
\ No newline at end of file
+}
+
+#endif // MKT_DATA_MESSAGE_HPP
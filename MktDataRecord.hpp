@@ -0,0 +1,20 @@
+#ifndef MktDataRecord_hpp
+#define MktDataRecord_hpp
+#include <cstdint>
+
+namespace sp {
+  // One parsed input line "Timestamp, Price, Size, Exchange, Type" in 32
+  // bytes. Exchange and Type are codes of GetExchangeDictionary() and
+  // GetTypeDictionary().
+  struct MktDataRecord {
+    int64_t timestamp = 0;      // Milliseconds since the epoch
+    int64_t price = 0;          // Fixed point, MktData::kPriceScale decimals
+    uint64_t size = 0;
+    uint16_t exchange = 0;
+    uint8_t type = 0;
+    uint8_t price_decimals = 0; // As written in the input, for FormatPrice
+  };
+  static_assert(sizeof(MktDataRecord) == 32);
+}// namespace sp
+
+#endif // MktDataRecord_hpp
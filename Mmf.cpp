@@ -1,5 +1,7 @@
 #include "Mmf.hpp"
+#include "HugePages.hpp"
 
+#include <algorithm>
 #include <cstring>
 #include <fcntl.h>
 #include <iostream>
@@ -13,7 +15,7 @@
 using namespace sp;
 void MMF::Cleanup() {
     if (mapped_ptr_ != MAP_FAILED && mapped_ptr_ != nullptr) {
-        munmap(mapped_ptr_, mapped_size_);
+        munmap(mapped_ptr_, map_length_);
         mapped_ptr_ = nullptr;
     }
     if (fd_ != -1) {
@@ -49,12 +51,18 @@ MMF::MMF(const std::string& filename, OpenMode mode)
     , mapped_ptr_(MAP_FAILED)
     , file_size_(0)
     , mapped_size_(0)
+    , map_length_(0)
+    , window_size_(0)
     , current_position_(0)
     , offset_(0)
     , filename_(filename)
     , is_valid_(false)
     , last_error_(Error::None)
-    , mode_(mode) {
+    , mode_(mode)
+    , huge_pages_(false)
+    , follow_(false)
+    , prefetched_until_(0)
+    , remap_count_(0) {
 
     fd_ = open(filename.c_str(), GetOpenFlags(), 0644);
     if (fd_ == -1) {
@@ -69,7 +77,7 @@ MMF::MMF(const std::string& filename, OpenMode mode)
         return;
     }
 
-    mapped_size_ = file_size_ = file_stat.st_size;
+    map_length_ = mapped_size_ = file_size_ = file_stat.st_size;
 
     if (mode_ != OpenMode::ReadOnly && file_size_ == 0) {
         if (ftruncate(fd_, mapped_size_) == -1) {
@@ -100,11 +108,18 @@ MMF::MMF(const std::string& filename, size_t offset, size_t size, OpenMode mode)
     , mapped_ptr_(MAP_FAILED)
     , file_size_(0)
     , mapped_size_(0)
+    , map_length_(0)
+    , window_size_(0)
     , current_position_(0)
+    , offset_(0)
     , filename_(filename)
     , is_valid_(false)
     , last_error_(Error::None)
-    , mode_(mode) {
+    , mode_(mode)
+    , huge_pages_(false)
+    , follow_(false)
+    , prefetched_until_(0)
+    , remap_count_(0) {
 
     fd_ = open(filename.c_str(), GetOpenFlags(), 0644);
     if (fd_ == -1) {
@@ -137,7 +152,8 @@ MMF::MMF(const std::string& filename, size_t offset, size_t size, OpenMode mode)
     size_t page_aligned_offset = (offset / page_size) * page_size;
     size_t max_available_from_offset = file_size_ - offset;
     size_t effective_size = std::min(size, max_available_from_offset);
-    mapped_size_ = (offset - page_aligned_offset) + effective_size;
+    map_length_ = mapped_size_ = (offset - page_aligned_offset) + effective_size;
+    window_size_ = size;
 
     if (mapped_size_ > 0) {
         std::cout << "Mapping file: " << filename_
@@ -173,16 +189,24 @@ MMF::MMF(MMF&& other) noexcept
     , mapped_ptr_(other.mapped_ptr_)
     , file_size_(other.file_size_)
     , mapped_size_(other.mapped_size_)
+    , map_length_(other.map_length_)
+    , window_size_(other.window_size_)
     , current_position_(other.current_position_)
+    , offset_(other.offset_)
     , filename_(std::move(other.filename_))
     , is_valid_(other.is_valid_)
     , last_error_(other.last_error_)
-    , mode_(other.mode_) {
+    , mode_(other.mode_)
+    , huge_pages_(other.huge_pages_)
+    , follow_(other.follow_)
+    , prefetched_until_(other.prefetched_until_)
+    , remap_count_(other.remap_count_) {
 
     other.fd_ = -1;
     other.mapped_ptr_ = MAP_FAILED;
     other.file_size_ = 0;
     other.mapped_size_ = 0;
+    other.map_length_ = 0;
     other.current_position_ = 0;
     other.is_valid_ = false;
     other.last_error_ = Error::None;
@@ -196,16 +220,24 @@ MMF& MMF::operator=(MMF&& other) noexcept {
         mapped_ptr_ = other.mapped_ptr_;
         file_size_ = other.file_size_;
         mapped_size_ = other.mapped_size_;
+        map_length_ = other.map_length_;
+        window_size_ = other.window_size_;
         current_position_ = other.current_position_;
+        offset_ = other.offset_;
         filename_ = std::move(other.filename_);
         is_valid_ = other.is_valid_;
         last_error_ = other.last_error_;
         mode_ = other.mode_;
+        huge_pages_ = other.huge_pages_;
+        follow_ = other.follow_;
+        prefetched_until_ = other.prefetched_until_;
+        remap_count_ = other.remap_count_;
 
         other.fd_ = -1;
         other.mapped_ptr_ = MAP_FAILED;
         other.file_size_ = 0;
         other.mapped_size_ = 0;
+        other.map_length_ = 0;
         other.current_position_ = 0;
         other.is_valid_ = false;
         other.last_error_ = Error::None;
@@ -272,10 +304,6 @@ std::pair<size_t, size_t> MMF::GetAlignedOffsetAndSize(size_t offset, size_t siz
   size_t page_aligned_offset = (offset / page_size) * page_size;
   size_t offset_delta = offset - page_aligned_offset;
   size_t mapped_size = offset_delta + size;
-  std::cout << "Page aligned offset: " << page_aligned_offset
-    << ", Original offset: " << offset
-    << ", Mapped size: " << mapped_size
-    << ", Size: " << size << std::endl;
   return {page_aligned_offset, mapped_size};
 }
 
@@ -291,36 +319,10 @@ std::optional<std::pair<size_t, size_t>> MMF::GetNextLineBounds(bool p_extend_ma
     if (p_extend_mapping && (file_size_ > offset_ + mapped_size_) ){
       size_t next_offset = offset_ + mapped_size_;
       size_t remaining = file_size_ - next_offset;
-      size_t map_size = std::min(mapped_size_, remaining);
-
-      // Unmap previous region
-      if (mapped_ptr_ != MAP_FAILED && mapped_ptr_ != nullptr) {
-        munmap(mapped_ptr_, mapped_size_);
-      }
-
-      const auto [new_offset, new_map_size] = GetAlignedOffsetAndSize(next_offset, map_size);
-      // Map next region
-
-      std::cout << "Creating new mapping for file:" << filename_ << ", current_position_:"
-        << current_position_ << ", new_map_size:" << mapped_size_ << ", total file size:"
-        << file_size_ << ", offset:" << new_offset << std::endl;
-
-      mapped_ptr_ = mmap(nullptr, new_map_size, GetProtFlags(), MAP_SHARED, fd_, new_offset);
-      if (mapped_ptr_ == MAP_FAILED) {
-        mapped_ptr_ = nullptr;
-        last_error_ = Error::MapFailed;
-        is_valid_ = false;
+      size_t map_size = std::min(GetWindowFrom(next_offset), remaining);
+      if (!RemapAt(next_offset, map_size)) {
         return std::nullopt;
       }
-      offset_ = new_offset;
-      mapped_size_ = new_map_size;
-      current_position_ = next_offset - new_offset; // Reset current position to the start of the new mapping
-
-      std::cout << "Created new mapping for file:" << filename_
-        << ", current_position_:" << current_position_
-        << ", new_map_size:" << mapped_size_
-        << ", total file size:" << file_size_
-        << ", offset:" << offset_ << std::endl;
       // file_size_ remains unchanged
     } else {
       last_error_ = Error::EndOfFile;
@@ -343,9 +345,66 @@ std::optional<std::pair<size_t, size_t>> MMF::GetNextLineBounds(bool p_extend_ma
     line_end++;
   }
 
+  // The line runs past the end of the window, map a window starting at the
+  // line instead of returning a truncated line
+  if (line_end == mapped_size_ && p_extend_mapping &&
+      file_size_ > offset_ + mapped_size_) {
+    const size_t line_offset = offset_ + line_start;
+    const size_t partial = mapped_size_ - line_start;
+    const size_t map_size = std::min(std::max(GetWindowFrom(line_offset), partial * 2),
+                                     file_size_ - line_offset);
+    if (!RemapAt(line_offset, map_size)) {
+      return std::nullopt;
+    }
+    return GetNextLineBounds(p_extend_mapping);
+  }
+
+  // Unterminated last line of a growing file, leave it for a later read
+  if (follow_ && line_end == mapped_size_ && offset_ + mapped_size_ >= file_size_) {
+    last_error_ = Error::EndOfFile;
+    return std::nullopt;
+  }
+
   return std::make_pair(line_start, line_end);
 }
 
+size_t MMF::GetWindowFrom(size_t p_file_offset) const {
+  return window_size_ != 0 ? window_size_ : file_size_ - p_file_offset;
+}
+
+bool MMF::RemapAt(size_t p_file_offset, size_t p_size) {
+  // Unmap previous region
+  if (mapped_ptr_ != MAP_FAILED && mapped_ptr_ != nullptr) {
+    munmap(mapped_ptr_, map_length_);
+  }
+
+  const auto [new_offset, new_map_size] = GetAlignedOffsetAndSize(p_file_offset, p_size);
+  // A followed file grows into the rest of the window, map all of it now.
+  // Pages past the end of the file are never read, mapped_size_ stops at it.
+  size_t length = new_map_size;
+  if (follow_ && window_size_ != 0) {
+    length = std::max(length, p_file_offset - new_offset + window_size_);
+  }
+
+  mapped_ptr_ = mmap(nullptr, length, GetProtFlags(), MAP_SHARED, fd_, new_offset);
+  if (mapped_ptr_ == MAP_FAILED) {
+    mapped_ptr_ = nullptr;
+    map_length_ = 0;
+    last_error_ = Error::MapFailed;
+    is_valid_ = false;
+    return false;
+  }
+  offset_ = new_offset;
+  mapped_size_ = new_map_size;
+  map_length_ = length;
+  ++remap_count_;
+  current_position_ = p_file_offset - new_offset; // Reset current position to the start of the new mapping
+  if (huge_pages_) {
+    AdviseHugePages(mapped_ptr_, mapped_size_);
+  }
+  return true;
+}
+
 
 MMF::Error MMF::WriteLine(const std::string& line) {
     if (!is_valid_ || mapped_ptr_ == MAP_FAILED) {
@@ -366,7 +425,7 @@ MMF::Error MMF::WriteLine(const std::string& line) {
         if (ftruncate(fd_, write_size + 1) == -1) {
             return Error::WriteError;
         }
-        mapped_size_ = write_size + 1;
+        map_length_ = mapped_size_ = write_size + 1;
         std::cout << "Creating new mapping for file: " << filename_
           << " with size: " << mapped_size_ << std::endl;
 
@@ -397,8 +456,8 @@ MMF::Error MMF::WriteLine(const std::string& line) {
             return Error::WriteError;
         }
 
-        munmap(mapped_ptr_, mapped_size_);
-        mapped_size_ = new_size;
+        munmap(mapped_ptr_, map_length_);
+        map_length_ = mapped_size_ = new_size;
         mapped_ptr_ = mmap(nullptr, mapped_size_, GetProtFlags(),
                          MAP_SHARED, fd_, 0);
 
@@ -420,6 +479,73 @@ MMF::Error MMF::WriteLine(const std::string& line) {
     return Error::None;
 }
 
+bool MMF::Refresh() {
+    if (!is_valid_ || fd_ == -1) {
+        return false;
+    }
+    struct stat file_stat;
+    if (fstat(fd_, &file_stat) == -1) {
+        last_error_ = Error::FileStatFailed;
+        return false;
+    }
+    const auto new_size = static_cast<size_t>(file_stat.st_size);
+    if (new_size <= file_size_) {
+        return false;
+    }
+    file_size_ = new_size;
+    if (mapped_ptr_ == nullptr || mapped_ptr_ == MAP_FAILED) {
+        // Was empty at construction, nothing mapped yet
+        mapped_size_ = 0;
+        return RemapAt(0, std::min(GetWindowFrom(0), file_size_));
+    }
+    // Appended bytes inside the mapped window are readable as they are
+    mapped_size_ = std::min(map_length_, file_size_ - offset_);
+    return true;
+}
+
+size_t MMF::Prefetch(size_t p_bytes) {
+    if (!is_valid_ || fd_ == -1) {
+        return 0;
+    }
+    const size_t position = offset_ + current_position_;
+    const size_t begin = std::max(position, prefetched_until_);
+    const size_t end = std::min(file_size_, position + p_bytes);
+    if (begin >= end) {
+        return 0;
+    }
+    const size_t mapped_end = offset_ + mapped_size_;
+    if (mapped_ptr_ != nullptr && mapped_ptr_ != MAP_FAILED && begin < mapped_end) {
+        // offset_ is page aligned, madvise wants a page aligned start
+        const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGE_SIZE));
+        const size_t from = (begin - offset_) / page_size * page_size;
+        const size_t to = std::min(end, mapped_end) - offset_;
+        madvise(static_cast<char*>(mapped_ptr_) + from, to - from, MADV_WILLNEED);
+    }
+    if (end > mapped_end) {
+        // Beyond the window: into the page cache, the next RemapAt finds it there
+        const size_t from = std::max(begin, mapped_end);
+        posix_fadvise(fd_, static_cast<off_t>(from), static_cast<off_t>(end - from),
+                      POSIX_FADV_WILLNEED);
+    }
+    prefetched_until_ = end;
+    return end - begin;
+}
+
+bool MMF::EnableHugePages() {
+    huge_pages_ = true;
+    if (!is_valid_ || mapped_ptr_ == nullptr || mapped_ptr_ == MAP_FAILED) {
+        return false;
+    }
+    return AdviseHugePages(mapped_ptr_, mapped_size_);
+}
+
+size_t MMF::GetHugePageBytes() const {
+    if (!is_valid_ || mapped_ptr_ == nullptr || mapped_ptr_ == MAP_FAILED) {
+        return 0;
+    }
+    return GetTransparentHugePageBytes(mapped_ptr_, mapped_size_);
+}
+
 MMF::Error MMF::Reset() {
     if (!is_valid_) {
         last_error_ = Error::NotMapped;
@@ -28,19 +28,27 @@ namespace sp {
     int fd_;
     void* mapped_ptr_;
     size_t file_size_;
-    size_t mapped_size_;
+    size_t mapped_size_;      // Bytes of file data in the window
+    size_t map_length_;       // Bytes mapped, past mapped_size_ in follow mode
+    size_t window_size_;      // Configured window, 0 maps the rest of the file
     size_t current_position_;
     size_t offset_;
     std::string filename_;
     mutable bool is_valid_;
     mutable Error last_error_;
     OpenMode mode_;
+    bool huge_pages_;
+    bool follow_;
+    size_t prefetched_until_; // File offset read-ahead was requested up to
+    size_t remap_count_;      // Windows mapped after construction
 
     void Cleanup();
     int GetOpenFlags() const;
     int GetProtFlags() const;
     std::optional<std::pair<size_t, size_t>> GetNextLineBounds(bool p_extend_mapping);
     std::pair<size_t, size_t> GetAlignedOffsetAndSize(size_t offset, size_t size) const;
+    bool RemapAt(size_t p_file_offset, size_t p_size);
+    size_t GetWindowFrom(size_t p_file_offset) const;
 
   public:
     explicit MMF(const std::string& filename, OpenMode mode = OpenMode::ReadOnly);
@@ -60,10 +68,43 @@ namespace sp {
     std::optional<size_t> GetMappedSize() const { return is_valid_ ? std::optional<size_t>(mapped_size_) : std::nullopt; }
     std::optional<size_t> GetFileSize() const { return is_valid_ ? std::optional<size_t>(file_size_) : std::nullopt; }
     std::optional<const void*> GetData() const { return (is_valid_ && mapped_ptr_ != nullptr) ? std::optional<const void*>(mapped_ptr_) : std::nullopt; }
-    std::optional<size_t> GetMappedOffset() const { return is_valid_ ? std::optional<size_t>(0) : std::nullopt; }
+    // File offset of the first mapped byte, file position = mapped offset + current position
+    std::optional<size_t> GetMappedOffset() const { return is_valid_ ? std::optional<size_t>(offset_) : std::nullopt; }
 
     std::optional<std::string> ReadLine(bool p_extend_mapping = false);
     std::optional<std::string_view> ReadLineView(bool p_extend_mapping = false);
+    // Follow mode is for files that are still being appended to: a last line
+    // without its newline is not returned (EndOfFile, position unchanged)
+    // until the writer completes it. Refresh() picks up appended bytes.
+    // Windows are then mapped at their full configured size even past the
+    // end of the file, so appends that land inside the window are read
+    // without remapping. The file must only grow while it is followed.
+    void SetFollowMode(bool p_follow) { follow_ = p_follow; }
+    // Size of the windows mapped once the current one is read, 0 maps the
+    // rest of the file. Set by the windowed constructor.
+    void SetWindowSize(size_t p_size) { window_size_ = p_size; }
+    bool IsFollowMode() const { return follow_; }
+    // Re-reads the file size so that ReadLine(true)/ReadLineView(true) continue
+    // into data appended since construction. True if the file grew.
+    bool Refresh();
+
+    // Asynchronous read-ahead of the next p_bytes from the current
+    // position: MADV_WILLNEED inside the window, POSIX_FADV_WILLNEED beyond
+    // it so the next window is already in the page cache when it is mapped.
+    // Only the part not requested before is issued, returns its size.
+    size_t Prefetch(size_t p_bytes);
+    // File offset up to which read-ahead has been requested
+    size_t GetPrefetchedUntil() const { return prefetched_until_; }
+    // Windows mapped since construction, one mmap/munmap pair each
+    size_t GetRemapCount() const { return remap_count_; }
+
+    // Advises the current and every later window with MADV_HUGEPAGE. Whether
+    // file backed THP is honoured depends on the kernel and filesystem, the
+    // mapping keeps working with regular pages when it is not.
+    bool EnableHugePages();
+    // Bytes of the current window actually backed by huge pages
+    size_t GetHugePageBytes() const;
+
     Error WriteLine(const std::string& line);
     Error Reset();
     Error SetPosition(size_t position);
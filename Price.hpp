@@ -0,0 +1,172 @@
+#ifndef Price_hpp
+#define Price_hpp
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace sp {
+  namespace MktData {
+    // Prices are int64 fixed point, value * 10^-scale. 6 digits covers every
+    // venue tick size and still leaves +-9.2e12 of range.
+    constexpr unsigned kPriceScale = 6;
+    constexpr unsigned kMaxPriceScale = 18;
+    // Sign, 19 digits, point
+    constexpr size_t kMaxPriceLength = 21;
+
+    namespace detail {
+      constexpr uint64_t kPow10[] = {
+        1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull,
+        100000000ull, 1000000000ull, 10000000000ull, 100000000000ull, 1000000000000ull,
+        10000000000000ull, 100000000000000ull, 1000000000000000ull, 10000000000000000ull,
+        100000000000000000ull, 1000000000000000000ull};
+
+      // Length of the leading run of ASCII digits
+      inline size_t CountDigits(const char* p_data, size_t p_size) {
+        size_t count = 0;
+        while (count < p_size && static_cast<unsigned char>(p_data[count] - '0') < 10) ++count;
+        return count;
+      }
+
+      // Value of exactly p_count (1..8) ASCII digits, eight at once: the
+      // digits are right aligned in a word padded with '0' and combined
+      // pairwise (x10), then in pairs of pairs (x100), then (x10000). The
+      // lanes assume the first byte is the lowest, big endian targets take
+      // the scalar loop.
+      inline uint64_t ParseDigitsSwar(const char* p_data, size_t p_count) {
+        if constexpr (std::endian::native != std::endian::little) {
+          uint64_t value = 0;
+          for (size_t i = 0; i < p_count; ++i) {
+            value = value * 10 + static_cast<uint64_t>(p_data[i] - '0');
+          }
+          return value;
+        }
+        uint64_t word = 0x3030303030303030ull;
+        std::memcpy(reinterpret_cast<char*>(&word) + (8 - p_count), p_data, p_count);
+        word -= 0x3030303030303030ull;
+        word = (word * 10) + (word >> 8);
+        word = (((word & 0x000000ff000000ffull) * (100 + (1000000ull << 32))) +
+                (((word >> 16) & 0x000000ff000000ffull) * (1 + (10000ull << 32)))) >> 32;
+        return word;
+      }
+
+      // p_value * 10^p_count + digits, false on overflow past INT64_MAX
+      inline bool AppendDigits(uint64_t& p_value, const char* p_data, size_t p_count) {
+        constexpr uint64_t kLimit = static_cast<uint64_t>(std::numeric_limits<int64_t>::max());
+        while (p_count > 0) {
+          const size_t chunk = p_count < 8 ? p_count : 8;
+          const uint64_t digits = ParseDigitsSwar(p_data, chunk);
+          uint64_t shifted;
+          if (__builtin_mul_overflow(p_value, kPow10[chunk], &shifted) ||
+              __builtin_add_overflow(shifted, digits, &p_value) || p_value > kLimit) {
+            return false;
+          }
+          p_data += chunk;
+          p_count -= chunk;
+        }
+        return true;
+      }
+    }
+
+    // "228.5" -> 228500000 at scale 6. Accepts an optional '-', digits and an
+    // optional '.' followed by at most p_scale digits. nullopt on malformed
+    // input, overflow, or text FormatPrice could not give back: leading
+    // zeros ("007.5"), decimals past the scale ("228.50000000") and negative
+    // zero. p_decimals receives the number of decimals written so that
+    // FormatPrice can reproduce the input text exactly.
+    inline std::optional<int64_t> ParsePrice(std::string_view p_text,
+                                             unsigned p_scale = kPriceScale,
+                                             unsigned* p_decimals = nullptr) {
+      if (p_scale > kMaxPriceScale) return std::nullopt;
+      const bool negative = !p_text.empty() && p_text.front() == '-';
+      if (negative) p_text.remove_prefix(1);
+
+      const size_t integer_digits = detail::CountDigits(p_text.data(), p_text.size());
+      if (integer_digits == 0) return std::nullopt;
+      if (integer_digits > 1 && p_text.front() == '0') return std::nullopt;
+      size_t decimals = 0;
+      if (integer_digits < p_text.size()) {
+        if (p_text[integer_digits] != '.') return std::nullopt;
+        decimals = detail::CountDigits(p_text.data() + integer_digits + 1,
+                                       p_text.size() - integer_digits - 1);
+        if (decimals == 0 || integer_digits + 1 + decimals != p_text.size()) return std::nullopt;
+      }
+      if (decimals > p_scale) return std::nullopt;
+      const char* fraction = p_text.data() + integer_digits + 1;
+
+      uint64_t value = 0;
+      if (!detail::AppendDigits(value, p_text.data(), integer_digits) ||
+          !detail::AppendDigits(value, fraction, decimals)) {
+        return std::nullopt;
+      }
+      uint64_t scaled;
+      if (__builtin_mul_overflow(value, detail::kPow10[p_scale - decimals], &scaled) ||
+          scaled > static_cast<uint64_t>(std::numeric_limits<int64_t>::max())) {
+        return std::nullopt;
+      }
+      if (negative && scaled == 0) return std::nullopt;
+      if (p_decimals) *p_decimals = static_cast<unsigned>(decimals);
+      const auto result = static_cast<int64_t>(scaled);
+      return negative ? -result : result;
+    }
+
+    // Writes p_value as decimal text to p_out (kMaxPriceLength bytes at
+    // least) and returns the length. p_decimals < 0 gives the shortest exact
+    // text, "228.5"; otherwise exactly that many decimals, "228.50" for 2,
+    // never dropping non-zero digits.
+    inline size_t FormatPrice(int64_t p_value, char* p_out, unsigned p_scale = kPriceScale,
+                              int p_decimals = -1) {
+      if (p_scale > kMaxPriceScale) p_scale = kMaxPriceScale;
+      char* out = p_out;
+      uint64_t magnitude = static_cast<uint64_t>(p_value);
+      if (p_value < 0) {
+        *out++ = '-';
+        magnitude = ~magnitude + 1;
+      }
+      const uint64_t integer = magnitude / detail::kPow10[p_scale];
+      uint64_t fraction = magnitude % detail::kPow10[p_scale];
+
+      char digits[20];
+      size_t count = 0;
+      uint64_t rest = integer;
+      do {
+        digits[count++] = static_cast<char>('0' + rest % 10);
+        rest /= 10;
+      } while (rest != 0);
+      while (count > 0) *out++ = digits[--count];
+
+      // Decimals needed to keep every non-zero digit
+      unsigned decimals = p_scale;
+      while (decimals > 0 && fraction % 10 == 0) {
+        fraction /= 10;
+        --decimals;
+      }
+      unsigned shown = decimals;
+      if (p_decimals >= 0 && static_cast<unsigned>(p_decimals) > decimals) {
+        shown = static_cast<unsigned>(p_decimals) < p_scale ? static_cast<unsigned>(p_decimals) : p_scale;
+      }
+      if (shown > 0) {
+        *out++ = '.';
+        // fraction holds `decimals` digits, pad with zeros up to `shown`
+        for (unsigned i = decimals; i > 0; --i) {
+          out[i - 1] = static_cast<char>('0' + fraction % 10);
+          fraction /= 10;
+        }
+        out += decimals;
+        for (unsigned i = decimals; i < shown; ++i) *out++ = '0';
+      }
+      return static_cast<size_t>(out - p_out);
+    }
+
+    inline std::string FormatPrice(int64_t p_value, unsigned p_scale = kPriceScale,
+                                   int p_decimals = -1) {
+      char buffer[kMaxPriceLength];
+      return std::string(buffer, FormatPrice(p_value, buffer, p_scale, p_decimals));
+    }
+  } // namespace MktData
+} // namespace sp
+
+#endif // Price_hpp
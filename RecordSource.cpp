@@ -0,0 +1,284 @@
+#include "RecordSource.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "Dictionary.hpp"
+#include "MergeJob.hpp"
+#include "MktData.hpp"
+
+using namespace sp;
+
+CsvRecordSource::CsvRecordSource(const std::string& p_filename, size_t p_batch_bytes)
+  : symbol_(MktData::GetSymbolFromFilename(p_filename)),
+    mmf_(p_filename),
+    batch_bytes_(std::max<size_t>(p_batch_bytes, 4096)) {
+  if (!mmf_.IsValid()) {
+    std::cerr << "Failed to open file: " << p_filename << " with error: "
+              << static_cast<int>(mmf_.GetLastError()) << std::endl;
+    return;
+  }
+  // An empty file is valid and has nothing mapped
+  if (const auto data = mmf_.GetData()) {
+    data_ = std::string_view(static_cast<const char*>(*data), mmf_.GetMappedSize().value_or(0));
+  }
+}
+
+bool CsvRecordSource::Refill() {
+  records_.clear();
+  next_ = 0;
+  while (records_.empty() && pos_ < data_.size()) {
+    auto block = data_.substr(pos_, batch_bytes_);
+    if (pos_ + block.size() < data_.size()) {
+      // Whole lines only
+      const auto newline = block.rfind('\n');
+      if (newline != std::string_view::npos) {
+        block = block.substr(0, newline + 1);
+      } else {
+        const auto end = data_.find('\n', pos_ + block.size());
+        block = data_.substr(pos_, end == std::string_view::npos ? end : end + 1 - pos_);
+      }
+    }
+    pos_ += block.size();
+    const size_t consumed = parser_.Parse(block, records_);
+    if (consumed < block.size()) {
+      tail_.assign(block.substr(consumed));
+      tail_ += '\n';
+      parser_.Parse(tail_, records_);
+    }
+  }
+  return !records_.empty();
+}
+
+CompressedRecordSource::CompressedRecordSource(const std::string& p_filename,
+                                               unsigned int p_threads, size_t p_batch_bytes)
+  : symbol_(GetRecordSourceSymbol(p_filename)),
+    file_(std::make_unique<CompressedFile>(p_filename, p_threads)),
+    batch_bytes_(std::max<size_t>(p_batch_bytes, 4096)) {
+  if (!file_->IsValid()) {
+    std::cerr << "Failed to open compressed file: " << p_filename << " with error: "
+              << static_cast<int>(file_->GetLastError()) << std::endl;
+  }
+}
+
+bool CompressedRecordSource::Refill() {
+  records_.clear();
+  next_ = 0;
+  while (records_.empty()) {
+    batch_.clear();
+    while (batch_.size() < batch_bytes_) {
+      const auto line = file_->ReadLineView();
+      if (!line) break;
+      batch_.append(*line);
+      batch_ += '\n';
+    }
+    if (batch_.empty()) return false;
+    parser_.Parse(batch_, records_);
+  }
+  return true;
+}
+
+namespace {
+  // Run header part of one dictionary, see BinaryRecordSource. False for a
+  // name too long for its uint16 length.
+  bool AppendDictionary(std::string& p_out, const CodeDictionary& p_dictionary, size_t p_size) {
+    const auto put = [&p_out](uint16_t p_value) {
+      p_out.append(reinterpret_cast<const char*>(&p_value), sizeof(p_value));
+    };
+    put(static_cast<uint16_t>(p_dictionary.GetKnownSize()));
+    put(static_cast<uint16_t>(p_size - p_dictionary.GetKnownSize()));
+    for (size_t code = p_dictionary.GetKnownSize(); code < p_size; ++code) {
+      const auto name = p_dictionary.Decode(static_cast<CodeDictionary::Code>(code));
+      if (name.size() > UINT16_MAX) return false;
+      put(static_cast<uint16_t>(name.size()));
+      p_out.append(name);
+    }
+    return true;
+  }
+
+  // Reads the header part written by AppendDictionary and returns the code
+  // in this process of every code of the writer, nullopt if the header is
+  // cut or a name cannot be encoded here
+  std::optional<std::vector<CodeDictionary::Code>> ReadDictionary(std::string_view& p_header,
+                                                                  CodeDictionary& p_dictionary) {
+    const auto get = [&p_header](uint16_t& p_value) {
+      if (p_header.size() < sizeof(p_value)) return false;
+      std::memcpy(&p_value, p_header.data(), sizeof(p_value));
+      p_header.remove_prefix(sizeof(p_value));
+      return true;
+    };
+    uint16_t known = 0;
+    uint16_t count = 0;
+    if (!get(known) || !get(count) || known > p_dictionary.GetKnownSize()) return std::nullopt;
+    std::vector<CodeDictionary::Code> codes(known + size_t{count});
+    for (size_t code = 0; code < known; ++code) codes[code] = static_cast<CodeDictionary::Code>(code);
+    for (size_t i = 0; i < count; ++i) {
+      uint16_t length = 0;
+      if (!get(length) || p_header.size() < length) return std::nullopt;
+      const auto code = p_dictionary.Encode(p_header.substr(0, length));
+      if (code == CodeDictionary::kInvalidCode) return std::nullopt;
+      codes[known + i] = code;
+      p_header.remove_prefix(length);
+    }
+    return codes;
+  }
+
+  bool IsIdentity(const std::vector<CodeDictionary::Code>& p_codes) {
+    for (size_t code = 0; code < p_codes.size(); ++code) {
+      if (p_codes[code] != code) return false;
+    }
+    return true;
+  }
+}
+
+BinaryRecordSource::BinaryRecordSource(const std::string& p_filename)
+  : symbol_(MktData::GetSymbolFromFilename(p_filename)),
+    mmf_(p_filename) {
+  if (!mmf_.IsValid()) {
+    std::cerr << "Failed to open file: " << p_filename << " with error: "
+              << static_cast<int>(mmf_.GetLastError()) << std::endl;
+    return;
+  }
+  const auto data = mmf_.GetData();
+  const size_t size = mmf_.GetMappedSize().value_or(0);
+  const auto not_a_run = [&p_filename] {
+    std::cerr << "Not a binary record run: " << p_filename << std::endl;
+  };
+  if (!data || size < kRecordRunMagic.size() ||
+      std::memcmp(*data, kRecordRunMagic.data(), kRecordRunMagic.size()) != 0) {
+    not_a_run();
+    return;
+  }
+  const std::string_view file(static_cast<const char*>(*data), size);
+  std::string_view header = file.substr(kRecordRunMagic.size());
+  const auto exchanges = ReadDictionary(header, GetExchangeDictionary());
+  const auto types = exchanges ? ReadDictionary(header, GetTypeDictionary()) : std::nullopt;
+  if (!types) {
+    not_a_run();
+    return;
+  }
+  // The mapping is page aligned and the padding keeps the records 8 aligned
+  const size_t offset = (size - header.size() + alignof(MktDataRecord) - 1) &
+                        ~(alignof(MktDataRecord) - 1);
+  if (offset > size || (size - offset) % sizeof(MktDataRecord) != 0) {
+    not_a_run();
+    return;
+  }
+  records_ = std::span<const MktDataRecord>(
+    reinterpret_cast<const MktDataRecord*>(file.data() + offset),
+    (size - offset) / sizeof(MktDataRecord));
+
+  if (!IsIdentity(*exchanges) || !IsIdentity(*types)) {
+    // Another process handed out the dynamic codes in another order
+    remapped_.assign(records_.begin(), records_.end());
+    for (auto& record : remapped_) {
+      if (record.exchange >= exchanges->size() || record.type >= types->size()) {
+        not_a_run();
+        return;
+      }
+      record.exchange = (*exchanges)[record.exchange];
+      record.type = static_cast<uint8_t>((*types)[record.type]);
+    }
+    records_ = remapped_;
+  }
+  valid_run_ = true;
+}
+
+bool BinaryRecordSource::IsRecordRun(const std::string& p_filename) {
+  std::ifstream file(p_filename, std::ios::binary);
+  char magic[kRecordRunMagic.size()];
+  return file.read(magic, sizeof(magic)) &&
+         std::string_view(magic, sizeof(magic)) == kRecordRunMagic;
+}
+
+bool sp::WriteRecordRun(const std::string& p_filename, std::span<const MktDataRecord> p_records) {
+  // Sizes first, a code handed out later is not in the header
+  const auto& exchanges = GetExchangeDictionary();
+  const auto& types = GetTypeDictionary();
+  const size_t exchange_count = exchanges.GetSize();
+  const size_t type_count = types.GetSize();
+  for (const auto& record : p_records) {
+    if (record.exchange >= exchange_count || record.type >= type_count) {
+      std::cerr << "Record with unknown exchange or type code, not writing: " << p_filename
+                << std::endl;
+      return false;
+    }
+  }
+  std::string header(BinaryRecordSource::kRecordRunMagic);
+  if (!AppendDictionary(header, exchanges, exchange_count) ||
+      !AppendDictionary(header, types, type_count)) {
+    std::cerr << "Exchange or type name too long for a binary run: " << p_filename << std::endl;
+    return false;
+  }
+  header.resize((header.size() + alignof(MktDataRecord) - 1) & ~(alignof(MktDataRecord) - 1), '\0');
+
+  FileWriter writer(p_filename);
+  if (!writer.IsValid()) {
+    std::cerr << "Failed to open file: " << p_filename << " for writing" << std::endl;
+    return false;
+  }
+
+  const auto bytes = std::as_bytes(p_records);
+  return writer.Write(header) == FileWriter::Error::None &&
+         writer.Write(std::string_view(reinterpret_cast<const char*>(bytes.data()),
+                                       bytes.size())) == FileWriter::Error::None &&
+         writer.Flush() == FileWriter::Error::None;
+}
+
+AnyRecordSource sp::OpenRecordSource(const std::string& p_filename, size_t p_batch_bytes,
+                                     unsigned int p_threads) {
+  if (BinaryRecordSource::IsRecordRun(p_filename)) return BinaryRecordSource(p_filename);
+  if (CompressedFile::DetectFormat(p_filename) != CompressedFile::Format::Unknown) {
+    return CompressedRecordSource(p_filename, p_threads, p_batch_bytes);
+  }
+  return CsvRecordSource(p_filename, p_batch_bytes);
+}
+
+std::optional<size_t> sp::MergeRecordSourcesToFile(
+    std::vector<AnyRecordSource>& p_sources, const std::string& p_output,
+    const InputFilter* p_filter, size_t p_buffer_size) {
+  for (const auto& source : p_sources) {
+    if (!source.IsValid()) {
+      std::cerr << "Invalid record source for symbol: " << source.GetSymbol() << std::endl;
+      return std::nullopt;
+    }
+  }
+  FileWriter writer(p_output, FileWriter::OpenMode::Truncate, p_buffer_size);
+  if (!writer.IsValid() || writer.WriteLine(MergeJob::kOutputHeader) != FileWriter::Error::None) {
+    std::cerr << "Failed to open output file: " << p_output << std::endl;
+    return std::nullopt;
+  }
+
+  const auto& exchanges = GetExchangeDictionary();
+  const auto& types = GetTypeDictionary();
+  std::string line;
+  bool failed = false;
+  const size_t written = MergeRecordSources(p_sources,
+    [&](std::string_view p_symbol, const MktDataRecord& p_record) {
+      line.resize(kFormattedRecordOverhead + p_symbol.size() +
+                  exchanges.Decode(p_record.exchange).size() +
+                  types.Decode(p_record.type).size());
+      const size_t length = FormatRecord(p_symbol, p_record, line.data());
+      failed |= writer.Write(std::string_view(line.data(), length)) != FileWriter::Error::None;
+    }, p_filter);
+  if (failed || writer.Flush() != FileWriter::Error::None) {
+    std::cerr << "Failed to write output file: " << p_output << std::endl;
+    return std::nullopt;
+  }
+  ReportDroppedDataLines(p_sources);
+  return written;
+}
+
+size_t sp::ReportDroppedDataLines(const std::vector<AnyRecordSource>& p_sources) {
+  size_t total = 0;
+  for (const auto& source : p_sources) {
+    const size_t dropped = source.GetDroppedDataLines();
+    if (dropped == 0) continue;
+    std::cerr << "Dropped: " << dropped << " data lines of symbol: " << source.GetSymbol()
+              << " that do not parse as records" << std::endl;
+    total += dropped;
+  }
+  return total;
+}
@@ -0,0 +1,316 @@
+#ifndef RecordSource_hpp
+#define RecordSource_hpp
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+#include "CompressedFile.hpp"
+#include "CsvParser.hpp"
+#include "FileWriter.hpp"
+#include "InputFilter.hpp"
+#include "MergeKey.hpp"
+#include "MktDataRecord.hpp"
+#include "Mmf.hpp"
+
+namespace sp {
+  // A per-symbol stream of MktDataRecords in timestamp order. Next()
+  // returns the next record, valid until the following call, or nullptr
+  // once the source is exhausted or failed. Merges are instantiated per
+  // source type so reading a record is an inlined call; AnyRecordSource
+  // covers inputs of mixed formats.
+  template<typename S>
+  concept RecordSource = requires(S& p_source, const S& p_const) {
+    { p_source.Next() } -> std::same_as<const MktDataRecord*>;
+    { p_const.GetSymbol() } -> std::convertible_to<std::string_view>;
+    { p_const.IsValid() } -> std::same_as<bool>;
+  };
+
+  // Input lines are parsed this many bytes at a time
+  constexpr size_t kDefaultRecordBatchBytes = 256 * 1024;
+
+  // Mapped CSV input, parsed in batches straight out of the mapping
+  class CsvRecordSource {
+  public:
+    explicit CsvRecordSource(const std::string& p_filename,
+                             size_t p_batch_bytes = kDefaultRecordBatchBytes);
+
+    bool IsValid() const { return mmf_.IsValid(); }
+    const std::string& GetSymbol() const { return symbol_; }
+    size_t GetRejectedLines() const { return parser_.GetRejectedLines(); }
+    size_t GetDroppedDataLines() const { return parser_.GetDroppedDataLines(); }
+
+    const MktDataRecord* Next() {
+      if (next_ == records_.size() && !Refill()) return nullptr;
+      return &records_[next_++];
+    }
+
+  private:
+    bool Refill();
+
+    std::string symbol_;
+    MMF mmf_;
+    std::string_view data_;
+    size_t pos_ = 0;
+    size_t batch_bytes_;
+    CsvBatchParser parser_;
+    std::vector<MktDataRecord> records_;
+    size_t next_ = 0;
+    std::string tail_; // Unterminated last line
+  };
+
+  // CSV input compressed as gzip or zstd, see CompressedFile
+  class CompressedRecordSource {
+  public:
+    explicit CompressedRecordSource(const std::string& p_filename, unsigned int p_threads = 1,
+                                    size_t p_batch_bytes = kDefaultRecordBatchBytes);
+
+    bool IsValid() const { return file_->IsValid(); }
+    const std::string& GetSymbol() const { return symbol_; }
+    size_t GetRejectedLines() const { return parser_.GetRejectedLines(); }
+    size_t GetDroppedDataLines() const { return parser_.GetDroppedDataLines(); }
+
+    const MktDataRecord* Next() {
+      if (next_ == records_.size() && !Refill()) return nullptr;
+      return &records_[next_++];
+    }
+
+  private:
+    bool Refill();
+
+    std::string symbol_;
+    std::unique_ptr<CompressedFile> file_;
+    size_t batch_bytes_;
+    CsvBatchParser parser_;
+    std::string batch_; // Lines gathered for the parser
+    std::vector<MktDataRecord> records_;
+    size_t next_ = 0;
+  };
+
+  // Binary run: kRecordRunMagic, the dynamic names of the Exchange and Type
+  // dictionaries of the writing process, zero padding to 8 bytes, then
+  // MktDataRecords in host byte order. Each dictionary is stored as uint16
+  // known size, uint16 name count and the names as uint16 length + bytes.
+  // Records are read in place from the mapping when every stored name has
+  // the same code in this process, otherwise they are copied with their
+  // codes remapped.
+  class BinaryRecordSource {
+  public:
+    static constexpr std::string_view kRecordRunMagic{"SPRECRN2", 8};
+
+    explicit BinaryRecordSource(const std::string& p_filename);
+
+    // False as well for a file that is not a binary run
+    bool IsValid() const { return mmf_.IsValid() && valid_run_; }
+    const std::string& GetSymbol() const { return symbol_; }
+    size_t GetRecordCount() const { return records_.size(); }
+
+    const MktDataRecord* Next() {
+      return next_ < records_.size() ? &records_[next_++] : nullptr;
+    }
+
+    static bool IsRecordRun(const std::string& p_filename);
+
+  private:
+    std::string symbol_;
+    MMF mmf_;
+    std::span<const MktDataRecord> records_;
+    std::vector<MktDataRecord> remapped_; // Backs records_ when codes differ
+    size_t next_ = 0;
+    bool valid_run_ = false;
+  };
+
+  // Writes p_records as a binary run, see BinaryRecordSource. False as well
+  // for a record whose Exchange or Type code was never handed out.
+  bool WriteRecordRun(const std::string& p_filename, std::span<const MktDataRecord> p_records);
+
+  // Records held in memory, e.g. test vectors
+  class VectorRecordSource {
+  public:
+    VectorRecordSource(std::string p_symbol, std::vector<MktDataRecord> p_records)
+      : symbol_(std::move(p_symbol)), records_(std::move(p_records)) {}
+
+    bool IsValid() const { return true; }
+    const std::string& GetSymbol() const { return symbol_; }
+
+    const MktDataRecord* Next() {
+      return next_ < records_.size() ? &records_[next_++] : nullptr;
+    }
+
+  private:
+    std::string symbol_;
+    std::vector<MktDataRecord> records_;
+    size_t next_ = 0;
+  };
+
+  // Any of the sources above. Next() dispatches with a switch on the held
+  // alternative, not through a vtable.
+  class AnyRecordSource {
+  public:
+    using Variant = std::variant<CsvRecordSource, CompressedRecordSource,
+                                 BinaryRecordSource, VectorRecordSource>;
+
+    template<RecordSource S>
+      requires std::constructible_from<Variant, S&&>
+    AnyRecordSource(S&& p_source) : source_(std::forward<S>(p_source)) {}
+
+    bool IsValid() const {
+      return std::visit([](const auto& p_source) { return p_source.IsValid(); }, source_);
+    }
+    std::string_view GetSymbol() const {
+      return std::visit([](const auto& p_source) -> std::string_view {
+        return p_source.GetSymbol();
+      }, source_);
+    }
+    const MktDataRecord* Next() {
+      return std::visit([](auto& p_source) { return p_source.Next(); }, source_);
+    }
+    // Data lines a CSV source could not turn into records, see
+    // CsvBatchParser::GetDroppedDataLines. 0 for the other sources.
+    size_t GetDroppedDataLines() const {
+      return std::visit([](const auto& p_source) -> size_t {
+        if constexpr (requires { p_source.GetDroppedDataLines(); }) {
+          return p_source.GetDroppedDataLines();
+        } else {
+          return 0;
+        }
+      }, source_);
+    }
+
+    template<typename S>
+    S* Get() { return std::get_if<S>(&source_); }
+
+  private:
+    Variant source_;
+  };
+
+  // Binary run by magic number, compressed by CompressedFile::DetectFormat,
+  // mapped CSV otherwise. Check IsValid() before use. p_threads decompress a
+  // compressed input, 0 for the CompressedFile default. Keep it at 1 when
+  // many sources are open at once, every source runs its own workers.
+  AnyRecordSource OpenRecordSource(const std::string& p_filename,
+                                   size_t p_batch_bytes = kDefaultRecordBatchBytes,
+                                   unsigned int p_threads = 1);
+
+  // K-way merge of p_sources in Order, by default (timestamp, symbol),
+  // calling p_sink(symbol, record) in that order. Sources whose symbol
+  // p_filter rejects are skipped, as are records it does not accept. A sink
+  // returning bool stops the merge by returning false. Returns the records
+  // passed to p_sink.
+  //
+  // The heap holds 64 bit keys while every head fits them (FitsPacked): the
+  // ranks are known up front, timestamps are checked as they arrive. The
+  // first head that does not fit moves the rest of the merge to 128 bit
+  // keys, which order the same.
+  template<MergeOrder Order = TimeSymbolOrder, RecordSource S, typename Sink>
+  size_t MergeRecordSources(std::vector<S>& p_sources, Sink&& p_sink,
+                            const InputFilter* p_filter = nullptr) {
+    const auto next = [p_filter](S& p_source) {
+      const MktDataRecord* record = p_source.Next();
+      if (p_filter) {
+        while (record != nullptr && !p_filter->AcceptsRecord(*record)) record = p_source.Next();
+      }
+      return record;
+    };
+
+    std::vector<std::string_view> symbols;
+    symbols.reserve(p_sources.size());
+    for (const auto& source : p_sources) symbols.push_back(source.GetSymbol());
+    const std::vector<uint32_t> ranks = RankSymbols(symbols);
+
+    // (record, source index) of every source with records left
+    std::vector<std::pair<const MktDataRecord*, size_t>> heads;
+    heads.reserve(p_sources.size());
+    bool packed = std::all_of(ranks.begin(), ranks.end(),
+                              [](uint32_t p_rank) { return p_rank <= kMaxPackedRank; });
+    for (size_t i = 0; i < p_sources.size(); ++i) {
+      if (p_filter && !p_filter->AcceptsSymbol(symbols[i])) continue;
+      if (const auto* record = next(p_sources[i])) {
+        heads.emplace_back(record, i);
+        packed = packed && FitsPacked(record->timestamp, ranks[i]);
+      }
+    }
+
+    size_t emitted = 0;
+    bool stopped = false;
+    // Merges heads until done or stopped, or, with p_checked, until a head
+    // does not fit p_pack, which leaves the remaining heads in heads
+    const auto merge = [&](auto p_pack, bool p_checked) {
+      using Key = decltype(p_pack(int64_t{0}, uint32_t{0}));
+      struct Head {
+        Key key;
+        const MktDataRecord* record;
+        size_t index;
+      };
+      // Min-heap on the key, one integer compare
+      const auto greater = [](const Head& p_lhs, const Head& p_rhs) {
+        return p_lhs.key > p_rhs.key;
+      };
+      std::vector<Head> heap;
+      heap.reserve(heads.size());
+      for (const auto& [record, index] : heads) {
+        heap.push_back({p_pack(record->timestamp, ranks[index]), record, index});
+      }
+      heads.clear();
+      std::make_heap(heap.begin(), heap.end(), greater);
+
+      while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), greater);
+        Head& head = heap.back();
+        ++emitted;
+        if constexpr (std::is_same_v<decltype(p_sink(symbols[head.index], *head.record)), bool>) {
+          if (!p_sink(symbols[head.index], *head.record)) {
+            stopped = true;
+            return;
+          }
+        } else {
+          p_sink(symbols[head.index], *head.record);
+        }
+        head.record = next(p_sources[head.index]);
+        if (head.record == nullptr) {
+          heap.pop_back();
+          continue;
+        }
+        if (p_checked && !FitsPacked(head.record->timestamp, ranks[head.index])) {
+          for (const auto& rest : heap) heads.emplace_back(rest.record, rest.index);
+          return;
+        }
+        head.key = p_pack(head.record->timestamp, ranks[head.index]);
+        std::push_heap(heap.begin(), heap.end(), greater);
+      }
+    };
+
+    if (packed) {
+      merge([](int64_t p_millis, uint32_t p_rank) { return Order::Pack(p_millis, p_rank); },
+            true);
+    }
+    if (!stopped && !heads.empty()) {
+      merge([](int64_t p_millis, uint32_t p_rank) { return Order::PackWide(p_millis, p_rank); },
+            false);
+    }
+    return emitted;
+  }
+
+  // Merges p_sources into p_output in the MergeJob output format. nullopt
+  // if an input is invalid or the output cannot be written. Data lines that
+  // do not parse as records are not in the output, see
+  // ReportDroppedDataLines.
+  std::optional<size_t> MergeRecordSourcesToFile(
+    std::vector<AnyRecordSource>& p_sources, const std::string& p_output,
+    const InputFilter* p_filter = nullptr,
+    size_t p_buffer_size = FileWriter::kDefaultBufferSize);
+
+  // Logs every source with data lines that were left out of the merge
+  // because they do not parse as records, and returns the total. MergeJob
+  // would have copied them through.
+  size_t ReportDroppedDataLines(const std::vector<AnyRecordSource>& p_sources);
+}// namespace sp
+
+#endif // RecordSource_hpp
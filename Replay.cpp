@@ -0,0 +1,205 @@
+#include "Replay.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <sys/mman.h>
+#include <thread>
+
+#include "MktData.hpp"
+#include "RecordSource.hpp"
+
+using namespace sp;
+
+Replayer::Replayer(const std::string& p_filename, Mode p_mode, double p_speed)
+  : mmf_(std::make_unique<MMF>(p_filename)),
+    mode_(p_mode),
+    speed_(p_mode == Mode::Scaled && p_speed > 0 ? p_speed : 1.0),
+    last_error_(Error::None) {
+  if (!mmf_->IsValid()) {
+    std::cerr << "Failed to open replay file: " << p_filename << " with error: "
+              << static_cast<int>(mmf_->GetLastError()) << std::endl;
+    last_error_ = Error::FileOpenFailed;
+    return;
+  }
+  const auto data = mmf_->GetData();
+  if (!data) return; // Empty file, nothing to replay
+
+  const std::string_view content(static_cast<const char*>(*data), *mmf_->GetMappedSize());
+  if (!content.starts_with("Symbol,")) {
+    std::cerr << "Not a merged output file: " << p_filename << std::endl;
+    last_error_ = Error::NotMergedOutput;
+    return;
+  }
+  // Read front to back exactly once
+  madvise(const_cast<void*>(*data), content.size(), MADV_SEQUENTIAL);
+
+  bitmaps_ = SymbolBitmapIndex::Load(SymbolBitmapIndex::GetPath(p_filename));
+  if (bitmaps_ && !bitmaps_->output.Matches(p_filename)) {
+    std::cerr << "Symbol bitmaps: " << SymbolBitmapIndex::GetPath(p_filename)
+              << " do not match replay file: " << p_filename << ", ignored" << std::endl;
+    bitmaps_.reset();
+  }
+}
+
+Replayer::Replayer(std::vector<std::string> p_runs, Mode p_mode, double p_speed)
+  : runs_(std::move(p_runs)),
+    mode_(p_mode),
+    speed_(p_mode == Mode::Scaled && p_speed > 0 ? p_speed : 1.0),
+    last_error_(Error::None) {}
+
+void Replayer::Subscribe(Callback p_callback, const std::vector<std::string>& p_symbols) {
+  const size_t index = callbacks_.size();
+  callbacks_.push_back(std::move(p_callback));
+  if (p_symbols.empty()) {
+    all_symbols_.push_back(index);
+    return;
+  }
+  for (const auto& symbol : p_symbols) {
+    auto& routed = routes_[symbol];
+    if (routed.empty() || routed.back() != index) routed.push_back(index);
+  }
+}
+
+void Replayer::Publish(const ReplayRecord& p_record, const std::vector<size_t>* p_routed) {
+  // Subscription order, whether with or without a symbol filter
+  auto all = all_symbols_.begin();
+  if (p_routed) {
+    for (const size_t index : *p_routed) {
+      for (; all != all_symbols_.end() && *all < index; ++all) callbacks_[*all](p_record);
+      callbacks_[index](p_record);
+    }
+  }
+  for (; all != all_symbols_.end(); ++all) callbacks_[*all](p_record);
+  ++records_published_;
+}
+
+void Replayer::Pace(int64_t p_millis) {
+  if (p_millis < 0 || p_millis == last_millis_) return;
+  last_millis_ = p_millis;
+  if (first_millis_ < 0) {
+    first_millis_ = p_millis;
+    start_ = std::chrono::steady_clock::now();
+    return;
+  }
+  const auto offset = std::chrono::duration<double, std::milli>(
+    static_cast<double>(p_millis - first_millis_) / speed_);
+  const auto target = start_ +
+    std::chrono::duration_cast<std::chrono::steady_clock::duration>(offset);
+  // In slices so that Stop() is not stuck behind a long recorded gap
+  constexpr auto kSlice = std::chrono::milliseconds(100);
+  for (auto now = std::chrono::steady_clock::now();
+       now < target && !stop_flag_.load(std::memory_order_relaxed);
+       now = std::chrono::steady_clock::now()) {
+    std::this_thread::sleep_until(std::min(target, now + kSlice));
+  }
+}
+
+size_t Replayer::Run() {
+  if (!IsValid()) return 0;
+  if (!mmf_) return RunRecordRuns();
+  const auto data = mmf_->GetData();
+  if (!data || callbacks_.empty()) return 0;
+
+  const char* const begin = static_cast<const char*>(*data);
+  const char* pos = begin;
+  const char* const end = pos + *mmf_->GetMappedSize();
+  const bool filtered = all_symbols_.empty();
+  const bool paced = mode_ != Mode::MaxSpeed;
+  const size_t published_before = records_published_;
+
+  // Blocks are only skipped when no subscriber takes every symbol
+  std::vector<uint64_t> mask;
+  const auto* blocks = filtered && bitmaps_ ? &bitmaps_->blocks : nullptr;
+  if (blocks) {
+    std::vector<std::string> symbols;
+    symbols.reserve(routes_.size());
+    for (const auto& [symbol, routed] : routes_) symbols.push_back(symbol);
+    mask = bitmaps_->MakeMask(symbols);
+  }
+  size_t block = 0; // Next block not entered yet
+
+  // Skip the header
+  pos = static_cast<const char*>(std::memchr(pos, '\n', end - pos));
+  pos = pos ? pos + 1 : end;
+
+  ReplayRecord record;
+  while (pos < end && !stop_flag_.load(std::memory_order_relaxed)) {
+    if (blocks && block < blocks->size() &&
+        (*blocks)[block].offset <= static_cast<uint64_t>(pos - begin)) {
+      const auto& entered = (*blocks)[block++];
+      if (!bitmaps_->Intersects(block - 1, mask)) {
+        pos = begin + entered.offset + entered.length;
+        ++blocks_skipped_;
+        continue;
+      }
+    }
+    const char* eol = static_cast<const char*>(std::memchr(pos, '\n', end - pos));
+    if (!eol) eol = end;
+    const std::string_view line(pos, eol - pos);
+    pos = eol + 1;
+
+    const auto comma = line.find(',');
+    if (comma == std::string_view::npos) continue; // Empty or broken line
+    ++records_read_;
+    record.symbol = line.substr(0, comma);
+
+    const std::vector<size_t>* routed = nullptr;
+    if (!routes_.empty()) {
+      const auto it = routes_.find(record.symbol);
+      if (it != routes_.end()) {
+        routed = &it->second;
+      } else if (filtered) {
+        continue;
+      }
+    }
+
+    record.fields = line.substr(comma + 1);
+    if (record.fields.starts_with(' ')) record.fields.remove_prefix(1);
+    record.timestamp = MktData::GetTimestampField(record.fields);
+    if (paced) {
+      record.millis = MktData::TimestampToMillis(record.timestamp);
+      Pace(record.millis);
+    }
+    Publish(record, routed);
+  }
+  return records_published_ - published_before;
+}
+
+size_t Replayer::RunRecordRuns() {
+  if (callbacks_.empty()) return 0;
+  const bool filtered = all_symbols_.empty();
+  std::vector<BinaryRecordSource> sources;
+  sources.reserve(runs_.size());
+  for (const auto& run : runs_) {
+    if (filtered && !routes_.contains(MktData::GetSymbolFromFilename(run))) continue;
+    sources.emplace_back(run);
+    if (!sources.back().IsValid()) {
+      last_error_ = Error::NotRecordRun;
+      return 0;
+    }
+  }
+
+  const bool paced = mode_ != Mode::MaxSpeed;
+  const size_t published_before = records_published_;
+  char timestamp[MktData::kTimestampLength];
+  ReplayRecord record;
+  record.timestamp = std::string_view(timestamp, sizeof(timestamp));
+  MergeRecordSources(sources, [&](std::string_view p_symbol, const MktDataRecord& p_record) {
+    if (stop_flag_.load(std::memory_order_relaxed)) return false;
+    ++records_read_;
+    const std::vector<size_t>* routed = nullptr;
+    if (!routes_.empty()) {
+      const auto it = routes_.find(p_symbol);
+      if (it != routes_.end()) routed = &it->second;
+    }
+    record.symbol = p_symbol;
+    record.millis = p_record.timestamp;
+    record.record = &p_record;
+    MktData::MillisToTimestamp(p_record.timestamp, timestamp);
+    if (paced) Pace(record.millis);
+    Publish(record, routed);
+    return true;
+  });
+  return records_published_ - published_before;
+}
@@ -0,0 +1,117 @@
+#ifndef Replay_hpp
+#define Replay_hpp
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "MktDataRecord.hpp"
+#include "Mmf.hpp"
+#include "SymbolBitmaps.hpp"
+
+namespace sp {
+  // One record of the replay, views that are only valid during the callback
+  struct ReplayRecord {
+    std::string_view symbol;
+    std::string_view timestamp;
+    std::string_view fields;  // Everything after the symbol column, text only
+    int64_t millis = -1;      // Of timestamp, paced modes or binary runs
+    const MktDataRecord* record = nullptr; // Decoded, binary runs only
+  };
+
+  // Streams a merged output file (see MergeJob) to subscribers, either as
+  // fast as possible or paced by the recorded timestamps. When the output
+  // has symbol bitmaps (<output>.sbm) and every subscriber has a symbol
+  // filter, blocks without any subscribed symbol are skipped unread.
+  //
+  // Binary record runs (see BinaryRecordSource, one per symbol) are
+  // replayed merged in (timestamp, symbol) order instead, with the decoded
+  // records read in place from their mappings. Runs of symbols no
+  // subscriber wants are not opened.
+  class Replayer {
+  public:
+    enum class Mode {
+      MaxSpeed, // No pacing, timestamps are not decoded
+      RealTime, // Recorded gaps are replayed as wall clock gaps
+      Scaled    // Recorded gaps divided by the speed factor
+    };
+
+    enum class Error {
+      None,
+      FileOpenFailed,
+      NotMergedOutput,
+      NotRecordRun
+    };
+
+    using Callback = std::function<void(const ReplayRecord&)>;
+
+    explicit Replayer(const std::string& p_filename, Mode p_mode = Mode::MaxSpeed,
+                      double p_speed = 1.0);
+    // Binary record runs, the symbol of each taken from its file name. They
+    // are opened by Run(), which fails with NotRecordRun on an invalid one.
+    explicit Replayer(std::vector<std::string> p_runs, Mode p_mode = Mode::MaxSpeed,
+                      double p_speed = 1.0);
+
+    Replayer(const Replayer&) = delete;
+    Replayer& operator=(const Replayer&) = delete;
+
+    bool IsValid() const { return last_error_ == Error::None; }
+    Error GetLastError() const { return last_error_; }
+
+    // p_symbols empty subscribes to everything. Records no subscriber wants
+    // are skipped before their timestamp is looked at.
+    void Subscribe(Callback p_callback, const std::vector<std::string>& p_symbols = {});
+
+    // Replays the whole file or every run (until Stop()), returns records
+    // published
+    size_t Run();
+    void Stop() { stop_flag_.store(true, std::memory_order_relaxed); }
+
+    size_t GetRecordsRead() const { return records_read_; }
+    size_t GetRecordsPublished() const { return records_published_; }
+    bool HasSymbolBitmaps() const { return bitmaps_.has_value(); }
+    size_t GetBlocksSkipped() const { return blocks_skipped_; }
+
+  private:
+    struct StringHash {
+      using is_transparent = void;
+      size_t operator()(std::string_view p_str) const {
+        return std::hash<std::string_view>{}(p_str);
+      }
+    };
+
+    // Subscribers of one symbol, indices into callbacks_
+    using Routes = std::unordered_map<std::string, std::vector<size_t>,
+                                      StringHash, std::equal_to<>>;
+
+    size_t RunRecordRuns();
+    void Publish(const ReplayRecord& p_record, const std::vector<size_t>* p_routed);
+    void Pace(int64_t p_millis);
+
+    std::unique_ptr<MMF> mmf_;
+    std::vector<std::string> runs_;
+    std::optional<SymbolBitmapIndex> bitmaps_;
+    Mode mode_;
+    double speed_;
+    Error last_error_;
+    std::vector<Callback> callbacks_;
+    std::vector<size_t> all_symbols_; // Subscribers without a symbol filter
+    Routes routes_;
+    int64_t first_millis_ = -1;
+    int64_t last_millis_ = -1;
+    std::chrono::steady_clock::time_point start_;
+    size_t records_read_ = 0;
+    size_t records_published_ = 0;
+    size_t blocks_skipped_ = 0;
+    std::atomic<bool> stop_flag_{false};
+  };
+}// namespace sp
+
+#endif // Replay_hpp
@@ -0,0 +1,146 @@
+#ifndef SPSCRing_hpp
+#define SPSCRing_hpp
+#include <atomic>
+#include <bit>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace sp {
+  // Bounded single-producer single-consumer ring without locks on the data
+  // path: each side stores only its own index and caches the other's, so
+  // the shared cache line is only read when the ring looks full or empty.
+  // The blocking Push()/Pop() spin briefly and then park on a condition
+  // variable, which the other side only touches when it sees the parked
+  // flag set. T must be default constructible.
+  template<typename T>
+  class SPSCRing {
+  public:
+    // Rounded up to a power of two
+    explicit SPSCRing(size_t p_capacity)
+      : slots_(std::bit_ceil(p_capacity < 2 ? size_t{2} : p_capacity)),
+        mask_(slots_.size() - 1) {}
+
+    SPSCRing(const SPSCRing&) = delete;
+    SPSCRing& operator=(const SPSCRing&) = delete;
+
+    size_t GetCapacity() const { return slots_.size(); }
+    // Approximate unless called from one of the two sides
+    size_t GetSize() const {
+      return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+    }
+    bool IsClosed() const { return closed_.load(std::memory_order_acquire); }
+    // Producer side, for a producer that parks outside the ring (one thread
+    // feeding several rings). seq_cst pairs with the consumer's pop like the
+    // parked flag handshake of Push().
+    bool HasRoom() const {
+      return tail_.load(std::memory_order_seq_cst) - head_.load(std::memory_order_seq_cst) <
+             slots_.size();
+    }
+
+    // Producer side, false if full. p_value is only moved from on success.
+    bool TryPush(T&& p_value) { return TryPushFrom(p_value); }
+    bool TryPush(const T& p_value) {
+      T copy(p_value);
+      return TryPushFrom(copy);
+    }
+
+    // Consumer side, nullopt if empty
+    std::optional<T> TryPop() {
+      const size_t head = head_.load(std::memory_order_relaxed);
+      if (head == cached_tail_) {
+        cached_tail_ = tail_.load(std::memory_order_acquire);
+        if (head == cached_tail_) return std::nullopt;
+      }
+      std::optional<T> value(std::move(slots_[head & mask_]));
+      head_.store(head + 1, std::memory_order_seq_cst);
+      if (producer_parked_.load(std::memory_order_seq_cst)) Wake();
+      return value;
+    }
+
+    // Blocks while full, false once closed
+    bool Push(T p_value) {
+      for (;;) {
+        if (IsClosed()) return false;
+        for (int spin = 0; spin < kSpins; ++spin) {
+          if (TryPushFrom(p_value)) return true;
+          std::this_thread::yield();
+        }
+        Park(producer_parked_, [this] {
+          return tail_.load(std::memory_order_seq_cst) -
+                 head_.load(std::memory_order_seq_cst) < slots_.size();
+        });
+      }
+    }
+
+    // Blocks while empty, nullopt once closed and drained
+    std::optional<T> Pop() {
+      for (;;) {
+        for (int spin = 0; spin < kSpins; ++spin) {
+          if (auto value = TryPop()) return value;
+          std::this_thread::yield();
+        }
+        if (IsClosed()) return TryPop();
+        Park(consumer_parked_, [this] {
+          return head_.load(std::memory_order_seq_cst) != tail_.load(std::memory_order_seq_cst);
+        });
+      }
+    }
+
+    // Either side: wakes and fails every blocked and later Push, Pop drains
+    // what is left first
+    void Close() {
+      closed_.store(true, std::memory_order_seq_cst);
+      Wake();
+    }
+
+  private:
+    static constexpr int kSpins = 64;
+
+    // Moves from p_value only on success
+    bool TryPushFrom(T& p_value) {
+      const size_t tail = tail_.load(std::memory_order_relaxed);
+      if (tail - cached_head_ == slots_.size()) {
+        cached_head_ = head_.load(std::memory_order_acquire);
+        if (tail - cached_head_ == slots_.size()) return false;
+      }
+      slots_[tail & mask_] = std::move(p_value);
+      // seq_cst pairs with the consumer storing its parked flag
+      tail_.store(tail + 1, std::memory_order_seq_cst);
+      if (consumer_parked_.load(std::memory_order_seq_cst)) Wake();
+      return true;
+    }
+
+    template<typename Ready>
+    void Park(std::atomic<bool>& p_parked, Ready p_ready) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      p_parked.store(true, std::memory_order_seq_cst);
+      cv_.wait(lock, [&] { return p_ready() || IsClosed(); });
+      p_parked.store(false, std::memory_order_relaxed);
+    }
+
+    void Wake() {
+      std::lock_guard<std::mutex> lock(mutex_);
+      cv_.notify_all();
+    }
+
+    static constexpr size_t kCacheLine = 64;
+
+    std::vector<T> slots_;
+    size_t mask_;
+    alignas(kCacheLine) std::atomic<size_t> head_{0}; // Next to pop
+    size_t cached_tail_ = 0;                          // Consumer's view of tail_
+    alignas(kCacheLine) std::atomic<size_t> tail_{0}; // Next to push
+    size_t cached_head_ = 0;                          // Producer's view of head_
+    alignas(kCacheLine) std::atomic<bool> consumer_parked_{false};
+    std::atomic<bool> producer_parked_{false};
+    std::atomic<bool> closed_{false};
+    std::mutex mutex_;
+    std::condition_variable cv_;
+  };
+}// namespace sp
+
+#endif // SPSCRing_hpp
@@ -0,0 +1,139 @@
+#include "SymbolBitmaps.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+using namespace sp;
+
+std::optional<size_t> SymbolBitmapIndex::FindSymbol(std::string_view p_symbol) const {
+  const auto it = std::lower_bound(symbols.begin(), symbols.end(), p_symbol);
+  if (it == symbols.end() || *it != p_symbol) return std::nullopt;
+  return static_cast<size_t>(it - symbols.begin());
+}
+
+std::vector<uint64_t> SymbolBitmapIndex::MakeMask(const std::vector<std::string>& p_symbols) const {
+  std::vector<uint64_t> mask(GetWordCount(), 0);
+  for (const auto& symbol : p_symbols) {
+    if (const auto bit = FindSymbol(symbol)) mask[*bit / 64] |= uint64_t{1} << (*bit % 64);
+  }
+  return mask;
+}
+
+bool SymbolBitmapIndex::Intersects(size_t p_block, const std::vector<uint64_t>& p_mask) const {
+  const uint64_t* block_bits = bits.data() + p_block * GetWordCount();
+  for (size_t i = 0; i < p_mask.size(); ++i) {
+    if (block_bits[i] & p_mask[i]) return true;
+  }
+  return false;
+}
+
+void SymbolBitmapIndex::Truncate(uint64_t p_length) {
+  const auto it = std::lower_bound(
+    blocks.begin(), blocks.end(), p_length,
+    [](const Block& p_block, uint64_t p_value) { return p_block.offset < p_value; });
+  blocks.erase(it, blocks.end());
+  bits.resize(blocks.size() * GetWordCount());
+  if (!blocks.empty()) {
+    auto& last = blocks.back();
+    last.length = std::min(last.length, p_length - last.offset);
+  }
+}
+
+bool SymbolBitmapIndex::Save(const std::string& p_path) const {
+  // kMagic, OutputFingerprint, symbol count, block count, length prefixed
+  // symbols, Blocks, then the bitmaps, host byte order
+  const uint64_t counts[2] = {symbols.size(), blocks.size()};
+  std::string bytes(kMagic);
+  bytes.append(reinterpret_cast<const char*>(&output), sizeof(output));
+  bytes.append(reinterpret_cast<const char*>(counts), sizeof(counts));
+  for (const auto& symbol : symbols) {
+    const auto length = static_cast<uint32_t>(symbol.size());
+    bytes.append(reinterpret_cast<const char*>(&length), sizeof(length));
+    bytes.append(symbol);
+  }
+  bytes.append(reinterpret_cast<const char*>(blocks.data()), blocks.size() * sizeof(Block));
+  bytes.append(reinterpret_cast<const char*>(bits.data()), bits.size() * sizeof(uint64_t));
+  return WriteFileAtomically(p_path, bytes);
+}
+
+std::optional<SymbolBitmapIndex> SymbolBitmapIndex::Load(const std::string& p_path) {
+  std::ifstream in(p_path, std::ios::binary | std::ios::ate);
+  if (!in) return std::nullopt;
+  const auto size = static_cast<uint64_t>(in.tellg());
+  in.seekg(0);
+  char magic[kMagic.size()];
+  uint64_t counts[2] = {};
+  SymbolBitmapIndex index;
+  if (!in.read(magic, sizeof(magic)) || std::string_view(magic, sizeof(magic)) != kMagic ||
+      !in.read(reinterpret_cast<char*>(&index.output), sizeof(index.output)) ||
+      !in.read(reinterpret_cast<char*>(counts), sizeof(counts)) ||
+      counts[0] > size || counts[1] > size) {
+    std::cerr << "Not a symbol bitmap index: " << p_path << std::endl;
+    return std::nullopt;
+  }
+  index.symbols.resize(counts[0]);
+  for (auto& symbol : index.symbols) {
+    uint32_t length = 0;
+    if (!in.read(reinterpret_cast<char*>(&length), sizeof(length)) || length > size) {
+      std::cerr << "Failed to read symbol bitmaps: " << p_path << std::endl;
+      return std::nullopt;
+    }
+    symbol.resize(length);
+    in.read(symbol.data(), length);
+  }
+  index.blocks.resize(counts[1]);
+  index.bits.resize(counts[1] * index.GetWordCount());
+  in.read(reinterpret_cast<char*>(index.blocks.data()),
+          static_cast<std::streamsize>(index.blocks.size() * sizeof(Block)));
+  in.read(reinterpret_cast<char*>(index.bits.data()),
+          static_cast<std::streamsize>(index.bits.size() * sizeof(uint64_t)));
+  if (!in || static_cast<uint64_t>(in.tellg()) != size ||
+      !std::is_sorted(index.symbols.begin(), index.symbols.end())) {
+    std::cerr << "Failed to read symbol bitmaps: " << p_path << std::endl;
+    return std::nullopt;
+  }
+  return index;
+}
+
+SymbolBitmapWriter::SymbolBitmapWriter(std::vector<std::string> p_symbols, size_t p_block_bytes,
+                                       std::optional<SymbolBitmapIndex> p_index)
+  : block_bytes_(p_block_bytes == 0 ? SymbolBitmapIndex::kDefaultBlockBytes : p_block_bytes) {
+  if (p_index && p_index->symbols == p_symbols) {
+    index_ = std::move(*p_index);
+    block_end_ = index_.GetCoveredLength();
+  } else {
+    index_.symbols = std::move(p_symbols);
+    if (p_index && !p_index->blocks.empty()) {
+      // Other inputs than the run that wrote it: the bit numbering changed,
+      // what it covered is kept as a single block with every bit set
+      const uint64_t begin = p_index->blocks.front().offset;
+      index_.blocks.push_back({begin, p_index->GetCoveredLength() - begin});
+      index_.bits.assign(index_.GetWordCount(), ~uint64_t{0});
+      block_end_ = index_.GetCoveredLength();
+    }
+  }
+  bits_begin_ = index_.bits.size();
+}
+
+void SymbolBitmapWriter::StartBlock(uint64_t p_offset) {
+  if (!index_.blocks.empty()) {
+    auto& last = index_.blocks.back();
+    last.length = p_offset - last.offset;
+  }
+  index_.blocks.push_back({p_offset, 0});
+  bits_begin_ = index_.bits.size();
+  index_.bits.resize(bits_begin_ + index_.GetWordCount(), 0);
+  block_end_ = p_offset + block_bytes_;
+}
+
+const SymbolBitmapIndex& SymbolBitmapWriter::Finish(const OutputFingerprint& p_output) {
+  const uint64_t length = p_output.length;
+  if (!index_.blocks.empty() && bits_begin_ == index_.bits.size() - index_.GetWordCount() &&
+      index_.blocks.back().offset < length) {
+    auto& last = index_.blocks.back();
+    last.length = std::max(last.length, length - last.offset);
+  }
+  index_.output = p_output;
+  return index_;
+}
@@ -0,0 +1,87 @@
+#ifndef SymbolBitmaps_hpp
+#define SymbolBitmaps_hpp
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Checkpoint.hpp"
+
+namespace sp {
+  // Sidecar of a merged output (<output>.sbm): the output is cut into blocks
+  // of about block_bytes at line boundaries and every block carries a bitmap
+  // of the symbols that have a record in it, bit i for symbols[i]. The
+  // bitmaps are exact, a clear bit means the symbol is not in the block, so
+  // a reader interested in a few symbols only touches the blocks whose
+  // bitmap intersects their mask. Bytes of the output no block covers
+  // (header, data appended later) have to be read. The OutputFingerprint
+  // tells whether the output is still the one the blocks describe.
+  struct SymbolBitmapIndex {
+    struct Block {
+      uint64_t offset = 0;
+      uint64_t length = 0;
+    };
+
+    static constexpr std::string_view kMagic{"SPSBMP02", 8};
+    static constexpr size_t kDefaultBlockBytes = 1024 * 1024;
+
+    OutputFingerprint output;         // Output the blocks refer to
+    std::vector<std::string> symbols; // Sorted
+    std::vector<Block> blocks;        // Sorted by offset, not overlapping
+    std::vector<uint64_t> bits;       // GetWordCount() words per block
+
+    size_t GetWordCount() const { return (symbols.size() + 63) / 64; }
+    // Bit of p_symbol, nullopt if no block contains it
+    std::optional<size_t> FindSymbol(std::string_view p_symbol) const;
+    // Mask of GetWordCount() words with the bits of p_symbols, unknown
+    // symbols are left out
+    std::vector<uint64_t> MakeMask(const std::vector<std::string>& p_symbols) const;
+    bool Intersects(size_t p_block, const std::vector<uint64_t>& p_mask) const;
+    // End of the last block
+    uint64_t GetCoveredLength() const {
+      return blocks.empty() ? 0 : blocks.back().offset + blocks.back().length;
+    }
+    // Cuts the blocks back to end at p_length at most. A cut block keeps its
+    // bitmap, a superset of what it still holds.
+    void Truncate(uint64_t p_length);
+
+    // Written with WriteFileAtomically
+    bool Save(const std::string& p_path) const;
+    static std::optional<SymbolBitmapIndex> Load(const std::string& p_path);
+    static std::string GetPath(const std::string& p_output) { return p_output + ".sbm"; }
+  };
+
+  // Builds a SymbolBitmapIndex as records are written: one compare and one
+  // bit set per record.
+  class SymbolBitmapWriter {
+  public:
+    // p_symbols sorted and unique, a record's symbol is given by its index
+    // into them. p_index continues a loaded index with the same symbols.
+    explicit SymbolBitmapWriter(std::vector<std::string> p_symbols,
+                                size_t p_block_bytes = SymbolBitmapIndex::kDefaultBlockBytes,
+                                std::optional<SymbolBitmapIndex> p_index = std::nullopt);
+
+    // p_offset where the record's line starts
+    void OnRecord(size_t p_symbol, uint64_t p_offset) {
+      if (p_offset >= block_end_) StartBlock(p_offset);
+      index_.bits[bits_begin_ + p_symbol / 64] |= uint64_t{1} << (p_symbol % 64);
+    }
+
+    // The index with the last block ending at the end of p_output, ready
+    // to Save
+    const SymbolBitmapIndex& Finish(const OutputFingerprint& p_output);
+    const SymbolBitmapIndex& GetIndex() const { return index_; }
+
+  private:
+    void StartBlock(uint64_t p_offset);
+
+    SymbolBitmapIndex index_;
+    size_t block_bytes_;
+    uint64_t block_end_ = 0;   // Offset at which the next block starts
+    size_t bits_begin_ = 0;    // First word of the current block
+  };
+}// namespace sp
+
+#endif // SymbolBitmaps_hpp
@@ -0,0 +1,185 @@
+#include "SymbolBlocks.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <fcntl.h>
+#include <iostream>
+#include <map>
+#include <unistd.h>
+
+#include "CsvParser.hpp"
+#include "Dictionary.hpp"
+#include "MergeJob.hpp"
+#include "RecordSource.hpp"
+
+using namespace sp;
+
+namespace {
+  std::string FormatDirectory(const std::vector<SymbolBlock>& p_blocks) {
+    std::string directory(kSymbolBlocksHeaderSize + p_blocks.size() * kSymbolBlockEntrySize, '\0');
+    char* out = directory.data();
+    out += std::snprintf(out, kSymbolBlocksHeaderSize + 1, "%s%20zu\n",
+                         kSymbolBlocksMagic.data(), p_blocks.size());
+    for (const auto& block : p_blocks) {
+      out += std::snprintf(out, kSymbolBlockEntrySize + 1, "#%-*s %20llu %20llu %20llu\n",
+                           static_cast<int>(kMaxBlockSymbolLength), block.symbol.c_str(),
+                           static_cast<unsigned long long>(block.offset),
+                           static_cast<unsigned long long>(block.length),
+                           static_cast<unsigned long long>(block.records));
+    }
+    return directory;
+  }
+
+  // Trims the padding of a fixed width field and parses it
+  std::optional<uint64_t> ParseField(std::string_view p_field) {
+    const auto first = p_field.find_first_not_of(' ');
+    if (first == std::string_view::npos) return std::nullopt;
+    p_field.remove_prefix(first);
+    uint64_t value = 0;
+    const auto [end, error] = std::from_chars(p_field.data(), p_field.data() + p_field.size(), value);
+    if (error != std::errc() || end != p_field.data() + p_field.size()) return std::nullopt;
+    return value;
+  }
+}
+
+std::optional<std::vector<SymbolBlock>> sp::ExportSymbolBlocks(
+    const std::vector<std::string>& p_inputs, const std::string& p_output,
+    const InputFilter* p_filter, size_t p_buffer_size) {
+  // Inputs by symbol, a symbol may span several files
+  std::map<std::string, std::vector<std::string>> groups;
+  for (const auto& input : p_inputs) {
+    std::string symbol = GetRecordSourceSymbol(input);
+    if (p_filter && !p_filter->AcceptsSymbol(symbol)) continue;
+    if (symbol.empty() || symbol.size() > kMaxBlockSymbolLength) {
+      std::cerr << "Symbol: " << symbol << " of file: " << input
+                << " does not fit the symbol block directory" << std::endl;
+      return std::nullopt;
+    }
+    groups[std::move(symbol)].push_back(input);
+  }
+
+  std::vector<SymbolBlock> blocks;
+  blocks.reserve(groups.size());
+  for (const auto& [symbol, files] : groups) blocks.push_back({symbol, 0, 0, 0});
+  const std::string placeholder = FormatDirectory(blocks);
+
+  FileWriter writer(p_output, FileWriter::OpenMode::Truncate, p_buffer_size);
+  if (!writer.IsValid() || writer.Write(placeholder) != FileWriter::Error::None ||
+      writer.WriteLine(MergeJob::kOutputHeader) != FileWriter::Error::None) {
+    std::cerr << "Failed to open output file: " << p_output << std::endl;
+    return std::nullopt;
+  }
+
+  const auto& exchanges = GetExchangeDictionary();
+  const auto& types = GetTypeDictionary();
+  std::string line;
+  bool failed = false;
+  auto block = blocks.begin();
+  for (const auto& [symbol, files] : groups) {
+    std::vector<AnyRecordSource> sources;
+    sources.reserve(files.size());
+    for (const auto& file : files) {
+      // Only this symbol's inputs are open, each gets the default workers
+      sources.push_back(OpenRecordSource(file, kDefaultRecordBatchBytes, 0));
+      if (!sources.back().IsValid()) {
+        std::cerr << "Failed to open input: " << file << std::endl;
+        return std::nullopt;
+      }
+    }
+    block->offset = writer.GetLength();
+    // One symbol, so this is a plain time merge of its files
+    block->records = MergeRecordSources(sources,
+      [&](std::string_view p_symbol, const MktDataRecord& p_record) {
+        line.resize(kFormattedRecordOverhead + p_symbol.size() +
+                    exchanges.Decode(p_record.exchange).size() +
+                    types.Decode(p_record.type).size());
+        const size_t length = FormatRecord(p_symbol, p_record, line.data());
+        failed |= writer.Write(std::string_view(line.data(), length)) != FileWriter::Error::None;
+      }, p_filter);
+    block->length = writer.GetLength() - block->offset;
+    ReportDroppedDataLines(sources);
+    ++block;
+    if (failed) break;
+  }
+  if (failed || writer.Flush() != FileWriter::Error::None) {
+    std::cerr << "Failed to write output file: " << p_output << std::endl;
+    return std::nullopt;
+  }
+
+  // Same size as the placeholder, only the offsets change
+  const std::string directory = FormatDirectory(blocks);
+  const int fd = open(p_output.c_str(), O_WRONLY | O_CLOEXEC);
+  const bool written = fd != -1 &&
+    pwrite(fd, directory.data(), directory.size(), 0) == static_cast<ssize_t>(directory.size());
+  if (fd != -1) close(fd);
+  if (!written) {
+    std::cerr << "Failed to write symbol block directory of: " << p_output << std::endl;
+    return std::nullopt;
+  }
+  std::cout << "Exported " << blocks.size() << " symbol blocks to: " << p_output << std::endl;
+  return blocks;
+}
+
+SymbolBlockFile::SymbolBlockFile(const std::string& p_filename)
+  : mmf_(p_filename) {
+  if (!mmf_.IsValid()) {
+    std::cerr << "Failed to open file: " << p_filename << " with error: "
+              << static_cast<int>(mmf_.GetLastError()) << std::endl;
+    last_error_ = Error::FileOpenFailed;
+    return;
+  }
+  if (const auto data = mmf_.GetData()) {
+    data_ = std::string_view(static_cast<const char*>(*data), mmf_.GetMappedSize().value_or(0));
+  }
+  if (!ReadDirectory(data_)) {
+    std::cerr << "Invalid symbol block directory in: " << p_filename << std::endl;
+    blocks_.clear();
+    last_error_ = Error::InvalidDirectory;
+  }
+}
+
+bool SymbolBlockFile::ReadDirectory(std::string_view p_data) {
+  if (p_data.size() < kSymbolBlocksHeaderSize || !p_data.starts_with(kSymbolBlocksMagic) ||
+      p_data[kSymbolBlocksHeaderSize - 1] != '\n') {
+    return false;
+  }
+  const auto count = ParseField(p_data.substr(kSymbolBlocksMagic.size(), 20));
+  if (!count || *count > (p_data.size() - kSymbolBlocksHeaderSize) / kSymbolBlockEntrySize) {
+    return false;
+  }
+  blocks_.reserve(*count);
+  for (size_t i = 0; i < *count; ++i) {
+    const auto entry = p_data.substr(kSymbolBlocksHeaderSize + i * kSymbolBlockEntrySize,
+                                     kSymbolBlockEntrySize);
+    if (entry.front() != '#' || entry.back() != '\n') return false;
+    SymbolBlock block;
+    const auto symbol = entry.substr(1, kMaxBlockSymbolLength);
+    block.symbol = std::string(symbol.substr(0, symbol.find_last_not_of(' ') + 1));
+    const auto offset = ParseField(entry.substr(1 + kMaxBlockSymbolLength + 1, 20));
+    const auto length = ParseField(entry.substr(1 + kMaxBlockSymbolLength + 22, 20));
+    const auto records = ParseField(entry.substr(1 + kMaxBlockSymbolLength + 43, 20));
+    if (block.symbol.empty() || !offset || !length || !records ||
+        *offset > p_data.size() || *length > p_data.size() - *offset) {
+      return false;
+    }
+    if (!blocks_.empty() && blocks_.back().symbol >= block.symbol) return false;
+    block.offset = *offset;
+    block.length = *length;
+    block.records = *records;
+    blocks_.push_back(std::move(block));
+  }
+  return true;
+}
+
+const SymbolBlock* SymbolBlockFile::FindBlock(std::string_view p_symbol) const {
+  const auto it = std::lower_bound(blocks_.begin(), blocks_.end(), p_symbol,
+    [](const SymbolBlock& p_block, std::string_view p_value) { return p_block.symbol < p_value; });
+  return it != blocks_.end() && it->symbol == p_symbol ? &*it : nullptr;
+}
+
+std::string_view SymbolBlockFile::GetBlockData(std::string_view p_symbol) const {
+  const auto* block = FindBlock(p_symbol);
+  if (block == nullptr) return {};
+  return data_.substr(block->offset, block->length);
+}
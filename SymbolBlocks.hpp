@@ -0,0 +1,84 @@
+#ifndef SymbolBlocks_hpp
+#define SymbolBlocks_hpp
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "FileWriter.hpp"
+#include "InputFilter.hpp"
+#include "Mmf.hpp"
+
+namespace sp {
+  // Symbol-major export: one contiguous block of output lines per symbol,
+  // symbols in alphabetical order and each block in time order, behind a
+  // directory that gives the file offset of every block:
+  //
+  //   #SYMBOL-BLOCKS <count>
+  //   #<symbol> <offset> <length> <records>     one line per symbol
+  //   Symbol, Timestamp, Price, Size, Exchange, Type
+  //   AAPL, 2021-03-05 10:00:00.123, ...        AAPL block
+  //   ...
+  //   MSFT, 2021-03-05 10:00:00.100, ...        MSFT block
+  //
+  // Directory lines are padded to a fixed width, so the directory is
+  // written ahead of the blocks and filled in once their offsets are known.
+  // A backtest on one instrument maps [offset, offset + length) only.
+  struct SymbolBlock {
+    std::string symbol;
+    uint64_t offset = 0;  // File offset of the first line
+    uint64_t length = 0;  // Bytes, whole lines
+    uint64_t records = 0;
+  };
+
+  constexpr std::string_view kSymbolBlocksMagic = "#SYMBOL-BLOCKS ";
+  constexpr size_t kMaxBlockSymbolLength = 16;
+  // "#" symbol ' ' offset ' ' length ' ' records '\n'
+  constexpr size_t kSymbolBlockEntrySize = 1 + kMaxBlockSymbolLength + 3 * 21 + 1;
+  constexpr size_t kSymbolBlocksHeaderSize = kSymbolBlocksMagic.size() + 20 + 1;
+
+  // Writes p_inputs (files as ChunkedFileReader reads them, plain, compressed
+  // or binary runs, see OpenRecordSource) to p_output in symbol blocks.
+  // Only the inputs of one symbol are open at a time. Symbols p_filter
+  // rejects get no block, records it rejects are left out. Data lines that
+  // do not parse as records are logged and left out, see
+  // ReportDroppedDataLines. nullopt on any error, including symbols longer
+  // than kMaxBlockSymbolLength.
+  std::optional<std::vector<SymbolBlock>> ExportSymbolBlocks(
+    const std::vector<std::string>& p_inputs, const std::string& p_output,
+    const InputFilter* p_filter = nullptr,
+    size_t p_buffer_size = FileWriter::kDefaultBufferSize);
+
+  // Reads the directory of a symbol block export and maps it
+  class SymbolBlockFile {
+  public:
+    enum class Error {
+      None,
+      FileOpenFailed,
+      InvalidDirectory
+    };
+
+    explicit SymbolBlockFile(const std::string& p_filename);
+
+    bool IsValid() const { return last_error_ == Error::None; }
+    Error GetLastError() const { return last_error_; }
+    const std::vector<SymbolBlock>& GetBlocks() const { return blocks_; }
+
+    // nullptr if p_symbol has no block
+    const SymbolBlock* FindBlock(std::string_view p_symbol) const;
+    // The lines of p_symbol's block, empty if there is none
+    std::string_view GetBlockData(std::string_view p_symbol) const;
+
+  private:
+    bool ReadDirectory(std::string_view p_data);
+
+    MMF mmf_;
+    std::string_view data_;
+    std::vector<SymbolBlock> blocks_; // Sorted by symbol
+    Error last_error_ = Error::None;
+  };
+}// namespace sp
+
+#endif // SymbolBlocks_hpp
@@ -0,0 +1,306 @@
+#include "ThreadedMerge.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "MemoryBudget.hpp"
+#include "MergeJob.hpp"
+#include "MktData.hpp"
+#include "utils.hpp"
+
+using namespace sp;
+
+namespace {
+  // Reader passes without progress before it parks
+  constexpr int kIdleSpins = 16;
+  // Bounds of the derived sizes, lines are far shorter
+  constexpr size_t kMinReadWindow = 64 * 1024;
+  constexpr size_t kMinBatchBytes = 4 * 1024;
+  constexpr size_t kMaxBatchBytes = 256 * 1024;
+
+  // Keeps the calling thread on p_node until destroyed, then restores its
+  // affinity
+  class ScopedNodePin {
+  public:
+    explicit ScopedNodePin(std::optional<unsigned int> p_node) {
+      if (!p_node) return;
+      saved_ = GetCurrentThreadCpus();
+      if (!PinCurrentThreadToNumaNode(*p_node)) {
+        std::cerr << "Failed to pin merging thread to node: " << *p_node << std::endl;
+        saved_.clear();
+      }
+    }
+    ~ScopedNodePin() {
+      if (!saved_.empty()) PinCurrentThreadToCpus(saved_);
+    }
+
+    ScopedNodePin(const ScopedNodePin&) = delete;
+    ScopedNodePin& operator=(const ScopedNodePin&) = delete;
+
+  private:
+    std::vector<unsigned int> saved_;
+  };
+}
+
+ThreadedMerge::ThreadedMerge(std::vector<std::string> p_inputs, std::string p_output,
+                             Options p_options)
+  : inputs_(std::move(p_inputs)),
+    output_(std::move(p_output)),
+    options_(std::move(p_options)) {}
+
+ThreadedMerge::~ThreadedMerge() {
+  StopReaders();
+}
+
+void ThreadedMerge::ApplyMemoryBudget() {
+  if (options_.read_window != 0 && options_.batch_bytes != 0) return;
+  const MemoryBudget budget;
+  const size_t inputs = std::max<size_t>(inputs_.size(), 1);
+  if (options_.read_window == 0) {
+    options_.read_window = std::max(
+      budget.GetStageBudget(MemoryBudget::Stage::ReadWindows) / inputs, kMinReadWindow);
+  }
+  if (options_.batch_bytes == 0) {
+    // Full ring plus the batch being read and the one being merged
+    const size_t batches = std::max<size_t>(options_.ring_batches, 1) + 2;
+    options_.batch_bytes = std::clamp(
+      budget.GetStageBudget(MemoryBudget::Stage::QueueCapacity) / (inputs * batches),
+      kMinBatchBytes, kMaxBatchBytes);
+  }
+  std::cout << "Merge buffers per input, read window: " << options_.read_window
+            << " batch: " << options_.batch_bytes << " x " << options_.ring_batches
+            << std::endl;
+}
+
+bool ThreadedMerge::OpenSource(Source& p_source) {
+  p_source.done = true;
+  if (!options_.filter.AcceptsSymbol(p_source.symbol)) return true; // Never opened
+  size_t offset = 0;
+  if (!options_.filter.GetStartTime().empty()) {
+    // Enter the input at the start time instead of reading up to it
+    const auto start = SeekFileToTime(p_source.filename, options_.filter.GetStartTime());
+    if (!start) return false;
+    offset = *start;
+  }
+  MMF probe(p_source.filename);
+  if (!probe.IsValid()) {
+    std::cerr << "Failed to open input file: " << p_source.filename << " with error: "
+              << static_cast<int>(probe.GetLastError()) << std::endl;
+    return false;
+  }
+  if (offset >= probe.GetFileSize().value_or(0)) return true; // Nothing to merge
+  p_source.mmf = std::make_unique<MMF>(p_source.filename, offset, options_.read_window);
+  if (!p_source.mmf->IsValid()) {
+    std::cerr << "Failed to open input file: " << p_source.filename << " with error: "
+              << static_cast<int>(p_source.mmf->GetLastError()) << std::endl;
+    return false;
+  }
+  p_source.ring = std::make_unique<SPSCRing<LineBatch>>(options_.ring_batches);
+  p_source.recycled = std::make_unique<SPSCRing<std::string>>(options_.ring_batches + 2);
+  p_source.done = false;
+  return true;
+}
+
+void ThreadedMerge::ReadBatch(Source& p_source) {
+  LineBatch batch;
+  if (auto buffer = p_source.recycled->TryPop()) batch.data = std::move(*buffer);
+  batch.data.reserve(options_.batch_bytes + 256);
+  const InputFilter* filter = options_.filter.IsEmpty() ? nullptr : &options_.filter;
+  while (batch.data.size() < options_.batch_bytes) {
+    const auto line = p_source.mmf->ReadLineView(true);
+    if (!line) {
+      if (p_source.mmf->GetLastError() != MMF::Error::EndOfFile) {
+        std::cerr << "Failed to read file: " << p_source.filename << " with error: "
+                  << static_cast<int>(p_source.mmf->GetLastError()) << std::endl;
+        p_source.failed = true;
+      }
+      batch.last = true;
+      break;
+    }
+    if (!MktData::IsDataLine(*line)) continue; // Header or empty line
+    if (filter) {
+      if (filter->IsPastEnd(MktData::GetTimestampField(*line))) {
+        batch.last = true;
+        break;
+      }
+      if (!filter->AcceptsLine(*line)) continue;
+    }
+    batch.data.append(*line);
+    batch.data.push_back('\n');
+  }
+  if (batch.last) p_source.mmf.reset();
+  p_source.pending = std::move(batch);
+}
+
+void ThreadedMerge::ReaderLoop(size_t p_first, size_t p_step, std::optional<unsigned int> p_cpu) {
+  if (p_cpu && !PinCurrentThreadToCpu(*p_cpu)) {
+    std::cerr << "Failed to pin merge reader: " << p_first << " to cpu: " << *p_cpu << std::endl;
+  }
+  size_t active = 0;
+  for (size_t i = p_first; i < sources_.size(); i += p_step) active += !sources_[i].done;
+
+  int idle = 0;
+  while (active != 0 && !stop_flag_) {
+    bool progress = false;
+    for (size_t i = p_first; i < sources_.size(); i += p_step) {
+      auto& source = sources_[i];
+      if (source.done) continue;
+      if (!source.pending) ReadBatch(source);
+      const bool last = source.pending->last;
+      if (!source.ring->TryPush(std::move(*source.pending))) continue; // Merger is behind
+      source.pending.reset();
+      progress = true;
+      if (last) {
+        if (source.failed) read_failed_ = true;
+        source.done = true;
+        --active;
+      }
+    }
+    if (progress) {
+      idle = 0;
+    } else if (++idle < kIdleSpins) {
+      std::this_thread::yield();
+    } else {
+      ParkReader(p_first, p_step);
+      idle = 0;
+    }
+  }
+  // Stopped early, the merger must not wait for batches that never come
+  for (size_t i = p_first; i < sources_.size(); i += p_step) {
+    if (sources_[i].ring) sources_[i].ring->Close();
+  }
+}
+
+void ThreadedMerge::ParkReader(size_t p_first, size_t p_step) {
+  auto& park = parks_[p_first];
+  const auto ready = [&] {
+    if (stop_flag_) return true;
+    for (size_t i = p_first; i < sources_.size(); i += p_step) {
+      if (!sources_[i].done && sources_[i].ring->HasRoom()) return true;
+    }
+    return false;
+  };
+  std::unique_lock<std::mutex> lock(park.mutex);
+  park.parked.store(true, std::memory_order_seq_cst);
+  park.cv.wait(lock, ready);
+  park.parked.store(false, std::memory_order_relaxed);
+}
+
+void ThreadedMerge::WakeReader(size_t p_index) {
+  auto& park = parks_[p_index % reader_threads_];
+  if (!park.parked.load(std::memory_order_seq_cst)) return;
+  std::lock_guard<std::mutex> lock(park.mutex);
+  park.cv.notify_one();
+}
+
+bool ThreadedMerge::Advance(size_t p_index) {
+  auto& cursor = cursors_[p_index];
+  for (;;) {
+    if (cursor.pos < cursor.batch.data.size()) {
+      const char* begin = cursor.batch.data.data() + cursor.pos;
+      const auto* newline = static_cast<const char*>(
+        std::memchr(begin, '\n', cursor.batch.data.size() - cursor.pos));
+      cursor.line = std::string_view(begin, static_cast<size_t>(newline - begin));
+      cursor.timestamp = MktData::GetTimestampField(cursor.line);
+      cursor.pos += cursor.line.size() + 1;
+      return true;
+    }
+    if (cursor.batch.last) return false;
+    auto& source = sources_[p_index];
+    auto next = source.ring->Pop();
+    if (!next) return false; // Stopped
+    WakeReader(p_index); // The ring has room again
+    cursor.batch.data.clear();
+    source.recycled->TryPush(std::move(cursor.batch.data)); // Dropped if full
+    cursor.batch = std::move(*next);
+    cursor.pos = 0;
+  }
+}
+
+bool ThreadedMerge::HeapGreater(size_t p_lhs, size_t p_rhs) const {
+  const auto& lhs = cursors_[p_lhs];
+  const auto& rhs = cursors_[p_rhs];
+  if (lhs.timestamp != rhs.timestamp) return lhs.timestamp > rhs.timestamp;
+  return sources_[p_lhs].symbol > sources_[p_rhs].symbol;
+}
+
+void ThreadedMerge::StopReaders() {
+  stop_flag_ = true;
+  for (size_t t = 0; parks_ && t < reader_threads_; ++t) {
+    std::lock_guard<std::mutex> lock(parks_[t].mutex);
+    parks_[t].cv.notify_one();
+  }
+  for (auto& reader : readers_) {
+    if (reader.joinable()) reader.join();
+  }
+  readers_.clear();
+}
+
+bool ThreadedMerge::Run() {
+  // The merger and its output buffer on the node the readers fill first
+  const ScopedNodePin pin(options_.pin_threads ? std::optional(options_.preferred_node)
+                                               : std::nullopt);
+  FileWriter writer(output_, FileWriter::OpenMode::Truncate, options_.output_buffer_size);
+  if (!writer.IsValid()) {
+    std::cerr << "Failed to open output file: " << output_ << std::endl;
+    return false;
+  }
+
+  ApplyMemoryBudget();
+  sources_.clear();
+  sources_.resize(inputs_.size());
+  cursors_.clear();
+  cursors_.resize(inputs_.size());
+  size_t active = 0;
+  for (size_t i = 0; i < inputs_.size(); ++i) {
+    sources_[i].filename = inputs_[i];
+    sources_[i].symbol = MktData::GetSymbolFromFilename(inputs_[i]);
+    if (!OpenSource(sources_[i])) return false;
+    active += !sources_[i].done;
+  }
+
+  size_t threads = options_.reader_threads;
+  if (threads == 0) threads = std::max<size_t>(GetCpuCoreCount(), 1);
+  threads = std::max<size_t>(std::min(threads, active), 1);
+  reader_threads_ = threads;
+  parks_ = std::make_unique<ReaderPark[]>(threads);
+  std::vector<unsigned int> cpus;
+  if (options_.pin_threads) cpus = PlanCpuPlacement(threads, options_.preferred_node);
+  std::cout << "Merging: " << active << " inputs into: " << output_ << " with: "
+            << threads << " reader threads" << std::endl;
+  for (size_t t = 0; t < threads; ++t) {
+    std::optional<unsigned int> cpu;
+    if (!cpus.empty()) cpu = cpus[t];
+    readers_.emplace_back(&ThreadedMerge::ReaderLoop, this, t, threads, cpu);
+  }
+
+  writer.WriteLine(MergeJob::kOutputHeader);
+  const auto greater = [this](size_t a, size_t b) { return HeapGreater(a, b); };
+  heap_.clear();
+  for (size_t i = 0; i < sources_.size(); ++i) {
+    if (!sources_[i].ring || !Advance(i)) continue;
+    heap_.push_back(i);
+    std::push_heap(heap_.begin(), heap_.end(), greater);
+  }
+  while (!heap_.empty() && !stop_flag_) {
+    std::pop_heap(heap_.begin(), heap_.end(), greater);
+    const size_t index = heap_.back();
+    heap_.pop_back();
+    writer.Write(sources_[index].symbol);
+    writer.Write(", ");
+    writer.WriteLine(cursors_[index].line);
+    ++records_written_;
+    if (Advance(index)) {
+      heap_.push_back(index);
+      std::push_heap(heap_.begin(), heap_.end(), greater);
+    }
+  }
+  StopReaders();
+  if (read_failed_) return false;
+  if (writer.Flush() != FileWriter::Error::None || writer.GetLastError() != FileWriter::Error::None) {
+    std::cerr << "Failed to write output file: " << output_ << std::endl;
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,131 @@
+#ifndef ThreadedMerge_hpp
+#define ThreadedMerge_hpp
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "FileWriter.hpp"
+#include "InputFilter.hpp"
+#include "Mmf.hpp"
+#include "SPSCRing.hpp"
+
+namespace sp {
+  struct ThreadedMergeOptions {
+    // Reader threads sharing the inputs, 0 uses one per core up to one per
+    // input
+    size_t reader_threads = 0;
+    // Lines travel to the merger in batches of about this many bytes, and
+    // each input may be ring_batches batches ahead of the merger. 0 derives
+    // batch_bytes from the MemoryBudget queue stage split over the inputs.
+    size_t batch_bytes = 0;
+    size_t ring_batches = 4;
+    // Per input MMF window, 0 derives it from the MemoryBudget read stage
+    size_t read_window = 0;
+    size_t output_buffer_size = FileWriter::kDefaultBufferSize;
+    // Pin the reader threads to the cpus PlanCpuPlacement picks, filling
+    // preferred_node first, and the merging thread to preferred_node for
+    // the duration of Run()
+    bool pin_threads = false;
+    unsigned int preferred_node = 0;
+    InputFilter filter;
+  };
+
+  // The same merge as MergeJob with the reading and line splitting done on
+  // reader threads. Every input has its own SPSCRing of line batches to the
+  // merging thread, produced by the one reader thread that owns the input,
+  // so readers never contend with each other, each ring is the ordered
+  // stream of one symbol and the merger pops from the ring of whichever
+  // input is at the top of its heap. No checkpoints, incremental or follow
+  // mode, use MergeJob for those.
+  class ThreadedMerge {
+  public:
+    using Options = ThreadedMergeOptions;
+
+    ThreadedMerge(std::vector<std::string> p_inputs, std::string p_output,
+                  Options p_options = {});
+    ~ThreadedMerge();
+
+    ThreadedMerge(const ThreadedMerge&) = delete;
+    ThreadedMerge& operator=(const ThreadedMerge&) = delete;
+
+    // Merges everything (until Stop()), false on any error
+    bool Run();
+    void Stop() { stop_flag_ = true; }
+
+    size_t GetRecordsWritten() const { return records_written_; }
+    size_t GetReaderThreads() const { return reader_threads_; }
+    // With the sizes derived by Run() filled in
+    const Options& GetOptions() const { return options_; }
+
+  private:
+    // Complete lines, each ending with '\n'
+    struct LineBatch {
+      std::string data;
+      bool last = false; // No batches follow
+    };
+
+    // Reader side of one input
+    struct Source {
+      std::string filename;
+      std::string symbol;
+      std::unique_ptr<SPSCRing<LineBatch>> ring;      // Reader -> merger
+      std::unique_ptr<SPSCRing<std::string>> recycled; // Consumed buffers back
+      std::unique_ptr<MMF> mmf;
+      std::optional<LineBatch> pending; // Ring was full
+      bool done = false;
+      bool failed = false;
+    };
+
+    // A reader whose rings are all full parks here until the merger pops
+    // from one of them, with the parked flag handshake of SPSCRing
+    struct ReaderPark {
+      std::mutex mutex;
+      std::condition_variable cv;
+      std::atomic<bool> parked{false};
+    };
+
+    // Merger side of one input
+    struct Cursor {
+      LineBatch batch;
+      size_t pos = 0;             // Start of the line after the head
+      std::string_view line;      // Head line without '\n'
+      std::string_view timestamp;
+    };
+
+    // Fills in the sizes left at 0 in options_
+    void ApplyMemoryBudget();
+    bool OpenSource(Source& p_source);
+    // Reads the next batch of p_source into its pending slot
+    void ReadBatch(Source& p_source);
+    void ReaderLoop(size_t p_first, size_t p_step, std::optional<unsigned int> p_cpu);
+    // Blocks reader p_first until one of its rings has room or Stop()
+    void ParkReader(size_t p_first, size_t p_step);
+    void WakeReader(size_t p_index);
+    // Next head line of input p_index, false once it is exhausted
+    bool Advance(size_t p_index);
+    bool HeapGreater(size_t p_lhs, size_t p_rhs) const;
+    void StopReaders();
+
+    std::vector<std::string> inputs_;
+    std::string output_;
+    Options options_;
+    std::vector<Source> sources_;
+    std::vector<Cursor> cursors_;
+    std::vector<size_t> heap_;
+    std::vector<std::thread> readers_;
+    std::unique_ptr<ReaderPark[]> parks_; // By reader
+    size_t records_written_ = 0;
+    size_t reader_threads_ = 0;
+    std::atomic<bool> stop_flag_{false};
+    std::atomic<bool> read_failed_{false};
+  };
+}// namespace sp
+
+#endif // ThreadedMerge_hpp
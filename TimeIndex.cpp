@@ -0,0 +1,130 @@
+#include "TimeIndex.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+using namespace sp;
+
+const TimeIndex::Entry* TimeIndex::FindBefore(int64_t p_millis) const {
+  const auto it = std::lower_bound(
+    entries.begin(), entries.end(), p_millis,
+    [](const Entry& p_entry, int64_t p_value) { return p_entry.millis < p_value; });
+  return it == entries.begin() ? nullptr : &*(it - 1);
+}
+
+void TimeIndex::Truncate(uint64_t p_length) {
+  const auto it = std::lower_bound(
+    entries.begin(), entries.end(), p_length,
+    [](const Entry& p_entry, uint64_t p_value) { return p_entry.offset < p_value; });
+  entries.erase(it, entries.end());
+}
+
+bool TimeIndex::Save(const std::string& p_path) const {
+  std::string bytes;
+  bytes.reserve(kMagic.size() + sizeof(output) + entries.size() * sizeof(Entry));
+  bytes.append(kMagic);
+  bytes.append(reinterpret_cast<const char*>(&output), sizeof(output));
+  bytes.append(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(Entry));
+  return WriteFileAtomically(p_path, bytes);
+}
+
+std::optional<TimeIndex> TimeIndex::Load(const std::string& p_path) {
+  std::ifstream in(p_path, std::ios::binary | std::ios::ate);
+  if (!in) return std::nullopt;
+  const auto size = static_cast<size_t>(in.tellg());
+  in.seekg(0);
+  constexpr size_t kHeaderSize = kMagic.size() + sizeof(OutputFingerprint);
+  char magic[kMagic.size()];
+  if (size < kHeaderSize || (size - kHeaderSize) % sizeof(Entry) != 0 ||
+      !in.read(magic, sizeof(magic)) || std::string_view(magic, sizeof(magic)) != kMagic) {
+    std::cerr << "Not a time index: " << p_path << std::endl;
+    return std::nullopt;
+  }
+  TimeIndex index;
+  index.entries.resize((size - kHeaderSize) / sizeof(Entry));
+  if (!in.read(reinterpret_cast<char*>(&index.output), sizeof(index.output)) ||
+      !in.read(reinterpret_cast<char*>(index.entries.data()),
+               static_cast<std::streamsize>(index.entries.size() * sizeof(Entry)))) {
+    std::cerr << "Failed to read time index: " << p_path << std::endl;
+    return std::nullopt;
+  }
+  return index;
+}
+
+IndexedOutputReader::IndexedOutputReader(const std::string& p_output, std::string p_index_path,
+                                         size_t p_window_size)
+  : output_(p_output),
+    window_size_(p_window_size) {
+  if (p_index_path.empty()) p_index_path = TimeIndex::GetPath(p_output);
+  auto index = TimeIndex::Load(p_index_path);
+  if (!index) {
+    std::cerr << "No time index: " << p_index_path << " for output: " << p_output << std::endl;
+    last_error_ = Error::IndexMissing;
+    return;
+  }
+  if (!index->output.Matches(p_output)) {
+    std::cerr << "Ignoring stale time index: " << p_index_path << ", output: " << p_output
+              << " was rewritten since" << std::endl;
+    return;
+  }
+  index_ = std::move(*index);
+}
+
+bool IndexedOutputReader::SeekToTime(std::string_view p_timestamp) {
+  if (last_error_ == Error::IndexMissing) return false;
+  const int64_t millis = MktData::TimestampToMillis(p_timestamp);
+  if (millis < 0) return false;
+
+  const auto* entry = index_.FindBefore(millis);
+  const size_t offset = entry ? entry->offset : 0;
+  ordinal_ = entry ? entry->ordinal : 0;
+  scanned_lines_ = 0;
+  pending_.reset();
+  mmf_ = std::make_unique<MMF>(output_, offset, window_size_);
+  if (!mmf_->IsValid()) {
+    std::cerr << "Failed to map output: " << output_ << " at: " << offset << " with error: "
+              << static_cast<int>(mmf_->GetLastError()) << std::endl;
+    last_error_ = Error::FileOpenFailed;
+    return false;
+  }
+  last_error_ = Error::None;
+  // Fixed width timestamps, plain string comparison orders them
+  while (const auto line = mmf_->ReadLineView(true)) {
+    const auto timestamp = MktData::GetField(*line, 1);
+    if (!MktData::IsDataLine(timestamp)) continue; // Header
+    if (timestamp >= p_timestamp) {
+      pending_ = line;
+      return true;
+    }
+    ++ordinal_;
+    ++scanned_lines_;
+  }
+  last_error_ = Error::EndOfFile;
+  return false;
+}
+
+std::optional<std::string_view> IndexedOutputReader::ReadLineView() {
+  if (pending_) {
+    const auto line = *pending_;
+    pending_.reset();
+    ++ordinal_;
+    return line;
+  }
+  if (!mmf_) {
+    if (last_error_ == Error::IndexMissing) return std::nullopt;
+    mmf_ = std::make_unique<MMF>(output_, 0, window_size_);
+    ordinal_ = 0;
+  }
+  if (!mmf_->IsValid()) {
+    last_error_ = Error::FileOpenFailed;
+    return std::nullopt;
+  }
+  while (const auto line = mmf_->ReadLineView(true)) {
+    if (!MktData::IsDataLine(MktData::GetField(*line, 1))) continue;
+    ++ordinal_;
+    return line;
+  }
+  last_error_ = Error::EndOfFile;
+  return std::nullopt;
+}
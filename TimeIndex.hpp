@@ -0,0 +1,140 @@
+#ifndef TimeIndex_hpp
+#define TimeIndex_hpp
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Checkpoint.hpp"
+#include "MktData.hpp"
+#include "Mmf.hpp"
+
+namespace sp {
+  // Sidecar of a merged output (<output>.tidx) mapping timestamps to output
+  // positions. An entry is added at the first record of every second and
+  // at least every record_interval records, so a reader starting at any
+  // time scans less than a second or record_interval records of output.
+  // Binary, host byte order: kMagic, the OutputFingerprint of the output it
+  // was saved with, then Entries.
+  struct TimeIndex {
+    struct Entry {
+      int64_t millis = 0;   // Timestamp of the record
+      uint64_t offset = 0;  // Output offset of its line
+      uint64_t ordinal = 0; // Records before it in the output
+    };
+    static_assert(sizeof(Entry) == 24);
+
+    static constexpr std::string_view kMagic{"SPTIDX02", 8};
+    static constexpr size_t kDefaultRecordInterval = 64 * 1024;
+
+    OutputFingerprint output;   // Output the entries refer to
+    std::vector<Entry> entries; // Sorted by offset, so by timestamp as well
+
+    // Last entry strictly before p_millis, nullptr if there is none and a
+    // reader has to start at the beginning of the output
+    const Entry* FindBefore(int64_t p_millis) const;
+    // Drops entries at or beyond p_length, e.g. when a resumed merge cuts
+    // its output back to the checkpoint
+    void Truncate(uint64_t p_length);
+
+    // Written with WriteFileAtomically
+    bool Save(const std::string& p_path) const;
+    static std::optional<TimeIndex> Load(const std::string& p_path);
+    static std::string GetPath(const std::string& p_output) { return p_output + ".tidx"; }
+  };
+
+  // Builds a TimeIndex as records are written. OnRecord() only compares the
+  // timestamp up to the seconds with the previous one and the ordinal with
+  // the next due one, so it costs next to nothing per record.
+  class TimeIndexWriter {
+  public:
+    explicit TimeIndexWriter(size_t p_record_interval = TimeIndex::kDefaultRecordInterval,
+                             TimeIndex p_index = {})
+      : record_interval_(p_record_interval == 0 ? TimeIndex::kDefaultRecordInterval
+                                                : p_record_interval),
+        index_(std::move(p_index)) {
+      if (!index_.entries.empty()) {
+        next_ordinal_ = index_.entries.back().ordinal + record_interval_;
+      }
+    }
+
+    // p_timestamp as in the output, e.g. "2021-03-05 10:00:00.123", p_offset
+    // where its line starts and p_ordinal the records written before it
+    void OnRecord(std::string_view p_timestamp, uint64_t p_offset, uint64_t p_ordinal) {
+      if (p_timestamp.size() < kSecondLength) return;
+      if (p_ordinal < next_ordinal_ &&
+          std::memcmp(p_timestamp.data(), second_, kSecondLength) == 0) {
+        return;
+      }
+      std::memcpy(second_, p_timestamp.data(), kSecondLength);
+      next_ordinal_ = p_ordinal + record_interval_;
+      index_.entries.push_back({MktData::TimestampToMillis(p_timestamp), p_offset, p_ordinal});
+    }
+
+    const TimeIndex& GetIndex() const { return index_; }
+    // The index with p_output as the output it refers to, ready to Save
+    const TimeIndex& Finish(const OutputFingerprint& p_output) {
+      index_.output = p_output;
+      return index_;
+    }
+
+  private:
+    static constexpr size_t kSecondLength = 19; // "2021-03-05 10:00:00"
+
+    size_t record_interval_;
+    TimeIndex index_;
+    uint64_t next_ordinal_ = 0;
+    char second_[kSecondLength] = {};
+  };
+
+  // Reads a merged output from a given time on: the TimeIndex gives the
+  // nearest indexed record before it, the MMF window is opened there and
+  // only the lines up to the first one at or after the start time are
+  // scanned. An index whose fingerprint no longer matches the output, e.g.
+  // left over from an earlier output at the same path, is ignored and the
+  // reader scans from the beginning.
+  class IndexedOutputReader {
+  public:
+    enum class Error {
+      None,
+      FileOpenFailed,
+      IndexMissing,
+      EndOfFile
+    };
+
+    // p_index_path empty uses TimeIndex::GetPath(p_output)
+    explicit IndexedOutputReader(const std::string& p_output, std::string p_index_path = {},
+                                 size_t p_window_size = 64 * 1024 * 1024);
+
+    bool IsValid() const { return last_error_ == Error::None || last_error_ == Error::EndOfFile; }
+    Error GetLastError() const { return last_error_; }
+    const TimeIndex& GetIndex() const { return index_; }
+
+    // Positions the reader at the first record whose timestamp is not
+    // before p_timestamp ("2021-03-05 14:00:00.000"), false if there is
+    // none or the output cannot be mapped there
+    bool SeekToTime(std::string_view p_timestamp);
+    // Next output line from the current position, header lines skipped
+    std::optional<std::string_view> ReadLineView();
+    // Records of the output before the next line ReadLineView returns
+    uint64_t GetRecordOrdinal() const { return ordinal_; }
+    // Output lines scanned by the last SeekToTime to reach the start time
+    size_t GetScannedLines() const { return scanned_lines_; }
+
+  private:
+    std::string output_;
+    size_t window_size_;
+    TimeIndex index_;
+    std::unique_ptr<MMF> mmf_;
+    std::optional<std::string_view> pending_; // First line found by SeekToTime
+    uint64_t ordinal_ = 0;
+    size_t scanned_lines_ = 0;
+    Error last_error_ = Error::None;
+  };
+}// namespace sp
+
+#endif // TimeIndex_hpp
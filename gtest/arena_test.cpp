@@ -0,0 +1,103 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <vector>
+#include "../Arena.hpp"
+#include "../MktDataMessage.hpp"
+
+using namespace sp;
+
+namespace {
+  // Upstream resource that counts how often the arena goes to the heap
+  class CountingResource : public std::pmr::memory_resource {
+  public:
+    size_t allocations = 0;
+    size_t deallocations = 0;
+
+  private:
+    void* do_allocate(size_t bytes, size_t alignment) override {
+      ++allocations;
+      return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+      ++deallocations;
+      std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+      return this == &other;
+    }
+  };
+}
+
+TEST(WindowArenaTest, AllocationsAreAligned) {
+  WindowArena arena(4096);
+  for (size_t alignment : {1, 2, 4, 8, 16, 64, 256}) {
+    arena.Allocate(3, 1);
+    void* p = arena.Allocate(24, alignment);
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(p) % alignment, 0u);
+  }
+}
+
+TEST(WindowArenaTest, CopyStringOutlivesSource) {
+  WindowArena arena(128);
+  std::string_view copy;
+  {
+    std::string line = "2021-03-05 10:00:00.123, 228.5, 120, NYSE, Ask";
+    copy = arena.CopyString(line);
+  }
+  EXPECT_EQ(copy, "2021-03-05 10:00:00.123, 228.5, 120, NYSE, Ask");
+  EXPECT_TRUE(arena.CopyString("").empty());
+}
+
+TEST(WindowArenaTest, ResetReusesBlocksWithoutUpstreamCalls) {
+  CountingResource upstream;
+  WindowArena arena(1024, &upstream);
+
+  for (int i = 0; i < 100; ++i) arena.CopyString(std::string(100, 'x'));
+  const size_t blocks = arena.GetBlockCount();
+  const size_t first_window_allocations = upstream.allocations;
+  EXPECT_GT(blocks, 1u);
+  EXPECT_GE(arena.GetBytesUsed(), 100u * 100u);
+
+  for (int window = 0; window < 10; ++window) {
+    arena.Reset();
+    EXPECT_EQ(arena.GetBytesUsed(), 0u);
+    for (int i = 0; i < 100; ++i) arena.CopyString(std::string(100, 'x'));
+  }
+  EXPECT_EQ(upstream.allocations, first_window_allocations);
+  EXPECT_EQ(arena.GetBlockCount(), blocks);
+  EXPECT_EQ(upstream.deallocations, 0u);
+}
+
+TEST(WindowArenaTest, OversizedBlocksAreReleasedOnReset) {
+  CountingResource upstream;
+  WindowArena arena(1024, &upstream);
+  arena.Allocate(64);
+  arena.Allocate(1024 * 1024);
+  EXPECT_EQ(arena.GetBlockCount(), 2u);
+  arena.Reset();
+  EXPECT_EQ(arena.GetBlockCount(), 1u);
+  EXPECT_EQ(upstream.deallocations, 1u);
+}
+
+TEST(WindowArenaTest, CreateConstructsInPlace) {
+  WindowArena arena;
+  auto symbol = arena.CopyString("MSFT");
+  auto line = arena.CopyString("2021-03-05 10:00:00.123, 228.5, 120, NYSE, Ask");
+  auto* msg = arena.Create<MktDataMessage>(symbol, line, 10);
+  EXPECT_EQ(msg->symbol_, "MSFT");
+  EXPECT_EQ(msg->batch_id_, 10u);
+}
+
+TEST(WindowArenaTest, PmrWindowBuffer) {
+  CountingResource upstream;
+  WindowArena arena(64 * 1024, &upstream);
+  pmr::WindowBuffer<int> buffer(&arena);
+  for (int i = 0; i < 1000; ++i) buffer.push_back(1000 - i);
+  std::sort(buffer.begin(), buffer.end());
+  EXPECT_EQ(buffer.front(), 1);
+  EXPECT_EQ(buffer.back(), 1000);
+  EXPECT_EQ(upstream.allocations, arena.GetBlockCount());
+}
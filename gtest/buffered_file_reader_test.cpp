@@ -0,0 +1,127 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../BufferedFileReader.hpp"
+#include "../ChunkedFileReader.hpp"
+
+using namespace sp;
+
+class BufferedFileReaderTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    test_dir_ = "test_buffered_files";
+    std::filesystem::remove_all(test_dir_);
+    std::filesystem::create_directory(test_dir_);
+  }
+
+  void TearDown() override {
+    std::filesystem::remove_all(test_dir_);
+  }
+
+  std::string WriteFile(const std::string& p_name, const std::string& p_content) {
+    const auto path = test_dir_ + "/" + p_name;
+    std::ofstream(path) << p_content;
+    return path;
+  }
+
+  // Lines of varying length so that many cross buffer boundaries
+  static std::string MakeLines(size_t p_count) {
+    std::string data;
+    for (size_t i = 0; i < p_count; ++i) {
+      data += "2021-03-05 10:00:00.123, " + std::to_string(i) + ", " +
+              std::string(i % 37, 'x') + ", NYSE, Ask\n";
+    }
+    return data;
+  }
+
+  static std::vector<std::string> SplitLines(const std::string& p_data) {
+    std::vector<std::string> lines;
+    std::istringstream in(p_data);
+    for (std::string line; std::getline(in, line);) lines.push_back(line);
+    return lines;
+  }
+
+  std::string test_dir_;
+};
+
+TEST_F(BufferedFileReaderTest, ReadsEveryLine) {
+  const auto data = MakeLines(5000);
+  const auto path = WriteFile("lines.txt", data);
+  for (size_t buffers : {2u, 3u, 8u}) {
+    BufferedFileReader reader(path, 0, 4096, buffers);
+    ASSERT_TRUE(reader.IsValid());
+    std::vector<std::string> lines;
+    while (auto line = reader.ReadLineView()) lines.emplace_back(*line);
+    EXPECT_EQ(reader.GetLastError(), BufferedFileReader::Error::EndOfFile);
+    EXPECT_EQ(lines, SplitLines(data)) << buffers << " buffers";
+    EXPECT_EQ(reader.GetPosition(), data.size());
+  }
+}
+
+TEST_F(BufferedFileReaderTest, OffsetAndUnterminatedLine) {
+  const auto path = WriteFile("tail.txt", "first\nsecond\n\nthird");
+  BufferedFileReader reader(path, 6, 4096);
+  auto line = reader.ReadLineView();
+  ASSERT_TRUE(line.has_value());
+  EXPECT_EQ(*line, "second");
+  EXPECT_EQ(reader.GetPosition(), 13u);
+  line = reader.ReadLineView();
+  ASSERT_TRUE(line.has_value());
+  EXPECT_EQ(*line, "");
+  line = reader.ReadLineView();
+  ASSERT_TRUE(line.has_value());
+  EXPECT_EQ(*line, "third");
+  EXPECT_FALSE(reader.ReadLineView().has_value());
+  EXPECT_EQ(reader.GetPosition(), 19u);
+}
+
+TEST_F(BufferedFileReaderTest, EmptyAndMissingFiles) {
+  const auto path = WriteFile("empty.txt", "");
+  BufferedFileReader empty(path);
+  ASSERT_TRUE(empty.IsValid());
+  EXPECT_FALSE(empty.ReadLineView().has_value());
+  EXPECT_EQ(empty.GetLastError(), BufferedFileReader::Error::EndOfFile);
+
+  BufferedFileReader missing(test_dir_ + "/missing.txt");
+  EXPECT_FALSE(missing.IsValid());
+  EXPECT_EQ(missing.GetLastError(), BufferedFileReader::Error::FileOpenFailed);
+  EXPECT_FALSE(missing.ReadLineView().has_value());
+}
+
+TEST_F(BufferedFileReaderTest, DestroyedBeforeTheEnd) {
+  const auto path = WriteFile("lines.txt", MakeLines(5000));
+  BufferedFileReader reader(path, 0, 4096, 2);
+  ASSERT_TRUE(reader.ReadLineView().has_value());
+  // The I/O thread is blocked on a full ring and must still be joined
+}
+
+TEST_F(BufferedFileReaderTest, ChunkedFileReaderBufferedRead) {
+  const auto data = MakeLines(3000);
+  const auto path = WriteFile("MSFT.txt", data);
+  QueueType queue;
+  WindowArena arena(1024 * 1024);
+  ChunkedFileReader reader(path, queue, 4096);
+  reader.SetBufferedRead(2);
+  reader.SetLineArena(&arena);
+  reader.Run();
+
+  std::vector<std::string> lines;
+  while (auto message = queue.TryDequeue()) {
+    EXPECT_EQ(message->symbol_, "MSFT");
+    lines.emplace_back(message->mkt_data_);
+  }
+  EXPECT_EQ(lines, SplitLines(data));
+}
+
+TEST_F(BufferedFileReaderTest, ChunkedFileReaderBufferedReadNeedsArena) {
+  const auto path = WriteFile("MSFT.txt", MakeLines(3000));
+  QueueType queue;
+  ChunkedFileReader reader(path, queue, 4096);
+  reader.SetBufferedRead(2);
+  reader.Run();
+  EXPECT_FALSE(queue.TryDequeue().has_value());
+}
@@ -0,0 +1,202 @@
+#include <gtest/gtest.h>
+#include <zlib.h>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "../CompressedFile.hpp"
+
+#ifdef SP_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+using namespace sp;
+
+class CompressedFileTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    test_dir_ = "test_compressed_files";
+    std::filesystem::remove_all(test_dir_);
+    std::filesystem::create_directory(test_dir_);
+    for (size_t i = 0; i < 20000; ++i) {
+      lines_.push_back("2021-03-05 10:00:00." + std::to_string(i % 1000) + ", 228.5, " +
+                       std::to_string(i) + ", NYSE, Ask");
+    }
+  }
+
+  void TearDown() override {
+    std::filesystem::remove_all(test_dir_);
+  }
+
+  static std::string Deflate(const std::string& p_data, int p_window_bits) {
+    z_stream stream{};
+    EXPECT_EQ(deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, p_window_bits, 8,
+                           Z_DEFAULT_STRATEGY), Z_OK);
+    std::string out(deflateBound(&stream, p_data.size()), '\0');
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(p_data.data()));
+    stream.avail_in = static_cast<uInt>(p_data.size());
+    stream.next_out = reinterpret_cast<Bytef*>(out.data());
+    stream.avail_out = static_cast<uInt>(out.size());
+    EXPECT_EQ(deflate(&stream, Z_FINISH), Z_STREAM_END);
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+    return out;
+  }
+
+  static void AppendLe(std::string& p_out, uint32_t p_value, size_t p_bytes) {
+    for (size_t i = 0; i < p_bytes; ++i) p_out.push_back(static_cast<char>(p_value >> (8 * i)));
+  }
+
+  // gzip member with a BGZF "BC" size field
+  static std::string BgzfMember(const std::string& p_data) {
+    const std::string compressed = Deflate(p_data, -MAX_WBITS);
+    std::string member("\x1f\x8b\x08\x04\0\0\0\0\0\xff", 10);
+    AppendLe(member, 6, 2);
+    member += "BC";
+    AppendLe(member, 2, 2);
+    AppendLe(member, static_cast<uint32_t>(12 + 6 + compressed.size() + 8 - 1), 2);
+    member += compressed;
+    AppendLe(member, crc32(0, reinterpret_cast<const Bytef*>(p_data.data()),
+                           static_cast<uInt>(p_data.size())), 4);
+    AppendLe(member, static_cast<uint32_t>(p_data.size()), 4);
+    return member;
+  }
+
+  // The lines in p_blocks members, split at arbitrary bytes
+  std::string WriteBgzf(size_t p_block_size) {
+    std::string text;
+    for (const auto& line : lines_) text += line + "\n";
+    std::string file;
+    for (size_t pos = 0; pos < text.size(); pos += p_block_size) {
+      file += BgzfMember(text.substr(pos, p_block_size));
+    }
+    file += BgzfMember(""); // EOF marker block
+    const std::string path = test_dir_ + "/bgzf.gz";
+    std::ofstream(path, std::ios::binary) << file;
+    return path;
+  }
+
+  void ExpectLines(CompressedFile& p_file) {
+    size_t count = 0;
+    while (auto line = p_file.ReadLineView()) {
+      ASSERT_LT(count, lines_.size());
+      ASSERT_EQ(*line, lines_[count]);
+      ++count;
+    }
+    EXPECT_EQ(count, lines_.size());
+    EXPECT_EQ(p_file.GetLastError(), CompressedFile::Error::EndOfFile);
+  }
+
+  std::string test_dir_;
+  std::vector<std::string> lines_;
+};
+
+TEST_F(CompressedFileTest, ParallelBgzfMembers) {
+  const auto path = WriteBgzf(7919); // Lines straddle members
+  EXPECT_EQ(CompressedFile::DetectFormat(path), CompressedFile::Format::Gzip);
+  CompressedFile file(path, 3);
+  ASSERT_TRUE(file.IsValid());
+  EXPECT_GT(file.GetFrameCount(), 100u);
+  ExpectLines(file);
+  EXPECT_FALSE(file.ReadLineView().has_value());
+}
+
+TEST_F(CompressedFileTest, SingleWorker) {
+  CompressedFile file(WriteBgzf(65536), 1, 1);
+  ASSERT_TRUE(file.IsValid());
+  ExpectLines(file);
+}
+
+TEST_F(CompressedFileTest, PlainGzipMembersInflateSequentially) {
+  std::string text;
+  for (const auto& line : lines_) text += line + "\n";
+  text.pop_back(); // Last line without newline
+  const size_t half = text.size() / 2;
+  const std::string path = test_dir_ + "/plain.gz";
+  std::ofstream(path, std::ios::binary) << Deflate(text.substr(0, half), 16 + MAX_WBITS)
+                                        << Deflate(text.substr(half), 16 + MAX_WBITS);
+  CompressedFile file(path);
+  ASSERT_TRUE(file.IsValid());
+  EXPECT_EQ(file.GetFrameCount(), 0u);
+  ExpectLines(file);
+}
+
+TEST_F(CompressedFileTest, ParallelZstdFrames) {
+#ifdef SP_HAVE_ZSTD
+  std::string text;
+  for (const auto& line : lines_) text += line + "\n";
+  std::string file;
+  size_t frames = 0;
+  for (size_t pos = 0; pos < text.size(); pos += 7919, ++frames) {
+    const auto block = text.substr(pos, 7919);
+    std::string frame(ZSTD_compressBound(block.size()), '\0');
+    const size_t size = ZSTD_compress(frame.data(), frame.size(), block.data(), block.size(), 3);
+    ASSERT_FALSE(ZSTD_isError(size));
+    file.append(frame.data(), size);
+  }
+  const std::string path = test_dir_ + "/frames.zst";
+  std::ofstream(path, std::ios::binary) << file;
+  EXPECT_EQ(CompressedFile::DetectFormat(path), CompressedFile::Format::Zstd);
+  CompressedFile zstd(path, 3);
+  ASSERT_TRUE(zstd.IsValid());
+  EXPECT_EQ(zstd.GetFrameCount(), frames);
+  ExpectLines(zstd);
+#else
+  GTEST_SKIP() << "Built without zstd";
+#endif
+}
+
+TEST_F(CompressedFileTest, Errors) {
+  CompressedFile missing(test_dir_ + "/missing.gz");
+  EXPECT_EQ(missing.GetLastError(), CompressedFile::Error::FileOpenFailed);
+  EXPECT_FALSE(missing.ReadLineView().has_value());
+
+  std::ofstream(test_dir_ + "/plain.txt") << "Timestamp, Price, Size, Exchange, Type\n";
+  EXPECT_EQ(CompressedFile::DetectFormat(test_dir_ + "/plain.txt"),
+            CompressedFile::Format::Unknown);
+  CompressedFile text(test_dir_ + "/plain.txt");
+  EXPECT_EQ(text.GetLastError(), CompressedFile::Error::UnsupportedFormat);
+
+  const std::string whole = Deflate(std::string(100000, 'x') + "\n", 16 + MAX_WBITS);
+  std::ofstream(test_dir_ + "/truncated.gz", std::ios::binary) << whole.substr(0, whole.size() / 2);
+  CompressedFile truncated(test_dir_ + "/truncated.gz");
+  ASSERT_TRUE(truncated.IsValid());
+  while (truncated.ReadLineView()) {}
+  EXPECT_EQ(truncated.GetLastError(), CompressedFile::Error::DecompressFailed);
+
+  std::ofstream(test_dir_ + "/empty.gz") << "";
+  CompressedFile empty(test_dir_ + "/empty.gz");
+  EXPECT_FALSE(empty.ReadLineView().has_value());
+}
+
+TEST_F(CompressedFileTest, DamagedBgzfSizes) {
+  const auto path = WriteBgzf(7919);
+  std::string file;
+  {
+    std::ifstream in(path, std::ios::binary);
+    file.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  }
+  // First member: 18 byte header, BSIZE at 16, ISIZE in its last 4 bytes
+  const size_t first = static_cast<unsigned char>(file[16]) +
+                       (static_cast<size_t>(static_cast<unsigned char>(file[17])) << 8) + 1;
+
+  // An ISIZE claiming 4 GiB must not size the buffer
+  std::string huge = file;
+  for (size_t i = first - 4; i < first; ++i) huge[i] = '\xff';
+  std::ofstream(test_dir_ + "/huge.gz", std::ios::binary) << huge;
+  CompressedFile claimed(test_dir_ + "/huge.gz", 2);
+  ASSERT_TRUE(claimed.IsValid());
+  while (claimed.ReadLineView()) {}
+  EXPECT_EQ(claimed.GetLastError(), CompressedFile::Error::DecompressFailed);
+
+  // A BSIZE smaller than the member header is no frame, the file is
+  // inflated sequentially instead
+  std::string tiny = file;
+  tiny[16] = 4;
+  tiny[17] = 0;
+  std::ofstream(test_dir_ + "/tiny.gz", std::ios::binary) << tiny;
+  CompressedFile sequential(test_dir_ + "/tiny.gz", 2);
+  ASSERT_TRUE(sequential.IsValid());
+  ExpectLines(sequential);
+}
@@ -0,0 +1,162 @@
+#include <gtest/gtest.h>
+#include <zlib.h>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../CompressedFile.hpp"
+#include "../CompressedWriter.hpp"
+
+using namespace sp;
+
+class CompressedWriterTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    test_dir_ = "test_compressed_writer_files";
+    std::filesystem::remove_all(test_dir_);
+    std::filesystem::create_directory(test_dir_);
+    output_ = test_dir_ + "/merged.txt.gz";
+    lines_.push_back("Symbol, Timestamp, Price, Size, Exchange, Type");
+    for (size_t i = 0; i < 50000; ++i) {
+      char line[96];
+      std::snprintf(line, sizeof(line), "SYM%zu, 2021-03-05 10:%02zu:%02zu.%03zu, 1.5, %zu, NYSE, Ask",
+                    i % 7, i / 60000, (i / 1000) % 60, i % 1000, i);
+      lines_.emplace_back(line);
+    }
+  }
+
+  void TearDown() override {
+    std::filesystem::remove_all(test_dir_);
+  }
+
+  std::string test_dir_;
+  std::string output_;
+  std::vector<std::string> lines_;
+};
+
+TEST_F(CompressedWriterTest, FramesRoundTripInOrder) {
+  {
+    CompressedWriter writer(output_, CompressedWriter::Format::Gzip, 3, 64 * 1024);
+    ASSERT_TRUE(writer.IsValid());
+    for (const auto& line : lines_) {
+      // Split like MergeJob writes a record
+      const auto comma = line.find(", ");
+      ASSERT_EQ(writer.Write(line.substr(0, comma)), CompressedWriter::Error::None);
+      ASSERT_EQ(writer.Write(", "), CompressedWriter::Error::None);
+      ASSERT_EQ(writer.WriteLine(std::string_view(line).substr(comma + 2)),
+                CompressedWriter::Error::None);
+    }
+    ASSERT_EQ(writer.Close(), CompressedWriter::Error::None);
+    EXPECT_GT(writer.GetFrameCount(), 10u);
+    EXPECT_LT(writer.GetLength(), writer.GetUncompressedLength() / 3);
+  }
+
+  CompressedFile file(output_, 2);
+  ASSERT_TRUE(file.IsValid());
+  EXPECT_GT(file.GetFrameCount(), 10u);
+  size_t count = 0;
+  while (auto line = file.ReadLineView()) {
+    ASSERT_LT(count, lines_.size());
+    ASSERT_EQ(*line, lines_[count]);
+    ++count;
+  }
+  EXPECT_EQ(count, lines_.size());
+
+  // Plain zlib sees one valid gzip stream of concatenated members
+  gzFile gz = gzopen(output_.c_str(), "rb");
+  ASSERT_NE(gz, nullptr);
+  char buffer[256];
+  ASSERT_NE(gzgets(gz, buffer, sizeof(buffer)), nullptr);
+  EXPECT_EQ(std::string(buffer), lines_[0] + "\n");
+  gzclose(gz);
+}
+
+TEST_F(CompressedWriterTest, FrameIndexSeeksByTime) {
+  {
+    CompressedWriter writer(output_, CompressedWriter::Format::Gzip, 2, 32 * 1024);
+    for (const auto& line : lines_) writer.WriteLine(line);
+  } // Closed by the destructor
+
+  const auto index = FrameIndex::Load(FrameIndex::GetPath(output_));
+  ASSERT_TRUE(index.has_value());
+  ASSERT_GT(index->frames.size(), 10u);
+  EXPECT_EQ(index->frames.front().compressed_offset, 0u);
+  EXPECT_EQ(index->frames.front().uncompressed_offset, 0u);
+  EXPECT_EQ(index->frames.front().first_key, "2021-03-05 10:00:00.000");
+  for (size_t i = 1; i < index->frames.size(); ++i) {
+    const auto& previous = index->frames[i - 1];
+    EXPECT_EQ(index->frames[i].compressed_offset,
+              previous.compressed_offset + previous.compressed_size);
+    EXPECT_LE(previous.first_key, index->frames[i].first_key);
+  }
+  EXPECT_EQ(index->FindFrame("2021-03-05 09:00:00.000"), 0u);
+
+  // Decompress only the frame the index points at
+  const std::string key = "2021-03-05 10:00:30.000";
+  const size_t frame_index = index->FindFrame(key);
+  ASSERT_GT(frame_index, 0u);
+  const auto& frame = index->frames[frame_index];
+  EXPECT_LT(frame.first_key, key);
+  ASSERT_LT(frame_index + 1, index->frames.size());
+  EXPECT_GE(index->frames[frame_index + 1].first_key, key);
+
+  std::ifstream in(output_, std::ios::binary);
+  std::string compressed(frame.compressed_size, '\0');
+  in.seekg(static_cast<std::streamoff>(frame.compressed_offset));
+  in.read(compressed.data(), static_cast<std::streamsize>(compressed.size()));
+  const std::string frame_file = test_dir_ + "/frame.gz";
+  std::ofstream(frame_file, std::ios::binary) << compressed;
+  CompressedFile part(frame_file, 1);
+  bool found = false;
+  while (auto line = part.ReadLineView()) {
+    found = found || line->find(key) != std::string_view::npos;
+  }
+  EXPECT_TRUE(found);
+  EXPECT_EQ(part.GetLastError(), CompressedFile::Error::EndOfFile);
+}
+
+TEST_F(CompressedWriterTest, ZstdFramesRoundTrip) {
+  const std::string path = test_dir_ + "/merged.txt.zst";
+  {
+    CompressedWriter writer(path, CompressedWriter::Format::Zstd, 2, 64 * 1024);
+#ifdef SP_HAVE_ZSTD
+    ASSERT_TRUE(writer.IsValid());
+    for (const auto& line : lines_) writer.WriteLine(line);
+    ASSERT_EQ(writer.Close(), CompressedWriter::Error::None);
+    EXPECT_GT(writer.GetFrameCount(), 10u);
+#else
+    EXPECT_EQ(writer.GetLastError(), CompressedWriter::Error::UnsupportedFormat);
+    GTEST_SKIP() << "Built without zstd";
+#endif
+  }
+
+  EXPECT_EQ(CompressedFile::DetectFormat(path), CompressedFile::Format::Zstd);
+  CompressedFile file(path, 2);
+  ASSERT_TRUE(file.IsValid());
+  EXPECT_GT(file.GetFrameCount(), 10u);
+  size_t count = 0;
+  while (auto line = file.ReadLineView()) {
+    ASSERT_LT(count, lines_.size());
+    ASSERT_EQ(*line, lines_[count]);
+    ++count;
+  }
+  EXPECT_EQ(count, lines_.size());
+}
+
+TEST_F(CompressedWriterTest, Errors) {
+  CompressedWriter missing(test_dir_ + "/no/such/dir.gz");
+  EXPECT_EQ(missing.GetLastError(), CompressedWriter::Error::FileOpenFailed);
+  EXPECT_NE(missing.WriteLine("x"), CompressedWriter::Error::None);
+  EXPECT_FALSE(FrameIndex::Load(test_dir_ + "/missing.fidx").has_value());
+}
+
+TEST_F(CompressedWriterTest, InvalidLevelFailsCompression) {
+  // deflateInit2 rejects the level, every frame reports the failure
+  CompressedWriter writer(output_, CompressedWriter::Format::Gzip, 2, 1024, 42);
+  ASSERT_TRUE(writer.IsValid());
+  for (const auto& line : lines_) writer.WriteLine(line);
+  EXPECT_EQ(writer.Close(), CompressedWriter::Error::CompressFailed);
+  EXPECT_EQ(writer.GetLength(), 0u);
+}
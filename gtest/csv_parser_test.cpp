@@ -0,0 +1,126 @@
+#include <gtest/gtest.h>
+#include <random>
+#include <string>
+#include <vector>
+#include "../CsvParser.hpp"
+#include "../Dictionary.hpp"
+#include "../MktData.hpp"
+
+using namespace sp;
+
+TEST(CsvParserTest, IndexMatchesScalar) {
+  std::mt19937 rng(42);
+  const std::string alphabet = "0123456789.:- ,\nABC";
+  std::vector<uint32_t> fast;
+  std::vector<uint32_t> reference;
+  for (size_t length : {0u, 1u, 15u, 63u, 64u, 65u, 127u, 128u, 1000u, 4099u}) {
+    std::string block(length, ' ');
+    for (auto& c : block) c = alphabet[rng() % alphabet.size()];
+    IndexStructurals(block, fast);
+    IndexStructuralsScalar(block, reference);
+    EXPECT_EQ(fast, reference) << "length " << length;
+  }
+}
+
+TEST(CsvParserTest, ParsesBothSeparators) {
+  const std::string block =
+    "Timestamp, Price, Size, Exchange, Type\n"
+    "2021-03-05 10:00:00.123, 228.5, 120, NYSE, Ask\n"
+    "2021-03-05 10:00:00.133,228.4,110,NASDAQ,Bid\r\n"
+    "\n"
+    "2021-03-05 10:00:00.134, 228.5, 120, NYSE_ARCA\n"     // Field missing
+    "2021-03-05 10:00:00.135, 228.5, 12x, NYSE, TRADE\n"   // Bad size
+    "2021-03-05 10:00:00.135, 22.8.5, 12, NYSE, TRADE\n"   // Bad price
+    "2021-03-05 10:00:00.136, 228.6, 7, NYSE, TRADE\n"
+    "2021-03-05 10:00:00.137, 228";                        // Unterminated
+  CsvBatchParser parser;
+  std::vector<MktDataRecord> records;
+  const size_t consumed = parser.Parse(block, records);
+  EXPECT_EQ(consumed, block.rfind('\n') + 1);
+  EXPECT_EQ(parser.GetRejectedLines(), 5u);
+  EXPECT_EQ(parser.GetDroppedDataLines(), 3u); // Not the header and empty line
+  ASSERT_EQ(records.size(), 3u);
+
+  EXPECT_EQ(records[0].timestamp, MktData::TimestampToMillis("2021-03-05 10:00:00.123"));
+  EXPECT_EQ(records[0].price, 228500000);
+  EXPECT_EQ(records[0].price_decimals, 1u);
+  EXPECT_EQ(records[0].size, 120u);
+  EXPECT_EQ(GetExchangeDictionary().Decode(records[0].exchange), "NYSE");
+  EXPECT_EQ(GetTypeDictionary().Decode(records[0].type), "Ask");
+
+  EXPECT_EQ(records[1].timestamp - records[0].timestamp, 10);
+  EXPECT_EQ(records[1].price, 228400000);
+  EXPECT_EQ(records[1].size, 110u);
+  EXPECT_EQ(GetExchangeDictionary().Decode(records[1].exchange), "NASDAQ");
+  EXPECT_EQ(GetTypeDictionary().Decode(records[1].type), "Bid");
+
+  EXPECT_EQ(records[2].size, 7u);
+  EXPECT_EQ(records[2].type, GetTypeDictionary().Find("TRADE"));
+}
+
+TEST(CsvParserTest, DropsMalformedTimestamps) {
+  const std::string block =
+    "2021-03-05 10:00:00.123, 228.5, 1, NYSE, Ask\n"
+    "2021-03-05 10:00:00.1239, 228.5, 2, NYSE, Ask\n"    // Too long
+    "2021-03-05 10:00:00.12, 228.5, 3, NYSE, Ask\n"      // Too short
+    "2021-03-05T10:00:00.123Z, 228.5, 4, NYSE, Ask\n"    // Other separators
+    "2021-03-05T10:00:00.123, 228.5, 5, NYSE, Ask\n"
+    "2021-03-05 10:0a:00.123, 228.5, 6, NYSE, Ask\n"     // Not a digit
+    "2021-03-05 10:00:00/123, 228.5, 7, NYSE, Ask\n"
+    "2021-13-05 10:00:00.123, 228.5, 8, NYSE, Ask\n"     // No such month
+    "2021-02-30 10:00:00.123, 228.5, 9, NYSE, Ask\n"     // No such day
+    "2021-03-05 24:00:00.000, 228.5, 10, NYSE, Ask\n"    // No such hour
+    "2021-03-05 10:60:00.000, 228.5, 11, NYSE, Ask\n"
+    "2020-02-29 23:59:59.999, 228.5, 12, NYSE, Ask\n";   // Leap day
+  CsvBatchParser parser;
+  std::vector<MktDataRecord> records;
+  parser.Parse(block, records);
+  EXPECT_EQ(parser.GetDroppedDataLines(), 10u);
+  ASSERT_EQ(records.size(), 2u);
+  EXPECT_EQ(records[0].size, 1u);
+  EXPECT_EQ(records[1].size, 12u);
+
+  EXPECT_TRUE(MktData::IsTimestamp("2021-03-05 10:00:00.123"));
+  EXPECT_FALSE(MktData::IsTimestamp("2021-03-05 10:00:00.1239"));
+  EXPECT_FALSE(MktData::IsTimestamp("2021-03-05T10:00:00.123Z"));
+  EXPECT_FALSE(MktData::IsTimestamp(""));
+}
+
+TEST(CsvParserTest, CarriesTailAcrossBlocks) {
+  std::string data;
+  for (size_t i = 0; i < 1000; ++i) {
+    data += "2021-03-05 10:00:00." + std::to_string(100 + i % 900) + ", 1.25, " +
+            std::to_string(i) + ", NYSE, Ask\n";
+  }
+  CsvBatchParser parser;
+  std::vector<MktDataRecord> records;
+  std::string carry;
+  for (size_t pos = 0; pos < data.size(); pos += 777) {
+    const std::string block = carry + data.substr(pos, 777);
+    carry = block.substr(parser.Parse(block, records));
+  }
+  EXPECT_TRUE(carry.empty());
+  EXPECT_EQ(parser.GetRejectedLines(), 0u);
+  ASSERT_EQ(records.size(), 1000u);
+  for (size_t i = 0; i < records.size(); ++i) EXPECT_EQ(records[i].size, i);
+}
+
+TEST(CsvParserTest, FormatsRecordsBack) {
+  const std::string block =
+    "2021-03-05 10:00:00.123, 228.5, 120, NYSE, Ask\n"
+    "2021-03-05 23:59:59.999, 46.10, 7, DARK_POOL_7, Bid\n"   // Unseen venue
+    "1999-12-31 00:00:00.000, 12, 0, NSX, TRADE\n";
+  CsvBatchParser parser;
+  std::vector<MktDataRecord> records;
+  parser.Parse(block, records);
+  ASSERT_EQ(records.size(), 3u);
+  EXPECT_EQ(GetExchangeDictionary().Decode(records[1].exchange), "DARK_POOL_7");
+
+  std::string formatted;
+  char line[256];
+  for (const auto& record : records) formatted.append(line, FormatRecord("MSFT", record, line));
+  EXPECT_EQ(formatted,
+            "MSFT, 2021-03-05 10:00:00.123, 228.5, 120, NYSE, Ask\n"
+            "MSFT, 2021-03-05 23:59:59.999, 46.10, 7, DARK_POOL_7, Bid\n"
+            "MSFT, 1999-12-31 00:00:00.000, 12, 0, NSX, TRADE\n");
+}
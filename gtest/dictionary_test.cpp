@@ -0,0 +1,63 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../Dictionary.hpp"
+
+using namespace sp;
+
+TEST(DictionaryTest, KnownNamesGetFixedCodes) {
+  CodeDictionary dictionary({"NYSE", "NASDAQ", "NYSE_ARCA", "NSX"}, 256);
+  EXPECT_EQ(dictionary.GetKnownSize(), 4u);
+  EXPECT_EQ(dictionary.Encode("NYSE"), 0u);
+  EXPECT_EQ(dictionary.Encode("NASDAQ"), 1u);
+  EXPECT_EQ(dictionary.Find("NYSE_ARCA"), 2u);
+  EXPECT_EQ(dictionary.Decode(3), "NSX");
+  EXPECT_EQ(dictionary.GetSize(), 4u);
+  // Prefixes and case variants are not known names
+  EXPECT_EQ(dictionary.Find("NYS"), CodeDictionary::kInvalidCode);
+  EXPECT_EQ(dictionary.Find("nyse"), CodeDictionary::kInvalidCode);
+}
+
+TEST(DictionaryTest, UnseenNamesAreAppended) {
+  CodeDictionary dictionary({"Ask", "Bid"}, 4);
+  EXPECT_EQ(dictionary.Find("TRADE"), CodeDictionary::kInvalidCode);
+  EXPECT_EQ(dictionary.Encode("TRADE"), 2u);
+  EXPECT_EQ(dictionary.Encode("TRADE"), 2u);
+  EXPECT_EQ(dictionary.Find("TRADE"), 2u);
+  EXPECT_EQ(dictionary.Decode(2), "TRADE");
+  EXPECT_EQ(dictionary.Encode("CANCEL"), 3u);
+  // Full
+  EXPECT_EQ(dictionary.Encode("CORRECTION"), CodeDictionary::kInvalidCode);
+  EXPECT_EQ(dictionary.Decode(4), "");
+  EXPECT_EQ(dictionary.GetSize(), 4u);
+}
+
+TEST(DictionaryTest, ConcurrentEncodeAgrees) {
+  CodeDictionary dictionary({"NYSE"}, CodeDictionary::kInvalidCode);
+  constexpr size_t kThreads = 4;
+  std::vector<std::vector<CodeDictionary::Code>> codes(kThreads);
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&dictionary, &codes, t] {
+      for (int i = 0; i < 200; ++i) codes[t].push_back(dictionary.Encode("X" + std::to_string(i)));
+    });
+  }
+  for (auto& thread : threads) thread.join();
+  EXPECT_EQ(dictionary.GetSize(), 201u);
+  for (size_t t = 1; t < kThreads; ++t) EXPECT_EQ(codes[t], codes[0]);
+  for (int i = 0; i < 200; ++i) EXPECT_EQ(dictionary.Decode(codes[0][i]), "X" + std::to_string(i));
+}
+
+TEST(DictionaryTest, GlobalDictionaries) {
+  auto& exchanges = GetExchangeDictionary();
+  for (const char* name : {"NYSE", "NASDAQ", "NYSE_ARCA", "NSX"}) {
+    const auto code = exchanges.Find(name);
+    ASSERT_LT(code, exchanges.GetKnownSize()) << name;
+    EXPECT_EQ(exchanges.Decode(code), name);
+  }
+  auto& types = GetTypeDictionary();
+  EXPECT_EQ(types.Decode(types.Find("Ask")), "Ask");
+  EXPECT_EQ(types.Decode(types.Find("Bid")), "Bid");
+  EXPECT_EQ(types.Decode(types.Find("TRADE")), "TRADE");
+}
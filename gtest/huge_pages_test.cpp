@@ -0,0 +1,65 @@
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <cstring>
+#include "../Arena.hpp"
+#include "../HugePages.hpp"
+
+using namespace sp;
+
+namespace {
+  constexpr size_t kMiB = 1024 * 1024;
+}
+
+TEST(HugePagesTest, TransparentBufferIsUsable) {
+  const auto before = GetHugePageStats();
+  size_t mapped = 0;
+  void* buffer = AllocateHugePageBuffer(3 * kMiB, HugePageMode::Transparent, &mapped);
+  ASSERT_NE(buffer, nullptr);
+  EXPECT_GE(mapped, 3 * kMiB);
+  std::memset(buffer, 0xAB, mapped);
+
+  const auto stats = GetHugePageStats();
+  EXPECT_EQ(stats.requested_bytes, before.requested_bytes + 3 * kMiB);
+  EXPECT_LE(stats.transparent_bytes, mapped + before.transparent_bytes);
+  EXPECT_LE(GetTransparentHugePageBytes(buffer, mapped), mapped);
+  FreeHugePageBuffer(buffer, mapped);
+
+  // Live buffers only, freeing gives the bytes back
+  const auto after = GetHugePageStats();
+  EXPECT_EQ(after.requested_bytes, before.requested_bytes);
+  EXPECT_EQ(after.fallback_bytes, before.fallback_bytes);
+}
+
+TEST(HugePagesTest, ExplicitFallsBackGracefully) {
+  size_t mapped = 0;
+  void* buffer = AllocateHugePageBuffer(kMiB, HugePageMode::Explicit, &mapped);
+  ASSERT_NE(buffer, nullptr);
+  static_cast<char*>(buffer)[0] = 1;
+  static_cast<char*>(buffer)[mapped - 1] = 1;
+  const auto stats = GetHugePageStats();
+  if (stats.explicit_pages == 0) {
+    // No hugetlb pool here, must have come from THP or regular pages
+    EXPECT_EQ(mapped % 4096, 0u);
+  }
+  FreeHugePageBuffer(buffer, mapped);
+}
+
+TEST(HugePagesTest, NoneModeIsNotCountedAsRequested) {
+  const auto before = GetHugePageStats();
+  size_t mapped = 0;
+  void* buffer = AllocateHugePageBuffer(10000, HugePageMode::None, &mapped);
+  ASSERT_NE(buffer, nullptr);
+  EXPECT_EQ(mapped % 4096, 0u);
+  EXPECT_EQ(GetHugePageStats().requested_bytes, before.requested_bytes);
+  FreeHugePageBuffer(buffer, mapped);
+}
+
+TEST(HugePagesTest, ArenaOnHugePageResource) {
+  HugePageMemoryResource upstream;
+  WindowArena arena(4 * kMiB, &upstream);
+  for (int i = 0; i < 1000; ++i) {
+    auto view = arena.CopyString("2021-03-05 10:00:00.123, 228.5, 120, NYSE, Ask");
+    ASSERT_EQ(view.size(), 46u);
+  }
+  EXPECT_EQ(arena.GetBlockCount(), 1u);
+}
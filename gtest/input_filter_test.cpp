@@ -0,0 +1,209 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+#include "../Dictionary.hpp"
+#include "../InputFilter.hpp"
+#include "../MktData.hpp"
+
+using namespace sp;
+
+class InputFilterTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    test_dir_ = "test_filter_files";
+    std::filesystem::remove_all(test_dir_);
+    std::filesystem::create_directory(test_dir_);
+  }
+
+  void TearDown() override {
+    std::filesystem::remove_all(test_dir_);
+  }
+
+  // One line per second from 10:00:00
+  static std::string MakeInput(size_t p_lines) {
+    std::string data = "Timestamp, Price, Size, Exchange, Type\n";
+    for (size_t i = 0; i < p_lines; ++i) {
+      char line[96];
+      std::snprintf(line, sizeof(line), "2021-03-05 10:%02zu:%02zu.000, 1.0, %zu, NYSE, Ask\n",
+                    i / 60, i % 60, i);
+      data += line;
+    }
+    return data;
+  }
+
+  std::string test_dir_;
+};
+
+TEST_F(InputFilterTest, AcceptsLines) {
+  InputFilter filter;
+  EXPECT_TRUE(filter.IsEmpty());
+  EXPECT_TRUE(filter.AcceptsSymbol("ANY"));
+  EXPECT_TRUE(filter.AcceptsLine("2021-03-05 10:00:00.123, 228.5, 120, NYSE, Ask"));
+
+  filter.SetSymbols({"MSFT", "CSCO"})
+        .SetTimeRange("2021-03-05 10:00:00.000", "2021-03-05 11:30:00.000")
+        .SetTypes({"TRADE"})
+        .SetExchanges({"NYSE", "NYSE_ARCA"});
+  EXPECT_FALSE(filter.IsEmpty());
+  EXPECT_TRUE(filter.AcceptsSymbol("CSCO"));
+  EXPECT_FALSE(filter.AcceptsSymbol("AAPL"));
+
+  EXPECT_TRUE(filter.AcceptsLine("2021-03-05 10:00:00.133, 228.5, 120, NYSE, TRADE"));
+  EXPECT_TRUE(filter.AcceptsLine("2021-03-05 11:29:59.999, 228.5, 120, NYSE_ARCA, TRADE\r"));
+  EXPECT_FALSE(filter.AcceptsLine("2021-03-05 09:59:59.999, 228.5, 120, NYSE, TRADE"));
+  EXPECT_FALSE(filter.AcceptsLine("2021-03-05 11:30:00.000, 228.5, 120, NYSE, TRADE"));
+  EXPECT_FALSE(filter.AcceptsLine("2021-03-05 10:00:00.133, 228.5, 120, NASDAQ, TRADE"));
+  EXPECT_FALSE(filter.AcceptsLine("2021-03-05 10:00:00.133, 228.5, 120, NYSE, Ask"));
+  EXPECT_TRUE(filter.IsPastEnd("2021-03-05 11:30:00.000"));
+  EXPECT_FALSE(filter.IsPastEnd("2021-03-05 11:29:59.999"));
+}
+
+TEST_F(InputFilterTest, AcceptsRecords) {
+  InputFilter filter;
+  auto& exchanges = GetExchangeDictionary();
+  auto& types = GetTypeDictionary();
+  MktDataRecord record;
+  record.timestamp = MktData::TimestampToMillis("2021-03-05 10:00:00.133");
+  record.exchange = exchanges.Encode("NYSE");
+  record.type = static_cast<uint8_t>(types.Encode("TRADE"));
+  EXPECT_TRUE(filter.AcceptsRecord(record));
+
+  filter.SetTimeRange("2021-03-05 10:00:00.000", "2021-03-05 11:30:00.000")
+        .SetTypes({"TRADE"})
+        .SetExchanges({"NYSE", "VENUE_NOT_SEEN_YET"});
+  EXPECT_TRUE(filter.AcceptsRecord(record));
+
+  auto other = record;
+  other.timestamp = MktData::TimestampToMillis("2021-03-05 11:30:00.000");
+  EXPECT_FALSE(filter.AcceptsRecord(other));
+  other = record;
+  other.exchange = exchanges.Encode("NASDAQ");
+  EXPECT_FALSE(filter.AcceptsRecord(other));
+  other.exchange = exchanges.Encode("VENUE_NOT_SEEN_YET");
+  EXPECT_TRUE(filter.AcceptsRecord(other));
+  other = record;
+  other.type = static_cast<uint8_t>(types.Encode("Bid"));
+  EXPECT_FALSE(filter.AcceptsRecord(other));
+}
+
+TEST_F(InputFilterTest, TimeRangePrefixes) {
+  // Lines and records must agree on a shortened bound
+  InputFilter filter;
+  filter.SetTimeRange("2021-03-05 10:00", "2021-03-05 11");
+  ASSERT_TRUE(filter.IsValid());
+  EXPECT_EQ(filter.GetStartTime(), "2021-03-05 10:00:00.000");
+  for (const char* timestamp : {"2021-03-05 09:59:59.999", "2021-03-05 10:00:00.000",
+                                "2021-03-05 10:30:00.000", "2021-03-05 10:59:59.999",
+                                "2021-03-05 11:00:00.000"}) {
+    MktDataRecord record;
+    record.timestamp = MktData::TimestampToMillis(timestamp);
+    const bool line = filter.AcceptsLine(std::string(timestamp) + ", 1, 1, NYSE, Ask");
+    EXPECT_EQ(line, filter.AcceptsRecord(record)) << timestamp;
+    EXPECT_EQ(line, std::string_view(timestamp) >= "2021-03-05 10" &&
+                    std::string_view(timestamp) < "2021-03-05 11") << timestamp;
+  }
+  filter.SetTimeRange("2021-03", "");
+  EXPECT_EQ(filter.GetStartTime(), "2021-03-01 00:00:00.000");
+
+  // Not a timestamp: nothing passes, instead of lines and records disagreeing
+  for (const char* bad : {"10:00", "2021-03-05T10:00", "2021-13", "2021-03-05 10:00:00.0001"}) {
+    InputFilter invalid;
+    invalid.SetTimeRange(bad, "");
+    EXPECT_FALSE(invalid.IsValid()) << bad;
+    EXPECT_FALSE(invalid.IsEmpty()) << bad;
+    MktDataRecord record;
+    record.timestamp = MktData::TimestampToMillis("2021-03-05 10:30:00.000");
+    EXPECT_FALSE(invalid.AcceptsLine("2021-03-05 10:30:00.000, 1, 1, NYSE, Ask")) << bad;
+    EXPECT_FALSE(invalid.AcceptsRecord(record)) << bad;
+    EXPECT_TRUE(invalid.IsPastEnd("2021-03-05 10:30:00.000")) << bad;
+  }
+}
+
+TEST_F(InputFilterTest, SeekToTime) {
+  const auto data = MakeInput(600);
+  const std::string_view view(data);
+  const size_t header = view.find('\n') + 1;
+  const size_t line = view.find('\n', header) + 1 - header;
+  const size_t at_10_05 = view.find("2021-03-05 10:05:00.000");
+
+  EXPECT_EQ(SeekToTime(view, ""), header);
+  EXPECT_EQ(SeekToTime(view, "2021-03-05 09:00:00.000"), header);
+  EXPECT_EQ(SeekToTime(view, "2021-03-05 10:00:00.000"), header);
+  EXPECT_EQ(SeekToTime(view, "2021-03-05 10:00:00.001"), header + line);
+  EXPECT_EQ(SeekToTime(view, "2021-03-05 10:05:00.000"), at_10_05);
+  EXPECT_EQ(SeekToTime(view, "2021-03-05 10:04:59.500"), at_10_05);
+  EXPECT_EQ(SeekToTime(view, "2021-03-05 10:09:59.000"), view.rfind("2021-03-05"));
+  EXPECT_EQ(SeekToTime(view, "2021-03-05 11:00:00.000"), view.size());
+  EXPECT_EQ(SeekToTime(std::string_view(), "2021-03-05 10:00:00.000"), 0u);
+
+  // Same timestamp on many lines, the first one is found
+  const std::string repeated = "Timestamp, Price, Size, Exchange, Type\n"
+                               "2021-03-05 10:00:00.000, 1, 1, NYSE, Ask\n"
+                               "2021-03-05 10:00:00.001, 1, 2, NYSE, Ask\n"
+                               "2021-03-05 10:00:00.001, 1, 3, NYSE, Ask\n"
+                               "2021-03-05 10:00:00.001, 1, 4, NYSE, Ask\n"
+                               "2021-03-05 10:00:00.002, 1, 5, NYSE, Ask";
+  const auto offset = SeekToTime(repeated, "2021-03-05 10:00:00.001");
+  EXPECT_EQ(repeated.substr(offset, 40), "2021-03-05 10:00:00.001, 1, 2, NYSE, Ask");
+
+  const std::string file = test_dir_ + "/MSFT.txt";
+  std::ofstream(file) << data;
+  EXPECT_EQ(SeekFileToTime(file, "2021-03-05 10:05:00.000"), at_10_05);
+  EXPECT_FALSE(SeekFileToTime(test_dir_ + "/missing.txt", "").has_value());
+}
+
+TEST_F(InputFilterTest, SeekToTimeSkipsBlankLines) {
+  // Blank lines between data lines must not send the search past records
+  const auto at = [](int p_second) {
+    char timestamp[32];
+    std::snprintf(timestamp, sizeof(timestamp), "2021-03-05 10:00:%02d.000", p_second);
+    return std::string(timestamp);
+  };
+  std::mt19937 rng(11);
+  for (int layout = 0; layout < 2000; ++layout) {
+    std::string data = "Timestamp, Price, Size, Exchange, Type\n";
+    for (int i = 0; i < 12; ++i) {
+      while (rng() % 3 == 0) data += '\n';
+      data += at(1 + i) + ", 1, 1, NYSE, Ask\n";
+    }
+    while (rng() % 3 == 0) data += '\n';
+
+    for (int i = 0; i <= 13; ++i) {
+      const auto target = at(i);
+      const auto offset = SeekToTime(data, target);
+      // Every data line before the offset is early, the next one is not
+      const auto next = data.find("2021-03-05", offset);
+      if (next != std::string::npos) {
+        EXPECT_GE(MktData::GetTimestampField(std::string_view(data).substr(next)), target);
+      }
+      if (offset > 0) {
+        const auto previous = data.rfind("2021-03-05", offset - 1);
+        if (previous != std::string::npos) {
+          EXPECT_LT(MktData::GetTimestampField(std::string_view(data).substr(previous)), target);
+        }
+      }
+    }
+  }
+}
+
+TEST_F(InputFilterTest, ListInputFiles) {
+  for (const char* name : {"MSFT.txt", "CSCO.txt", "AAPL.txt"}) {
+    std::ofstream(test_dir_ + "/" + name) << MakeInput(1);
+  }
+  std::filesystem::create_directory(test_dir_ + "/nested");
+  for (const char* name : {"AAPL.txt.tidx", "AAPL.txt.sbm", "merged.ckpt", "merged.ckpt.tmp"}) {
+    std::ofstream(test_dir_ + "/" + name) << "not an input";
+  }
+
+  EXPECT_EQ(ListInputFiles(test_dir_),
+            (std::vector<std::string>{test_dir_ + "/AAPL.txt", test_dir_ + "/CSCO.txt",
+                                      test_dir_ + "/MSFT.txt"}));
+  InputFilter filter;
+  filter.SetSymbols({"MSFT", "CSCO", "IBM"});
+  EXPECT_EQ(ListInputFiles(test_dir_, filter),
+            (std::vector<std::string>{test_dir_ + "/CSCO.txt", test_dir_ + "/MSFT.txt"}));
+  EXPECT_TRUE(ListInputFiles(test_dir_ + "/missing").empty());
+}
@@ -0,0 +1,173 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "../InputScan.hpp"
+#include "../MktData.hpp"
+
+using namespace sp;
+
+class InputScanTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    test_dir_ = "test_input_scan";
+    std::filesystem::remove_all(test_dir_);
+    std::filesystem::create_directory(test_dir_);
+  }
+
+  void TearDown() override {
+    std::filesystem::remove_all(test_dir_);
+  }
+
+  // One line per second from p_first_second on
+  std::string WriteInput(const std::string& p_name, size_t p_first_second, size_t p_lines) {
+    const std::string path = test_dir_ + "/" + p_name;
+    std::ofstream out(path);
+    out << "Timestamp, Price, Size, Exchange, Type\n";
+    for (size_t i = p_first_second; i < p_first_second + p_lines; ++i) {
+      char line[96];
+      std::snprintf(line, sizeof(line), "2021-03-05 10:%02zu:%02zu.000, 1.0, %zu, NYSE, Ask\n",
+                    i / 60, i % 60, i);
+      out << line;
+    }
+    return path;
+  }
+
+  std::string test_dir_;
+};
+
+TEST_F(InputScanTest, SymbolTableAndSizes) {
+  WriteInput("MSFT.txt", 0, 10);
+  WriteInput("CSCO.txt", 0, 20);
+  WriteInput("AAPL.txt", 0, 5);
+  std::ofstream(test_dir_ + "/IBM.txt.gz") << "compressed";
+  std::filesystem::create_directory(test_dir_ + "/nested.txt");
+
+  const auto directory = ScanInputDirectory(test_dir_);
+  ASSERT_TRUE(directory.has_value());
+  EXPECT_EQ(directory->GetSymbols(), (std::vector<std::string>{"AAPL", "CSCO", "IBM", "MSFT"}));
+  EXPECT_EQ(directory->GetFilenames(),
+            (std::vector<std::string>{test_dir_ + "/AAPL.txt", test_dir_ + "/CSCO.txt",
+                                      test_dir_ + "/IBM.txt.gz", test_dir_ + "/MSFT.txt"}));
+  uint64_t total = 0;
+  for (const auto& file : directory->files) {
+    EXPECT_EQ(file.size, std::filesystem::file_size(file.filename));
+    EXPECT_TRUE(file.first_timestamp.empty());
+    total += file.size;
+  }
+  EXPECT_EQ(directory->total_bytes, total);
+  ASSERT_NE(directory->FindSymbol("IBM"), nullptr);
+  EXPECT_TRUE(directory->FindSymbol("IBM")->compressed);
+  EXPECT_EQ(directory->FindSymbol("ORCL"), nullptr);
+
+  InputScanOptions options;
+  options.filter.SetSymbols({"MSFT", "IBM", "ORCL"});
+  const auto filtered = ScanInputDirectory(test_dir_, options);
+  ASSERT_TRUE(filtered.has_value());
+  EXPECT_EQ(filtered->GetSymbols(), (std::vector<std::string>{"IBM", "MSFT"}));
+
+  EXPECT_FALSE(ScanInputDirectory(test_dir_ + "/missing").has_value());
+}
+
+TEST_F(InputScanTest, LeavesOutMergeOutputAndSidecars) {
+  WriteInput("MSFT.txt", 0, 10);
+  WriteInput("MSFT.txt.gz", 0, 10);
+  WriteInput("CSCO.txt", 0, 10);
+  WriteInput("merged.txt", 0, 20);
+  for (const char* name : {"merged.txt.tidx", "merged.txt.sbm", "merged.txt.fidx",
+                           "merged.ckpt", "merged.ckpt.tmp"}) {
+    std::ofstream(test_dir_ + "/" + name) << "not an input";
+  }
+  InputScanOptions options;
+  options.output = "./" + test_dir_ + "/merged.txt";
+  const auto directory = ScanInputDirectory(test_dir_, options);
+  ASSERT_TRUE(directory.has_value());
+  EXPECT_EQ(directory->GetFilenames(),
+            (std::vector<std::string>{test_dir_ + "/CSCO.txt", test_dir_ + "/MSFT.txt",
+                                      test_dir_ + "/MSFT.txt.gz"}));
+  // Two files for MSFT, ranks come from the symbol table
+  EXPECT_EQ(directory->GetSymbols(), (std::vector<std::string>{"CSCO", "MSFT"}));
+  EXPECT_EQ(directory->FindSymbol("MSFT")->filename, test_dir_ + "/MSFT.txt");
+}
+
+TEST_F(InputScanTest, ReadsFirstAndLastTimestamps) {
+  WriteInput("MSFT.txt", 5, 300); // Longer than a page
+  WriteInput("CSCO.txt", 0, 1);
+  {
+    // Unterminated last line, still being written
+    std::ofstream(WriteInput("AAPL.txt", 100, 3), std::ios::app) << "2021-03-05 10:09";
+  }
+  std::ofstream(test_dir_ + "/IBM.txt") << "Timestamp, Price, Size, Exchange, Type\n";
+  std::ofstream(test_dir_ + "/ORCL.txt");
+  std::ofstream(test_dir_ + "/IBM.txt.gz") << "compressed";
+
+  InputScanOptions options;
+  options.read_timestamps = true;
+  options.prefetch_bytes = 1024 * 1024;
+  options.threads = 3;
+  const auto directory = ScanInputDirectory(test_dir_, options);
+  ASSERT_TRUE(directory.has_value());
+  ASSERT_EQ(directory->files.size(), 6u);
+
+  const auto* msft = directory->FindSymbol("MSFT");
+  ASSERT_NE(msft, nullptr);
+  EXPECT_GT(msft->size, 4096u);
+  EXPECT_EQ(msft->first_timestamp, "2021-03-05 10:00:05.000");
+  EXPECT_EQ(msft->last_timestamp, "2021-03-05 10:05:04.000");
+  EXPECT_EQ(directory->FindSymbol("CSCO")->first_timestamp, "2021-03-05 10:00:00.000");
+  EXPECT_EQ(directory->FindSymbol("CSCO")->last_timestamp, "2021-03-05 10:00:00.000");
+  EXPECT_EQ(directory->FindSymbol("AAPL")->last_timestamp, "2021-03-05 10:01:42.000");
+  // Header only, empty and compressed inputs have no timestamps
+  for (const auto& file : directory->files) {
+    if (file.symbol == "IBM" || file.symbol == "ORCL") {
+      EXPECT_TRUE(file.first_timestamp.empty()) << file.filename;
+      EXPECT_TRUE(file.last_timestamp.empty()) << file.filename;
+    }
+  }
+  EXPECT_EQ(directory->first_timestamp, "2021-03-05 10:00:00.000");
+  EXPECT_EQ(directory->last_timestamp, "2021-03-05 10:05:04.000");
+}
+
+TEST_F(InputScanTest, PlansTimePartitionsByBytes) {
+  // Most of the bytes in the first minute
+  for (int i = 0; i < 3; ++i) WriteInput("EARLY" + std::to_string(i) + ".txt", 0, 60);
+  WriteInput("LATE.txt", 60, 60);
+  InputScanOptions options;
+  options.read_timestamps = true;
+  const auto directory = ScanInputDirectory(test_dir_, options);
+  ASSERT_TRUE(directory.has_value());
+
+  const auto boundaries = directory->PlanTimePartitions(4);
+  ASSERT_EQ(boundaries.size(), 3u);
+  EXPECT_LT(boundaries[0], boundaries[1]);
+  EXPECT_LT(boundaries[1], boundaries[2]);
+  // Three quarters of the bytes are in the first minute
+  EXPECT_LT(boundaries[1], "2021-03-05 10:01:00.000");
+  EXPECT_GE(boundaries[2], "2021-03-05 10:00:59.000");
+  EXPECT_LE(boundaries[2], "2021-03-05 10:01:01.000");
+  EXPECT_TRUE(directory->PlanTimePartitions(1).empty());
+  EXPECT_TRUE(ScanInputDirectory(test_dir_)->PlanTimePartitions(4).empty());
+}
+
+TEST_F(InputScanTest, ManyFilesOnManyThreads) {
+  std::vector<std::string> symbols;
+  for (int i = 0; i < 500; ++i) {
+    char symbol[16];
+    std::snprintf(symbol, sizeof(symbol), "S%04d", i);
+    symbols.push_back(symbol);
+    WriteInput(symbols.back() + ".txt", i % 60, 2);
+  }
+  InputScanOptions options;
+  options.read_timestamps = true;
+  options.threads = 32;
+  const auto directory = ScanInputDirectory(test_dir_, options);
+  ASSERT_TRUE(directory.has_value());
+  EXPECT_EQ(directory->GetSymbols(), symbols);
+  for (size_t i = 0; i < symbols.size(); ++i) {
+    const auto& file = directory->files[i];
+    EXPECT_EQ(MktData::TimestampToMillis(file.last_timestamp) -
+              MktData::TimestampToMillis(file.first_timestamp), 1000) << file.filename;
+  }
+}
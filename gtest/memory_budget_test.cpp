@@ -0,0 +1,160 @@
+#include "../MemoryBudget.hpp"
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+using namespace sp;
+
+namespace {
+  constexpr size_t kMiB = 1024 * 1024;
+  constexpr size_t kGiB = 1024 * kMiB;
+}
+
+class MemoryBudgetTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    root_ = std::filesystem::absolute("test_memory_budget_root").string();
+    std::filesystem::remove_all(root_);
+    std::filesystem::create_directories(root_ + "/proc/self");
+    std::filesystem::create_directories(root_ + "/sys/fs/cgroup");
+    // 64 GiB box with 32 GiB available
+    WriteFile("/proc/meminfo",
+              "MemTotal:       67108864 kB\n"
+              "MemFree:         1048576 kB\n"
+              "MemAvailable:   33554432 kB\n");
+  }
+
+  void TearDown() override {
+    std::filesystem::remove_all(root_);
+  }
+
+  void WriteFile(const std::string& p_relative, const std::string& p_content) {
+    const std::filesystem::path path = root_ + p_relative;
+    std::filesystem::create_directories(path.parent_path());
+    std::ofstream(path) << p_content;
+  }
+
+  std::string root_;
+};
+
+TEST_F(MemoryBudgetTest, NoCgroupUsesMemAvailable) {
+  MemoryBudget budget(0.5, {}, root_);
+  EXPECT_EQ(budget.GetLimits().mem_total, 64 * kGiB);
+  EXPECT_FALSE(budget.GetLimits().cgroup_limit.has_value());
+  EXPECT_EQ(budget.GetUsableMemory(), 32 * kGiB);
+  EXPECT_EQ(budget.GetTotalBudget(), 16 * kGiB);
+}
+
+TEST_F(MemoryBudgetTest, CgroupV2LimitCapsBudget) {
+  WriteFile("/proc/self/cgroup", "0::/job\n");
+  WriteFile("/sys/fs/cgroup/cgroup.controllers", "cpu memory\n");
+  WriteFile("/sys/fs/cgroup/job/memory.max", std::to_string(4 * kGiB) + "\n");
+  WriteFile("/sys/fs/cgroup/job/memory.current", std::to_string(2 * kGiB) + "\n");
+  // Half of the charged memory is page cache that can be reclaimed
+  WriteFile("/sys/fs/cgroup/job/memory.stat",
+            "anon 1073741824\ninactive_file " + std::to_string(kGiB) + "\n");
+  WriteFile("/sys/fs/cgroup/job/cpu.max", "250000 100000\n");
+
+  MemoryBudget budget(1.0, {}, root_);
+  ASSERT_TRUE(budget.GetLimits().cgroup_limit.has_value());
+  EXPECT_EQ(*budget.GetLimits().cgroup_limit, 4 * kGiB);
+  EXPECT_EQ(budget.GetUsableMemory(), 3 * kGiB);
+  ASSERT_TRUE(budget.GetLimits().cpu_quota.has_value());
+  EXPECT_DOUBLE_EQ(*budget.GetLimits().cpu_quota, 2.5);
+  EXPECT_LE(budget.GetEffectiveCpuCount(), 3u);
+}
+
+TEST_F(MemoryBudgetTest, CgroupV2TightestAncestorWins) {
+  WriteFile("/proc/self/cgroup", "0::/outer/inner\n");
+  WriteFile("/sys/fs/cgroup/cgroup.controllers", "memory\n");
+  WriteFile("/sys/fs/cgroup/outer/memory.max", std::to_string(kGiB) + "\n");
+  WriteFile("/sys/fs/cgroup/outer/memory.current", "0\n");
+  WriteFile("/sys/fs/cgroup/outer/inner/memory.max", "max\n");
+
+  MemoryBudget budget(1.0, {}, root_);
+  EXPECT_EQ(budget.GetUsableMemory(), kGiB);
+}
+
+TEST_F(MemoryBudgetTest, CgroupV1Limits) {
+  WriteFile("/proc/self/cgroup",
+            "4:memory:/docker/abc\n3:cpu,cpuacct:/docker/abc\n");
+  WriteFile("/sys/fs/cgroup/memory/memory.limit_in_bytes",
+            std::to_string(8 * kGiB) + "\n");
+  WriteFile("/sys/fs/cgroup/memory/memory.usage_in_bytes",
+            std::to_string(kGiB) + "\n");
+  WriteFile("/sys/fs/cgroup/cpu,cpuacct/cpu.cfs_quota_us", "100000\n");
+  WriteFile("/sys/fs/cgroup/cpu,cpuacct/cpu.cfs_period_us", "100000\n");
+
+  MemoryBudget budget(1.0, {}, root_);
+  EXPECT_EQ(budget.GetUsableMemory(), 7 * kGiB);
+  EXPECT_EQ(budget.GetEffectiveCpuCount(), 1u);
+}
+
+TEST_F(MemoryBudgetTest, CgroupV1UnlimitedIsIgnored) {
+  WriteFile("/proc/self/cgroup", "4:memory:/\n");
+  WriteFile("/sys/fs/cgroup/memory/memory.limit_in_bytes",
+            "9223372036854771712\n");
+  WriteFile("/sys/fs/cgroup/memory/memory.usage_in_bytes", "0\n");
+
+  MemoryBudget budget(1.0, {}, root_);
+  EXPECT_FALSE(budget.GetLimits().cgroup_limit.has_value());
+  EXPECT_EQ(budget.GetUsableMemory(), 32 * kGiB);
+}
+
+TEST_F(MemoryBudgetTest, MalformedCpuMaxIsIgnored) {
+  WriteFile("/proc/self/cgroup", "0::/job\n");
+  WriteFile("/sys/fs/cgroup/cgroup.controllers", "cpu\n");
+  for (const char* cpu_max : {"abc 100000\n", "25x 100000\n", "-1 100000\n",
+                              "99999999999999999999 100000\n"}) {
+    WriteFile("/sys/fs/cgroup/job/cpu.max", cpu_max);
+    MemoryBudget budget(1.0, {}, root_);
+    EXPECT_FALSE(budget.GetLimits().cpu_quota.has_value()) << cpu_max;
+  }
+}
+
+TEST_F(MemoryBudgetTest, NodeFreeFollowsRoot) {
+  // Nodes 0 and 2, whatever the topology of the host running the test
+  WriteFile("/sys/devices/system/node/node0/meminfo",
+            "Node 0 MemTotal:       33554432 kB\nNode 0 MemFree:         1048576 kB\n");
+  WriteFile("/sys/devices/system/node/node2/meminfo",
+            "Node 2 MemTotal:       33554432 kB\nNode 2 MemFree:         3145728 kB\n");
+  WriteFile("/sys/devices/system/node/possible", "0,2\n");
+  std::filesystem::create_directories(root_ + "/sys/devices/system/node/nodeX");
+
+  MemoryBudget budget(1.0, {}, root_);
+  const std::vector<size_t> expected = {kGiB, 0, 3 * kGiB};
+  EXPECT_EQ(budget.GetLimits().node_free, expected);
+}
+
+TEST_F(MemoryBudgetTest, StagesSumToFraction) {
+  MemoryBudget::StageShares shares;
+  shares.read_windows = 2;
+  shares.queue_capacity = 1;
+  shares.sort_buffers = 1;
+  shares.output_buffers = 0;
+  MemoryBudget budget(0.25, shares, root_);
+
+  using Stage = MemoryBudget::Stage;
+  EXPECT_EQ(budget.GetTotalBudget(), 8 * kGiB);
+  EXPECT_EQ(budget.GetStageBudget(Stage::ReadWindows), 4 * kGiB);
+  EXPECT_EQ(budget.GetStageBudget(Stage::QueueCapacity), 2 * kGiB);
+  EXPECT_EQ(budget.GetStageBudget(Stage::SortBuffers), 2 * kGiB);
+  EXPECT_EQ(budget.GetStageBudget(Stage::OutputBuffers), 0u);
+  EXPECT_EQ(budget.GetStageBudgetPerThread(Stage::ReadWindows, 4), kGiB);
+
+  size_t sum = 0;
+  for (auto stage : {Stage::ReadWindows, Stage::QueueCapacity,
+                     Stage::SortBuffers, Stage::OutputBuffers}) {
+    sum += budget.GetStageBudget(stage);
+  }
+  EXPECT_LE(sum, budget.GetTotalBudget());
+}
+
+TEST_F(MemoryBudgetTest, RealSystemProbe) {
+  MemoryBudget budget;
+  EXPECT_GT(budget.GetLimits().mem_total, 0u);
+  EXPECT_LE(budget.GetTotalBudget(), budget.GetLimits().mem_total);
+  EXPECT_GE(budget.GetEffectiveCpuCount(), 1u);
+}
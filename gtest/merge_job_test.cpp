@@ -0,0 +1,389 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../Checkpoint.hpp"
+#include "../CompressedFile.hpp"
+#include "../MergeJob.hpp"
+
+using namespace sp;
+
+class MergeJobTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    test_dir_ = "test_merge_files";
+    std::filesystem::remove_all(test_dir_);
+    std::filesystem::create_directory(test_dir_);
+
+    // The example from the Readme
+    WriteFile("MSFT.txt",
+              "Timestamp, Price, Size, Exchange, Type\n"
+              "2021-03-05 10:00:00.123, 228.5, 120, NYSE, Ask\n"
+              "2021-03-05 10:00:00.123, 228.4, 110, NASDAQ, Bid\n"
+              "2021-03-05 10:00:00.133, 228.5, 120, NYSE, TRADE\n"
+              "2021-03-05 10:00:00.134, 228.5, 120, NYSE_ARCA, Ask\n");
+    WriteFile("CSCO.txt",
+              "Timestamp, Price, Size, Exchange, Type\n"
+              "2021-03-05 10:00:00.123, 46.14, 120, NYSE_ARCA, Ask\n"
+              "2021-03-05 10:00:00.123, 46.13, 110, NSX, Bid\n"
+              "2021-03-05 10:00:00.130, 46.13, 120, NYSE, TRADE\n"
+              "2021-03-05 10:00:00.131, 46.14, 120, NYSE_ARCA, Ask\n");
+    inputs_ = {test_dir_ + "/MSFT.txt", test_dir_ + "/CSCO.txt"};
+    output_ = test_dir_ + "/merged.txt";
+    checkpoint_ = test_dir_ + "/merged.ckpt";
+  }
+
+  void TearDown() override {
+    std::filesystem::remove_all(test_dir_);
+  }
+
+  void WriteFile(const std::string& p_name, const std::string& p_content) {
+    std::ofstream(test_dir_ + "/" + p_name) << p_content;
+  }
+
+  static std::string ReadFile(const std::string& p_path) {
+    std::ifstream in(p_path);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+  }
+
+  // Many symbols with interleaved timestamps, large enough to cross windows
+  void WriteLargeInputs(size_t p_symbols, size_t p_lines) {
+    inputs_.clear();
+    for (size_t s = 0; s < p_symbols; ++s) {
+      const std::string symbol = "SYM" + std::to_string(s);
+      std::ofstream out(test_dir_ + "/" + symbol + ".txt");
+      out << "Timestamp, Price, Size, Exchange, Type\n";
+      for (size_t i = 0; i < p_lines; ++i) {
+        const size_t ms = i * 3 + (s % 3);
+        char ts[32];
+        std::snprintf(ts, sizeof(ts), "2021-03-05 10:%02zu:%02zu.%03zu",
+                      (ms / 60000) % 60, (ms / 1000) % 60, ms % 1000);
+        out << ts << ", " << 100 + s << "." << i % 100 << ", " << i
+            << ", NYSE, Ask\n";
+      }
+      inputs_.push_back(test_dir_ + "/" + symbol + ".txt");
+    }
+  }
+
+  std::string test_dir_;
+  std::vector<std::string> inputs_;
+  std::string output_;
+  std::string checkpoint_;
+};
+
+TEST_F(MergeJobTest, MergesReadmeExample) {
+  MergeJob job(inputs_, output_);
+  ASSERT_TRUE(job.Run());
+  EXPECT_EQ(job.GetRecordsWritten(), 8u);
+  EXPECT_EQ(ReadFile(output_),
+            "Symbol, Timestamp, Price, Size, Exchange, Type\n"
+            "CSCO, 2021-03-05 10:00:00.123, 46.14, 120, NYSE_ARCA, Ask\n"
+            "CSCO, 2021-03-05 10:00:00.123, 46.13, 110, NSX, Bid\n"
+            "MSFT, 2021-03-05 10:00:00.123, 228.5, 120, NYSE, Ask\n"
+            "MSFT, 2021-03-05 10:00:00.123, 228.4, 110, NASDAQ, Bid\n"
+            "CSCO, 2021-03-05 10:00:00.130, 46.13, 120, NYSE, TRADE\n"
+            "CSCO, 2021-03-05 10:00:00.131, 46.14, 120, NYSE_ARCA, Ask\n"
+            "MSFT, 2021-03-05 10:00:00.133, 228.5, 120, NYSE, TRADE\n"
+            "MSFT, 2021-03-05 10:00:00.134, 228.5, 120, NYSE_ARCA, Ask\n");
+}
+
+TEST_F(MergeJobTest, CheckpointRoundTrip) {
+  MergeCheckpoint checkpoint;
+  checkpoint.inputs = {{"/data/with space/MSFT.txt", 123}, {"CSCO.txt", 0}};
+  checkpoint.last_timestamp = "2021-03-05 10:00:00.123";
+  checkpoint.last_symbol = "MSFT";
+  checkpoint.output_length = 4096;
+  checkpoint.records_written = 77;
+  ASSERT_TRUE(checkpoint.Save(checkpoint_));
+
+  auto loaded = MergeCheckpoint::Load(checkpoint_);
+  ASSERT_TRUE(loaded.has_value());
+  EXPECT_EQ(loaded->last_timestamp, checkpoint.last_timestamp);
+  EXPECT_EQ(loaded->last_symbol, "MSFT");
+  EXPECT_EQ(loaded->output_length, 4096u);
+  EXPECT_EQ(loaded->records_written, 77u);
+  ASSERT_EQ(loaded->inputs.size(), 2u);
+  EXPECT_EQ(loaded->GetInputOffset("/data/with space/MSFT.txt"), 123u);
+  EXPECT_FALSE(loaded->GetInputOffset("AAPL.txt").has_value());
+  EXPECT_FALSE(MergeCheckpoint::Load(test_dir_ + "/missing.ckpt").has_value());
+}
+
+TEST_F(MergeJobTest, ResumesAfterCrash) {
+  WriteLargeInputs(7, 3000);
+  const std::string expected_output = test_dir_ + "/expected.txt";
+  // Same options without the checkpoint, set by name so that new
+  // MergeJobOptions fields cannot shift them
+  MergeJob::Options options;
+  options.checkpoint_interval = 0;
+  options.read_window = 4096;
+  {
+    MergeJob job(inputs_, expected_output, options);
+    ASSERT_TRUE(job.Run());
+  }
+
+  options.checkpoint_path = checkpoint_;
+  {
+    MergeJob job(inputs_, output_, options);
+    ASSERT_TRUE(job.Open());
+    EXPECT_FALSE(job.IsResumed());
+    ASSERT_EQ(job.Step(5000), 5000u);
+    ASSERT_TRUE(job.Checkpoint());
+    // Records emitted after the checkpoint reach the file but must be
+    // discarded on restart
+    ASSERT_EQ(job.Step(1234), 1234u);
+  }
+
+  auto checkpoint = MergeCheckpoint::Load(checkpoint_);
+  ASSERT_TRUE(checkpoint.has_value());
+  EXPECT_EQ(checkpoint->records_written, 5000u);
+  EXPECT_GT(std::filesystem::file_size(output_), checkpoint->output_length);
+
+  MergeJob resumed(inputs_, output_, options);
+  ASSERT_TRUE(resumed.Run());
+  EXPECT_TRUE(resumed.IsResumed());
+  EXPECT_EQ(resumed.GetRecordsWritten(), 7u * 3000u);
+  EXPECT_EQ(ReadFile(output_), ReadFile(expected_output));
+}
+
+TEST_F(MergeJobTest, PeriodicCheckpointsAndCompletedResume) {
+  MergeJob::Options options;
+  options.checkpoint_path = checkpoint_;
+  options.checkpoint_interval = 3;
+  {
+    MergeJob job(inputs_, output_, options);
+    ASSERT_TRUE(job.Run());
+  }
+  const auto merged = ReadFile(output_);
+  auto checkpoint = MergeCheckpoint::Load(checkpoint_);
+  ASSERT_TRUE(checkpoint.has_value());
+  EXPECT_EQ(checkpoint->records_written, 8u);
+  EXPECT_EQ(checkpoint->output_length, merged.size());
+  EXPECT_EQ(checkpoint->last_timestamp, "2021-03-05 10:00:00.134");
+  EXPECT_EQ(checkpoint->last_symbol, "MSFT");
+
+  // Everything was merged, a rerun has nothing left to do
+  MergeJob rerun(inputs_, output_, options);
+  ASSERT_TRUE(rerun.Run());
+  EXPECT_TRUE(rerun.IsResumed());
+  EXPECT_EQ(ReadFile(output_), merged);
+}
+
+// A plain resume continues from the saved offsets, an input that grew
+// meanwhile must not put older records after newer ones
+TEST_F(MergeJobTest, ResumeDropsRecordsBehindCheckpoint) {
+  MergeJob::Options options;
+  options.checkpoint_path = checkpoint_;
+  {
+    MergeJob job(inputs_, output_, options);
+    ASSERT_TRUE(job.Open());
+    ASSERT_EQ(job.Step(6), 6u);
+    ASSERT_TRUE(job.Checkpoint());
+  }
+  ASSERT_EQ(MergeCheckpoint::Load(checkpoint_)->last_timestamp, "2021-03-05 10:00:00.131");
+
+  std::ofstream(inputs_[1], std::ios::app)
+    << "2021-03-05 10:00:00.100, 46.00, 1, NSX, Bid\n"
+    << "2021-03-05 10:00:00.200, 46.20, 2, NSX, Bid\n";
+  MergeJob resumed(inputs_, output_, options);
+  ASSERT_TRUE(resumed.Run());
+  EXPECT_TRUE(resumed.IsResumed());
+  EXPECT_EQ(resumed.GetLateRecords(), 1u);
+  const auto merged = ReadFile(output_);
+  EXPECT_EQ(merged.find("46.00"), std::string::npos);
+  EXPECT_NE(merged.find("CSCO, 2021-03-05 10:00:00.200, 46.20, 2, NSX, Bid\n"), std::string::npos);
+}
+
+TEST_F(MergeJobTest, FailedPeriodicCheckpointStopsRun) {
+  MergeJob::Options options;
+  options.checkpoint_path = test_dir_ + "/missing/merged.ckpt";
+  options.checkpoint_interval = 3;
+  MergeJob job(inputs_, output_, options);
+  EXPECT_FALSE(job.Run());
+  EXPECT_TRUE(job.HasCheckpointFailed());
+  EXPECT_EQ(job.GetRecordsWritten(), 3u);
+}
+
+TEST_F(MergeJobTest, MissingInputFails) {
+  inputs_.push_back(test_dir_ + "/NOPE.txt");
+  MergeJob job(inputs_, output_);
+  EXPECT_FALSE(job.Run());
+}
+
+TEST_F(MergeJobTest, IncrementalAppendsOnlyNewData) {
+  MergeJob::Options options;
+  options.checkpoint_path = checkpoint_;
+  options.incremental = true;
+  {
+    MergeJob job(inputs_, output_, options);
+    ASSERT_TRUE(job.Run());
+    EXPECT_EQ(job.GetRecordsWritten(), 8u);
+  }
+  const auto first_run = ReadFile(output_);
+
+  // Both files grow, CSCO also gets a record that is already too old and
+  // MSFT ends with a line that is still being written
+  std::ofstream(inputs_[0], std::ios::app)
+    << "2021-03-05 10:00:01.000, 228.6, 100, NYSE, Bid\n"
+    << "2021-03-05 10:00:02.000, 228.7";
+  std::ofstream(inputs_[1], std::ios::app)
+    << "2021-03-05 10:00:00.100, 46.00, 1, NSX, Bid\n"
+    << "2021-03-05 10:00:01.000, 46.15, 200, NSX, Ask\n";
+
+  {
+    MergeJob job(inputs_, output_, options);
+    ASSERT_TRUE(job.Run());
+    EXPECT_TRUE(job.IsResumed());
+    EXPECT_GT(job.GetNewInputBytes(), 0u);
+    EXPECT_EQ(job.GetLateRecords(), 1u);
+    EXPECT_EQ(job.GetRecordsWritten(), 10u);
+  }
+  EXPECT_EQ(ReadFile(output_),
+            first_run +
+            "CSCO, 2021-03-05 10:00:01.000, 46.15, 200, NSX, Ask\n"
+            "MSFT, 2021-03-05 10:00:01.000, 228.6, 100, NYSE, Bid\n");
+
+  // The writer finishes the partial line
+  std::ofstream(inputs_[0], std::ios::app) << ", 10, NYSE, TRADE\n";
+  {
+    MergeJob job(inputs_, output_, options);
+    ASSERT_TRUE(job.Run());
+    EXPECT_EQ(job.GetLateRecords(), 0u);
+    EXPECT_EQ(job.GetRecordsWritten(), 11u);
+  }
+  EXPECT_EQ(ReadFile(output_),
+            first_run +
+            "CSCO, 2021-03-05 10:00:01.000, 46.15, 200, NSX, Ask\n"
+            "MSFT, 2021-03-05 10:00:01.000, 228.6, 100, NYSE, Bid\n"
+            "MSFT, 2021-03-05 10:00:02.000, 228.7, 10, NYSE, TRADE\n");
+}
+
+TEST_F(MergeJobTest, IncrementalNeedsCheckpoint) {
+  MergeJob::Options options;
+  options.incremental = true;
+  MergeJob job(inputs_, output_, options);
+  EXPECT_FALSE(job.Run());
+}
+
+TEST_F(MergeJobTest, CompressedOutput) {
+  WriteLargeInputs(5, 2000);
+  const std::string expected_output = test_dir_ + "/expected.txt";
+  {
+    MergeJob job(inputs_, expected_output);
+    ASSERT_TRUE(job.Run());
+  }
+
+  MergeJob::Options options;
+  options.output_compression = CompressedWriter::Format::Gzip;
+  options.output_threads = 2;
+  {
+    MergeJob job(inputs_, output_ + ".gz", options);
+    ASSERT_TRUE(job.Run());
+  }
+  EXPECT_TRUE(std::filesystem::exists(FrameIndex::GetPath(output_ + ".gz")));
+  CompressedFile file(output_ + ".gz");
+  std::string merged;
+  while (auto line = file.ReadLineView()) {
+    merged.append(*line);
+    merged.push_back('\n');
+  }
+  EXPECT_EQ(merged, ReadFile(expected_output));
+
+  options.checkpoint_path = checkpoint_;
+  MergeJob checkpointed(inputs_, output_ + ".gz", options);
+  EXPECT_FALSE(checkpointed.Run());
+}
+
+TEST_F(MergeJobTest, FilterPushedIntoInputs) {
+  MergeJob::Options options;
+  options.filter.SetSymbols({"CSCO", "MSFT"})
+                .SetTimeRange("2021-03-05 10:00:00.124", "2021-03-05 10:00:00.134")
+                .SetExchanges({"NYSE", "NYSE_ARCA"});
+  inputs_.push_back(test_dir_ + "/IBM_not_there.txt"); // Filtered out, never opened
+  MergeJob job(inputs_, output_, options);
+  ASSERT_TRUE(job.Run());
+  EXPECT_EQ(ReadFile(output_),
+            "Symbol, Timestamp, Price, Size, Exchange, Type\n"
+            "CSCO, 2021-03-05 10:00:00.130, 46.13, 120, NYSE, TRADE\n"
+            "CSCO, 2021-03-05 10:00:00.131, 46.14, 120, NYSE_ARCA, Ask\n"
+            "MSFT, 2021-03-05 10:00:00.133, 228.5, 120, NYSE, TRADE\n");
+}
+
+TEST_F(MergeJobTest, FollowMergesAppendedLines) {
+  MergeJob::Options options;
+  options.follow = true;
+  options.lateness = std::chrono::milliseconds(50);
+  options.poll_interval = std::chrono::milliseconds(10);
+  MergeJob job(inputs_, output_, options);
+  bool ok = false;
+  std::thread follower([&] { ok = job.Run(); });
+
+  const auto wait_for = [&](size_t p_records) {
+    for (int i = 0; i < 500 && job.GetRecordsWritten() < p_records; ++i) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return job.GetRecordsWritten();
+  };
+  // CSCO goes idle first, the last MSFT records wait for the lateness bound
+  EXPECT_EQ(wait_for(8), 8u);
+
+  std::ofstream(inputs_[0], std::ios::app)
+    << "2021-03-05 10:00:00.500, 228.6, 100, NYSE, Bid\n"
+    << "2021-03-05 10:00:02.000, 228.7";
+  std::ofstream(inputs_[1], std::ios::app)
+    << "2021-03-05 10:00:01.000, 46.15, 200, NSX, Ask\n";
+  // The partial MSFT line is not a record yet
+  EXPECT_EQ(wait_for(10), 10u);
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  EXPECT_EQ(job.GetRecordsWritten(), 10u);
+
+  std::ofstream(inputs_[0], std::ios::app) << ", 10, NYSE, TRADE\n";
+  EXPECT_EQ(wait_for(11), 11u);
+  // Behind the emitted stream by now
+  std::ofstream(inputs_[1], std::ios::app)
+    << "2021-03-05 10:00:00.900, 46.00, 1, NSX, Bid\n";
+  for (int i = 0; i < 500 && job.GetLateRecords() == 0; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  job.Stop();
+  follower.join();
+  EXPECT_TRUE(ok);
+  EXPECT_EQ(job.GetLateRecords(), 1u);
+
+  const auto merged = ReadFile(output_);
+  EXPECT_NE(merged.find("MSFT, 2021-03-05 10:00:00.500, 228.6, 100, NYSE, Bid\n"
+                        "CSCO, 2021-03-05 10:00:01.000, 46.15, 200, NSX, Ask\n"
+                        "MSFT, 2021-03-05 10:00:02.000, 228.7, 10, NYSE, TRADE\n"),
+            std::string::npos);
+  EXPECT_EQ(merged.find("46.00"), std::string::npos);
+}
+
+// Read-ahead for the inputs next in line changes nothing about the output
+TEST_F(MergeJobTest, PrefetchEarliestInputs) {
+  WriteLargeInputs(6, 3000);
+  const std::string expected_output = test_dir_ + "/expected.txt";
+  MergeJob::Options options;
+  options.read_window = 4096;
+  options.prefetch_inputs = 0;
+  {
+    MergeJob job(inputs_, expected_output, options);
+    ASSERT_TRUE(job.Run());
+    EXPECT_EQ(job.GetPrefetchedBytes(), 0u);
+  }
+
+  options.prefetch_inputs = 2;
+  options.prefetch_bytes = 16 * 1024;
+  options.prefetch_interval = 64;
+  MergeJob job(inputs_, output_, options);
+  ASSERT_TRUE(job.Run());
+  EXPECT_GT(job.GetPrefetchedBytes(), 0u);
+  size_t total = 0;
+  for (const auto& input : inputs_) total += std::filesystem::file_size(input);
+  EXPECT_LE(job.GetPrefetchedBytes(), total);
+  EXPECT_EQ(ReadFile(output_), ReadFile(expected_output));
+}
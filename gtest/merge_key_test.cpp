@@ -0,0 +1,153 @@
+#include <gtest/gtest.h>
+#include <random>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+#include "../MergeKey.hpp"
+#include "../RecordSource.hpp"
+
+using namespace sp;
+
+static_assert(MergeOrder<TimeSymbolOrder>);
+static_assert(MergeOrder<SymbolTimeOrder>);
+
+TEST(MergeKeyTest, PackedKeysOrderLikeTuples) {
+  std::mt19937_64 rng(7);
+  for (int i = 0; i < 10000; ++i) {
+    const int64_t ta = static_cast<int64_t>(rng() % (kMaxPackedMillis + 1));
+    const int64_t tb = rng() % 4 == 0 ? ta : static_cast<int64_t>(rng() % (kMaxPackedMillis + 1));
+    const uint32_t ra = static_cast<uint32_t>(rng() % (kMaxPackedRank + 1));
+    const uint32_t rb = rng() % 4 == 0 ? ra : static_cast<uint32_t>(rng() % (kMaxPackedRank + 1));
+    ASSERT_TRUE(FitsPacked(ta, ra));
+    EXPECT_EQ(TimeSymbolOrder::Pack(ta, ra) < TimeSymbolOrder::Pack(tb, rb),
+              std::tie(ta, ra) < std::tie(tb, rb));
+    EXPECT_EQ(SymbolTimeOrder::Pack(ta, ra) < SymbolTimeOrder::Pack(tb, rb),
+              std::tie(ra, ta) < std::tie(rb, tb));
+  }
+}
+
+TEST(MergeKeyTest, WideKeysOrderEveryTimestamp) {
+  const std::vector<int64_t> times = {INT64_MIN, -1000, -1, 0, 1, kMaxPackedMillis,
+                                      kMaxPackedMillis + 1, INT64_MAX};
+  const std::vector<uint32_t> ranks = {0, 1, kMaxPackedRank + 1, UINT32_MAX};
+  for (const int64_t ta : times) {
+    for (const int64_t tb : times) {
+      for (const uint32_t ra : ranks) {
+        for (const uint32_t rb : ranks) {
+          EXPECT_EQ(TimeSymbolOrder::PackWide(ta, ra) < TimeSymbolOrder::PackWide(tb, rb),
+                    std::tie(ta, ra) < std::tie(tb, rb));
+          EXPECT_EQ(SymbolTimeOrder::PackWide(ta, ra) < SymbolTimeOrder::PackWide(tb, rb),
+                    std::tie(ra, ta) < std::tie(rb, tb));
+        }
+      }
+    }
+  }
+  EXPECT_FALSE(FitsPacked(-1, 0));
+  EXPECT_FALSE(FitsPacked(kMaxPackedMillis + 1, 0));
+  EXPECT_FALSE(FitsPacked(0, kMaxPackedRank + 1));
+}
+
+TEST(MergeKeyTest, RanksFollowSymbolOrder) {
+  const std::vector<std::string_view> symbols = {"MSFT", "AAPL", "IBM", "AAPL", "A"};
+  EXPECT_EQ(RankSymbols(symbols), (std::vector<uint32_t>{3, 1, 2, 1, 0}));
+  EXPECT_TRUE(RankSymbols({}).empty());
+}
+
+TEST(MergeKeyTest, SortRecordsIsStableInBothOrders) {
+  std::vector<RankedRecord> records;
+  for (uint64_t i = 0; i < 60; ++i) {
+    RankedRecord ranked;
+    ranked.record.timestamp = static_cast<int64_t>(i % 5);
+    ranked.record.size = i; // Input position
+    ranked.rank = static_cast<uint32_t>(i % 3);
+    records.push_back(ranked);
+  }
+  const auto check = [](const std::vector<RankedRecord>& p_sorted, bool p_time_first) {
+    for (size_t i = 1; i < p_sorted.size(); ++i) {
+      const auto& a = p_sorted[i - 1];
+      const auto& b = p_sorted[i];
+      const auto ka = p_time_first ? std::tuple(a.record.timestamp, int64_t{a.rank}, a.record.size)
+                                   : std::tuple(int64_t{a.rank}, a.record.timestamp, a.record.size);
+      const auto kb = p_time_first ? std::tuple(b.record.timestamp, int64_t{b.rank}, b.record.size)
+                                   : std::tuple(int64_t{b.rank}, b.record.timestamp, b.record.size);
+      EXPECT_LT(ka, kb) << "at " << i;
+    }
+  };
+  auto by_time = records;
+  SortRecords<TimeSymbolOrder>(by_time);
+  check(by_time, true);
+  auto by_symbol = records;
+  SortRecords<SymbolTimeOrder>(by_symbol);
+  check(by_symbol, false);
+
+  // A negative timestamp does not fit 64 bits, the wide keys take over
+  records[7].record.timestamp = -5;
+  SortRecords<TimeSymbolOrder>(records);
+  EXPECT_EQ(records.front().record.size, 7u);
+  check(std::vector<RankedRecord>(records.begin() + 1, records.end()), true);
+}
+
+TEST(MergeKeyTest, MergeFollowsTheOrder) {
+  const auto record = [](int64_t p_millis) {
+    MktDataRecord record;
+    record.timestamp = p_millis;
+    return record;
+  };
+  const auto make_sources = [&] {
+    std::vector<VectorRecordSource> sources;
+    sources.emplace_back("MSFT", std::vector<MktDataRecord>{record(1), record(4)});
+    sources.emplace_back("AAPL", std::vector<MktDataRecord>{record(2), record(3)});
+    sources.emplace_back("IBM", std::vector<MktDataRecord>{record(2)});
+    return sources;
+  };
+  using Merged = std::vector<std::pair<std::string, int64_t>>;
+  const auto collect = [](Merged& p_merged) {
+    return [&p_merged](std::string_view p_symbol, const MktDataRecord& p_record) {
+      p_merged.emplace_back(std::string(p_symbol), p_record.timestamp);
+    };
+  };
+
+  auto sources = make_sources();
+  Merged by_time;
+  MergeRecordSources<TimeSymbolOrder>(sources, collect(by_time));
+  EXPECT_EQ(by_time, (Merged{{"MSFT", 1}, {"AAPL", 2}, {"IBM", 2}, {"AAPL", 3}, {"MSFT", 4}}));
+
+  sources = make_sources();
+  Merged by_symbol;
+  MergeRecordSources<SymbolTimeOrder>(sources, collect(by_symbol));
+  EXPECT_EQ(by_symbol, (Merged{{"AAPL", 2}, {"AAPL", 3}, {"IBM", 2}, {"MSFT", 1}, {"MSFT", 4}}));
+}
+
+TEST(MergeKeyTest, MergeMovesToWideKeysWhenAHeadDoesNotFit) {
+  const auto record = [](int64_t p_millis) {
+    MktDataRecord record;
+    record.timestamp = p_millis;
+    return record;
+  };
+  constexpr int64_t kLate = kMaxPackedMillis + 10;
+  using Merged = std::vector<std::pair<std::string, int64_t>>;
+  const auto merge = [](std::vector<VectorRecordSource> p_sources) {
+    Merged merged;
+    MergeRecordSources(p_sources, [&merged](std::string_view p_symbol, const MktDataRecord& p_record) {
+      merged.emplace_back(std::string(p_symbol), p_record.timestamp);
+    });
+    return merged;
+  };
+
+  // Packed until MSFT reaches kLate, wide for the rest
+  std::vector<VectorRecordSource> sources;
+  sources.emplace_back("MSFT", std::vector<MktDataRecord>{record(1), record(kLate), record(kLate + 1)});
+  sources.emplace_back("AAPL", std::vector<MktDataRecord>{record(2), record(kLate), record(kLate + 2)});
+  sources.emplace_back("IBM", std::vector<MktDataRecord>{record(3)});
+  EXPECT_EQ(merge(std::move(sources)),
+            (Merged{{"MSFT", 1}, {"AAPL", 2}, {"IBM", 3}, {"AAPL", kLate}, {"MSFT", kLate},
+                    {"MSFT", kLate + 1}, {"AAPL", kLate + 2}}));
+
+  // Wide from the start
+  sources.clear();
+  sources.emplace_back("MSFT", std::vector<MktDataRecord>{record(-5), record(0)});
+  sources.emplace_back("AAPL", std::vector<MktDataRecord>{record(-5), record(1)});
+  EXPECT_EQ(merge(std::move(sources)),
+            (Merged{{"AAPL", -5}, {"MSFT", -5}, {"MSFT", 0}, {"AAPL", 1}}));
+}
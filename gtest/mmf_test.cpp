@@ -1141,4 +1141,141 @@ TEST_F(MMFTest, ChunkedRemappingSplitLineView) {
     auto line3 = mmf.ReadLineView(true);
     ASSERT_FALSE(line3.has_value());
     ASSERT_EQ(mmf.GetLastError(), MMF::Error::EndOfFile);
-}
\ No newline at end of file
+}
+// Huge page advice must never break reading, whether or not the kernel
+// backs file mappings with huge pages
+TEST_F(MMFTest, EnableHugePagesKeepsReading) {
+  MMF mmf(large_file_);
+  ASSERT_TRUE(mmf.IsValid());
+  mmf.EnableHugePages();
+
+  size_t count = 0;
+  while (auto line = mmf.ReadLineView(true)) {
+    ++count;
+  }
+  EXPECT_EQ(count, 1000u);
+  EXPECT_LE(mmf.GetHugePageBytes(), mmf.GetMappedSize().value_or(0));
+}
+
+TEST_F(MMFTest, EnableHugePagesInvalid) {
+  MMF mmf(non_existent_file_);
+  EXPECT_FALSE(mmf.EnableHugePages());
+  EXPECT_EQ(mmf.GetHugePageBytes(), 0u);
+}
+
+// Lines crossing a window boundary must come back whole, and mapped offset
+// plus current position must give the file offset of the next line
+TEST_F(MMFTest, ChunkedRemappingLineAcrossWindows) {
+  const auto page_size = sysconf(_SC_PAGE_SIZE);
+  MMF mmf(large_file_, 0, page_size);
+  ASSERT_TRUE(mmf.IsValid());
+
+  std::ifstream expected_file(large_file_);
+  std::string expected;
+  size_t file_position = 0;
+  size_t count = 0;
+  while (auto line = mmf.ReadLineView(true)) {
+    ASSERT_TRUE(std::getline(expected_file, expected));
+    ASSERT_EQ(*line, expected);
+    file_position += expected.size() + 1;
+    ASSERT_EQ(mmf.GetMappedOffset().value() + mmf.GetCurrentPosition().value(),
+              file_position);
+    ++count;
+  }
+  EXPECT_EQ(count, 1000u);
+  EXPECT_EQ(mmf.GetLastError(), MMF::Error::EndOfFile);
+}
+
+// A followed file keeps its partial last line back until the writer ends it,
+// and Refresh() continues into appended data, also for a file that was empty
+TEST_F(MMFTest, FollowModeRefresh) {
+  const std::string file = test_dir_ + "/growing.txt";
+  std::ofstream(file) << "";
+  MMF mmf(file);
+  ASSERT_TRUE(mmf.IsValid());
+  mmf.SetFollowMode(true);
+  EXPECT_TRUE(mmf.IsFollowMode());
+  EXPECT_FALSE(mmf.Refresh());
+
+  std::ofstream(file, std::ios::app) << "line 1\nline";
+  ASSERT_TRUE(mmf.Refresh());
+  auto line = mmf.ReadLineView(true);
+  ASSERT_TRUE(line.has_value());
+  EXPECT_EQ(*line, "line 1");
+  EXPECT_FALSE(mmf.ReadLineView(true).has_value());
+  EXPECT_EQ(mmf.GetLastError(), MMF::Error::EndOfFile);
+  EXPECT_EQ(mmf.GetMappedOffset().value() + mmf.GetCurrentPosition().value(), 7u);
+
+  std::ofstream(file, std::ios::app) << " 2\nline 3\n";
+  ASSERT_TRUE(mmf.Refresh());
+  line = mmf.ReadLineView(true);
+  ASSERT_TRUE(line.has_value());
+  EXPECT_EQ(*line, "line 2");
+  line = mmf.ReadLineView(true);
+  ASSERT_TRUE(line.has_value());
+  EXPECT_EQ(*line, "line 3");
+  EXPECT_FALSE(mmf.ReadLineView(true).has_value());
+  EXPECT_FALSE(mmf.Refresh());
+}
+
+// A followed window keeps its configured size near the end of the file, so
+// appends inside it are read without mapping again
+TEST_F(MMFTest, FollowModeKeepsWindowSize) {
+  const auto page_size = static_cast<size_t>(sysconf(_SC_PAGE_SIZE));
+  const std::string file = test_dir_ + "/tail.txt";
+  std::ofstream(file) << "line 0\n";
+  MMF mmf(file, 0, 4 * page_size);
+  ASSERT_TRUE(mmf.IsValid());
+  mmf.SetFollowMode(true);
+  ASSERT_TRUE(mmf.ReadLineView(true).has_value());
+  EXPECT_FALSE(mmf.ReadLineView(true).has_value());
+
+  // The first append maps a full window from the end of what was read
+  std::ofstream(file, std::ios::app) << "line 1\n";
+  ASSERT_TRUE(mmf.Refresh());
+  auto line = mmf.ReadLineView(true);
+  ASSERT_TRUE(line.has_value());
+  EXPECT_EQ(*line, "line 1");
+  const size_t remaps = mmf.GetRemapCount();
+
+  size_t position = 14;
+  for (int i = 2; i < 200; ++i) {
+    const std::string text = "line " + std::to_string(i);
+    std::ofstream(file, std::ios::app) << text << "\n";
+    position += text.size() + 1;
+    ASSERT_TRUE(mmf.Refresh());
+    line = mmf.ReadLineView(true);
+    ASSERT_TRUE(line.has_value()) << i;
+    EXPECT_EQ(*line, text);
+    EXPECT_FALSE(mmf.ReadLineView(true).has_value());
+    EXPECT_EQ(mmf.GetMappedOffset().value() + mmf.GetCurrentPosition().value(), position);
+  }
+  EXPECT_EQ(mmf.GetRemapCount(), remaps); // Never mapped again
+}
+
+// Read-ahead covers the window and the file beyond it, never past the end,
+// and is only issued once per range
+TEST_F(MMFTest, PrefetchAheadOfPosition) {
+  const auto page_size = static_cast<size_t>(sysconf(_SC_PAGE_SIZE));
+  const auto file_size = std::filesystem::file_size(large_file_);
+  ASSERT_GT(file_size, 3 * page_size);
+  MMF mmf(large_file_, 0, page_size);
+  ASSERT_TRUE(mmf.IsValid());
+  EXPECT_EQ(mmf.GetPrefetchedUntil(), 0u);
+
+  EXPECT_EQ(mmf.Prefetch(2 * page_size), 2 * page_size);
+  EXPECT_EQ(mmf.GetPrefetchedUntil(), 2 * page_size);
+  EXPECT_EQ(mmf.Prefetch(2 * page_size), 0u);
+  EXPECT_EQ(mmf.Prefetch(3 * page_size), page_size);
+
+  // Reading is unaffected, and later requests start from the new position
+  size_t count = 0;
+  while (mmf.ReadLineView(true)) ++count;
+  EXPECT_EQ(count, 1000u);
+  EXPECT_EQ(mmf.Prefetch(page_size), 0u);
+  EXPECT_EQ(mmf.GetPrefetchedUntil(), 3 * page_size);
+
+  MMF whole(large_file_);
+  EXPECT_EQ(whole.Prefetch(file_size + page_size), file_size);
+  EXPECT_EQ(whole.GetPrefetchedUntil(), file_size);
+}
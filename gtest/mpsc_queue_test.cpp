@@ -3,6 +3,7 @@
 #include <vector>
 #include <atomic>
 #include <chrono>
+#include <deque>
 #include "../MPSCQueue.hpp" // Adjust path as needed
 
 using namespace sp;
@@ -74,4 +75,103 @@ TEST(MPSCQueueTest, EnqueueNeverBlocks) {
         ASSERT_TRUE(val.has_value());
         EXPECT_EQ(val.value(), i);
     }
-}
\ No newline at end of file
+}
+TEST(MPSCQueueTest, EveryWaitStrategyDeliversInOrder) {
+    using Strategy = QueueWaitStrategy;
+    for (auto strategy : {Strategy::Blocking, Strategy::BusySpin, Strategy::SpinYield,
+                          Strategy::SpinFutex}) {
+        MPSCQueue<int> queue(strategy);
+        EXPECT_EQ(queue.GetWaitStrategy(), strategy);
+        constexpr int num_producers = 3;
+        constexpr int items_per_producer = 2000;
+        std::vector<std::thread> producers;
+        for (int p = 0; p < num_producers; ++p) {
+            producers.emplace_back([&queue, p]() {
+                for (int j = 0; j < items_per_producer; ++j) {
+                    queue.Enqueue(p * items_per_producer + j);
+                    // Let the queue run dry now and then so the consumer parks
+                    if (j % 500 == 0) std::this_thread::sleep_for(std::chrono::milliseconds(2));
+                }
+            });
+        }
+        std::vector<int> last(num_producers, -1);
+        for (int i = 0; i < num_producers * items_per_producer; ++i) {
+            const int value = queue.Dequeue();
+            const int producer = value / items_per_producer;
+            EXPECT_GT(value, last[producer]);
+            last[producer] = value;
+        }
+        for (auto& t : producers) t.join();
+        EXPECT_TRUE(queue.Empty());
+    }
+}
+
+TEST(MPSCQueueTest, ParkedConsumerIsWoken) {
+    using Strategy = QueueWaitStrategy;
+    for (auto strategy : {Strategy::Blocking, Strategy::SpinYield, Strategy::SpinFutex}) {
+        MPSCQueue<int> queue(strategy);
+        std::atomic<bool> finished{false};
+        std::thread consumer([&]() {
+            EXPECT_EQ(queue.Dequeue(), 7);
+            finished = true;
+        });
+        // Long enough to get past the spinning phase
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        EXPECT_FALSE(finished);
+        queue.BulkEnqueue(std::deque<int>{7});
+        consumer.join();
+        EXPECT_TRUE(finished);
+    }
+}
+
+TEST(MPSCQueueTest, TelemetryCountsDepthSwapsAndIdleTime) {
+    static_assert(sizeof(MPSCQueue<int>) < sizeof(MPSCQueue<int, std::allocator<int>, true>));
+    MPSCQueue<int, std::allocator<int>, true> queue;
+    for (int i = 0; i < 10; ++i) queue.Enqueue(i);
+    queue.BulkEnqueue(std::deque<int>{10, 11});
+    EXPECT_EQ(queue.Dequeue(), 0); // Swaps the other 11 into the cache
+    for (int i = 1; i < 12; ++i) EXPECT_EQ(queue.TryDequeue(), i);
+
+    std::thread consumer([&]() { EXPECT_EQ(queue.Dequeue(), 12); });
+    // Idle time starts before the consumer parks, wait for that first
+    while (!queue.IsConsumerParked()) std::this_thread::yield();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    queue.Enqueue(12);
+    consumer.join();
+
+    const QueueTelemetry telemetry = queue.GetTelemetry();
+    EXPECT_EQ(telemetry.enqueued, 13u);
+    EXPECT_EQ(telemetry.dequeued, 13u);
+    EXPECT_EQ(telemetry.high_water_mark, 12u);
+    EXPECT_EQ(telemetry.cache_swaps, 1u);
+    EXPECT_DOUBLE_EQ(telemetry.GetItemsPerSwap(), 13.0);
+    EXPECT_GE(telemetry.consumer_idle, std::chrono::milliseconds(20));
+    EXPECT_GT(telemetry.GetEnqueueRate(), 0.0);
+
+    queue.ResetTelemetry();
+    EXPECT_EQ(queue.GetTelemetry().enqueued, 0u);
+    EXPECT_EQ(queue.GetTelemetry().high_water_mark, 0u);
+}
+
+TEST(MPSCQueueTest, TelemetryCountsContendedEnqueues) {
+    MPSCQueue<int, std::allocator<int>, true> queue;
+    constexpr int num_producers = 4;
+    constexpr int items_per_producer = 20000;
+    std::vector<std::thread> producers;
+    for (int p = 0; p < num_producers; ++p) {
+        producers.emplace_back([&queue]() {
+            for (int j = 0; j < items_per_producer; ++j) queue.Enqueue(j);
+        });
+    }
+    for (int i = 0; i < num_producers * items_per_producer; ++i) queue.Dequeue();
+    for (auto& t : producers) t.join();
+
+    const QueueTelemetry telemetry = queue.GetTelemetry();
+    EXPECT_EQ(telemetry.enqueued, static_cast<uint64_t>(num_producers * items_per_producer));
+    EXPECT_EQ(telemetry.dequeued, telemetry.enqueued);
+    EXPECT_LE(telemetry.high_water_mark, telemetry.enqueued);
+    EXPECT_LE(telemetry.contended_enqueues, telemetry.enqueued);
+    if (telemetry.contended_enqueues == 0) {
+        EXPECT_EQ(telemetry.producer_blocked.count(), 0);
+    }
+}
@@ -0,0 +1,93 @@
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <string>
+#include "../Price.hpp"
+
+using namespace sp;
+
+TEST(PriceTest, ParsesToFixedPoint) {
+  EXPECT_EQ(MktData::ParsePrice("228.5"), 228500000);
+  EXPECT_EQ(MktData::ParsePrice("46.14"), 46140000);
+  EXPECT_EQ(MktData::ParsePrice("0.000001"), 1);
+  EXPECT_EQ(MktData::ParsePrice("7"), 7000000);
+  EXPECT_EQ(MktData::ParsePrice("-12.25"), -12250000);
+  EXPECT_EQ(MktData::ParsePrice("123456789.12345678", 8), 12345678912345678);
+  EXPECT_EQ(MktData::ParsePrice("46.14", 2), 4614);
+
+  unsigned decimals = 0;
+  EXPECT_EQ(MktData::ParsePrice("228.50", MktData::kPriceScale, &decimals), 228500000);
+  EXPECT_EQ(decimals, 2u);
+}
+
+TEST(PriceTest, RejectsMalformedAndLossy) {
+  for (const char* text : {"", "-", ".5", "5.", "1..2", "1.2.3", "+1", "12a", " 1", "1e5"}) {
+    EXPECT_FALSE(MktData::ParsePrice(text).has_value()) << text;
+  }
+  EXPECT_FALSE(MktData::ParsePrice("1.0000001").has_value()); // Below the scale
+  // Parse without loss but would not format back to the same text
+  for (const char* text : {"228.50000000", "1.2500000", "007.5", "00", "-0", "-0.00"}) {
+    EXPECT_FALSE(MktData::ParsePrice(text).has_value()) << text;
+  }
+  EXPECT_FALSE(MktData::ParsePrice("1", MktData::kMaxPriceScale + 1).has_value());
+}
+
+TEST(PriceTest, DetectsOverflow) {
+  // INT64_MAX is 9223372036854775807
+  EXPECT_EQ(MktData::ParsePrice("9223372036854.775807"), std::numeric_limits<int64_t>::max());
+  EXPECT_FALSE(MktData::ParsePrice("9223372036854.775808").has_value());
+  EXPECT_FALSE(MktData::ParsePrice("9223372036855").has_value());
+  EXPECT_FALSE(MktData::ParsePrice("99999999999999999999999").has_value());
+  EXPECT_EQ(MktData::ParsePrice("9223372036854775807", 0), std::numeric_limits<int64_t>::max());
+}
+
+TEST(PriceTest, FormatsExactly) {
+  EXPECT_EQ(MktData::FormatPrice(228500000), "228.5");
+  EXPECT_EQ(MktData::FormatPrice(46140000), "46.14");
+  EXPECT_EQ(MktData::FormatPrice(7000000), "7");
+  EXPECT_EQ(MktData::FormatPrice(1), "0.000001");
+  EXPECT_EQ(MktData::FormatPrice(-12250000), "-12.25");
+  EXPECT_EQ(MktData::FormatPrice(228500000, MktData::kPriceScale, 2), "228.50");
+  EXPECT_EQ(MktData::FormatPrice(7000000, MktData::kPriceScale, 1), "7.0");
+  EXPECT_EQ(MktData::FormatPrice(46140000, MktData::kPriceScale, 1), "46.14"); // Never lossy
+  EXPECT_EQ(MktData::FormatPrice(std::numeric_limits<int64_t>::max()), "9223372036854.775807");
+  EXPECT_EQ(MktData::FormatPrice(std::numeric_limits<int64_t>::min()), "-9223372036854.775808");
+}
+
+TEST(PriceTest, RoundTripsText) {
+  std::mt19937_64 rng(7);
+  for (int i = 0; i < 10000; ++i) {
+    std::string text;
+    if (rng() % 4 == 0) text += '-';
+    text += std::to_string(rng() % 10000000);
+    const unsigned decimals = rng() % (MktData::kPriceScale + 1);
+    if (decimals > 0) {
+      text += '.';
+      for (unsigned d = 0; d < decimals; ++d) text += static_cast<char>('0' + rng() % 10);
+    }
+    if (text.starts_with("-") && text.find_first_not_of("-0.") == std::string::npos) {
+      EXPECT_FALSE(MktData::ParsePrice(text).has_value()) << text; // No fixed point form
+      continue;
+    }
+    unsigned parsed_decimals = 0;
+    const auto value = MktData::ParsePrice(text, MktData::kPriceScale, &parsed_decimals);
+    ASSERT_TRUE(value.has_value()) << text;
+    EXPECT_EQ(parsed_decimals, decimals);
+    EXPECT_EQ(MktData::FormatPrice(*value, MktData::kPriceScale, static_cast<int>(parsed_decimals)), text);
+  }
+}
+
+TEST(PriceTest, RefusesTextItCannotRoundTrip) {
+  // Either the text comes back unchanged or it is not accepted at all
+  for (const char* text : {"228.50000000", "007.5", "0.5", "0", "228.500000"}) {
+    unsigned decimals = 0;
+    const auto value = MktData::ParsePrice(text, MktData::kPriceScale, &decimals);
+    if (value) {
+      EXPECT_EQ(MktData::FormatPrice(*value, MktData::kPriceScale, static_cast<int>(decimals)), text);
+    }
+  }
+  EXPECT_FALSE(MktData::ParsePrice("228.50000000").has_value());
+  EXPECT_FALSE(MktData::ParsePrice("007.5").has_value());
+  EXPECT_EQ(MktData::ParsePrice("0.5"), 500000);
+}
@@ -0,0 +1,251 @@
+#include <gtest/gtest.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../Dictionary.hpp"
+#include "../MktData.hpp"
+#include "../RecordSource.hpp"
+
+using namespace sp;
+
+class RecordSourceTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    test_dir_ = "test_record_sources";
+    std::filesystem::remove_all(test_dir_);
+    std::filesystem::create_directory(test_dir_);
+  }
+
+  void TearDown() override {
+    std::filesystem::remove_all(test_dir_);
+  }
+
+  std::string WriteFile(const std::string& p_name, const std::string& p_content) {
+    const std::string path = test_dir_ + "/" + p_name;
+    std::ofstream(path, std::ios::binary) << p_content;
+    return path;
+  }
+
+  std::string WriteGzip(const std::string& p_name, const std::string& p_content) {
+    const std::string path = test_dir_ + "/" + p_name;
+    gzFile file = gzopen(path.c_str(), "wb");
+    EXPECT_NE(file, nullptr);
+    gzwrite(file, p_content.data(), static_cast<unsigned>(p_content.size()));
+    gzclose(file);
+    return path;
+  }
+
+  static std::string ReadFile(const std::string& p_path) {
+    std::ifstream in(p_path);
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    return buffer.str();
+  }
+
+  static MktDataRecord Record(int64_t p_millis, int64_t p_price, uint64_t p_size) {
+    MktDataRecord record;
+    record.timestamp = p_millis;
+    record.price = p_price;
+    record.size = p_size;
+    record.exchange = GetExchangeDictionary().Encode("NYSE");
+    record.type = static_cast<uint8_t>(GetTypeDictionary().Encode("TRADE"));
+    return record;
+  }
+
+  template<RecordSource S>
+  static std::vector<MktDataRecord> Drain(S& p_source) {
+    std::vector<MktDataRecord> records;
+    while (const auto* record = p_source.Next()) records.push_back(*record);
+    return records;
+  }
+
+  std::string test_dir_;
+};
+
+static_assert(RecordSource<CsvRecordSource>);
+static_assert(RecordSource<CompressedRecordSource>);
+static_assert(RecordSource<BinaryRecordSource>);
+static_assert(RecordSource<VectorRecordSource>);
+static_assert(RecordSource<AnyRecordSource>);
+
+TEST_F(RecordSourceTest, CsvSourceReadsAcrossBatches) {
+  std::string content = "Timestamp, Price, Size, Exchange, Type\n";
+  for (int i = 0; i < 1000; ++i) {
+    content += "2021-03-05 10:00:00." + std::to_string(100 + i % 900) + ", 228.5, " +
+               std::to_string(i) + ", NYSE, Ask\n";
+  }
+  content += "2021-03-05 10:00:01.000, 228.25, 5, NASDAQ, Bid"; // Unterminated
+  // Smallest batch, the lines straddle every batch boundary
+  CsvRecordSource source(WriteFile("MSFT.txt", content), 1);
+  ASSERT_TRUE(source.IsValid());
+  EXPECT_EQ(source.GetSymbol(), "MSFT");
+  const auto records = Drain(source);
+  ASSERT_EQ(records.size(), 1001u);
+  for (size_t i = 0; i < 1000; ++i) EXPECT_EQ(records[i].size, i);
+  EXPECT_EQ(records.back().price, 228'250'000);
+  EXPECT_EQ(source.GetRejectedLines(), 1u); // The header
+  EXPECT_EQ(source.Next(), nullptr);
+}
+
+TEST_F(RecordSourceTest, EmptyCsvIsValidAndEmpty) {
+  CsvRecordSource source(WriteFile("EMPTY.txt", ""));
+  EXPECT_TRUE(source.IsValid());
+  EXPECT_EQ(source.Next(), nullptr);
+  EXPECT_FALSE(CsvRecordSource(test_dir_ + "/missing.txt").IsValid());
+}
+
+TEST_F(RecordSourceTest, CompressedSourceMatchesCsv) {
+  std::string content;
+  for (int i = 0; i < 5000; ++i) {
+    content += "2021-03-05 10:00:" + std::to_string(10 + i / 1000) + "." +
+               std::to_string(100 + i % 900) + ", 12.5, " + std::to_string(i) + ", NYSE, Bid\n";
+  }
+  CompressedRecordSource compressed(WriteGzip("IBM.txt.gz", content), 1, 4096);
+  ASSERT_TRUE(compressed.IsValid());
+  EXPECT_EQ(compressed.GetSymbol(), "IBM");
+  CsvRecordSource plain(WriteFile("IBM.txt", content));
+  const auto expected = Drain(plain);
+  const auto records = Drain(compressed);
+  ASSERT_EQ(records.size(), expected.size());
+  for (size_t i = 0; i < records.size(); ++i) {
+    EXPECT_EQ(records[i].timestamp, expected[i].timestamp);
+    EXPECT_EQ(records[i].size, expected[i].size);
+  }
+}
+
+TEST_F(RecordSourceTest, BinaryRunRoundTrips) {
+  const std::vector<MktDataRecord> written = {Record(1, 10, 1), Record(2, 20, 2), Record(3, 30, 3)};
+  const std::string path = test_dir_ + "/AAPL.rec";
+  ASSERT_TRUE(WriteRecordRun(path, written));
+  EXPECT_TRUE(BinaryRecordSource::IsRecordRun(path));
+  BinaryRecordSource source(path);
+  ASSERT_TRUE(source.IsValid());
+  EXPECT_EQ(source.GetSymbol(), "AAPL");
+  EXPECT_EQ(source.GetRecordCount(), 3u);
+  const auto records = Drain(source);
+  ASSERT_EQ(records.size(), 3u);
+  EXPECT_EQ(records[2].price, 30);
+
+  EXPECT_FALSE(BinaryRecordSource(WriteFile("CSV.txt", "2021-03-05 10:00:00.000, 1, 1, NYSE, Ask\n"))
+                 .IsValid());
+  EXPECT_FALSE(BinaryRecordSource(WriteFile("CUT.rec", std::string(BinaryRecordSource::kRecordRunMagic) + "abc"))
+                 .IsValid());
+}
+
+TEST_F(RecordSourceTest, BinaryRunKeepsVenuesAcrossProcesses) {
+  // The writer hands out dynamic codes in another order than this process
+  auto& exchanges = GetExchangeDictionary();
+  auto& types = GetTypeDictionary();
+  const std::string path = test_dir_ + "/AAPL.rec";
+  const pid_t child = fork();
+  ASSERT_NE(child, -1);
+  if (child == 0) {
+    MktDataRecord a = Record(1, 10, 1);
+    a.exchange = exchanges.Encode("RUN_VENUE_A");
+    a.type = static_cast<uint8_t>(types.Encode("RUN_TYPE_A"));
+    MktDataRecord b = Record(2, 20, 2);
+    b.exchange = exchanges.Encode("RUN_VENUE_C");
+    const std::vector<MktDataRecord> records = {a, b, Record(3, 30, 3)};
+    _exit(WriteRecordRun(path, records) ? 0 : 1);
+  }
+  int status = 0;
+  ASSERT_EQ(waitpid(child, &status, 0), child);
+  ASSERT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  // Takes the code the writer gave RUN_VENUE_A
+  const auto reader_venue = exchanges.Encode("RUN_VENUE_B");
+
+  BinaryRecordSource source(path);
+  ASSERT_TRUE(source.IsValid());
+  const auto records = Drain(source);
+  ASSERT_EQ(records.size(), 3u);
+  EXPECT_EQ(exchanges.Decode(records[0].exchange), "RUN_VENUE_A");
+  EXPECT_EQ(types.Decode(records[0].type), "RUN_TYPE_A");
+  EXPECT_EQ(exchanges.Decode(records[1].exchange), "RUN_VENUE_C");
+  EXPECT_EQ(exchanges.Decode(records[2].exchange), "NYSE");
+  EXPECT_EQ(types.Decode(records[2].type), "TRADE");
+  EXPECT_EQ(exchanges.Find("RUN_VENUE_B"), reader_venue);
+
+  // Codes never handed out have no name to store
+  MktDataRecord unknown = Record(4, 40, 4);
+  unknown.exchange = static_cast<uint16_t>(exchanges.GetSize());
+  EXPECT_FALSE(WriteRecordRun(test_dir_ + "/BAD.rec", std::vector<MktDataRecord>{unknown}));
+  EXPECT_FALSE(std::filesystem::exists(test_dir_ + "/BAD.rec"));
+}
+
+TEST_F(RecordSourceTest, OpenRecordSourceDetectsFormat) {
+  const std::string line = "2021-03-05 10:00:00.000, 1, 1, NYSE, Ask\n";
+  auto csv = OpenRecordSource(WriteFile("A.txt", line));
+  auto gzip = OpenRecordSource(WriteGzip("B.txt.gz", line));
+  ASSERT_TRUE(WriteRecordRun(test_dir_ + "/C.rec", std::vector<MktDataRecord>{Record(1, 1, 1)}));
+  auto binary = OpenRecordSource(test_dir_ + "/C.rec");
+  EXPECT_NE(csv.Get<CsvRecordSource>(), nullptr);
+  EXPECT_NE(gzip.Get<CompressedRecordSource>(), nullptr);
+  EXPECT_NE(binary.Get<BinaryRecordSource>(), nullptr);
+  for (auto* source : {&csv, &gzip, &binary}) {
+    ASSERT_TRUE(source->IsValid());
+    EXPECT_NE(source->Next(), nullptr);
+    EXPECT_EQ(source->Next(), nullptr);
+  }
+  EXPECT_EQ(gzip.GetSymbol(), "B");
+
+  // Compressed inputs take a decompression thread count
+  auto threaded = OpenRecordSource(WriteGzip("D.txt.gz", line), kDefaultRecordBatchBytes, 2);
+  ASSERT_NE(threaded.Get<CompressedRecordSource>(), nullptr);
+  ASSERT_TRUE(threaded.IsValid());
+  EXPECT_NE(threaded.Next(), nullptr);
+}
+
+TEST_F(RecordSourceTest, MergesByTimestampThenSymbol) {
+  std::vector<VectorRecordSource> sources;
+  sources.emplace_back("MSFT", std::vector<MktDataRecord>{Record(1, 0, 0), Record(3, 0, 0), Record(5, 0, 0)});
+  sources.emplace_back("AAPL", std::vector<MktDataRecord>{Record(3, 0, 0), Record(4, 0, 0)});
+  sources.emplace_back("IBM", std::vector<MktDataRecord>{});
+  std::vector<std::pair<int64_t, std::string>> merged;
+  const size_t emitted = MergeRecordSources(sources,
+    [&](std::string_view p_symbol, const MktDataRecord& p_record) {
+      merged.emplace_back(p_record.timestamp, std::string(p_symbol));
+    });
+  EXPECT_EQ(emitted, 5u);
+  const std::vector<std::pair<int64_t, std::string>> expected = {
+    {1, "MSFT"}, {3, "AAPL"}, {3, "MSFT"}, {4, "AAPL"}, {5, "MSFT"}};
+  EXPECT_EQ(merged, expected);
+}
+
+TEST_F(RecordSourceTest, MergesMixedFormatsToFile) {
+  std::vector<AnyRecordSource> sources;
+  sources.push_back(OpenRecordSource(WriteFile("MSFT.txt",
+    "Timestamp, Price, Size, Exchange, Type\n"
+    "2021-03-05 10:00:00.123, 228.5, 120, NYSE, Ask\n"
+    "2021-03-05 10:00:00.200, 228.50, 10, NYSE, TRADE\n"
+    "2021-03-05 10:00:00.300, 228.1234567, 1, NYSE, TRADE\n"))); // Too many decimals
+  sources.push_back(OpenRecordSource(WriteGzip("IBM.txt.gz",
+    "2021-03-05 10:00:00.123, 12.25, 7, NASDAQ, Bid\n")));
+  ASSERT_TRUE(WriteRecordRun(test_dir_ + "/AAPL.rec",
+    std::vector<MktDataRecord>{Record(MktData::TimestampToMillis("2021-03-05 10:00:00.150"),
+                                      100'000'000, 3)}));
+  sources.push_back(OpenRecordSource(test_dir_ + "/AAPL.rec"));
+  sources.push_back(VectorRecordSource("ZZZ", {}));
+
+  const std::string output = test_dir_ + "/merged.txt";
+  const auto written = MergeRecordSourcesToFile(sources, output);
+  ASSERT_TRUE(written.has_value());
+  EXPECT_EQ(*written, 4u);
+  EXPECT_EQ(ReadFile(output),
+            "Symbol, Timestamp, Price, Size, Exchange, Type\n"
+            "IBM, 2021-03-05 10:00:00.123, 12.25, 7, NASDAQ, Bid\n"
+            "MSFT, 2021-03-05 10:00:00.123, 228.5, 120, NYSE, Ask\n"
+            "AAPL, 2021-03-05 10:00:00.150, 100, 3, NYSE, TRADE\n"
+            "MSFT, 2021-03-05 10:00:00.200, 228.50, 10, NYSE, TRADE\n");
+  // Left out of the output and reported
+  EXPECT_EQ(sources[0].GetDroppedDataLines(), 1u);
+  EXPECT_EQ(ReportDroppedDataLines(sources), 1u);
+
+  std::vector<AnyRecordSource> broken;
+  broken.push_back(OpenRecordSource(test_dir_ + "/missing.txt"));
+  EXPECT_FALSE(MergeRecordSourcesToFile(broken, output).has_value());
+}
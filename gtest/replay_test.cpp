@@ -0,0 +1,155 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "../MktData.hpp"
+#include "../RecordSource.hpp"
+#include "../Replay.hpp"
+
+using namespace sp;
+
+class ReplayTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    test_dir_ = "test_replay_files";
+    std::filesystem::remove_all(test_dir_);
+    std::filesystem::create_directory(test_dir_);
+    merged_ = test_dir_ + "/merged.txt";
+    // MergeJob output of the Readme example
+    std::ofstream(merged_)
+      << "Symbol, Timestamp, Price, Size, Exchange, Type\n"
+         "CSCO, 2021-03-05 10:00:00.123, 46.14, 120, NYSE_ARCA, Ask\n"
+         "CSCO, 2021-03-05 10:00:00.123, 46.13, 110, NSX, Bid\n"
+         "MSFT, 2021-03-05 10:00:00.123, 228.5, 120, NYSE, Ask\n"
+         "MSFT, 2021-03-05 10:00:00.123, 228.4, 110, NASDAQ, Bid\n"
+         "CSCO, 2021-03-05 10:00:00.130, 46.13, 120, NYSE, TRADE\n"
+         "CSCO, 2021-03-05 10:00:00.131, 46.14, 120, NYSE_ARCA, Ask\n"
+         "MSFT, 2021-03-05 10:00:00.133, 228.5, 120, NYSE, TRADE\n"
+         "MSFT, 2021-03-05 10:00:00.134, 228.5, 120, NYSE_ARCA, Ask\n";
+  }
+
+  void TearDown() override {
+    std::filesystem::remove_all(test_dir_);
+  }
+
+  std::string test_dir_;
+  std::string merged_;
+};
+
+TEST_F(ReplayTest, MaxSpeedPublishesEverything) {
+  Replayer replayer(merged_);
+  ASSERT_TRUE(replayer.IsValid());
+  std::vector<std::string> lines;
+  replayer.Subscribe([&](const ReplayRecord& p_record) {
+    EXPECT_EQ(p_record.millis, -1);
+    lines.push_back(std::string(p_record.symbol) + "|" + std::string(p_record.fields));
+  });
+  EXPECT_EQ(replayer.Run(), 8u);
+  ASSERT_EQ(lines.size(), 8u);
+  EXPECT_EQ(lines.front(), "CSCO|2021-03-05 10:00:00.123, 46.14, 120, NYSE_ARCA, Ask");
+  EXPECT_EQ(lines.back(), "MSFT|2021-03-05 10:00:00.134, 228.5, 120, NYSE_ARCA, Ask");
+}
+
+TEST_F(ReplayTest, SymbolFilters) {
+  Replayer replayer(merged_);
+  std::vector<std::string> order;
+  size_t msft = 0;
+  replayer.Subscribe([&](const ReplayRecord& p_record) {
+    EXPECT_EQ(p_record.symbol, "MSFT");
+    EXPECT_EQ(p_record.timestamp.size(), 23u);
+    ++msft;
+    order.push_back("msft");
+  }, {"MSFT", "AAPL"});
+  replayer.Subscribe([&](const ReplayRecord&) { order.push_back("all"); });
+  EXPECT_EQ(replayer.Run(), 8u);
+  EXPECT_EQ(msft, 4u);
+  EXPECT_EQ(replayer.GetRecordsRead(), 8u);
+  // Subscription order within one record
+  EXPECT_EQ(order[2], "msft");
+  EXPECT_EQ(order[3], "all");
+
+  // Filtered subscribers only, the other symbol is skipped entirely
+  Replayer filtered(merged_);
+  size_t csco = 0;
+  filtered.Subscribe([&](const ReplayRecord&) { ++csco; }, {"CSCO"});
+  EXPECT_EQ(filtered.Run(), 4u);
+  EXPECT_EQ(csco, 4u);
+}
+
+TEST_F(ReplayTest, ScaledPacing) {
+  std::ofstream(merged_)
+    << "Symbol, Timestamp, Price, Size, Exchange, Type\n"
+       "CSCO, 2021-03-05 10:00:00.000, 46.14, 120, NYSE_ARCA, Ask\n"
+       "MSFT, 2021-03-05 10:00:00.400, 228.5, 120, NYSE, Ask\n";
+  Replayer replayer(merged_, Replayer::Mode::Scaled, 4.0);
+  std::vector<int64_t> millis;
+  replayer.Subscribe([&](const ReplayRecord& p_record) { millis.push_back(p_record.millis); });
+  const auto start = std::chrono::steady_clock::now();
+  EXPECT_EQ(replayer.Run(), 2u);
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  // 400ms recorded at 4x
+  EXPECT_GE(elapsed, std::chrono::milliseconds(100));
+  EXPECT_LT(elapsed, std::chrono::milliseconds(400));
+  ASSERT_EQ(millis.size(), 2u);
+  EXPECT_EQ(millis[1] - millis[0], 400);
+}
+
+TEST_F(ReplayTest, InvalidFiles) {
+  Replayer missing(test_dir_ + "/missing.txt");
+  EXPECT_FALSE(missing.IsValid());
+  EXPECT_EQ(missing.GetLastError(), Replayer::Error::FileOpenFailed);
+  EXPECT_EQ(missing.Run(), 0u);
+
+  std::ofstream(test_dir_ + "/input.txt") << "Timestamp, Price, Size, Exchange, Type\n";
+  Replayer input(test_dir_ + "/input.txt");
+  EXPECT_EQ(input.GetLastError(), Replayer::Error::NotMergedOutput);
+}
+
+TEST_F(ReplayTest, BinaryRunsAreMergedAndDecoded) {
+  const int64_t base = MktData::TimestampToMillis("2021-03-05 10:00:00.123");
+  const auto make = [base](int64_t p_offset, int64_t p_price) {
+    MktDataRecord record;
+    record.timestamp = base + p_offset;
+    record.price = p_price;
+    record.size = 100;
+    return record;
+  };
+  const std::vector<MktDataRecord> msft = {make(0, 1), make(10, 2), make(11, 3)};
+  const std::vector<MktDataRecord> csco = {make(0, 4), make(7, 5)};
+  const std::string msft_run = test_dir_ + "/MSFT.run";
+  const std::string csco_run = test_dir_ + "/CSCO.run";
+  ASSERT_TRUE(WriteRecordRun(msft_run, msft));
+  ASSERT_TRUE(WriteRecordRun(csco_run, csco));
+
+  Replayer replayer(std::vector<std::string>{msft_run, csco_run});
+  ASSERT_TRUE(replayer.IsValid());
+  std::vector<std::string> order;
+  replayer.Subscribe([&](const ReplayRecord& p_record) {
+    ASSERT_NE(p_record.record, nullptr);
+    EXPECT_EQ(p_record.millis, p_record.record->timestamp);
+    EXPECT_EQ(MktData::TimestampToMillis(p_record.timestamp), p_record.millis);
+    EXPECT_TRUE(p_record.fields.empty());
+    order.push_back(std::string(p_record.symbol) + std::to_string(p_record.record->price));
+  });
+  EXPECT_EQ(replayer.Run(), 5u);
+  // (timestamp, symbol) order across the runs
+  EXPECT_EQ(order, (std::vector<std::string>{"CSCO4", "MSFT1", "CSCO5", "MSFT2", "MSFT3"}));
+
+  // Runs of other symbols are not even opened
+  std::ofstream(test_dir_ + "/IBM.run") << "not a run";
+  Replayer filtered(std::vector<std::string>{msft_run, csco_run, test_dir_ + "/IBM.run"});
+  size_t count = 0;
+  filtered.Subscribe([&](const ReplayRecord& p_record) {
+    EXPECT_EQ(p_record.symbol, "MSFT");
+    if (++count == 2) filtered.Stop();
+  }, {"MSFT"});
+  EXPECT_EQ(filtered.Run(), 2u);
+  EXPECT_EQ(filtered.GetRecordsRead(), 2u);
+
+  Replayer invalid(std::vector<std::string>{msft_run, test_dir_ + "/IBM.run"});
+  invalid.Subscribe([](const ReplayRecord&) {});
+  EXPECT_EQ(invalid.Run(), 0u);
+  EXPECT_EQ(invalid.GetLastError(), Replayer::Error::NotRecordRun);
+}
@@ -0,0 +1,76 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../SPSCRing.hpp"
+
+using namespace sp;
+
+TEST(SPSCRingTest, TryPushAndPop) {
+  SPSCRing<int> ring(3);
+  EXPECT_EQ(ring.GetCapacity(), 4u);
+  EXPECT_FALSE(ring.TryPop().has_value());
+  for (int i = 0; i < 4; ++i) EXPECT_TRUE(ring.TryPush(i));
+  EXPECT_FALSE(ring.TryPush(4));
+  EXPECT_EQ(ring.GetSize(), 4u);
+  for (int i = 0; i < 4; ++i) EXPECT_EQ(ring.TryPop(), i);
+  EXPECT_FALSE(ring.TryPop().has_value());
+  // Wraps around
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_TRUE(ring.TryPush(i));
+    EXPECT_EQ(ring.TryPop(), i);
+  }
+}
+
+TEST(SPSCRingTest, FailedPushKeepsValue) {
+  SPSCRing<std::string> ring(2);
+  EXPECT_TRUE(ring.TryPush("a"));
+  EXPECT_TRUE(ring.TryPush("b"));
+  std::thread consumer([&ring] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_EQ(ring.Pop(), "a");
+  });
+  // Blocks until the consumer makes room, then pushes the original value
+  EXPECT_TRUE(ring.Push(std::string(100, 'x')));
+  consumer.join();
+  EXPECT_EQ(ring.Pop(), "b");
+  EXPECT_EQ(ring.Pop(), std::string(100, 'x'));
+}
+
+TEST(SPSCRingTest, OrderedAcrossThreads) {
+  constexpr int kCount = 200000;
+  SPSCRing<int> ring(64);
+  std::thread producer([&ring] {
+    for (int i = 0; i < kCount; ++i) ASSERT_TRUE(ring.Push(i));
+    ring.Close();
+  });
+  int expected = 0;
+  while (auto value = ring.Pop()) {
+    ASSERT_EQ(*value, expected);
+    ++expected;
+  }
+  producer.join();
+  EXPECT_EQ(expected, kCount);
+}
+
+TEST(SPSCRingTest, CloseWakesBothSides) {
+  SPSCRing<int> empty(4);
+  std::thread consumer([&empty] { EXPECT_FALSE(empty.Pop().has_value()); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  empty.Close();
+  consumer.join();
+
+  SPSCRing<int> full(2);
+  full.TryPush(1);
+  full.TryPush(2);
+  std::thread producer([&full] { EXPECT_FALSE(full.Push(3)); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  full.Close();
+  producer.join();
+  // What was pushed before closing is still delivered
+  EXPECT_EQ(full.Pop(), 1);
+  EXPECT_EQ(full.Pop(), 2);
+  EXPECT_FALSE(full.Pop().has_value());
+  EXPECT_FALSE(full.Push(4));
+}
@@ -0,0 +1,221 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "../MergeJob.hpp"
+#include "../Replay.hpp"
+#include "../SymbolBitmaps.hpp"
+
+using namespace sp;
+
+class SymbolBitmapsTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    test_dir_ = "test_symbol_bitmaps";
+    std::filesystem::remove_all(test_dir_);
+    std::filesystem::create_directory(test_dir_);
+    output_ = test_dir_ + "/merged.txt";
+  }
+
+  void TearDown() override {
+    std::filesystem::remove_all(test_dir_);
+  }
+
+  static std::string Timestamp(size_t p_millis) {
+    char ts[32];
+    std::snprintf(ts, sizeof(ts), "2021-03-05 10:%02zu:%02zu.%03zu",
+                  (p_millis / 60000) % 60, (p_millis / 1000) % 60, p_millis % 1000);
+    return ts;
+  }
+
+  // An input active from p_begin_ms to p_end_ms, a line every 3 ms
+  void WriteInput(const std::string& p_symbol, size_t p_begin_ms, size_t p_end_ms) {
+    const std::string path = test_dir_ + "/" + p_symbol + ".txt";
+    std::ofstream out(path);
+    out << "Timestamp, Price, Size, Exchange, Type\n";
+    for (size_t ms = p_begin_ms; ms < p_end_ms; ms += 3) {
+      out << Timestamp(ms) << ", 1.5, " << ms << ", NYSE, Ask\n";
+    }
+    inputs_.push_back(path);
+  }
+
+  // Symbols published by a replay subscribed to p_symbols
+  std::vector<std::string> Replay(const std::vector<std::string>& p_symbols,
+                                  size_t* p_skipped = nullptr) const {
+    Replayer replayer(output_);
+    std::vector<std::string> lines;
+    replayer.Subscribe([&](const ReplayRecord& p_record) {
+      lines.push_back(std::string(p_record.symbol) + "|" + std::string(p_record.fields));
+    }, p_symbols);
+    replayer.Run();
+    if (p_skipped) *p_skipped = replayer.GetBlocksSkipped();
+    return lines;
+  }
+
+  std::string test_dir_;
+  std::string output_;
+  std::vector<std::string> inputs_;
+};
+
+TEST_F(SymbolBitmapsTest, WriterCutsBlocksAndSetsBits) {
+  std::vector<std::string> symbols;
+  for (int i = 0; i < 70; ++i) symbols.push_back("S" + std::to_string(100 + i));
+  SymbolBitmapWriter writer(symbols, 100);
+  writer.OnRecord(0, 10);
+  writer.OnRecord(65, 60);
+  writer.OnRecord(1, 110); // New block
+  writer.OnRecord(1, 150);
+  const auto& index = writer.Finish({180, 0});
+  ASSERT_EQ(index.GetWordCount(), 2u);
+  ASSERT_EQ(index.blocks.size(), 2u);
+  EXPECT_EQ(index.blocks[0].offset, 10u);
+  EXPECT_EQ(index.blocks[0].length, 100u);
+  EXPECT_EQ(index.blocks[1].offset, 110u);
+  EXPECT_EQ(index.blocks[1].length, 70u);
+
+  EXPECT_TRUE(index.Intersects(0, index.MakeMask({"S165"})));
+  EXPECT_FALSE(index.Intersects(1, index.MakeMask({"S165"})));
+  EXPECT_TRUE(index.Intersects(1, index.MakeMask({"S165", "S101"})));
+  EXPECT_FALSE(index.Intersects(0, index.MakeMask({"NOPE"})));
+  EXPECT_FALSE(index.FindSymbol("NOPE").has_value());
+
+  const std::string path = test_dir_ + "/index.sbm";
+  ASSERT_TRUE(index.Save(path));
+  auto loaded = SymbolBitmapIndex::Load(path);
+  ASSERT_TRUE(loaded.has_value());
+  EXPECT_EQ(loaded->symbols, symbols);
+  EXPECT_EQ(loaded->bits, index.bits);
+  loaded->Truncate(130);
+  ASSERT_EQ(loaded->blocks.size(), 2u);
+  EXPECT_EQ(loaded->blocks[1].length, 20u);
+  loaded->Truncate(110);
+  EXPECT_EQ(loaded->blocks.size(), 1u);
+  EXPECT_EQ(loaded->bits.size(), 2u);
+
+  std::ofstream(test_dir_ + "/bad.sbm") << "not an index";
+  EXPECT_FALSE(SymbolBitmapIndex::Load(test_dir_ + "/bad.sbm").has_value());
+  EXPECT_FALSE(SymbolBitmapIndex::Load(test_dir_ + "/missing.sbm").has_value());
+}
+
+TEST_F(SymbolBitmapsTest, ReplaySkipsBlocksWithoutSubscribedSymbols) {
+  // Symbols trading in different parts of the session
+  WriteInput("EARLY", 0, 3000);
+  WriteInput("LATE", 6000, 9000);
+  WriteInput("ALLDAY", 0, 9000);
+  MergeJob::Options options;
+  options.read_window = 4096;
+  options.symbol_bitmap_block_bytes = 4096;
+  {
+    MergeJob job(inputs_, output_, options);
+    ASSERT_TRUE(job.Run());
+  }
+  // Reference without bitmaps
+  const auto early = Replay({"EARLY"});
+  const auto late = Replay({"LATE"});
+  const auto all = Replay({});
+  ASSERT_FALSE(early.empty());
+
+  options.symbol_bitmaps = true;
+  {
+    MergeJob job(inputs_, output_, options);
+    ASSERT_TRUE(job.Run());
+  }
+  const auto index = SymbolBitmapIndex::Load(SymbolBitmapIndex::GetPath(output_));
+  ASSERT_TRUE(index.has_value());
+  EXPECT_EQ(index->symbols, (std::vector<std::string>{"ALLDAY", "EARLY", "LATE"}));
+  EXPECT_EQ(index->GetCoveredLength(), std::filesystem::file_size(output_));
+  EXPECT_GT(index->blocks.size(), 10u);
+
+  size_t skipped = 0;
+  EXPECT_EQ(Replay({"EARLY"}, &skipped), early);
+  // Between a third and two thirds of the blocks hold no EARLY record
+  EXPECT_GE(skipped, index->blocks.size() / 3);
+  EXPECT_EQ(Replay({"LATE"}, &skipped), late);
+  EXPECT_GE(skipped, index->blocks.size() / 3);
+  EXPECT_EQ(Replay({"EARLY", "LATE"}, &skipped), Replay({"LATE", "EARLY"}));
+  EXPECT_EQ(Replay({"NOPE"}, &skipped).size(), 0u);
+  EXPECT_EQ(skipped, index->blocks.size());
+  EXPECT_EQ(Replay({}, &skipped), all);
+  EXPECT_EQ(skipped, 0u);
+}
+
+TEST_F(SymbolBitmapsTest, ResumedMergeAndStaleIndex) {
+  WriteInput("EARLY", 0, 2000);
+  WriteInput("LATE", 4000, 6000);
+  WriteInput("ALLDAY", 0, 6000);
+  const std::string checkpoint = test_dir_ + "/merged.ckpt";
+  MergeJob::Options options;
+  options.read_window = 4096;
+  options.symbol_bitmaps = true;
+  options.symbol_bitmap_block_bytes = 2048;
+  options.checkpoint_path = checkpoint;
+  options.checkpoint_interval = 0;
+  {
+    MergeJob job(inputs_, output_, options);
+    ASSERT_TRUE(job.Open());
+    ASSERT_EQ(job.Step(1000), 1000u);
+    ASSERT_TRUE(job.Checkpoint());
+    // Written and indexed in memory, lost with the crash
+    ASSERT_EQ(job.Step(700), 700u);
+  }
+  {
+    MergeJob resumed(inputs_, output_, options);
+    ASSERT_TRUE(resumed.Run());
+  }
+  const auto index = SymbolBitmapIndex::Load(SymbolBitmapIndex::GetPath(output_));
+  ASSERT_TRUE(index.has_value());
+  EXPECT_EQ(index->GetCoveredLength(), std::filesystem::file_size(output_));
+  for (size_t i = 1; i < index->blocks.size(); ++i) {
+    EXPECT_EQ(index->blocks[i].offset, index->blocks[i - 1].offset + index->blocks[i - 1].length);
+  }
+
+  // Every record of a block is in its bitmap
+  std::ifstream in(output_);
+  std::string line;
+  std::getline(in, line);
+  size_t block = 0;
+  for (uint64_t offset = line.size() + 1; std::getline(in, line); offset += line.size() + 1) {
+    while (index->blocks[block].offset + index->blocks[block].length <= offset) ++block;
+    const std::string symbol = line.substr(0, line.find(','));
+    EXPECT_TRUE(index->Intersects(block, index->MakeMask({symbol}))) << offset;
+  }
+
+  size_t skipped = 0;
+  const auto early = Replay({"EARLY"}, &skipped);
+  EXPECT_EQ(early.size(), (2000u + 2) / 3);
+  EXPECT_GT(skipped, 0u);
+
+  // Bitmaps of an output rewritten since are ignored, same length or not
+  {
+    std::fstream out(output_, std::ios::in | std::ios::out | std::ios::binary);
+    out.seekp(-2, std::ios::end);
+    out.put('9');
+  }
+  {
+    Replayer replayer(output_);
+    EXPECT_TRUE(replayer.IsValid());
+    EXPECT_FALSE(replayer.HasSymbolBitmaps());
+  }
+  std::filesystem::resize_file(output_, std::filesystem::file_size(output_) / 2);
+  Replayer replayer(output_);
+  EXPECT_TRUE(replayer.IsValid());
+  EXPECT_FALSE(replayer.HasSymbolBitmaps());
+
+  // A fresh merge without bitmaps does not leave the old ones behind
+  options.symbol_bitmaps = false;
+  options.checkpoint_path.clear();
+  MergeJob job(inputs_, output_, options);
+  ASSERT_TRUE(job.Run());
+  EXPECT_FALSE(std::filesystem::exists(SymbolBitmapIndex::GetPath(output_)));
+}
+
+TEST_F(SymbolBitmapsTest, RejectedWithCompressedOutput) {
+  WriteInput("EARLY", 0, 100);
+  MergeJob::Options options;
+  options.symbol_bitmaps = true;
+  options.output_compression = CompressedWriter::Format::Gzip;
+  MergeJob job(inputs_, test_dir_ + "/merged.gz", options);
+  EXPECT_FALSE(job.Run());
+}
@@ -0,0 +1,127 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "../Dictionary.hpp"
+#include "../MktData.hpp"
+#include "../MergeJob.hpp"
+#include "../RecordSource.hpp"
+#include "../SymbolBlocks.hpp"
+
+using namespace sp;
+
+class SymbolBlocksTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    test_dir_ = "test_symbol_blocks";
+    std::filesystem::remove_all(test_dir_);
+    std::filesystem::create_directory(test_dir_);
+    output_ = test_dir_ + "/blocks.txt";
+  }
+
+  void TearDown() override {
+    std::filesystem::remove_all(test_dir_);
+  }
+
+  std::string WriteFile(const std::string& p_name, const std::string& p_content) {
+    const std::string path = test_dir_ + "/" + p_name;
+    std::ofstream(path, std::ios::binary) << p_content;
+    return path;
+  }
+
+  std::string test_dir_;
+  std::string output_;
+};
+
+TEST_F(SymbolBlocksTest, WritesOneBlockPerSymbolBehindTheDirectory) {
+  const std::vector<std::string> inputs = {
+    WriteFile("MSFT.txt", "Timestamp, Price, Size, Exchange, Type\n"
+                          "2021-03-05 10:00:00.100, 228.5, 120, NYSE, Ask\n"
+                          "2021-03-05 10:00:00.300, 228.4, 110, NASDAQ, Bid\n"),
+    WriteFile("AAPL.txt", "2021-03-05 10:00:00.200, 120.25, 5, NYSE, TRADE\n"),
+    WriteFile("IBM.txt", "Timestamp, Price, Size, Exchange, Type\n"),
+  };
+  // A second file of AAPL as a binary run, merged into the same block
+  MktDataRecord record;
+  record.timestamp = MktData::TimestampToMillis("2021-03-05 10:00:00.150");
+  record.price = 121'000'000;
+  record.size = 1;
+  record.exchange = GetExchangeDictionary().Encode("NSX");
+  record.type = static_cast<uint8_t>(GetTypeDictionary().Encode("Bid"));
+  ASSERT_TRUE(WriteRecordRun(test_dir_ + "/AAPL.rec", std::vector<MktDataRecord>{record}));
+  auto all_inputs = inputs;
+  all_inputs.push_back(test_dir_ + "/AAPL.rec");
+
+  const auto blocks = ExportSymbolBlocks(all_inputs, output_);
+  ASSERT_TRUE(blocks.has_value());
+  ASSERT_EQ(blocks->size(), 3u);
+  EXPECT_EQ((*blocks)[0].symbol, "AAPL");
+  EXPECT_EQ((*blocks)[0].records, 2u);
+  EXPECT_EQ((*blocks)[1].symbol, "IBM");
+  EXPECT_EQ((*blocks)[1].records, 0u);
+  EXPECT_EQ((*blocks)[1].length, 0u);
+  EXPECT_EQ((*blocks)[2].symbol, "MSFT");
+  EXPECT_EQ((*blocks)[2].records, 2u);
+
+  SymbolBlockFile file(output_);
+  ASSERT_TRUE(file.IsValid());
+  ASSERT_EQ(file.GetBlocks().size(), 3u);
+  EXPECT_EQ(file.GetBlocks()[0].offset, kSymbolBlocksHeaderSize + 3 * kSymbolBlockEntrySize +
+                                         MergeJob::kOutputHeader.size() + 1);
+  EXPECT_EQ(file.GetBlockData("AAPL"),
+            "AAPL, 2021-03-05 10:00:00.150, 121, 1, NSX, Bid\n"
+            "AAPL, 2021-03-05 10:00:00.200, 120.25, 5, NYSE, TRADE\n");
+  EXPECT_EQ(file.GetBlockData("MSFT"),
+            "MSFT, 2021-03-05 10:00:00.100, 228.5, 120, NYSE, Ask\n"
+            "MSFT, 2021-03-05 10:00:00.300, 228.4, 110, NASDAQ, Bid\n");
+  EXPECT_TRUE(file.GetBlockData("IBM").empty());
+  EXPECT_NE(file.FindBlock("IBM"), nullptr);
+  EXPECT_EQ(file.FindBlock("CSCO"), nullptr);
+
+  // A block is a plain slice of the file, e.g. for an MMF window
+  const auto* msft = file.FindBlock("MSFT");
+  ASSERT_NE(msft, nullptr);
+  std::ifstream in(output_, std::ios::binary);
+  std::string slice(msft->length, '\0');
+  in.seekg(static_cast<std::streamoff>(msft->offset));
+  in.read(slice.data(), static_cast<std::streamsize>(slice.size()));
+  EXPECT_EQ(slice, file.GetBlockData("MSFT"));
+  EXPECT_EQ(std::filesystem::file_size(output_), msft->offset + msft->length);
+}
+
+TEST_F(SymbolBlocksTest, FilterSelectsSymbolsAndRecords) {
+  const std::vector<std::string> inputs = {
+    WriteFile("MSFT.txt", "2021-03-05 10:00:00.100, 228.5, 120, NYSE, Ask\n"
+                          "2021-03-05 10:00:00.300, 228.4, 110, NASDAQ, TRADE\n"),
+    WriteFile("AAPL.txt", "2021-03-05 10:00:00.200, 120.25, 5, NYSE, TRADE\n"),
+  };
+  InputFilter filter;
+  filter.SetSymbols({"MSFT"}).SetTypes({"TRADE"});
+  const auto blocks = ExportSymbolBlocks(inputs, output_, &filter);
+  ASSERT_TRUE(blocks.has_value());
+  ASSERT_EQ(blocks->size(), 1u);
+  SymbolBlockFile file(output_);
+  ASSERT_TRUE(file.IsValid());
+  EXPECT_EQ(file.GetBlockData("MSFT"), "MSFT, 2021-03-05 10:00:00.300, 228.4, 110, NASDAQ, TRADE\n");
+}
+
+TEST_F(SymbolBlocksTest, RejectsBadInputsAndDirectories) {
+  EXPECT_FALSE(ExportSymbolBlocks({WriteFile("AVERYLONGSYMBOLNAME.txt", "")}, output_).has_value());
+  EXPECT_FALSE(ExportSymbolBlocks({test_dir_ + "/MISSING.txt"}, output_).has_value());
+
+  EXPECT_EQ(SymbolBlockFile(test_dir_ + "/none.txt").GetLastError(),
+            SymbolBlockFile::Error::FileOpenFailed);
+  EXPECT_EQ(SymbolBlockFile(WriteFile("plain.txt", "Symbol, Timestamp\n")).GetLastError(),
+            SymbolBlockFile::Error::InvalidDirectory);
+
+  ASSERT_TRUE(ExportSymbolBlocks({WriteFile("MSFT.txt", "2021-03-05 10:00:00.100, 1, 1, NYSE, Ask\n")},
+                                 output_).has_value());
+  std::ifstream in(output_, std::ios::binary);
+  std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  // Offset beyond the end of the file
+  content.replace(kSymbolBlocksHeaderSize + 1 + kMaxBlockSymbolLength + 1, 20,
+                  std::string(9, ' ') + "99999999999");
+  EXPECT_EQ(SymbolBlockFile(WriteFile("cut.txt", content)).GetLastError(),
+            SymbolBlockFile::Error::InvalidDirectory);
+}
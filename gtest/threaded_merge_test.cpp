@@ -0,0 +1,139 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../MemoryBudget.hpp"
+#include "../MergeJob.hpp"
+#include "../ThreadedMerge.hpp"
+
+using namespace sp;
+
+class ThreadedMergeTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    test_dir_ = "test_threaded_merge_files";
+    std::filesystem::remove_all(test_dir_);
+    std::filesystem::create_directory(test_dir_);
+    output_ = test_dir_ + "/merged.txt";
+  }
+
+  void TearDown() override {
+    std::filesystem::remove_all(test_dir_);
+  }
+
+  static std::string ReadFile(const std::string& p_path) {
+    std::ifstream in(p_path);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+  }
+
+  // Interleaved timestamps with ties across symbols
+  void WriteInputs(size_t p_symbols, size_t p_lines) {
+    inputs_.clear();
+    for (size_t s = 0; s < p_symbols; ++s) {
+      const std::string path = test_dir_ + "/SYM" + std::to_string(s) + ".txt";
+      std::ofstream out(path);
+      out << "Timestamp, Price, Size, Exchange, Type\n";
+      for (size_t i = 0; i < p_lines; ++i) {
+        const size_t ms = i * 3 + (s % 4);
+        char ts[32];
+        std::snprintf(ts, sizeof(ts), "2021-03-05 10:%02zu:%02zu.%03zu",
+                      (ms / 60000) % 60, (ms / 1000) % 60, ms % 1000);
+        out << ts << ", " << 100 + s << "." << i % 100 << ", " << i
+            << (i % 2 ? ", NYSE, Ask\n" : ", NASDAQ, TRADE\n");
+      }
+      inputs_.push_back(path);
+    }
+  }
+
+  std::string MergeJobOutput(const InputFilter& p_filter = {}) {
+    const std::string expected = test_dir_ + "/expected.txt";
+    MergeJob::Options options;
+    options.filter = p_filter;
+    MergeJob job(inputs_, expected, options);
+    EXPECT_TRUE(job.Run());
+    return ReadFile(expected);
+  }
+
+  std::string test_dir_;
+  std::vector<std::string> inputs_;
+  std::string output_;
+};
+
+TEST_F(ThreadedMergeTest, MatchesMergeJob) {
+  WriteInputs(9, 2000);
+  const auto expected = MergeJobOutput();
+  for (size_t threads : {1u, 3u, 0u}) {
+    ThreadedMerge::Options options;
+    options.reader_threads = threads;
+    options.batch_bytes = 1000; // Many batches and full rings
+    options.ring_batches = 2;
+    options.read_window = 8192;
+    ThreadedMerge merge(inputs_, output_, options);
+    ASSERT_TRUE(merge.Run());
+    EXPECT_EQ(merge.GetRecordsWritten(), 9u * 2000u);
+    if (threads != 0) {
+      EXPECT_EQ(merge.GetReaderThreads(), threads);
+    }
+    EXPECT_EQ(ReadFile(output_), expected) << threads << " threads";
+  }
+}
+
+TEST_F(ThreadedMergeTest, AppliesFilter) {
+  WriteInputs(5, 500);
+  InputFilter filter;
+  filter.SetSymbols({"SYM1", "SYM3", "SYM4"})
+        .SetTimeRange("2021-03-05 10:00:00.300", "2021-03-05 10:00:01.000")
+        .SetTypes({"TRADE"});
+  const auto expected = MergeJobOutput(filter);
+
+  ThreadedMerge::Options options;
+  options.filter = filter;
+  options.pin_threads = true;
+  ThreadedMerge merge(inputs_, output_, options);
+  ASSERT_TRUE(merge.Run());
+  EXPECT_GT(merge.GetRecordsWritten(), 0u);
+  EXPECT_EQ(ReadFile(output_), expected);
+}
+
+TEST_F(ThreadedMergeTest, DerivesSizesFromMemoryBudget) {
+  WriteInputs(4, 100);
+  {
+    ThreadedMerge merge(inputs_, output_);
+    ASSERT_TRUE(merge.Run());
+    // The budget is probed again here, available memory moves in between
+    const MemoryBudget budget;
+    const auto& options = merge.GetOptions();
+    EXPECT_GE(options.read_window, 64u * 1024);
+    EXPECT_LE(options.read_window,
+              std::max<size_t>(budget.GetStageBudget(MemoryBudget::Stage::ReadWindows) / 2,
+                               64 * 1024));
+    EXPECT_GE(options.batch_bytes, 4u * 1024);
+    EXPECT_LE(options.batch_bytes, 256u * 1024);
+  }
+  ThreadedMerge::Options options;
+  options.read_window = 8192;
+  options.batch_bytes = 1000;
+  ThreadedMerge merge(inputs_, output_, options);
+  ASSERT_TRUE(merge.Run());
+  EXPECT_EQ(merge.GetOptions().read_window, 8192u);
+  EXPECT_EQ(merge.GetOptions().batch_bytes, 1000u);
+}
+
+TEST_F(ThreadedMergeTest, EmptyAndMissingInputs) {
+  WriteInputs(2, 10);
+  std::ofstream(test_dir_ + "/EMPTY.txt") << "";
+  inputs_.push_back(test_dir_ + "/EMPTY.txt");
+  const auto expected = MergeJobOutput();
+  {
+    ThreadedMerge merge(inputs_, output_);
+    ASSERT_TRUE(merge.Run());
+    EXPECT_EQ(ReadFile(output_), expected);
+  }
+  inputs_.push_back(test_dir_ + "/MISSING.txt");
+  ThreadedMerge merge(inputs_, output_);
+  EXPECT_FALSE(merge.Run());
+}
@@ -0,0 +1,231 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "../Checkpoint.hpp"
+#include "../MergeJob.hpp"
+#include "../TimeIndex.hpp"
+
+using namespace sp;
+
+class TimeIndexTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    test_dir_ = "test_time_index";
+    std::filesystem::remove_all(test_dir_);
+    std::filesystem::create_directory(test_dir_);
+    output_ = test_dir_ + "/merged.txt";
+  }
+
+  void TearDown() override {
+    std::filesystem::remove_all(test_dir_);
+  }
+
+  static std::string Timestamp(size_t p_millis) {
+    char ts[32];
+    std::snprintf(ts, sizeof(ts), "2021-03-05 10:%02zu:%02zu.%03zu",
+                  (p_millis / 60000) % 60, (p_millis / 1000) % 60, p_millis % 1000);
+    return ts;
+  }
+
+  // p_symbols inputs with a line every 7 ms, ~p_seconds seconds of data
+  void WriteInputs(size_t p_symbols, size_t p_seconds) {
+    for (size_t s = 0; s < p_symbols; ++s) {
+      const std::string path = test_dir_ + "/SYM" + std::to_string(s) + ".txt";
+      std::ofstream out(path);
+      out << "Timestamp, Price, Size, Exchange, Type\n";
+      for (size_t ms = s; ms < p_seconds * 1000; ms += 7) {
+        out << Timestamp(ms) << ", 1.5, " << ms << ", NYSE, Ask\n";
+      }
+      inputs_.push_back(path);
+    }
+  }
+
+  // Every data line of the output
+  std::vector<std::string> ReadOutput() const {
+    std::ifstream in(output_);
+    std::vector<std::string> lines;
+    std::string line;
+    std::getline(in, line); // Header
+    while (std::getline(in, line)) lines.push_back(line);
+    return lines;
+  }
+
+  std::string test_dir_;
+  std::string output_;
+  std::vector<std::string> inputs_;
+};
+
+TEST_F(TimeIndexTest, WriterAddsSecondsAndRecordIntervals) {
+  TimeIndexWriter writer(3);
+  uint64_t offset = 0;
+  const std::vector<std::string> timestamps = {
+    "2021-03-05 10:00:00.100", "2021-03-05 10:00:00.200", "2021-03-05 10:00:00.300",
+    "2021-03-05 10:00:00.400", // 3 records since the last entry
+    "2021-03-05 10:00:01.000", // New second
+    "2021-03-05 10:00:01.001"};
+  for (size_t i = 0; i < timestamps.size(); ++i) {
+    writer.OnRecord(timestamps[i], offset, i);
+    offset += 50;
+  }
+  const auto& entries = writer.GetIndex().entries;
+  ASSERT_EQ(entries.size(), 3u);
+  EXPECT_EQ(entries[0].ordinal, 0u);
+  EXPECT_EQ(entries[1].ordinal, 3u);
+  EXPECT_EQ(entries[1].offset, 150u);
+  EXPECT_EQ(entries[2].ordinal, 4u);
+  EXPECT_EQ(entries[2].millis, MktData::TimestampToMillis("2021-03-05 10:00:01.000"));
+
+  const TimeIndex& index = writer.GetIndex();
+  EXPECT_EQ(index.FindBefore(entries[0].millis), nullptr);
+  EXPECT_EQ(index.FindBefore(entries[2].millis), &entries[1]);
+  EXPECT_EQ(index.FindBefore(entries[2].millis + 1), &entries[2]);
+
+  TimeIndex copy = index;
+  copy.Truncate(150);
+  EXPECT_EQ(copy.entries.size(), 1u);
+}
+
+TEST_F(TimeIndexTest, SaveLoadRoundTrip) {
+  TimeIndex index;
+  index.entries = {{1, 10, 0}, {2, 20, 5}};
+  const std::string path = test_dir_ + "/index.tidx";
+  ASSERT_TRUE(index.Save(path));
+  const auto loaded = TimeIndex::Load(path);
+  ASSERT_TRUE(loaded.has_value());
+  ASSERT_EQ(loaded->entries.size(), 2u);
+  EXPECT_EQ(loaded->entries[1].offset, 20u);
+  EXPECT_EQ(loaded->entries[1].ordinal, 5u);
+
+  std::ofstream(test_dir_ + "/bad.tidx") << "not an index";
+  EXPECT_FALSE(TimeIndex::Load(test_dir_ + "/bad.tidx").has_value());
+  EXPECT_FALSE(TimeIndex::Load(test_dir_ + "/missing.tidx").has_value());
+}
+
+TEST_F(TimeIndexTest, ReaderStartsAtTimeFromMergeIndex) {
+  WriteInputs(5, 20);
+  MergeJob::Options options;
+  options.read_window = 4096;
+  options.time_index = true;
+  options.time_index_records = 1000;
+  MergeJob job(inputs_, output_, options);
+  ASSERT_TRUE(job.Run());
+
+  const auto lines = ReadOutput();
+  ASSERT_EQ(lines.size(), job.GetRecordsWritten());
+  IndexedOutputReader reader(output_, {}, 64 * 1024);
+  ASSERT_TRUE(reader.IsValid());
+  // An entry per second at least, more for the record interval
+  EXPECT_GE(reader.GetIndex().entries.size(), 20u);
+
+  for (const size_t start_ms : {0u, 1u, 999u, 1000u, 7777u, 14003u, 19990u}) {
+    const std::string start = Timestamp(start_ms);
+    ASSERT_TRUE(reader.SeekToTime(start)) << start;
+    size_t expected = 0;
+    while (expected < lines.size() && MktData::GetField(lines[expected], 1) < start) ++expected;
+    EXPECT_EQ(reader.GetRecordOrdinal(), expected) << start;
+    // Less than a second of data scanned to get there
+    EXPECT_LE(reader.GetScannedLines(), 5u * 1000 / 7 + 5) << start;
+    const auto line = reader.ReadLineView();
+    ASSERT_TRUE(line.has_value());
+    EXPECT_EQ(*line, lines[expected]) << start;
+    EXPECT_EQ(reader.GetRecordOrdinal(), expected + 1);
+  }
+  // Reads on to the end
+  ASSERT_TRUE(reader.SeekToTime(Timestamp(19000)));
+  size_t count = 0;
+  while (reader.ReadLineView()) ++count;
+  EXPECT_EQ(reader.GetRecordOrdinal(), lines.size());
+  EXPECT_GT(count, 0u);
+  EXPECT_FALSE(reader.SeekToTime("2021-03-05 11:00:00.000"));
+}
+
+TEST_F(TimeIndexTest, ResumedMergeKeepsIndexConsistent) {
+  WriteInputs(3, 10);
+  const std::string checkpoint = test_dir_ + "/merged.ckpt";
+  MergeJob::Options options;
+  options.read_window = 4096;
+  options.time_index = true;
+  options.time_index_records = 100;
+  options.checkpoint_path = checkpoint;
+  options.checkpoint_interval = 0;
+  {
+    MergeJob job(inputs_, output_, options);
+    ASSERT_TRUE(job.Open());
+    ASSERT_EQ(job.Step(1500), 1500u);
+    ASSERT_TRUE(job.Checkpoint());
+    // Written and indexed in memory, lost with the crash
+    ASSERT_EQ(job.Step(700), 700u);
+  }
+  MergeJob resumed(inputs_, output_, options);
+  ASSERT_TRUE(resumed.Run());
+
+  const auto lines = ReadOutput();
+  const auto index = TimeIndex::Load(TimeIndex::GetPath(output_));
+  ASSERT_TRUE(index.has_value());
+  std::ifstream in(output_);
+  const std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  uint64_t previous = 0;
+  for (const auto& entry : index->entries) {
+    EXPECT_GE(entry.offset, previous);
+    previous = entry.offset;
+    ASSERT_LT(entry.ordinal, lines.size());
+    // Every entry points at the start of the line of its ordinal
+    EXPECT_EQ(content.substr(entry.offset, lines[entry.ordinal].size()), lines[entry.ordinal]);
+    EXPECT_EQ(entry.millis, MktData::TimestampToMillis(MktData::GetField(lines[entry.ordinal], 1)));
+  }
+}
+
+TEST_F(TimeIndexTest, StaleIndexIsIgnoredOrRemoved) {
+  WriteInputs(3, 5);
+  MergeJob::Options options;
+  options.time_index = true;
+  options.time_index_records = 100;
+  {
+    MergeJob job(inputs_, output_, options);
+    ASSERT_TRUE(job.Run());
+  }
+  const auto index = TimeIndex::Load(TimeIndex::GetPath(output_));
+  ASSERT_TRUE(index.has_value());
+  EXPECT_EQ(index->output.length, std::filesystem::file_size(output_));
+  EXPECT_TRUE(index->output.Matches(output_));
+
+  // Same length, different bytes: the entries no longer point at lines
+  auto lines = ReadOutput();
+  const auto target = lines[lines.size() / 2];
+  std::rotate(lines.begin(), lines.begin() + 1, lines.end());
+  {
+    std::ofstream out(output_, std::ios::trunc);
+    out << MergeJob::kOutputHeader << "\n";
+    for (const auto& line : lines) out << line << "\n";
+  }
+  ASSERT_EQ(std::filesystem::file_size(output_), index->output.length);
+  IndexedOutputReader reader(output_);
+  EXPECT_EQ(reader.GetLastError(), IndexedOutputReader::Error::None);
+  EXPECT_TRUE(reader.GetIndex().entries.empty());
+  // Scans from the beginning instead
+  ASSERT_TRUE(reader.SeekToTime(MktData::GetField(target, 1)));
+
+  // A fresh merge without an index does not leave the old one behind
+  options.time_index = false;
+  MergeJob job(inputs_, output_, options);
+  ASSERT_TRUE(job.Run());
+  EXPECT_FALSE(std::filesystem::exists(TimeIndex::GetPath(output_)));
+}
+
+TEST_F(TimeIndexTest, MissingIndexAndCompressedOutput) {
+  std::ofstream(output_) << MergeJob::kOutputHeader << "\n";
+  IndexedOutputReader reader(output_);
+  EXPECT_EQ(reader.GetLastError(), IndexedOutputReader::Error::IndexMissing);
+  EXPECT_FALSE(reader.SeekToTime("2021-03-05 10:00:00.000"));
+
+  WriteInputs(1, 1);
+  MergeJob::Options options;
+  options.time_index = true;
+  options.output_compression = CompressedWriter::Format::Gzip;
+  MergeJob job(inputs_, test_dir_ + "/merged.gz", options);
+  EXPECT_FALSE(job.Run());
+}
@@ -0,0 +1,57 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include "../utils.hpp"
+
+using namespace sp;
+
+TEST(UtilsTest, ParseCpuList) {
+  EXPECT_EQ(ParseCpuList("0-3,8-11,16"),
+            (std::vector<unsigned int>{0, 1, 2, 3, 8, 9, 10, 11, 16}));
+  EXPECT_EQ(ParseCpuList("5"), (std::vector<unsigned int>{5}));
+  // As read from sysfs, with the trailing newline
+  EXPECT_EQ(ParseCpuList("0-1\n"), (std::vector<unsigned int>{0, 1}));
+  EXPECT_TRUE(ParseCpuList("").empty());
+  EXPECT_TRUE(ParseCpuList("\n").empty());
+  // Malformed ranges are skipped, the rest is kept
+  EXPECT_EQ(ParseCpuList("x,2,a-b,4-5"), (std::vector<unsigned int>{2, 4, 5}));
+}
+
+TEST(UtilsTest, PlanCpuPlacementFillsPreferredNodeFirst) {
+  const std::vector<NumaNode> nodes = {{0, {0, 1, 2, 3}}, {1, {4, 5, 6, 7}}};
+  EXPECT_EQ(PlanCpuPlacement(nodes, 2, 0), (std::vector<unsigned int>{0, 1}));
+  EXPECT_EQ(PlanCpuPlacement(nodes, 2, 1), (std::vector<unsigned int>{4, 5}));
+  // Spills over to the other node in id order
+  EXPECT_EQ(PlanCpuPlacement(nodes, 6, 1), (std::vector<unsigned int>{4, 5, 6, 7, 0, 1}));
+  // Round-robin once every cpu has a thread
+  EXPECT_EQ(PlanCpuPlacement(nodes, 10, 0),
+            (std::vector<unsigned int>{0, 1, 2, 3, 4, 5, 6, 7, 0, 1}));
+  // Unknown preferred node keeps the id order
+  EXPECT_EQ(PlanCpuPlacement(nodes, 5, 9), (std::vector<unsigned int>{0, 1, 2, 3, 4}));
+  EXPECT_TRUE(PlanCpuPlacement(nodes, 0, 0).empty());
+  EXPECT_TRUE(PlanCpuPlacement(std::vector<NumaNode>{}, 4, 0).empty());
+}
+
+TEST(UtilsTest, RealTopologyAndPinning) {
+  const auto nodes = GetNumaTopology();
+  ASSERT_FALSE(nodes.empty());
+  EXPECT_EQ(GetNumaNodeCount(), nodes.size());
+  const auto placement = PlanCpuPlacement(3, nodes.front().id);
+  ASSERT_EQ(placement.size(), 3u);
+  EXPECT_NE(std::find(nodes.front().cpus.begin(), nodes.front().cpus.end(), placement[0]),
+            nodes.front().cpus.end());
+
+  // On a thread of its own, the test runner keeps its affinity
+  std::thread([&nodes]() {
+    const auto saved = GetCurrentThreadCpus();
+    ASSERT_FALSE(saved.empty());
+    ASSERT_TRUE(PinCurrentThreadToNumaNode(nodes.front().id));
+    EXPECT_EQ(GetCurrentThreadCpus(), nodes.front().cpus);
+    ASSERT_TRUE(PinCurrentThreadToCpu(nodes.front().cpus.front()));
+    EXPECT_EQ(GetCurrentThreadCpus(), (std::vector<unsigned int>{nodes.front().cpus.front()}));
+    ASSERT_TRUE(PinCurrentThreadToCpus(saved));
+    EXPECT_EQ(GetCurrentThreadCpus(), saved);
+    EXPECT_FALSE(PinCurrentThreadToCpus({}));
+  }).join();
+}
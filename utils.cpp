@@ -1,11 +1,58 @@
-#pragma once
-#include <thread>
+#include "utils.hpp"
+
+#include <algorithm>
+#include <filesystem>
 #include <fstream>
-#include <string>
+#include <pthread.h>
+#include <sched.h>
 #include <sstream>
-#include <algorithm>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+#include "MemoryBudget.hpp"
 
 namespace  sp {
+  namespace {
+    std::vector<unsigned int> GetAllowedCpus() {
+      std::vector<unsigned int> cpus;
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (unsigned int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+          if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+        }
+      }
+      if (cpus.empty()) {
+        for (unsigned int cpu = 0; cpu < GetCpuCoreCount(); ++cpu)
+          cpus.push_back(cpu);
+      }
+      return cpus;
+    }
+  } // namespace
+
+  std::vector<unsigned int> ParseCpuList(const std::string& p_list) {
+    std::vector<unsigned int> cpus;
+    std::istringstream iss(p_list);
+    std::string range;
+    while (std::getline(iss, range, ',')) {
+      if (range.empty() || range == "\n") continue;
+      const auto dash = range.find('-');
+      try {
+        if (dash == std::string::npos) {
+          cpus.push_back(std::stoul(range));
+        } else {
+          const auto first = std::stoul(range.substr(0, dash));
+          const auto last = std::stoul(range.substr(dash + 1));
+          for (auto cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+        }
+      } catch (const std::exception&) {
+        // Ignore malformed ranges, sysfs is authoritative enough
+      }
+    }
+    return cpus;
+  }
+
   unsigned int GetCpuCoreCount() {
     return std::max(1u, std::thread::hardware_concurrency());
   }
@@ -25,11 +72,114 @@ namespace  sp {
     return 0;
   }
 
-  // Returns the max assignable memory per thread in bytes
+  // Returns the max assignable memory per thread in bytes, bounded by the
+  // cgroup limit and MemAvailable rather than MemTotal
   size_t GetMaxMemoryPerThread() {
-    size_t total_mem = GetTotalSystemMemory();
-    unsigned int cores = GetCpuCoreCount();
-    if (cores == 0) return 0;
-    return total_mem / cores;
+    const MemoryBudget budget;
+    return budget.GetTotalBudget() / budget.GetEffectiveCpuCount();
+  }
+
+  std::vector<NumaNode> GetNumaTopology() {
+    const auto allowed = GetAllowedCpus();
+    std::vector<NumaNode> nodes;
+
+    std::error_code ec;
+    const std::filesystem::path root("/sys/devices/system/node");
+    for (const auto& entry : std::filesystem::directory_iterator(root, ec)) {
+      const auto name = entry.path().filename().string();
+      if (name.rfind("node", 0) != 0 || name.size() == 4 ||
+          !std::all_of(name.begin() + 4, name.end(), ::isdigit)) {
+        continue;
+      }
+      std::ifstream cpulist(entry.path() / "cpulist");
+      std::string list;
+      std::getline(cpulist, list);
+
+      NumaNode node{static_cast<unsigned int>(std::stoul(name.substr(4))), {}};
+      for (const auto cpu : ParseCpuList(list)) {
+        if (std::find(allowed.begin(), allowed.end(), cpu) != allowed.end())
+          node.cpus.push_back(cpu);
+      }
+      // Memory-only nodes and nodes outside our affinity are of no use
+      if (!node.cpus.empty()) nodes.push_back(std::move(node));
+    }
+
+    if (nodes.empty()) {
+      nodes.push_back({0, allowed});
+    }
+    std::sort(nodes.begin(), nodes.end(),
+              [](const NumaNode& a, const NumaNode& b) { return a.id < b.id; });
+    return nodes;
+  }
+
+  unsigned int GetNumaNodeCount() {
+    return static_cast<unsigned int>(GetNumaTopology().size());
+  }
+
+  std::vector<unsigned int> PlanCpuPlacement(size_t thread_count,
+                                             unsigned int preferred_node) {
+    return PlanCpuPlacement(GetNumaTopology(), thread_count, preferred_node);
+  }
+
+  std::vector<unsigned int> PlanCpuPlacement(std::vector<NumaNode> nodes,
+                                             size_t thread_count,
+                                             unsigned int preferred_node) {
+    std::stable_partition(nodes.begin(), nodes.end(),
+      [preferred_node](const NumaNode& n) { return n.id == preferred_node; });
+
+    std::vector<unsigned int> order;
+    for (const auto& node : nodes) {
+      order.insert(order.end(), node.cpus.begin(), node.cpus.end());
+    }
+
+    std::vector<unsigned int> placement;
+    if (order.empty()) return placement;
+    placement.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; ++i) {
+      placement.push_back(order[i % order.size()]);
+    }
+    return placement;
+  }
+
+  bool PinCurrentThreadToCpu(unsigned int cpu) {
+    if (cpu >= CPU_SETSIZE) return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+  }
+
+  bool PinCurrentThreadToNumaNode(unsigned int node) {
+    for (const auto& numa_node : GetNumaTopology()) {
+      if (numa_node.id != node) continue;
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      for (const auto cpu : numa_node.cpus) {
+        if (cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+      }
+      return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+    }
+    return false;
+  }
+
+  std::vector<unsigned int> GetCurrentThreadCpus() {
+    std::vector<unsigned int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (pthread_getaffinity_np(pthread_self(), sizeof(set), &set) != 0) return cpus;
+    for (unsigned int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+    }
+    return cpus;
+  }
+
+  bool PinCurrentThreadToCpus(const std::vector<unsigned int>& cpus) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (const auto cpu : cpus) {
+      if (cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+    }
+    if (CPU_COUNT(&set) == 0) return false;
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
   }
-};// namespace sp
\ No newline at end of file
+};// namespace sp
@@ -1,8 +1,45 @@
 #ifndef UTILS_HPP
 #define UTILS_HPP
+#include <cstddef>
+#include <string>
+#include <vector>
 
 namespace sp {
   unsigned int GetCpuCoreCount();
   size_t GetTotalSystemMemory();
   size_t GetMaxMemoryPerThread();
-}
\ No newline at end of file
+
+  // NUMA topology probe (Linux sysfs). Machines without NUMA information are
+  // reported as a single node owning every CPU the process may run on.
+  struct NumaNode {
+    unsigned int id;
+    std::vector<unsigned int> cpus;
+  };
+
+  std::vector<NumaNode> GetNumaTopology();
+  unsigned int GetNumaNodeCount();
+
+  // Parses a sysfs cpulist such as "0-3,8-11,16", malformed ranges are
+  // skipped
+  std::vector<unsigned int> ParseCpuList(const std::string& p_list);
+
+  // Returns cpus for thread_count threads, filling preferred_node first and
+  // then spilling over to the remaining nodes in id order. Cpus are reused
+  // round-robin when there are more threads than cpus. Buffers a pinned
+  // thread allocates and fills are first touched there, so they end up on
+  // its node without an explicit memory policy.
+  std::vector<unsigned int> PlanCpuPlacement(size_t thread_count,
+                                             unsigned int preferred_node = 0);
+  // Same for a given topology
+  std::vector<unsigned int> PlanCpuPlacement(std::vector<NumaNode> nodes,
+                                             size_t thread_count,
+                                             unsigned int preferred_node = 0);
+
+  bool PinCurrentThreadToCpu(unsigned int cpu);
+  bool PinCurrentThreadToNumaNode(unsigned int node);
+  // Affinity of the calling thread, to restore it after pinning
+  std::vector<unsigned int> GetCurrentThreadCpus();
+  bool PinCurrentThreadToCpus(const std::vector<unsigned int>& cpus);
+}
+
+#endif // UTILS_HPP